@@ -0,0 +1,147 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Network scenario for the NATIVE_SIM platform. Node 0 is a gateway doing a continuous FG scan,
+// all other nodes push sensor data to it like the sensor_push example, with a random interval
+// so the nodes do not stay synchronised. At the end of the simulation the delivery statistics
+// of each node are printed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scheduler.h"
+#include "timer.h"
+#include "debug.h"
+#include "d7ap_fs.h"
+#include "log.h"
+#include "ng.h"
+
+#include "d7ap.h"
+#include "alp_layer.h"
+
+#include "platform.h"
+#include "sim.h"
+
+#define GATEWAY_NODE_ID         0
+#define SENSOR_FILE_ID          0x40
+#define SENSOR_INTERVAL_SEC     10
+
+#if !defined(PLATFORM_NATIVE_SIM)
+    #error This application requires the NATIVE_SIM platform
+#endif
+
+static alp_interface_config_t itf_config = (alp_interface_config_t){
+  .itf_id = ALP_ITF_ID_D7ASP,
+  .d7ap_session_config = {
+    .qos = {
+        .qos_resp_mode = SESSION_RESP_MODE_PREFERRED,
+        .qos_retry_mode = SESSION_RETRY_MODE_NO
+    },
+    .dormant_timeout = 0,
+    .addressee = {
+        .ctrl = {
+            .nls_method = AES_NONE,
+            .id_type = ID_TYPE_NOID,
+        },
+        .access_class = 0x01,
+        .id = { 0 }
+    }
+  }
+};
+
+static alp_init_args_t NGDEF(alp_init_args);
+static uint8_t NGDEF(alp_command)[128];
+static uint16_t NGDEF(sequence_number);
+static uint32_t NGDEF(pushes_sent);
+static uint32_t NGDEF(pushes_acked);
+static uint32_t NGDEF(pushes_received);
+
+static void execute_sensor_measurement()
+{
+  // the payload identifies the node and the measurement
+  uint8_t payload[3] = { get_node_global_id(), NG(sequence_number) >> 8, NG(sequence_number) & 0xFF };
+  NG(sequence_number)++;
+
+  fifo_t alp_command_fifo;
+  fifo_init(&alp_command_fifo, NG(alp_command), sizeof(NG(alp_command)));
+  alp_append_forward_action(&alp_command_fifo, &itf_config, sizeof(itf_config));
+  alp_append_return_file_data_action(&alp_command_fifo, SENSOR_FILE_ID, 0, sizeof(payload), payload);
+
+  NG(pushes_sent)++;
+  alp_layer_process_command(NG(alp_command), fifo_get_size(&alp_command_fifo), ALP_ITF_ID_HOST, NULL);
+}
+
+static void schedule_sensor_measurement()
+{
+  // uniformly distributed between 0.5 and 1.5 times the interval
+  timer_tick_t interval = SENSOR_INTERVAL_SEC * TIMER_TICKS_PER_SEC;
+  timer_post_task_delay(&execute_sensor_measurement, interval / 2 + rand() % interval);
+}
+
+static void on_alp_command_completed_cb(uint8_t tag_id, bool success)
+{
+  if(success)
+    NG(pushes_acked)++;
+
+  schedule_sensor_measurement();
+}
+
+static void on_alp_command_result_cb(alp_interface_status_t* result, uint8_t* payload, uint8_t payload_length)
+{
+}
+
+static void on_unsolicited_response_received(alp_interface_status_t* result, uint8_t *alp_command, uint8_t alp_command_size)
+{
+  NG(pushes_received)++;
+}
+
+static void print_statistics()
+{
+  uint16_t current_node = get_node_global_id();
+  printf("node  pushes  acked  received\n");
+  for(uint16_t node = 0; node < sim_config.node_count; node++)
+  {
+    set_node_global_id(node);
+    printf("%4u %7u %6u %9u\n", node, NG(pushes_sent), NG(pushes_acked), NG(pushes_received));
+  }
+
+  set_node_global_id(current_node);
+}
+
+void bootstrap()
+{
+  d7ap_init();
+
+  if(get_node_global_id() == GATEWAY_NODE_ID)
+  {
+    d7ap_fs_write_dll_conf_active_access_class(0x01); // set to first AC, which is continuous FG scan
+    NG(alp_init_args).alp_received_unsolicited_data_cb = &on_unsolicited_response_received;
+    alp_layer_init(&NG(alp_init_args), false);
+    atexit(&print_statistics);
+  }
+  else
+  {
+    NG(alp_init_args).alp_command_completed_cb = &on_alp_command_completed_cb;
+    NG(alp_init_args).alp_command_result_cb = &on_alp_command_result_cb;
+    alp_layer_init(&NG(alp_init_args), false);
+
+    sched_register_task(&execute_sensor_measurement);
+    schedule_sensor_measurement();
+  }
+}
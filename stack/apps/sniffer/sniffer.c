@@ -28,118 +28,118 @@
 #include "hwlcd.h"
 #endif
 #include "hwsystem.h"
-#include "hwradio.h"
 #include "hwatomic.h"
 
 #include "packet_queue.h"
+#include "phy.h"
+#include "d7ap_fs.h"
 #include "timer.h"
 #include "log.h"
 #include "debug.h"
 #include "platform.h"
-#include "shell.h"
-#include "fs.h"
+#include "fifo.h"
 #include "scheduler.h"
 #include "console.h"
 #include "version.h"
-
-#include "alp_cmd_handler.h"
-
-#define PACKET_FIFO_BUFFER_SIZE (10 * sizeof(hw_radio_packet_t))
-
-hw_radio_packet_t packet;
-fifo_t packet_fifo;
-uint8_t packet_fifo_buffer[PACKET_FIFO_BUFFER_SIZE];
-
-hw_radio_packet_t* alloc_packet(uint8_t length)
-{
-  return &packet;
-}
-
-void free_packet(hw_radio_packet_t* packet)
+#include "radio_capture.h"
+
+// room for a few frames of the maximum size, queued as capture records followed by the frame. The frames are
+// recorded as read from the radio, so FEC coded frames take up to twice the decoded size
+#define MAX_FRAME_SIZE (2 * (UINT8_MAX + 3))
+#define CAPTURE_FIFO_BUFFER_SIZE (4 * (sizeof(radio_capture_record_t) + MAX_FRAME_SIZE))
+
+static fifo_t capture_fifo;
+static uint8_t capture_fifo_buffer[CAPTURE_FIFO_BUFFER_SIZE];
+
+static channel_id_t rx_channel = {
+  .channel_header = {
+    .ch_coding = PHY_CODING_PN9,
+    .ch_class = PHY_CLASS_NORMAL_RATE,
+    .ch_freq_band = PHY_BAND_868
+  },
+  .center_freq_index = 0
+};
+
+// the frames are sent as capture records, see radio_capture.h
+static void process_fifo()
 {
-}
-
-void process_fifo()
-{
-  hw_radio_packet_t current_packet;
-  start_atomic();
-    while(fifo_get_size(&packet_fifo) > sizeof(hw_radio_packet_t))
+  radio_capture_record_t record;
+  static uint8_t frame[MAX_FRAME_SIZE];
+  while(true)
+  {
+    start_atomic();
+    if(fifo_get_size(&capture_fifo) < sizeof(record))
     {
-      fifo_pop(&packet_fifo, (uint8_t*)&current_packet, sizeof(hw_radio_packet_t));
-      console_print_byte(0xC0);
-      console_print_byte(1);
-      console_print_bytes(current_packet.data, current_packet.length); // TODO include metadata
+      end_atomic();
+      return;
     }
-  end_atomic();
-}
 
-void on_packet_received(hw_radio_packet_t* packet)
-{
-  fifo_put(&packet_fifo, (uint8_t*)packet, sizeof(hw_radio_packet_t));
-  sched_post_task(&process_fifo);
+    fifo_pop(&capture_fifo, (uint8_t*)&record, sizeof(record));
+    fifo_pop(&capture_fifo, frame, record.length);
+    end_atomic();
+
+    console_print_byte(RADIO_CAPTURE_SERIAL_SYNC);
+    console_print_byte(RADIO_CAPTURE_SERIAL_RECORD);
+    console_print_bytes((uint8_t*)&record, sizeof(record));
+    // console_print_bytes() takes at most UINT8_MAX bytes
+    for(uint16_t offset = 0; offset < record.length; offset += UINT8_MAX)
+      console_print_bytes(frame + offset, record.length - offset > UINT8_MAX ? UINT8_MAX : record.length - offset);
+  }
 }
 
-void bootstrap()
+// called from interrupt context before the PHY decodes the frame, so the capture contains the bit errors which
+// the FEC corrects or which make the CRC fail, like the radio received them
+static void on_raw_packet_received(packet_t* packet)
 {
-  dae_access_profile_t access_classes[] = {
-    {
-      .control_scan_type_is_foreground = true,
-      .control_csma_ca_mode = CSMA_CA_MODE_UNC,
-      .control_number_of_subbands = 1,
-      .subnet = 0x00,
-      .scan_automation_period = 0,
-      .subbands[0] = (subband_t){
-        .channel_header = {
-          .ch_coding = PHY_CODING_PN9,
-          .ch_class = PHY_CLASS_NORMAL_RATE,
-          .ch_freq_band = PHY_BAND_868
-        },
-        .channel_index_start = 0,
-        .channel_index_end = 0,
-        .eirp = 0,
-        .ccao = 0
-      }
-    }
+  hw_radio_packet_t* hw_radio_packet = &packet->hw_radio_packet;
+  radio_capture_record_t record = {
+    .timestamp = hw_radio_packet->rx_meta.timestamp,
+    .channel_header = packet->phy_config.rx.channel_id.channel_header_raw,
+    .center_freq_index = packet->phy_config.rx.channel_id.center_freq_index,
+    .syncword_class = packet->phy_config.rx.syncword_class,
+    .rssi = hw_radio_packet->rx_meta.rssi,
+    .lqi = hw_radio_packet->rx_meta.lqi,
+    .flags = 0,
+    .length = hw_radio_packet->length
   };
 
-  fs_init_args_t fs_init_args = (fs_init_args_t){
-      .fs_user_files_init_cb = NULL,
-      .access_profiles_count = 1,
-      .access_profiles = access_classes
-  };
+#ifdef HAL_RADIO_USE_HW_DC_FREE
+  record.flags |= RADIO_CAPTURE_FLAG_PN9_DECODED;
+#endif
+#ifdef HAL_RADIO_USE_HW_FEC
+  record.flags |= RADIO_CAPTURE_FLAG_FEC_DECODED;
+#endif
 
-  fs_init(&fs_init_args);
+  if(fifo_get_size(&capture_fifo) + sizeof(record) + record.length <= CAPTURE_FIFO_BUFFER_SIZE)
+  {
+    fifo_put(&capture_fifo, (uint8_t*)&record, sizeof(record));
+    fifo_put(&capture_fifo, hw_radio_packet->data, record.length);
+    sched_post_task(&process_fifo);
+  }
+  else
+    log_print_string("capture fifo full, frame dropped");
+}
 
-  shell_init();
-  shell_register_handler((cmd_handler_registration_t){ .id = ALP_CMD_HANDLER_ID, .cmd_handler_callback = &alp_cmd_handler });
+// the frame was recorded by on_raw_packet_received() already
+static void on_packet_received(packet_t* packet)
+{
+  packet_queue_free_packet(packet);
+}
 
-  // notify booted to serial
-  uint8_t read_firmware_version_alp_command[] = { 0x01, D7A_FILE_FIRMWARE_VERSION_FILE_ID, 0, D7A_FILE_FIRMWARE_VERSION_SIZE };
-  alp_process_command_console_output(read_firmware_version_alp_command, sizeof(read_firmware_version_alp_command));
+void bootstrap()
+{
+  d7ap_fs_init();
+  packet_queue_init();
+  phy_init();
 
-  fifo_init(&packet_fifo, packet_fifo_buffer, PACKET_FIFO_BUFFER_SIZE);
+  fifo_init(&capture_fifo, capture_fifo_buffer, CAPTURE_FIFO_BUFFER_SIZE);
 
   sched_register_task(&process_fifo);
 
-  hw_radio_init(alloc_packet, free_packet);
-
-  hw_rx_cfg_t rx_cfg = {
-    .channel_id = {
-      .channel_header = {
-        .ch_coding = PHY_CODING_PN9,
-        .ch_class = PHY_CLASS_NORMAL_RATE,
-        .ch_freq_band = PHY_BAND_868
-      },
-      .center_freq_index = 0
-    },
-    .syncword_class = PHY_SYNCWORD_CLASS1
-  };
-
-  hw_radio_set_rx(&rx_cfg, &on_packet_received, NULL);
+  phy_set_raw_rx_callback(&on_raw_packet_received);
+  phy_start_rx(&rx_channel, PHY_SYNCWORD_CLASS1, &on_packet_received);
 
 #ifdef HAS_LCD
   lcd_write_string("SNIFFER %s", _GIT_SHA1);
 #endif
-
 }
-
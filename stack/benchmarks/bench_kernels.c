@@ -0,0 +1,353 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmarks of the coding, crypto, fifo and ALP kernels. These work on frames with the sizes of benchmark_sizes.
+ * Kernels which modify their input in place (FEC decoding, AES-CCM decryption) first copy the frame, this copy is
+ * included in the result.
+ */
+
+#include <string.h>
+
+#include "benchmark.h"
+#include "crc.h"
+#include "pn9.h"
+#include "fec.h"
+#include "aes.h"
+#include "fifo.h"
+#include "alp.h"
+#include "d7ap.h"
+#include "debug.h"
+
+#define FRAME_BUFFER_SIZE 256
+#define FEC_BUFFER_SIZE (2 * (FRAME_BUFFER_SIZE + 3))
+#define CCM_AUTH_LEN 4
+#define ALP_COMMAND_COUNT 16
+
+static uint8_t frame[FEC_BUFFER_SIZE];
+static uint8_t encoded_frames[BENCHMARK_SIZE_COUNT][FEC_BUFFER_SIZE];
+static uint16_t encoded_lengths[BENCHMARK_SIZE_COUNT];
+
+static const uint8_t key[AES_BLOCK_SIZE] = {
+    0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f
+};
+static uint8_t iv[AES_BLOCK_SIZE] = { 0x49, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 };
+static uint8_t ctr_blk[AES_BLOCK_SIZE] = { 0x01, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 };
+static uint8_t add[8] = { 0xAA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 }; // the UID, as used for unicast
+
+static uint8_t fifo_buffer[FRAME_BUFFER_SIZE];
+
+static uint8_t alp_requests[ALP_COMMAND_COUNT][ALP_PAYLOAD_MAX_SIZE];
+static uint8_t alp_request_lengths[ALP_COMMAND_COUNT];
+static uint8_t alp_responses[ALP_COMMAND_COUNT][ALP_PAYLOAD_MAX_SIZE];
+static uint8_t alp_response_lengths[ALP_COMMAND_COUNT];
+
+static volatile uint32_t sink; // keeps the compiler from optimising the results away
+
+static void fill_frame(void)
+{
+    for(uint16_t i = 0; i < sizeof(frame); i++)
+        frame[i] = i * 7 + 3;
+}
+
+static uint32_t run_crc(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    uint16_t crc = 0;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t size = benchmark_get_size(i);
+        crc ^= crc_calculate(frame, size);
+        bytes += size;
+    }
+
+    sink = crc;
+    return bytes;
+}
+
+static uint32_t run_pn9(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t size = benchmark_get_size(i);
+        pn9_encode(frame, size);
+        bytes += size;
+    }
+
+    return bytes;
+}
+
+static uint32_t run_fec_encode(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t size = benchmark_get_size(i);
+        fec_encode(frame, size);
+        bytes += size;
+    }
+
+    return bytes;
+}
+
+static void setup_fec_decode(void)
+{
+    fill_frame();
+    for(uint16_t i = 0; i < BENCHMARK_SIZE_COUNT; i++)
+    {
+        memcpy(encoded_frames[i], frame, benchmark_sizes[i]);
+        encoded_lengths[i] = fec_encode(encoded_frames[i], benchmark_sizes[i]);
+    }
+
+    fill_frame();
+}
+
+static uint32_t run_fec_decode(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t idx = i & (BENCHMARK_SIZE_COUNT - 1);
+        memcpy(frame, encoded_frames[idx], encoded_lengths[idx]);
+        fec_decode_packet(frame, encoded_lengths[idx], encoded_lengths[idx]);
+        bytes += benchmark_sizes[idx];
+    }
+
+    return bytes;
+}
+
+static void setup_aes(void)
+{
+    AES128_init(key);
+    fill_frame();
+}
+
+static uint32_t run_ccm_encrypt(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    uint8_t ctr[AES_BLOCK_SIZE];
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t size = benchmark_get_size(i);
+        memcpy(ctr, ctr_blk, AES_BLOCK_SIZE);
+        AES128_CCM_encrypt(frame, size, iv, add, sizeof(add), ctr, CCM_AUTH_LEN);
+        bytes += size;
+    }
+
+    return bytes;
+}
+
+static void setup_ccm_decrypt(void)
+{
+    setup_aes();
+    uint8_t ctr[AES_BLOCK_SIZE];
+    for(uint16_t i = 0; i < BENCHMARK_SIZE_COUNT; i++)
+    {
+        memcpy(encoded_frames[i], frame, benchmark_sizes[i]);
+        memcpy(ctr, ctr_blk, AES_BLOCK_SIZE);
+        AES128_CCM_encrypt(encoded_frames[i], benchmark_sizes[i], iv, add, sizeof(add), ctr, CCM_AUTH_LEN);
+    }
+}
+
+static uint32_t run_ccm_decrypt(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    uint8_t ctr[AES_BLOCK_SIZE];
+    error_t errors = SUCCESS;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t idx = i & (BENCHMARK_SIZE_COUNT - 1);
+        uint8_t size = benchmark_sizes[idx];
+        memcpy(frame, encoded_frames[idx], size + CCM_AUTH_LEN);
+        memcpy(ctr, ctr_blk, AES_BLOCK_SIZE);
+        errors |= AES128_CCM_decrypt(frame, size, iv, add, sizeof(add), ctr, frame + size, CCM_AUTH_LEN);
+        bytes += size;
+    }
+
+    assert(errors == SUCCESS);
+    return bytes;
+}
+
+static uint32_t run_fifo_copy(uint32_t ops)
+{
+    fifo_t fifo;
+    uint32_t bytes = 0;
+    fifo_init(&fifo, fifo_buffer, sizeof(fifo_buffer));
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t size = benchmark_get_size(i);
+        fifo_put(&fifo, frame, size);
+        fifo_pop(&fifo, frame, size);
+        bytes += size;
+    }
+
+    return bytes;
+}
+
+static uint32_t run_fifo_byte(uint32_t ops)
+{
+    fifo_t fifo;
+    uint32_t bytes = 0;
+    fifo_init(&fifo, fifo_buffer, sizeof(fifo_buffer));
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t size = benchmark_get_size(i);
+        for(uint8_t j = 0; j < size; j++)
+            fifo_put_byte(&fifo, frame[j]);
+
+        fifo_pop(&fifo, frame, size);
+        bytes += size;
+    }
+
+    return bytes;
+}
+
+static uint32_t run_fifo_span(uint32_t ops)
+{
+    fifo_t fifo;
+    fifo_span_t spans[2];
+    uint32_t bytes = 0;
+    uint32_t sum = 0;
+    fifo_init(&fifo, fifo_buffer, sizeof(fifo_buffer));
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        // produced in place (like a DMA), consumed in place (like the CRC over a received frame)
+        uint8_t size = benchmark_get_size(i);
+        fifo_reserve(&fifo, spans);
+        uint8_t part1 = spans[0].len < size ? spans[0].len : size;
+        memcpy(spans[0].data, frame, part1);
+        memcpy(spans[1].data, frame + part1, size - part1);
+        fifo_commit(&fifo, size);
+
+        fifo_peek_spans(&fifo, spans);
+        part1 = spans[0].len < size ? spans[0].len : size;
+        sum += spans[0].data[0] + spans[part1 < size].data[0];
+        fifo_consume(&fifo, size);
+        bytes += size;
+    }
+
+    sink = sum;
+    return bytes;
+}
+
+static uint8_t alp_data_length(uint16_t idx, uint8_t max)
+{
+    uint8_t size = benchmark_sizes[idx];
+    return size > max ? max : size;
+}
+
+// requests as sent by the host through a gateway, and the responses of the nodes
+static void setup_alp(void)
+{
+    fifo_t fifo;
+    uint8_t data[ALP_PAYLOAD_MAX_SIZE] = { 0 };
+    alp_interface_config_t itf_config = (alp_interface_config_t){
+        .itf_id = ALP_ITF_ID_D7ASP,
+        .d7ap_session_config = {
+            .qos = { .qos_resp_mode = SESSION_RESP_MODE_PREFERRED },
+            .addressee = {
+                .ctrl = { .nls_method = AES_NONE, .id_type = ID_TYPE_UID },
+                .access_class = 0x01,
+                .id = { 0xAA, 0, 0, 0, 0, 0, 0, 0x01 }
+            }
+        }
+    };
+
+    alp_interface_status_t status = (alp_interface_status_t){
+        .itf_id = ALP_ITF_ID_D7ASP,
+        .d7ap_session_result = {
+            .channel = { .channel_header = 0x12, .center_freq_index = 0x20 },
+            .rx_level = 70,
+            .link_budget = 80,
+            .addressee = itf_config.d7ap_session_config.addressee
+        }
+    };
+
+    for(uint8_t i = 0; i < ALP_COMMAND_COUNT; i++)
+    {
+        fifo_init(&fifo, alp_requests[i], ALP_PAYLOAD_MAX_SIZE);
+        alp_append_forward_action(&fifo, &itf_config, sizeof(itf_config));
+        alp_append_tag_request_action(&fifo, i, true);
+        if(i % 2)
+            alp_append_read_file_data_action(&fifo, 0x40, 0, alp_data_length(i, 128), true, false);
+        else
+            alp_append_write_file_data_action(&fifo, 0x41, 0, alp_data_length(i, 128), data, true, false);
+
+        alp_request_lengths[i] = fifo_get_size(&fifo);
+
+        fifo_init(&fifo, alp_responses[i], ALP_PAYLOAD_MAX_SIZE);
+        alp_append_interface_status(&fifo, &status);
+        alp_append_return_file_data_action(&fifo, 0x40, 0, alp_data_length(i, 160), data);
+        alp_response_lengths[i] = fifo_get_size(&fifo);
+    }
+}
+
+static uint32_t run_alp_parse_action(uint32_t ops)
+{
+    fifo_t fifo;
+    alp_action_t action;
+    uint32_t bytes = 0;
+    uint32_t actions = 0;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t c = i % ALP_COMMAND_COUNT;
+        fifo_init_filled(&fifo, alp_responses[c], alp_response_lengths[c], ALP_PAYLOAD_MAX_SIZE);
+        while(fifo_get_size(&fifo) > 0)
+        {
+            alp_parse_action(&fifo, &action);
+            actions++;
+        }
+
+        bytes += alp_response_lengths[c];
+    }
+
+    sink = actions;
+    return bytes;
+}
+
+static uint32_t run_alp_expected_response_length(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    uint32_t response_length = 0;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t c = i % ALP_COMMAND_COUNT;
+        response_length += alp_get_expected_response_length(alp_requests[c], alp_request_lengths[c]);
+        bytes += alp_request_lengths[c];
+    }
+
+    sink = response_length;
+    return bytes;
+}
+
+const benchmark_t kernel_benchmarks[] = {
+    { "crc_calculate", fill_frame, run_crc },
+    { "pn9_encode", fill_frame, run_pn9 },
+    { "fec_encode", fill_frame, run_fec_encode },
+    { "fec_decode_packet", setup_fec_decode, run_fec_decode },
+    { "AES128_CCM_encrypt", setup_aes, run_ccm_encrypt },
+    { "AES128_CCM_decrypt", setup_ccm_decrypt, run_ccm_decrypt },
+    { "fifo_put/fifo_pop", fill_frame, run_fifo_copy },
+    { "fifo_put_byte/fifo_pop", fill_frame, run_fifo_byte },
+    { "fifo_reserve/fifo_peek_spans", fill_frame, run_fifo_span },
+    { "alp_parse_action", setup_alp, run_alp_parse_action },
+    { "alp_get_expected_response_length", setup_alp, run_alp_expected_response_length },
+};
+
+const uint8_t kernel_benchmark_count = sizeof(kernel_benchmarks) / sizeof(kernel_benchmarks[0]);
@@ -0,0 +1,213 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmarks which need the stack to be initialised, like a gateway: the assembly and disassembly of D7A frames and
+ * the scheduler and timer operations.
+ */
+
+#include <string.h>
+
+#include "benchmark.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "fifo.h"
+#include "alp.h"
+#include "alp_layer.h"
+#include "d7ap.h"
+#include "d7ap_fs.h"
+#include "packet.h"
+#include "packet_queue.h"
+#include "debug.h"
+
+#define PENDING_TASK_COUNT 8
+#define PENDING_TIMER_COUNT 4
+#define FRAME_COUNT 16
+
+static alp_init_args_t alp_init_args;
+static uint32_t unsolicited_responses = 0;
+
+static uint8_t frames[FRAME_COUNT][PACKET_MAX_HEADER_SIZE + 255];
+static uint16_t frame_lengths[FRAME_COUNT];
+
+static void dummy_task0(void* arg) {}
+static void dummy_task1(void* arg) {}
+static void dummy_task2(void* arg) {}
+static void dummy_task3(void* arg) {}
+static void dummy_task4(void* arg) {}
+static void dummy_task5(void* arg) {}
+static void dummy_task6(void* arg) {}
+static void dummy_task7(void* arg) {}
+
+static const task_t dummy_tasks[PENDING_TASK_COUNT] = {
+    dummy_task0, dummy_task1, dummy_task2, dummy_task3, dummy_task4, dummy_task5, dummy_task6, dummy_task7
+};
+
+// an unsolicited report of a node, broadcast without requesting an acknowledgement
+static void fill_packet(packet_t* packet, uint8_t payload_length)
+{
+    uint8_t* payload = packet_get_tx_payload_buffer(packet);
+    fifo_t fifo;
+    uint8_t data[D7A_PAYLOAD_MAX_SIZE] = { 0 };
+    fifo_init(&fifo, payload, D7A_PAYLOAD_MAX_SIZE);
+    alp_append_return_file_data_action(&fifo, 0x40, 0, payload_length, data);
+
+    packet->payload_length = fifo_get_size(&fifo);
+    packet->dll_header.subnet = 0x01;
+    packet->dll_header.control_target_id_type = ID_TYPE_NOID;
+    packet->d7anp_ctrl.origin_id_type = ID_TYPE_UID;
+    packet->origin_access_class = 0x01;
+    packet->d7atp_ctrl.ctrl_is_start = true;
+    packet->d7atp_dialog_id = 1;
+}
+
+static void on_unsolicited_response_received(alp_interface_status_t* result, uint8_t *alp_command, uint8_t alp_command_size)
+{
+    unsolicited_responses++;
+}
+
+static uint8_t frame_payload_length(uint8_t idx)
+{
+    // leave room for the ALP operand and headers
+    uint8_t size = benchmark_sizes[idx];
+    return size > 180 ? 180 : size;
+}
+
+static uint32_t run_packet_assemble(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        packet_t* packet = packet_queue_alloc_packet();
+        fill_packet(packet, frame_payload_length(i % FRAME_COUNT));
+        packet_assemble(packet);
+        bytes += packet->hw_radio_packet.length;
+        packet_queue_free_packet(packet);
+    }
+
+    return bytes;
+}
+
+static void setup_packet_disassemble(void)
+{
+    for(uint8_t i = 0; i < FRAME_COUNT; i++)
+    {
+        packet_t* packet = packet_queue_alloc_packet();
+        fill_packet(packet, frame_payload_length(i));
+        packet_assemble(packet);
+        frame_lengths[i] = packet->hw_radio_packet.length;
+        memcpy(frames[i], packet->hw_radio_packet.data + packet->hw_radio_packet.tx_meta.data_offset, frame_lengths[i]);
+        packet_queue_free_packet(packet);
+    }
+}
+
+/*
+ * Hands a received frame to the DLL, like phy.c does, and runs the upper layers until the packet is processed
+ * completely. This includes the delivery of the unsolicited response to the ALP layer.
+ */
+static uint32_t run_packet_disassemble(uint32_t ops)
+{
+    uint32_t bytes = 0;
+    uint32_t expected_responses = unsolicited_responses + ops;
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        uint8_t idx = i % FRAME_COUNT;
+        packet_t* packet = packet_queue_alloc_packet();
+        assert(packet != NULL);
+        memcpy(packet->hw_radio_packet.data, frames[idx], frame_lengths[idx]);
+        packet->hw_radio_packet.length = frame_lengths[idx];
+        packet->hw_radio_packet.rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+        packet->hw_radio_packet.rx_meta.timestamp = timer_get_counter_value();
+        packet->hw_radio_packet.rx_meta.rssi = -70;
+
+        packet_queue_mark_processing(packet);
+        packet_disassemble(packet);
+        // the upper layers process the packet from tasks, this runs nested in the benchmark task
+        scheduler_run_pending_tasks();
+        bytes += frame_lengths[idx];
+    }
+
+    assert(unsolicited_responses == expected_responses); // none of the frames was filtered
+    return bytes;
+}
+
+static void setup_tasks(void)
+{
+    for(uint8_t i = 0; i < PENDING_TASK_COUNT; i++)
+        sched_register_task(dummy_tasks[i]);
+}
+
+static uint32_t run_sched_post_task(uint32_t ops)
+{
+    // a post followed by a cancel, with some other tasks pending
+    for(uint8_t i = 1; i < PENDING_TASK_COUNT; i++)
+        sched_post_task_prio(dummy_tasks[i], MIN_PRIORITY, NULL);
+
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        sched_post_task_prio(dummy_tasks[0], DEFAULT_PRIORITY, NULL);
+        sched_cancel_task(dummy_tasks[0]);
+    }
+
+    for(uint8_t i = 1; i < PENDING_TASK_COUNT; i++)
+        sched_cancel_task(dummy_tasks[i]);
+
+    return 0;
+}
+
+static uint32_t run_timer_post_task(uint32_t ops)
+{
+    // a post followed by a cancel, with some other timers pending. The time does not advance on the NATIVE platform,
+    // so the timers do not fire.
+    timer_tick_t now = timer_get_counter_value();
+    for(uint8_t i = 1; i <= PENDING_TIMER_COUNT; i++)
+        timer_post_task_prio(dummy_tasks[i], now + 1000 * i, DEFAULT_PRIORITY, 0, NULL);
+
+    for(uint32_t i = 0; i < ops; i++)
+    {
+        timer_post_task_prio(dummy_tasks[0], now + 100 + (i & 0xFFF), DEFAULT_PRIORITY, 0, NULL);
+        timer_cancel_task(dummy_tasks[0]);
+    }
+
+    for(uint8_t i = 1; i <= PENDING_TIMER_COUNT; i++)
+        timer_cancel_task(dummy_tasks[i]);
+
+    return 0;
+}
+
+// an operation of the scheduler and the timer takes a few tens of ns, which varies by up to 50% between runs
+// depending on the code and data placement on the host
+const benchmark_t stack_benchmarks[] = {
+    { "packet_assemble", NULL, run_packet_assemble },
+    { "packet_disassemble", setup_packet_disassemble, run_packet_disassemble },
+    { "sched_post_task_prio", setup_tasks, run_sched_post_task, 60 },
+    { "timer_post_task_prio", setup_tasks, run_timer_post_task, 60 },
+};
+
+const uint8_t stack_benchmark_count = sizeof(stack_benchmarks) / sizeof(stack_benchmarks[0]);
+
+void bootstrap()
+{
+    // initialised like a gateway
+    d7ap_init();
+    d7ap_fs_write_dll_conf_active_access_class(0x01);
+    alp_init_args.alp_received_unsolicited_data_cb = &on_unsolicited_response_received;
+    alp_layer_init(&alp_init_args, false);
+
+    benchmarks_start();
+}
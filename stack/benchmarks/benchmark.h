@@ -0,0 +1,67 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file benchmark.h
+ *
+ *  \brief The microbenchmarks of the stack's hot kernels, run on the NATIVE platform
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "types.h"
+
+/*! \brief A single benchmark
+ *
+ * run() performs the given number of operations and returns the number of bytes processed by them, which is used
+ * to calculate the throughput. Benchmarks which do not process a byte stream return 0.
+ */
+typedef struct
+{
+    const char* name;
+    void (*setup)(void);            /**< Called once before the benchmark is run, can be NULL */
+    uint32_t (*run)(uint32_t ops);
+    uint8_t tolerance_percent;      /**< The change between runs which is still noise, 0 uses the default threshold */
+} benchmark_t;
+
+/*! \brief The number of entries in benchmark_sizes, a power of 2 */
+#define BENCHMARK_SIZE_COUNT 256
+
+/*! \brief Frame sizes, drawn from the distribution seen by a gateway
+ *
+ * Kernels which work on frames cycle through these sizes, see benchmark_get_size().
+ */
+extern uint8_t benchmark_sizes[BENCHMARK_SIZE_COUNT];
+
+static inline uint8_t benchmark_get_size(uint32_t op)
+{
+    return benchmark_sizes[op & (BENCHMARK_SIZE_COUNT - 1)];
+}
+
+/*! \brief Benchmarks of the kernels which do not need the stack to be running, see bench_kernels.c */
+extern const benchmark_t kernel_benchmarks[];
+extern const uint8_t kernel_benchmark_count;
+
+/*! \brief Benchmarks which need an initialised stack, see bench_stack.c */
+extern const benchmark_t stack_benchmarks[];
+extern const uint8_t stack_benchmark_count;
+
+/*! \brief Parses the command line and posts the task running all benchmarks, to be called once the stack is initialised */
+void benchmarks_start(void);
+
+#endif /* BENCHMARK_H_ */
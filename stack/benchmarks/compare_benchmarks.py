@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+
+# Compares the results of stack_benchmarks.elf against a baseline and flags the benchmarks which became slower by more
+# than the threshold. The exit code is 1 when a regression is found, so this can be used in CI.
+#
+# usage: compare_benchmarks.py <baseline.json> <results.json> [-t <threshold in %, default 25>] [--init]
+#
+# The numbers depend on the host, so the baseline should be generated on the machine running the comparison:
+#   stack_benchmarks.elf -o baseline.json
+# or using --init, which stores the results as baseline when the baseline does not exist yet.
+#
+# A benchmark only regresses when the change exceeds the threshold, its own tolerance and the spread between the
+# samples of the baseline and the results combined, so the noise of the host is not reported as a regression.
+
+import argparse
+import json
+import os
+import shutil
+import sys
+
+
+def load(path):
+  with open(path) as f:
+    results = json.load(f)
+
+  return results, {b["name"]: b for b in results["benchmarks"]}
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Compare benchmark results against a baseline")
+  parser.add_argument("baseline", help="the JSON file with the baseline results")
+  parser.add_argument("results", help="the JSON file with the new results")
+  parser.add_argument("-t", "--threshold", type=float, default=25.0,
+                      help="the allowed increase of the time per operation, in percent (default: 25)")
+  parser.add_argument("--init", action="store_true",
+                      help="store the results as baseline when the baseline does not exist")
+  args = parser.parse_args()
+
+  if args.init and not os.path.exists(args.baseline):
+    shutil.copyfile(args.results, args.baseline)
+    print("no baseline found, stored the results as baseline in {}".format(args.baseline))
+    return 0
+
+  baseline, baseline_benchmarks = load(args.baseline)
+  results, result_benchmarks = load(args.results)
+
+  print("baseline: {} ({}), results: {} ({})".format(baseline["git_sha1"], baseline["build_type"],
+                                                     results["git_sha1"], results["build_type"]))
+  if baseline["build_type"] != results["build_type"]:
+    print("warning: comparing different build types, the results are not representative")
+
+  regressions = 0
+  print("{:<40} {:>12} {:>12} {:>8} {:>8}".format("benchmark", "baseline", "ns/op", "change", "allowed"))
+  for name, result in result_benchmarks.items():
+    if name not in baseline_benchmarks:
+      print("{:<40} {:>12} {:>12.1f} {:>8}".format(name, "-", result["ns_per_op"], "new"))
+      continue
+
+    old = baseline_benchmarks[name]["ns_per_op"]
+    change = (result["ns_per_op"] - old) * 100.0 / old
+    # results without the spread or the tolerance (older results, gateway_replay) only use the threshold
+    noise = baseline_benchmarks[name].get("spread_percent", 0.0) + result.get("spread_percent", 0.0)
+    allowed = max(args.threshold, result.get("tolerance_percent", 0.0), noise)
+    marker = ""
+    if change > allowed:
+      marker = "  REGRESSION"
+      regressions += 1
+
+    print("{:<40} {:>12.1f} {:>12.1f} {:>+7.1f}% {:>7.1f}%{}".format(name, old, result["ns_per_op"], change, allowed,
+                                                                    marker))
+
+  for name in baseline_benchmarks:
+    if name not in result_benchmarks:
+      print("{:<40} {:>12.1f} {:>12} {:>8}".format(name, baseline_benchmarks[name]["ns_per_op"], "-", "missing"))
+
+  if regressions:
+    print("{} benchmark(s) regressed by more than the allowed change".format(regressions))
+    return 1
+
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,123 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the EEPROM programming done by the file system on the NATIVE platform.
+ *
+ * The metadata and the permanent files are stored in a simulated EEPROM which accounts the time spent programming
+ * and the words and bytes which were actually programmed. This reports the program time of the file system
+ * initialisation done at boot, and of the writes the stack does while running: the PHY and DLL status updated
+ * by every background scan and the frame counter of the node, one event per second.
+ * For both the bytes written are compared to the bytes requested by the file system, and to the bytes passed to
+ * d7ap_fs_write_file() by the callers.
+ *
+ * usage: fs_eeprom.elf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "d7ap_fs.h"
+#include "platform.h"
+#include "timer.h"
+
+#define EVENT_COUNT 600
+
+static uint32_t bytes_written_by_callers = 0;
+
+static uint32_t get_bytes_programmed(const blockdevice_sim_eeprom_stats_t* stats)
+{
+    return stats->word_programs * BLOCKDEVICE_SIM_EEPROM_WORD_SIZE + stats->byte_programs;
+}
+
+static void print_stats(const char* name)
+{
+    blockdevice_sim_eeprom_stats_t metadata_stats;
+    blockdevice_sim_eeprom_stats_t permanent_stats;
+    native_get_blockdevice_stats(&metadata_stats, &permanent_stats);
+
+    printf("%s:\n", name);
+    const blockdevice_sim_eeprom_stats_t* stats[] = { &metadata_stats, &permanent_stats };
+    const char* bd_names[] = { "metadata", "permanent" };
+    for(uint8_t i = 0; i < 2; i++)
+    {
+        printf("  %-10s %6u program calls, %6u bytes requested, %6u bytes written (%u skipped), %8.1f ms programming, max wear %u\n",
+               bd_names[i], stats[i]->program_calls, stats[i]->bytes_requested, get_bytes_programmed(stats[i]),
+               stats[i]->bytes_skipped, stats[i]->program_time_us / 1000.0, stats[i]->max_wear);
+    }
+}
+
+static void write(uint8_t file_id, uint32_t offset, const uint8_t* data, uint32_t length)
+{
+    if(d7ap_fs_write_file(file_id, offset, data, length) != 0)
+    {
+        printf("FAILED: writing file %i\n", file_id);
+        exit(1);
+    }
+
+    bytes_written_by_callers += length;
+}
+
+static void run_write_sequence()
+{
+    for(uint16_t i = 0; i < EVENT_COUNT; i++)
+    {
+        // the noise floor of the scanned channel and the DLL status, updated by every background scan
+        uint8_t noise_floor = 0x50 + (i % 5);
+        write(D7A_FILE_PHY_STATUS_FILE_ID, 8, &noise_floor, 1);
+        uint8_t dll_status[2] = { (uint8_t)(i >> 8), (uint8_t)i };
+        write(D7A_FILE_DLL_STATUS_FILE_ID, 0, dll_status, sizeof(dll_status));
+
+        // the key counter and the big endian frame counter, incremented for every secured frame transmitted
+        uint32_t frame_counter = i + 1;
+        uint8_t nwl_security[D7A_FILE_NWL_SECURITY_SIZE] = { 0, frame_counter >> 24, frame_counter >> 16, frame_counter >> 8, frame_counter };
+        write(D7A_FILE_NWL_SECURITY, 0, nwl_security, sizeof(nwl_security));
+
+        native_timer_advance(native_timer_get_ticks_per_sec());
+    }
+
+    d7ap_fs_flush();
+}
+
+void bootstrap()
+{
+    native_reset_blockdevice_stats();
+    d7ap_fs_init();
+    print_stats("file system initialisation at boot");
+
+    native_reset_blockdevice_stats();
+    run_write_sequence();
+    char name[80];
+    snprintf(name, sizeof(name), "%i events, %u bytes written by the callers", EVENT_COUNT, bytes_written_by_callers);
+    print_stats(name);
+
+    const d7ap_fs_cache_stats_t* cache_stats = d7ap_fs_get_cache_stats();
+    printf("cache: %i writes and %i bytes saved, %u flushes, %u header reads saved\n", cache_stats->writes_saved,
+           cache_stats->bytes_saved, cache_stats->flushes, cache_stats->header_reads_saved);
+
+    // the status writes are coalesced by the cache and the EEPROM only programs the changed words and bytes
+    blockdevice_sim_eeprom_stats_t permanent_stats;
+    native_get_blockdevice_stats(NULL, &permanent_stats);
+    if(get_bytes_programmed(&permanent_stats) > permanent_stats.bytes_requested
+       || permanent_stats.bytes_requested > bytes_written_by_callers)
+    {
+        printf("FAILED: more bytes programmed than written\n");
+        exit(1);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,490 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a radio capture (see radio_capture.h) through the receive path of a gateway on the NATIVE platform, to
+ * measure the throughput of the stack offline.
+ *
+ * The stack is initialised like the gateway app, including the modem interface on a pseudo-terminal which is
+ * drained by a host thread. The frames are injected in the radio driver, so they take the real path from phy.c
+ * through the DLL, network, transport and session layers to ALP and the modem interface. The virtual time of the
+ * platform follows the timestamps of the capture, so the protocol timers behave like they did when the capture was
+ * taken, independent of the replay speed.
+ *
+ * The CPU time per layer is measured by wrapping the entry points of the layers using the --wrap option of the
+ * linker. The time of a layer excludes the time of the layers above it. Timers and tasks, like the processing of
+ * the ALP command and the modem interface, are accounted separately. A frame which does not reach ALP is counted
+ * as a drop of the highest layer it reached.
+ *
+ * usage: gateway_replay.elf <capture> [-x <speed, 1 = as recorded, 0 = as fast as possible>] [-l <loops>]
+ *                                     [-o <results.json>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "scheduler.h"
+#include "timer.h"
+#include "crc.h"
+#include "pn9.h"
+#include "fec.h"
+#include "alp_layer.h"
+#include "d7ap.h"
+#include "d7ap_fs.h"
+#include "packet.h"
+#include "d7asp.h"
+#include "d7ap_stack.h"
+#include "modem_interface.h"
+#include "radio_capture.h"
+#include "version.h"
+#include "debug.h"
+#include "platform.h"
+
+typedef enum
+{
+    LAYER_PHY,
+    LAYER_DLL,
+    LAYER_NWL,
+    LAYER_TRANS,
+    LAYER_SESSION,
+    LAYER_ALP,
+    LAYER_TASKS,
+    LAYER_COUNT
+} layer_t;
+
+static const char* layer_names[LAYER_COUNT] = { "PHY", "DLL", "NWL", "TRANS", "SESSION", "ALP", "timers+tasks" };
+
+typedef enum
+{
+    DROP_NOT_LISTENING,
+    DROP_RADIO_NOT_RX,
+    DROP_TOO_LONG,
+    DROP_NO_PACKET,
+    DROP_PHY,
+    DROP_DLL_CRC,
+    DROP_DLL_FILTER,
+    DROP_NWL,
+    DROP_TRANS,
+    DROP_SESSION,
+    DROP_COUNT
+} drop_reason_t;
+
+static const char* drop_names[DROP_COUNT] = {
+    "PHY not listening on the channel/syncword",
+    "radio not in RX",
+    "frame too long",
+    "packet queue full",
+    "PHY: not passed to the DLL",
+    "DLL: CRC invalid",
+    "DLL: subnet, address or header",
+    "NWL: rejected",
+    "TRANS: rejected",
+    "SESSION: no payload",
+};
+
+static alp_init_args_t alp_init_args;
+
+static const char* capture_path;
+static double speed = 0;
+static uint32_t loops = 1;
+static const char* json_path = NULL;
+
+static uint8_t* capture;
+static long capture_size;
+static uint32_t capture_ticks_per_sec;
+
+static uint64_t layer_ns[LAYER_COUNT];
+static uint64_t nested_ns;
+static layer_t highest_layer;
+static bool crc_invalid;
+static uint32_t drops[DROP_COUNT];
+static uint32_t frame_count = 0;
+static uint32_t delivered_count = 0;
+static uint32_t recoded_count = 0;
+static uint64_t frame_bytes = 0;
+static uint64_t capture_duration_ticks = 0;
+static volatile uint64_t serial_bytes = 0;
+
+static uint64_t get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// accumulates the time of 'call' in 'layer', excluding the time of the (timed) layers it calls
+#define TIMED(layer, call) do {                         \
+        uint64_t __outer_nested_ns = nested_ns;         \
+        nested_ns = 0;                                  \
+        if(layer != LAYER_TASKS && highest_layer < layer) \
+            highest_layer = layer;                      \
+        uint64_t __start = get_time_ns();               \
+        call;                                           \
+        uint64_t __elapsed = get_time_ns() - __start;   \
+        layer_ns[layer] += __elapsed - nested_ns;       \
+        nested_ns = __outer_nested_ns + __elapsed;      \
+    } while(0)
+
+// the entry points of the layers, see the description on top
+
+void __real_packet_disassemble(packet_t* packet);
+void __wrap_packet_disassemble(packet_t* packet)
+{
+    // the same check as packet_disassemble() does, only to tell CRC errors apart from other drops
+    if(packet->hw_radio_packet.rx_meta.crc_status == HW_CRC_UNAVAILABLE)
+    {
+        uint16_t crc = __builtin_bswap16(crc_calculate(packet->hw_radio_packet.data, packet->hw_radio_packet.length - 2));
+        crc_invalid = memcmp(&crc, packet->hw_radio_packet.data + packet->hw_radio_packet.length - 2, 2) != 0;
+    }
+
+    TIMED(LAYER_DLL, __real_packet_disassemble(packet));
+}
+
+void __real_d7anp_process_received_packet(packet_t* packet);
+void __wrap_d7anp_process_received_packet(packet_t* packet)
+{
+    TIMED(LAYER_NWL, __real_d7anp_process_received_packet(packet));
+}
+
+void __real_d7atp_process_received_packet(packet_t* packet);
+void __wrap_d7atp_process_received_packet(packet_t* packet)
+{
+    TIMED(LAYER_TRANS, __real_d7atp_process_received_packet(packet));
+}
+
+bool __real_d7asp_process_received_packet(packet_t* packet);
+bool __wrap_d7asp_process_received_packet(packet_t* packet)
+{
+    bool result;
+    TIMED(LAYER_SESSION, result = __real_d7asp_process_received_packet(packet));
+    return result;
+}
+
+bool __real_d7ap_stack_process_unsolicited_request(uint8_t* payload, uint8_t length, d7ap_session_result_t result);
+bool __wrap_d7ap_stack_process_unsolicited_request(uint8_t* payload, uint8_t length, d7ap_session_result_t result)
+{
+    bool expect_response;
+    TIMED(LAYER_ALP, expect_response = __real_d7ap_stack_process_unsolicited_request(payload, length, result));
+    return expect_response;
+}
+
+void __real_d7ap_stack_process_received_response(uint8_t* payload, uint8_t length, d7ap_session_result_t result);
+void __wrap_d7ap_stack_process_received_response(uint8_t* payload, uint8_t length, d7ap_session_result_t result)
+{
+    TIMED(LAYER_ALP, __real_d7ap_stack_process_received_response(payload, length, result));
+}
+
+static void on_unsolicited_response_received(alp_interface_status_t* result, uint8_t *alp_command, uint8_t alp_command_size)
+{
+}
+
+// the host side of the modem interface, which only drains the pseudo-terminal
+static void* serial_reader(void* arg)
+{
+    int fd = open(native_uart_get_pty_name(0), O_RDWR | O_NOCTTY);
+    assert(fd >= 0);
+    uint8_t buffer[256];
+    ssize_t count;
+    while((count = read(fd, buffer, sizeof(buffer))) > 0)
+        __atomic_add_fetch(&serial_bytes, count, __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+static void load_capture()
+{
+    FILE* file = fopen(capture_path, "rb");
+    if(file == NULL)
+    {
+        perror(capture_path);
+        exit(1);
+    }
+
+    fseek(file, 0, SEEK_END);
+    capture_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    capture = malloc(capture_size);
+    assert(capture != NULL);
+    if(fread(capture, 1, capture_size, file) != capture_size)
+    {
+        perror(capture_path);
+        exit(1);
+    }
+
+    fclose(file);
+
+    radio_capture_header_t header;
+    if(capture_size < sizeof(header))
+    {
+        fprintf(stderr, "%s: not a capture file\n", capture_path);
+        exit(1);
+    }
+
+    memcpy(&header, capture, sizeof(header));
+    if(header.magic != RADIO_CAPTURE_MAGIC || header.version != RADIO_CAPTURE_VERSION || header.ticks_per_sec == 0)
+    {
+        fprintf(stderr, "%s: not a capture file or unsupported version\n", capture_path);
+        exit(1);
+    }
+
+    capture_ticks_per_sec = header.ticks_per_sec;
+}
+
+static drop_reason_t inject(const radio_capture_record_t* record, const uint8_t* data)
+{
+    channel_id_t channel = { .channel_header_raw = record->channel_header, .center_freq_index = record->center_freq_index };
+    if(!phy_is_rx_on(&channel, record->syncword_class))
+        return DROP_NOT_LISTENING;
+
+    // the PHY of the NATIVE platform decodes in software, so undo the decoding done by the radio which captured.
+    // Such frames are coded again without the bit errors of the air, see radio_capture.h
+    uint8_t frame[2 * (255 + 3)];
+    uint16_t length = record->length;
+    bool fec_decoded = (record->flags & RADIO_CAPTURE_FLAG_FEC_DECODED)
+                       && channel.channel_header.ch_coding == PHY_CODING_FEC_PN9;
+    if(length > (fec_decoded ? 255 : sizeof(frame)))
+        return DROP_TOO_LONG;
+
+    memcpy(frame, data, length);
+    if(fec_decoded)
+        length = fec_encode(frame, length);
+
+    if(fec_decoded || (record->flags & RADIO_CAPTURE_FLAG_PN9_DECODED))
+        recoded_count++;
+
+    if(record->flags & RADIO_CAPTURE_FLAG_PN9_DECODED)
+        pn9_encode(frame, length);
+
+    error_t err;
+    TIMED(LAYER_PHY, err = native_radio_inject_frame(frame, length, record->rssi, record->lqi));
+    switch(err)
+    {
+        case SUCCESS: break;
+        case EOFF: return DROP_RADIO_NOT_RX;
+        case ESIZE: return DROP_TOO_LONG;
+        case ENOMEM: return DROP_NO_PACKET;
+        default: assert(false);
+    }
+
+    TIMED(LAYER_TASKS, scheduler_run_pending_tasks());
+    switch(highest_layer)
+    {
+        case LAYER_PHY: return DROP_PHY;
+        case LAYER_DLL: return crc_invalid ? DROP_DLL_CRC : DROP_DLL_FILTER;
+        case LAYER_NWL: return DROP_NWL;
+        case LAYER_TRANS: return DROP_TRANS;
+        case LAYER_SESSION: return DROP_SESSION;
+        default: return DROP_COUNT; // delivered
+    }
+}
+
+static void replay_loop(uint64_t start_ticks, uint64_t wall_start_ns)
+{
+    uint32_t native_ticks_per_sec = native_timer_get_ticks_per_sec();
+    uint64_t capture_ticks = 0;
+    uint32_t previous_timestamp = 0;
+    bool first = true;
+    long offset = sizeof(radio_capture_header_t);
+    while(offset + (long)sizeof(radio_capture_record_t) <= capture_size)
+    {
+        radio_capture_record_t record;
+        memcpy(&record, capture + offset, sizeof(record));
+        offset += sizeof(record);
+        if(offset + record.length > capture_size)
+        {
+            fprintf(stderr, "%s: truncated record\n", capture_path);
+            break;
+        }
+
+        // the timestamps wrap around
+        if(!first)
+            capture_ticks += (uint32_t)(record.timestamp - previous_timestamp);
+
+        first = false;
+        previous_timestamp = record.timestamp;
+
+        uint64_t target = start_ticks + capture_ticks * native_ticks_per_sec / capture_ticks_per_sec;
+        if(target > native_timer_get_ticks())
+            TIMED(LAYER_TASKS, native_timer_advance(target - native_timer_get_ticks()));
+
+        if(speed > 0)
+        {
+            uint64_t wall_target_ns = wall_start_ns + (uint64_t)(capture_ticks * 1e9 / capture_ticks_per_sec / speed);
+            struct timespec ts = { .tv_sec = wall_target_ns / 1000000000, .tv_nsec = wall_target_ns % 1000000000 };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+
+        highest_layer = LAYER_PHY;
+        crc_invalid = false;
+        drop_reason_t result = inject(&record, capture + offset);
+        if(result == DROP_COUNT)
+            delivered_count++;
+        else
+            drops[result]++;
+
+        frame_count++;
+        frame_bytes += record.length;
+        offset += record.length;
+    }
+
+    capture_duration_ticks = capture_ticks;
+}
+
+static void report(uint64_t wall_ns)
+{
+    uint64_t total_ns = 0;
+    for(uint8_t i = 0; i < LAYER_COUNT; i++)
+        total_ns += layer_ns[i];
+
+    double capture_s = (double)capture_duration_ticks / capture_ticks_per_sec;
+    printf("Replayed %u frames (%llu bytes) of %.1f s of capture, %u time(s), in %.3f s\n", frame_count,
+           (unsigned long long)frame_bytes, capture_s, loops, wall_ns / 1e9);
+    printf("Delivered to ALP: %u (%.1f%%), %llu bytes forwarded on the modem interface\n", delivered_count,
+           frame_count ? 100.0 * delivered_count / frame_count : 0, (unsigned long long)serial_bytes);
+    if(recoded_count)
+        printf("Coded again without bit errors: %u frames, which do not exercise the FEC correction\n", recoded_count);
+
+    printf("Stack CPU time: %.3f ms, %.1f us/frame, %.0f frames/s\n\n", total_ns / 1e6,
+           frame_count ? total_ns / 1e3 / frame_count : 0, total_ns ? frame_count * 1e9 / total_ns : 0);
+
+    printf("%-14s %12s %12s %8s\n", "layer", "CPU ms", "us/frame", "share");
+    for(uint8_t i = 0; i < LAYER_COUNT; i++)
+    {
+        uint64_t ns = layer_ns[i];
+        printf("%-14s %12.3f %12.2f %7.1f%%\n", layer_names[i], ns / 1e6, frame_count ? ns / 1e3 / frame_count : 0,
+               total_ns ? 100.0 * ns / total_ns : 0);
+    }
+
+    printf("\n%-44s %10s\n", "drop reason", "frames");
+    for(uint8_t i = 0; i < DROP_COUNT; i++)
+    {
+        if(drops[i])
+            printf("%-44s %10u\n", drop_names[i], drops[i]);
+    }
+
+    if(json_path == NULL)
+        return;
+
+    // in the format of the benchmark results, so compare_benchmarks.py can be used to detect regressions
+    FILE* file = fopen(json_path, "w");
+    if(file == NULL)
+    {
+        perror(json_path);
+        exit(1);
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"git_sha1\": \"%s\",\n", _GIT_SHA1);
+    fprintf(file, "  \"build_type\": \"%s\",\n", BENCHMARK_BUILD_TYPE);
+    fprintf(file, "  \"capture\": \"%s\",\n", capture_path);
+    fprintf(file, "  \"frames\": %u,\n", frame_count);
+    fprintf(file, "  \"delivered\": %u,\n", delivered_count);
+    fprintf(file, "  \"recoded\": %u,\n", recoded_count);
+    fprintf(file, "  \"drops\": {");
+    for(uint8_t i = 0; i < DROP_COUNT; i++)
+        fprintf(file, "%s\n    \"%s\": %u", i ? "," : "", drop_names[i], drops[i]);
+
+    fprintf(file, "\n  },\n");
+    fprintf(file, "  \"benchmarks\": [\n");
+    fprintf(file, "    { \"name\": \"gateway_replay\", \"ops\": %u, \"ns_per_op\": %.3f, \"bytes_per_s\": %.0f }",
+            frame_count, frame_count ? (double)total_ns / frame_count : 0, total_ns ? frame_bytes * 1e9 / total_ns : 0);
+    for(uint8_t i = 0; i < LAYER_COUNT; i++)
+    {
+        fprintf(file, ",\n    { \"name\": \"gateway_replay/%s\", \"ops\": %u, \"ns_per_op\": %.3f, \"bytes_per_s\": 0 }",
+                layer_names[i], frame_count, frame_count ? (double)layer_ns[i] / frame_count : 0);
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+    printf("\nResults written to %s\n", json_path);
+}
+
+static void replay()
+{
+#ifndef NDEBUG
+    printf("Warning: this is a debug build, use CMAKE_BUILD_TYPE=Release for representative numbers\n");
+#endif
+    // let the modem interface and the stack settle before the first frame
+    native_timer_advance(native_timer_get_ticks_per_sec());
+
+    uint64_t wall_start_ns = get_time_ns();
+    for(uint32_t i = 0; i < loops; i++)
+    {
+        // the loops are separated by a second, to let the dialogs of the previous loop finish
+        uint64_t start_ticks = native_timer_get_ticks() + native_timer_get_ticks_per_sec();
+        replay_loop(start_ticks, get_time_ns());
+    }
+
+    // complete the pending dialogs and flush the modem interface
+    TIMED(LAYER_TASKS, native_timer_advance(native_timer_get_ticks_per_sec()));
+    uint64_t wall_ns = get_time_ns() - wall_start_ns;
+
+    report(wall_ns);
+    exit(0);
+}
+
+static void parse_args()
+{
+    int argc;
+    char** argv = native_get_args(&argc);
+    int opt;
+    while((opt = getopt(argc, argv, "x:l:o:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'x': speed = atof(optarg); break;
+            case 'l': loops = atoi(optarg); break;
+            case 'o': json_path = optarg; break;
+            default: optind = argc + 1; break;
+        }
+    }
+
+    if(optind != argc - 1 || loops == 0 || speed < 0)
+    {
+        fprintf(stderr, "usage: %s <capture> [-x <speed, 1 = as recorded, 0 = as fast as possible>] [-l <loops>] "
+                        "[-o <results.json>]\n", argv[0]);
+        exit(1);
+    }
+
+    capture_path = argv[optind];
+}
+
+void bootstrap()
+{
+    parse_args();
+    load_capture();
+
+    // initialised like the gateway app
+    modem_interface_init(0, 115200, (pin_id_t) 0, (pin_id_t) 0);
+    pthread_t reader;
+    int rc = pthread_create(&reader, NULL, &serial_reader, NULL);
+    assert(rc == 0);
+
+    d7ap_init();
+    d7ap_fs_write_dll_conf_active_access_class(0x01); // set to first AC, which is continuous FG scan
+    alp_init_args.alp_received_unsolicited_data_cb = &on_unsolicited_response_received;
+    alp_layer_init(&alp_init_args, true);
+
+    sched_register_task(&replay);
+    sched_post_task_prio(&replay, MIN_PRIORITY, NULL);
+}
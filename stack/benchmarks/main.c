@@ -0,0 +1,238 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Microbenchmarks of the hot kernels of the stack, run on the NATIVE platform.
+ *
+ * Each benchmark is calibrated so a sample takes about the requested time, the median of a number of samples is
+ * reported together with the spread between the fastest and the slowest sample, which indicates how much the host
+ * disturbed the measurement. The results are printed and, when requested, written as JSON which can be compared
+ * against a baseline using compare_benchmarks.py.
+ *
+ * usage: stack_benchmarks.elf [-o <results.json>] [-f <name filter>] [-t <sample time in ms>] [-n <samples>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "scheduler.h"
+#include "version.h"
+#include "debug.h"
+#include "platform.h"
+
+#define DEFAULT_SAMPLE_TIME_MS 100
+#define DEFAULT_SAMPLES 5
+#define MAX_SAMPLES 32
+#define MAX_RESULTS 32
+
+typedef struct
+{
+    const char* name;
+    uint32_t ops;
+    double ns_per_op;
+    double bytes_per_s;
+    double spread_percent;
+    uint8_t tolerance_percent;
+} result_t;
+
+uint8_t benchmark_sizes[BENCHMARK_SIZE_COUNT];
+
+static const char* json_path = NULL;
+static const char* filter = NULL;
+static uint32_t sample_time_ms = DEFAULT_SAMPLE_TIME_MS;
+static uint8_t samples = DEFAULT_SAMPLES;
+static result_t results[MAX_RESULTS];
+static uint8_t result_count = 0;
+
+static uint64_t get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The size of the frames handled by a gateway: mostly sensor reports and acknowledgements, some file reads and
+// writes and few large transfers. The sizes are drawn once using a fixed seed, so all runs use the same sequence.
+static void generate_sizes()
+{
+    static const struct { uint8_t min; uint8_t max; uint8_t weight; } size_classes[] = {
+        { 8, 16, 30 },      // acknowledgements, short responses
+        { 17, 48, 45 },     // sensor reports
+        { 49, 128, 20 },    // file reads and writes
+        { 129, 200, 5 },    // large transfers
+    };
+
+    uint32_t seed = 0x4F535337;
+    for(uint16_t i = 0; i < BENCHMARK_SIZE_COUNT; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        uint8_t pick = (seed >> 16) % 100;
+        uint8_t c = 0;
+        while(pick >= size_classes[c].weight)
+            pick -= size_classes[c++].weight;
+
+        seed = seed * 1103515245 + 12345;
+        benchmark_sizes[i] = size_classes[c].min + (seed >> 16) % (size_classes[c].max - size_classes[c].min + 1);
+    }
+}
+
+static void measure(const benchmark_t* benchmark)
+{
+    if(filter != NULL && strstr(benchmark->name, filter) == NULL)
+        return;
+
+    assert(result_count < MAX_RESULTS);
+    if(benchmark->setup)
+        benchmark->setup();
+
+    // warm up the caches, then double the number of operations until a run takes at least 10% of a sample
+    uint32_t ops = 16;
+    benchmark->run(ops);
+    uint64_t duration;
+    while(true)
+    {
+        uint64_t start = get_time_ns();
+        benchmark->run(ops);
+        duration = get_time_ns() - start;
+        if(duration * 10 >= sample_time_ms * 1000000ULL || ops >= 0x40000000)
+            break;
+
+        ops *= 2;
+    }
+
+    uint64_t scaled_ops = ops * (sample_time_ms * 1000000ULL) / (duration ? duration : 1);
+    ops = scaled_ops < 1 ? 1 : (scaled_ops > 0xFFFFFFFF ? 0xFFFFFFFF : scaled_ops);
+
+    uint64_t durations[MAX_SAMPLES];
+    uint32_t bytes = 0;
+    for(uint8_t i = 0; i < samples; i++)
+    {
+        uint64_t start = get_time_ns();
+        bytes = benchmark->run(ops);
+        duration = get_time_ns() - start;
+
+        // insertion sort, the number of samples is small
+        uint8_t j = i;
+        for(; j > 0 && durations[j - 1] > duration; j--)
+            durations[j] = durations[j - 1];
+
+        durations[j] = duration;
+    }
+
+    double median_duration = (samples & 1) ? durations[samples / 2]
+                                           : (durations[samples / 2 - 1] + durations[samples / 2]) / 2.0;
+    result_t* result = &results[result_count++];
+    result->name = benchmark->name;
+    result->ops = ops;
+    result->ns_per_op = median_duration / ops;
+    result->bytes_per_s = bytes * 1e9 / median_duration;
+    result->spread_percent = (durations[samples - 1] - durations[0]) * 100.0 / median_duration;
+    result->tolerance_percent = benchmark->tolerance_percent;
+    printf("%-40s %10.1f ns/op", result->name, result->ns_per_op);
+    if(bytes)
+        printf(" %10.2f MB/s", result->bytes_per_s / 1e6);
+    else
+        printf(" %15s", "");
+
+    printf("  spread %5.1f%%\n", result->spread_percent);
+}
+
+static void write_json()
+{
+    FILE* file = fopen(json_path, "w");
+    if(file == NULL)
+    {
+        perror(json_path);
+        exit(1);
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"git_sha1\": \"%s\",\n", _GIT_SHA1);
+    fprintf(file, "  \"build_type\": \"%s\",\n", BENCHMARK_BUILD_TYPE);
+    fprintf(file, "  \"benchmarks\": [\n");
+    for(uint8_t i = 0; i < result_count; i++)
+    {
+        fprintf(file, "    { \"name\": \"%s\", \"ops\": %u, \"ns_per_op\": %.3f, \"bytes_per_s\": %.0f, "
+                "\"spread_percent\": %.1f",
+                results[i].name, results[i].ops, results[i].ns_per_op, results[i].bytes_per_s, results[i].spread_percent);
+        if(results[i].tolerance_percent)
+            fprintf(file, ", \"tolerance_percent\": %u", results[i].tolerance_percent);
+
+        fprintf(file, " }%s\n", i + 1 < result_count ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    printf("Results written to %s\n", json_path);
+}
+
+static void parse_args()
+{
+    int argc;
+    char** argv = native_get_args(&argc);
+    int opt;
+    while((opt = getopt(argc, argv, "o:f:t:n:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'o': json_path = optarg; break;
+            case 'f': filter = optarg; break;
+            case 't': sample_time_ms = atoi(optarg); break;
+            case 'n': samples = atoi(optarg) > MAX_SAMPLES ? 0 : atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-o <results.json>] [-f <name filter>] [-t <sample time in ms>] [-n <samples>]\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    if(sample_time_ms == 0 || samples == 0)
+    {
+        fprintf(stderr, "the sample time should be at least 1 and the number of samples between 1 and %i\n", MAX_SAMPLES);
+        exit(1);
+    }
+}
+
+static void run_benchmarks()
+{
+#ifndef NDEBUG
+    printf("Warning: this is a debug build, use CMAKE_BUILD_TYPE=Release for representative numbers\n");
+#endif
+    for(uint8_t i = 0; i < kernel_benchmark_count; i++)
+        measure(&kernel_benchmarks[i]);
+
+    for(uint8_t i = 0; i < stack_benchmark_count; i++)
+        measure(&stack_benchmarks[i]);
+
+    if(json_path)
+        write_json();
+
+    exit(0);
+}
+
+// called from bootstrap() once the stack is initialised, see bench_stack.c
+void benchmarks_start()
+{
+    parse_args();
+    generate_sizes();
+    sched_register_task(&run_benchmarks);
+    sched_post_task_prio(&run_benchmarks, MIN_PRIORITY, NULL);
+}
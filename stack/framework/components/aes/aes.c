@@ -60,6 +60,7 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 #include <string.h> // CBC mode, for memset
 #include "stdbool.h"
 #include "aes.h"
+#include "framework_defs.h"
 
 #ifdef HAL_SUPPORT_HW_AES
 #include "hwaes.h"
@@ -89,21 +90,9 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 /*****************************************************************************/
 // state - array holding the intermediate results during decryption.
 typedef uint8_t state_t[4][4];
-static state_t *state;
 
-// The array that stores the round keys.
-static uint8_t RoundKey[176];
-
-// The array that stores the 128 bits key
-static uint8_t AES128_key[16];
-
-// The Key input to the AES Program
-static const uint8_t *Key;
-
-#if defined(CBC) && CBC
-    // Initial Vector used only for CBC mode
-    static uint8_t *Iv;
-#endif
+// The context used by the AES128_xxx() functions, which work with the key set by AES128_init()
+static aes128_ctx_t default_ctx;
 
 // The lookup-tables are marked const so they can be placed in read-only storage instead of RAM
 // The numbers below can be computed dynamically trading ROM for RAM -
@@ -168,6 +157,45 @@ static const uint8_t Rcon[255] = {
     0x61, 0xc2, 0x9f, 0x25, 0x4a, 0x94, 0x33, 0x66, 0xcc, 0x83, 0x1d, 0x3a, 0x74, 0xe8, 0xcb };
 
 
+#if defined(FRAMEWORK_AES_TTABLE)
+// Te0[x] contains column (2 * S[x], S[x], S[x], 3 * S[x]) of the MixColumns multiplication, the tables
+// for the other rows of the state are rotations of this table.
+static const uint32_t Te0[256] = {
+    0xc66363a5, 0xf87c7c84, 0xee777799, 0xf67b7b8d, 0xfff2f20d, 0xd66b6bbd, 0xde6f6fb1, 0x91c5c554,
+    0x60303050, 0x02010103, 0xce6767a9, 0x562b2b7d, 0xe7fefe19, 0xb5d7d762, 0x4dababe6, 0xec76769a,
+    0x8fcaca45, 0x1f82829d, 0x89c9c940, 0xfa7d7d87, 0xeffafa15, 0xb25959eb, 0x8e4747c9, 0xfbf0f00b,
+    0x41adadec, 0xb3d4d467, 0x5fa2a2fd, 0x45afafea, 0x239c9cbf, 0x53a4a4f7, 0xe4727296, 0x9bc0c05b,
+    0x75b7b7c2, 0xe1fdfd1c, 0x3d9393ae, 0x4c26266a, 0x6c36365a, 0x7e3f3f41, 0xf5f7f702, 0x83cccc4f,
+    0x6834345c, 0x51a5a5f4, 0xd1e5e534, 0xf9f1f108, 0xe2717193, 0xabd8d873, 0x62313153, 0x2a15153f,
+    0x0804040c, 0x95c7c752, 0x46232365, 0x9dc3c35e, 0x30181828, 0x379696a1, 0x0a05050f, 0x2f9a9ab5,
+    0x0e070709, 0x24121236, 0x1b80809b, 0xdfe2e23d, 0xcdebeb26, 0x4e272769, 0x7fb2b2cd, 0xea75759f,
+    0x1209091b, 0x1d83839e, 0x582c2c74, 0x341a1a2e, 0x361b1b2d, 0xdc6e6eb2, 0xb45a5aee, 0x5ba0a0fb,
+    0xa45252f6, 0x763b3b4d, 0xb7d6d661, 0x7db3b3ce, 0x5229297b, 0xdde3e33e, 0x5e2f2f71, 0x13848497,
+    0xa65353f5, 0xb9d1d168, 0x00000000, 0xc1eded2c, 0x40202060, 0xe3fcfc1f, 0x79b1b1c8, 0xb65b5bed,
+    0xd46a6abe, 0x8dcbcb46, 0x67bebed9, 0x7239394b, 0x944a4ade, 0x984c4cd4, 0xb05858e8, 0x85cfcf4a,
+    0xbbd0d06b, 0xc5efef2a, 0x4faaaae5, 0xedfbfb16, 0x864343c5, 0x9a4d4dd7, 0x66333355, 0x11858594,
+    0x8a4545cf, 0xe9f9f910, 0x04020206, 0xfe7f7f81, 0xa05050f0, 0x783c3c44, 0x259f9fba, 0x4ba8a8e3,
+    0xa25151f3, 0x5da3a3fe, 0x804040c0, 0x058f8f8a, 0x3f9292ad, 0x219d9dbc, 0x70383848, 0xf1f5f504,
+    0x63bcbcdf, 0x77b6b6c1, 0xafdada75, 0x42212163, 0x20101030, 0xe5ffff1a, 0xfdf3f30e, 0xbfd2d26d,
+    0x81cdcd4c, 0x180c0c14, 0x26131335, 0xc3ecec2f, 0xbe5f5fe1, 0x359797a2, 0x884444cc, 0x2e171739,
+    0x93c4c457, 0x55a7a7f2, 0xfc7e7e82, 0x7a3d3d47, 0xc86464ac, 0xba5d5de7, 0x3219192b, 0xe6737395,
+    0xc06060a0, 0x19818198, 0x9e4f4fd1, 0xa3dcdc7f, 0x44222266, 0x542a2a7e, 0x3b9090ab, 0x0b888883,
+    0x8c4646ca, 0xc7eeee29, 0x6bb8b8d3, 0x2814143c, 0xa7dede79, 0xbc5e5ee2, 0x160b0b1d, 0xaddbdb76,
+    0xdbe0e03b, 0x64323256, 0x743a3a4e, 0x140a0a1e, 0x924949db, 0x0c06060a, 0x4824246c, 0xb85c5ce4,
+    0x9fc2c25d, 0xbdd3d36e, 0x43acacef, 0xc46262a6, 0x399191a8, 0x319595a4, 0xd3e4e437, 0xf279798b,
+    0xd5e7e732, 0x8bc8c843, 0x6e373759, 0xda6d6db7, 0x018d8d8c, 0xb1d5d564, 0x9c4e4ed2, 0x49a9a9e0,
+    0xd86c6cb4, 0xac5656fa, 0xf3f4f407, 0xcfeaea25, 0xca6565af, 0xf47a7a8e, 0x47aeaee9, 0x10080818,
+    0x6fbabad5, 0xf0787888, 0x4a25256f, 0x5c2e2e72, 0x381c1c24, 0x57a6a6f1, 0x73b4b4c7, 0x97c6c651,
+    0xcbe8e823, 0xa1dddd7c, 0xe874749c, 0x3e1f1f21, 0x964b4bdd, 0x61bdbddc, 0x0d8b8b86, 0x0f8a8a85,
+    0xe0707090, 0x7c3e3e42, 0x71b5b5c4, 0xcc6666aa, 0x904848d8, 0x06030305, 0xf7f6f601, 0x1c0e0e12,
+    0xc26161a3, 0x6a35355f, 0xae5757f9, 0x69b9b9d0, 0x17868691, 0x99c1c158, 0x3a1d1d27, 0x279e9eb9,
+    0xd9e1e138, 0xebf8f813, 0x2b9898b3, 0x22111133, 0xd26969bb, 0xa9d9d970, 0x078e8e89, 0x339494a7,
+    0x2d9b9bb6, 0x3c1e1e22, 0x15878792, 0xc9e9e920, 0x87cece49, 0xaa5555ff, 0x50282878, 0xa5dfdf7a,
+    0x038c8c8f, 0x59a1a1f8, 0x09898980, 0x1a0d0d17, 0x65bfbfda, 0xd7e6e631, 0x844242c6, 0xd06868b8,
+    0x824141c3, 0x299999b0, 0x5a2d2d77, 0x1e0f0f11, 0x7bb0b0cb, 0xa85454fc, 0x6dbbbbd6, 0x2c16163a
+};
+#endif
+
 /*****************************************************************************/
 /* Private functions:                                                        */
 /*****************************************************************************/
@@ -181,75 +209,44 @@ static uint8_t getSBoxInvert(uint8_t num)
     return rsbox[num];
 }
 
+// The round keys are stored as big endian words, word i contains the bytes 4i to 4i + 3 of the expanded key
+#define ROUND_KEY_BYTE(round_keys, index) ((uint8_t)((round_keys)[(index) / 4] >> (24 - 8 * ((index) % 4))))
+
 // This function produces Nb(Nr+1) round keys. The round keys are used in each round to decrypt the states.
-static void KeyExpansion(void)
+static void KeyExpansion(uint32_t *RoundKey, const uint8_t *Key)
 {
-    uint32_t i, j, k;
-    uint8_t tempa[4]; // Used for the column/row operations
+    uint32_t i;
+    uint32_t temp;
 
     // The first round key is the key itself.
     for (i = 0; i < Nk; ++i)
     {
-        RoundKey[(i * 4) + 0] = Key[(i * 4) + 0];
-        RoundKey[(i * 4) + 1] = Key[(i * 4) + 1];
-        RoundKey[(i * 4) + 2] = Key[(i * 4) + 2];
-        RoundKey[(i * 4) + 3] = Key[(i * 4) + 3];
+        RoundKey[i] = ((uint32_t)Key[i * 4] << 24) | ((uint32_t)Key[i * 4 + 1] << 16) |
+                      ((uint32_t)Key[i * 4 + 2] << 8) | Key[i * 4 + 3];
     }
 
     // All other round keys are found from the previous round keys.
     for (; (i < (Nb * (Nr + 1))); ++i)
     {
-        for (j = 0; j < 4; ++j)
-        {
-            tempa[j] = RoundKey[(i-1) * 4 + j];
-        }
+        temp = RoundKey[i - 1];
         if (i % Nk == 0)
         {
-            // This function rotates the 4 bytes in a word to the left once.
-            // [a0,a1,a2,a3] becomes [a1,a2,a3,a0]
-
-            // Function RotWord()
-            {
-                k = tempa[0];
-                tempa[0] = tempa[1];
-                tempa[1] = tempa[2];
-                tempa[2] = tempa[3];
-                tempa[3] = k;
-            }
-
-            // SubWord() is a function that takes a four-byte input word and
-            // applies the S-box to each of the four bytes to produce an output word.
-
-            // Function Subword()
-            {
-                tempa[0] = getSBoxValue(tempa[0]);
-                tempa[1] = getSBoxValue(tempa[1]);
-                tempa[2] = getSBoxValue(tempa[2]);
-                tempa[3] = getSBoxValue(tempa[3]);
-            }
-
-            tempa[0] =  tempa[0] ^ Rcon[i/Nk];
+            // RotWord() rotates the 4 bytes in a word to the left once, SubWord() applies the S-box
+            // to each of the four bytes.
+            temp = ((uint32_t)getSBoxValue((temp >> 16) & 0xff) << 24) ^
+                   ((uint32_t)getSBoxValue((temp >> 8) & 0xff) << 16) ^
+                   ((uint32_t)getSBoxValue(temp & 0xff) << 8) ^
+                   getSBoxValue(temp >> 24);
+
+            temp ^= (uint32_t)Rcon[i/Nk] << 24;
         }
-        else if (Nk > 6 && i % Nk == 4)
-        {
-            // Function Subword()
-            {
-                tempa[0] = getSBoxValue(tempa[0]);
-                tempa[1] = getSBoxValue(tempa[1]);
-                tempa[2] = getSBoxValue(tempa[2]);
-                tempa[3] = getSBoxValue(tempa[3]);
-            }
-        }
-        RoundKey[i * 4 + 0] = RoundKey[(i - Nk) * 4 + 0] ^ tempa[0];
-        RoundKey[i * 4 + 1] = RoundKey[(i - Nk) * 4 + 1] ^ tempa[1];
-        RoundKey[i * 4 + 2] = RoundKey[(i - Nk) * 4 + 2] ^ tempa[2];
-        RoundKey[i * 4 + 3] = RoundKey[(i - Nk) * 4 + 3] ^ tempa[3];
+        RoundKey[i] = RoundKey[i - Nk] ^ temp;
     }
 }
 
 // This function adds the round key to state.
 // The round key is added to the state by an XOR function.
-static void AddRoundKey(uint8_t round)
+static void AddRoundKey(state_t *state, const uint32_t *RoundKey, uint8_t round)
 {
     uint8_t i, j;
 
@@ -257,14 +254,15 @@ static void AddRoundKey(uint8_t round)
     {
         for (j = 0; j < 4; ++j)
         {
-            (*state)[i][j] ^= RoundKey[round * Nb * 4 + i * Nb + j];
+            (*state)[i][j] ^= ROUND_KEY_BYTE(RoundKey, round * Nb * 4 + i * Nb + j);
         }
     }
 }
 
+#if !defined(FRAMEWORK_AES_TTABLE)
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void SubBytes(void)
+static void SubBytes(state_t *state)
 {
     uint8_t i, j;
 
@@ -280,7 +278,7 @@ static void SubBytes(void)
 // The ShiftRows() function shifts the rows in the state to the left.
 // Each row is shifted with different offset.
 // Offset = Row number. So the first row is not shifted.
-static void ShiftRows(void)
+static void ShiftRows(state_t *state)
 {
     uint8_t temp;
 
@@ -307,14 +305,16 @@ static void ShiftRows(void)
     (*state)[2][3] = (*state)[1][3];
     (*state)[1][3] = temp;
 }
+#endif
 
 static uint8_t xtime(uint8_t x)
 {
     return ((x<<1) ^ (((x>>7) & 1) * 0x1b));
 }
 
+#if !defined(FRAMEWORK_AES_TTABLE)
 // MixColumns function mixes the columns of the state matrix
-static void MixColumns(void)
+static void MixColumns(state_t *state)
 {
     uint8_t i;
     uint8_t Tmp, Tm, t;
@@ -329,6 +329,7 @@ static void MixColumns(void)
         Tm  = (*state)[i][3] ^ t ;        Tm = xtime(Tm);  (*state)[i][3] ^= Tm ^ Tmp ;
     }
 }
+#endif
 
 // Multiply is used to multiply numbers in the field GF(2^8)
 #if MULTIPLY_AS_A_FUNCTION
@@ -353,7 +354,7 @@ static uint8_t Multiply(uint8_t x, uint8_t y)
 // MixColumns function mixes the columns of the state matrix.
 // The method used to multiply may be difficult to understand for the inexperienced.
 // Please use the references to gain more information.
-static void InvMixColumns(void)
+static void InvMixColumns(state_t *state)
 {
     int i;
     uint8_t a, b, c, d;
@@ -375,7 +376,7 @@ static void InvMixColumns(void)
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void InvSubBytes(void)
+static void InvSubBytes(state_t *state)
 {
     uint8_t i, j;
 
@@ -388,7 +389,7 @@ static void InvSubBytes(void)
     }
 }
 
-static void InvShiftRows(void)
+static void InvShiftRows(state_t *state)
 {
     uint8_t temp;
 
@@ -416,59 +417,118 @@ static void InvShiftRows(void)
     (*state)[3][3] = temp;
 }
 
+#if defined(FRAMEWORK_AES_TTABLE)
+
+#define ROR8(x) (((x) >> 8) | ((x) << 24))
+#define ROR16(x) (((x) >> 16) | ((x) << 16))
+#define ROR24(x) (((x) >> 24) | ((x) << 8))
+
+static uint32_t load_column(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void store_column(uint8_t *p, uint32_t column)
+{
+    p[0] = column >> 24;
+    p[1] = column >> 16;
+    p[2] = column >> 8;
+    p[3] = column;
+}
+
+// Cipher is the main function that encrypts the PlainText. Each column of the state is kept in a word,
+// SubBytes, ShiftRows and MixColumns of a round are combined in 16 table lookups.
+static void Cipher(state_t *state, const uint32_t *RoundKey)
+{
+    uint8_t round;
+    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+
+    // Add the First round key to the state before starting the rounds.
+    s0 = load_column((*state)[0]) ^ RoundKey[0];
+    s1 = load_column((*state)[1]) ^ RoundKey[1];
+    s2 = load_column((*state)[2]) ^ RoundKey[2];
+    s3 = load_column((*state)[3]) ^ RoundKey[3];
+
+    for (round = 1; round < Nr; ++round)
+    {
+        RoundKey += 4;
+        t0 = Te0[s0 >> 24] ^ ROR8(Te0[(s1 >> 16) & 0xff]) ^ ROR16(Te0[(s2 >> 8) & 0xff]) ^ ROR24(Te0[s3 & 0xff]) ^ RoundKey[0];
+        t1 = Te0[s1 >> 24] ^ ROR8(Te0[(s2 >> 16) & 0xff]) ^ ROR16(Te0[(s3 >> 8) & 0xff]) ^ ROR24(Te0[s0 & 0xff]) ^ RoundKey[1];
+        t2 = Te0[s2 >> 24] ^ ROR8(Te0[(s3 >> 16) & 0xff]) ^ ROR16(Te0[(s0 >> 8) & 0xff]) ^ ROR24(Te0[s1 & 0xff]) ^ RoundKey[2];
+        t3 = Te0[s3 >> 24] ^ ROR8(Te0[(s0 >> 16) & 0xff]) ^ ROR16(Te0[(s1 >> 8) & 0xff]) ^ ROR24(Te0[s2 & 0xff]) ^ RoundKey[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    // The last round is given below.
+    // The MixColumns function is not here in the last round.
+    RoundKey += 4;
+    t0 = ((uint32_t)sbox[s0 >> 24] << 24) ^ ((uint32_t)sbox[(s1 >> 16) & 0xff] << 16) ^ ((uint32_t)sbox[(s2 >> 8) & 0xff] << 8) ^ sbox[s3 & 0xff];
+    t1 = ((uint32_t)sbox[s1 >> 24] << 24) ^ ((uint32_t)sbox[(s2 >> 16) & 0xff] << 16) ^ ((uint32_t)sbox[(s3 >> 8) & 0xff] << 8) ^ sbox[s0 & 0xff];
+    t2 = ((uint32_t)sbox[s2 >> 24] << 24) ^ ((uint32_t)sbox[(s3 >> 16) & 0xff] << 16) ^ ((uint32_t)sbox[(s0 >> 8) & 0xff] << 8) ^ sbox[s1 & 0xff];
+    t3 = ((uint32_t)sbox[s3 >> 24] << 24) ^ ((uint32_t)sbox[(s0 >> 16) & 0xff] << 16) ^ ((uint32_t)sbox[(s1 >> 8) & 0xff] << 8) ^ sbox[s2 & 0xff];
+
+    store_column((*state)[0], t0 ^ RoundKey[0]);
+    store_column((*state)[1], t1 ^ RoundKey[1]);
+    store_column((*state)[2], t2 ^ RoundKey[2]);
+    store_column((*state)[3], t3 ^ RoundKey[3]);
+}
+
+#else
 
 // Cipher is the main function that encrypts the PlainText.
-static void Cipher(void)
+static void Cipher(state_t *state, const uint32_t *RoundKey)
 {
     uint8_t round = 0;
 
     // Add the First round key to the state before starting the rounds.
-    AddRoundKey(0);
+    AddRoundKey(state, RoundKey, 0);
 
     // There will be Nr rounds.
     // The first Nr-1 rounds are identical.
     // These Nr-1 rounds are executed in the loop below.
     for (round = 1; round < Nr; ++round)
     {
-      SubBytes();
-      ShiftRows();
-      MixColumns();
-      AddRoundKey(round);
+      SubBytes(state);
+      ShiftRows(state);
+      MixColumns(state);
+      AddRoundKey(state, RoundKey, round);
     }
 
     // The last round is given below.
     // The MixColumns function is not here in the last round.
-    SubBytes();
-    ShiftRows();
-    AddRoundKey(Nr);
+    SubBytes(state);
+    ShiftRows(state);
+    AddRoundKey(state, RoundKey, Nr);
 }
 
-static void InvCipher(void)
+#endif // FRAMEWORK_AES_TTABLE
+
+static void InvCipher(state_t *state, const uint32_t *RoundKey)
 {
     uint8_t round = 0;
 
     // Add the First round key to the state before starting the rounds.
-    AddRoundKey(Nr);
+    AddRoundKey(state, RoundKey, Nr);
 
     // There will be Nr rounds.
     // The first Nr-1 rounds are identical.
     // These Nr-1 rounds are executed in the loop below.
     for (round = Nr-1; round > 0; round--)
     {
-      InvShiftRows();
-      InvSubBytes();
-      AddRoundKey(round);
-      InvMixColumns();
+      InvShiftRows(state);
+      InvSubBytes(state);
+      AddRoundKey(state, RoundKey, round);
+      InvMixColumns(state);
     }
 
     // The last round is given below.
     // The MixColumns function is not here in the last round.
-    InvShiftRows();
-    InvSubBytes();
-    AddRoundKey(0);
+    InvShiftRows(state);
+    InvSubBytes(state);
+    AddRoundKey(state, RoundKey, 0);
 }
 
-static void BlockCopy(uint8_t *output, uint8_t *input)
+static void BlockCopy(uint8_t *output, const uint8_t *input)
 {
     uint8_t i;
 
@@ -484,51 +544,131 @@ static void BlockCopy(uint8_t *output, uint8_t *input)
 /* Public functions:                                                         */
 /*****************************************************************************/
 
-void AES128_init(const uint8_t *key)
+void aes128_init(aes128_ctx_t *ctx, const uint8_t *key)
 {
-    memcpy(AES128_key, key, KEYLEN);
-    Key = AES128_key;
-    KeyExpansion();
+    memcpy(ctx->key, key, KEYLEN);
+    KeyExpansion(ctx->round_keys, key);
 }
 
-#if defined(ECB) && ECB
-
-
-void AES128_ECB_encrypt(uint8_t *input, uint8_t *output)
+void aes128_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
 {
 #ifdef HAL_SUPPORT_HW_AES
     /*
      * Hardware AES support for ECB through the low level peripheral library EMLIB
-     * The functions AES128_ECB_encrypt() expects inputs of 128 bit length = 16 bytes.
+     * The function expects inputs of 128 bit length = 16 bytes.
      */
-    hw_aes_ecb128(output, input, 16, Key, true);
+    hw_aes_ecb128(output, input, 16, ctx->key, true);
 #else
     // Copy input to output, and work in-memory on output
-    BlockCopy(output, input);
-    state = (state_t *)output;
+    if (output != input)
+        BlockCopy(output, input);
 
     // The next function call encrypts the PlainText with the Key using AES algorithm.
-    Cipher();
+    Cipher((state_t *)output, ctx->round_keys);
 #endif // HAL_SUPPORT_HW_AES
 }
 
-void AES128_ECB_decrypt(uint8_t *input, uint8_t *output)
+void aes128_decrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
 {
 #ifdef HAL_SUPPORT_HW_AES
     /*
      * Hardware AES support for ECB through the low level peripheral library EMLIB
-     * The functions AES128_ECB_decrypt() expects inputs of 128 bit length = 16 bytes.
+     * The function expects inputs of 128 bit length = 16 bytes.
      */
-    hw_aes_ecb128(output, input, 16, Key, false);
+    hw_aes_ecb128(output, input, 16, ctx->key, false);
 #else
     // Copy input to output, and work in-memory on output
-    BlockCopy(output, input);
-    state = (state_t *)output;
+    if (output != input)
+        BlockCopy(output, input);
 
-    InvCipher();
+    InvCipher((state_t *)output, ctx->round_keys);
 #endif // HAL_SUPPORT_HW_AES
 }
 
+/*
+ * As specified in the RFC3686,  The encryption of n plaintext blocks can be
+ * summarized as:
+ *      CTRBLK := NONCE || IV || ONE
+ *      FOR i := 1 to n-1 DO
+ *        CT[i] := PT[i] XOR AES(CTRBLK)
+ *        CTRBLK := CTRBLK + 1
+ *      END
+ *      CT[n] := PT[n] XOR TRUNC(AES(CTRBLK))
+ *
+ * The AES() function performs AES encryption with the fresh key.
+ *
+ * The TRUNC() function truncates the output of the AES encrypt
+ * operation to the same length as the final plaintext block, returning
+ * the most significant bits.
+ */
+
+void aes128_ctr_encrypt(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, uint8_t *ctr_blk)
+{
+#ifdef HAL_SUPPORT_HW_AES
+    // Hardware AES support for CTR through the low level peripheral library EMLIB
+    hw_aes_ctr128(output, input, length, ctx->key, ctr_blk);
+#else
+    uintptr_t i, j;
+    uint8_t remainders = length % KEYLEN; /* Remaining bytes in the last non-full block */
+    uint8_t ctr[KEYLEN];
+
+    for(i = KEYLEN; i <= length; i += KEYLEN)
+    {
+        aes128_encrypt_block(ctx, ctr_blk, ctr);
+        for (j = 0; j < KEYLEN; j++)
+            output[j] = input[j] ^ ctr[j];
+
+        aes128_ctr_increment(ctr_blk);
+
+        input += KEYLEN;
+        output += KEYLEN;
+    }
+
+    if(remainders)
+    {
+        aes128_encrypt_block(ctx, ctr_blk, ctr);
+        for (i=0; i < remainders; ++i)
+            output[i] = input[i] ^ ctr[i];
+    }
+#endif
+}
+
+void aes128_ctr_increment(uint8_t *ctr_blk)
+{
+    uint8_t j;
+
+    /* Increment block counter */
+    for (j = 0; j < KEYLEN; j++)
+    {
+        ctr_blk[j]++;
+        if (ctr_blk[j])
+            break;
+    }
+}
+
+const aes128_ctx_t *aes128_default_ctx(void)
+{
+    return &default_ctx;
+}
+
+void AES128_init(const uint8_t *key)
+{
+    aes128_init(&default_ctx, key);
+}
+
+#if defined(ECB) && ECB
+
+
+void AES128_ECB_encrypt(uint8_t *input, uint8_t *output)
+{
+    aes128_encrypt_block(&default_ctx, input, output);
+}
+
+void AES128_ECB_decrypt(uint8_t *input, uint8_t *output)
+{
+    aes128_decrypt_block(&default_ctx, input, output);
+}
+
 
 #endif // #if defined(ECB) && ECB
 
@@ -536,7 +676,7 @@ void AES128_ECB_decrypt(uint8_t *input, uint8_t *output)
 #if defined(CBC) && CBC
 
 
-static void XorWithIv(uint8_t *buf)
+static void XorWithIv(uint8_t *buf, const uint8_t *Iv)
 {
     uint8_t i;
 
@@ -550,22 +690,17 @@ void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
 {
 #ifdef HAL_SUPPORT_HW_AES
     // Hardware AES support for CBC through the low level peripheral library EMLIB
-    hw_aes_cbc128(output, input, length, Key, iv, true);
+    hw_aes_cbc128(output, input, length, default_ctx.key, iv, true);
 #else
     uintptr_t i;
     uint8_t remainders = length % KEYLEN; /* Remaining bytes in the last non-full block */
-
-    if (iv != 0)
-    {
-        Iv = (uint8_t *)iv;
-    }
+    const uint8_t *Iv = iv;
 
     for(i = KEYLEN; i <= length; i += KEYLEN)
     {
         BlockCopy(output, input);
-        XorWithIv(output);
-        state = (state_t *)output;
-        Cipher();
+        XorWithIv(output, Iv);
+        Cipher((state_t *)output, default_ctx.round_keys);
         Iv = output;
         input += KEYLEN;
         output += KEYLEN;
@@ -575,9 +710,8 @@ void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
     {
         BlockCopy(output, input);
         memset(output + remainders, 0, KEYLEN - remainders); /* add 0-padding */
-        XorWithIv(output);
-        state = (state_t *)output;
-        Cipher();
+        XorWithIv(output, Iv);
+        Cipher((state_t *)output, default_ctx.round_keys);
     }
 #endif // HAL_SUPPORT_HW_AES
 }
@@ -586,22 +720,16 @@ void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
 {
 #ifdef HAL_SUPPORT_HW_AES
     // Hardware AES support for CBC through the low level peripheral library EMLIB
-    hw_aes_cbc128(output, input, length, Key, iv, false);
+    hw_aes_cbc128(output, input, length, default_ctx.key, iv, false);
 #else
     uintptr_t i;
-
-    // If iv is passed as 0, we continue to encrypt without re-setting the Iv
-    if (iv != 0)
-    {
-        Iv = (uint8_t *)iv;
-    }
+    const uint8_t *Iv = iv;
 
     for(i = KEYLEN; i <= length; i += KEYLEN)
     {
         BlockCopy(output, input);
-        state = (state_t *)output;
-        InvCipher();
-        XorWithIv(output);
+        InvCipher((state_t *)output, default_ctx.round_keys);
+        XorWithIv(output, Iv);
         Iv = input;
         input += KEYLEN;
         output += KEYLEN;
@@ -614,63 +742,9 @@ void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
 
 #if defined(CTR) && CTR
 
-/*
- * As specified in the RFC3686,  The encryption of n plaintext blocks can be
- * summarized as:
- *      CTRBLK := NONCE || IV || ONE
- *      FOR i := 1 to n-1 DO
- *        CT[i] := PT[i] XOR AES(CTRBLK)
- *        CTRBLK := CTRBLK + 1
- *      END
- *      CT[n] := PT[n] XOR TRUNC(AES(CTRBLK))
- *
- * The AES() function performs AES encryption with the fresh key.
- *
- * The TRUNC() function truncates the output of the AES encrypt
- * operation to the same length as the final plaintext block, returning
- * the most significant bits.
- */
-
 void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_t *ctr_blk)
 {
-#ifdef HAL_SUPPORT_HW_AES
-    // Hardware AES support for CTR through the low level peripheral library EMLIB
-    hw_aes_ctr128(output, input, length, Key, ctr_blk);
-#else
-    uintptr_t i, j;
-    uint8_t remainders = length % KEYLEN; /* Remaining bytes in the last non-full block */
-    uint8_t ctr[KEYLEN];
-
-    BlockCopy(ctr, ctr_blk);
-    state = (state_t *)ctr;
-
-    for(i = KEYLEN; i <= length; i += KEYLEN)
-    {
-        Cipher();
-        BlockCopy(output, input);
-        for (j = 0; j < KEYLEN; j++)
-            output[j] ^= ctr[j];
-
-        /* Increment block counter */
-        for (j = 0; j < KEYLEN; j++)
-        {
-            ctr_blk[j]++;
-            if (ctr_blk[j])
-                break;
-        }
-
-        input += KEYLEN;
-        output += KEYLEN;
-        BlockCopy(ctr, ctr_blk);
-    }
-
-    if(remainders)
-    {
-        Cipher();
-        for (i=0; i < remainders; ++i)
-            output[i] = input[i] ^ ctr[i];
-    }
-#endif
+    aes128_ctr_encrypt(&default_ctx, output, input, length, ctr_blk);
 }
 
 #endif // #if defined(CTR) && CTR
@@ -57,6 +57,21 @@ static void xor_aes_block(uint8_t *dst, const uint8_t *src)
     }
 }
 
+static error_t check_lengths(uint8_t length, uint8_t add_len, uint8_t auth_len)
+{
+    if (auth_len != 4 && auth_len != 8 && auth_len != 16)
+        return EINVAL;
+
+    /* For DASH7, the payload length shall be less than 250 - Security header len - authentication tag len */
+    if (length > (250 - 5 - auth_len))
+        return EINVAL;
+
+    if (add_len > (2 * AES_BLOCK_SIZE - 1))
+        return EINVAL;
+
+    return SUCCESS;
+}
+
 /*
  * Authentication
  *
@@ -65,36 +80,23 @@ static void xor_aes_block(uint8_t *dst, const uint8_t *src)
  * 
  */
 
-error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
-                        const uint8_t *add, uint8_t add_len, uint8_t auth_len )
+/* The CBC-MAC is computed by:
+ *
+ * X_1 := E( K, B_0 )
+ * X_i+1 := E( K, X_i XOR B_i )  for i=1, ..., n
+ * T := first-M-bytes( X_n+1 )
+ *
+ * cbc_mac_start() computes the X_i for B_0 and the blocks of additional authenticated data,
+ * cbc_mac_update() adds one (possibly partial, zero-padded) block of the message.
+ */
+static void cbc_mac_start(const aes128_ctx_t *ctx, uint8_t *tag, const uint8_t *iv, const uint8_t *add, uint8_t add_len)
 {
     uint8_t blk[AES_BLOCK_SIZE];
-    uint8_t i;
-    uint8_t remainders;
-    uint8_t tag[AES_BLOCK_SIZE];
-
-    /* sanity checks */
-    if (auth_len != 4 && auth_len != 8 && auth_len != 16)
-        return EINVAL;
-
-    if (add_len > (2 * AES_BLOCK_SIZE - 1))
-        return EINVAL;
-
-    /* For DASH7, the payload length shall be less than 250 - authentication tag len */
-    if (length > (250 - auth_len))
-        return EINVAL;
-
-    /* The CBC-MAC is computed by:
-     *
-     * X_1 := E( K, B_0 )
-     * X_i+1 := E( K, X_i XOR B_i )  for i=1, ..., n
-     * T := first-M-bytes( X_n+1 )
-     */
 
     /* X_1 = E(K, B_0) */
     DPRINT("Blk0");
     DPRINT_DATA((uint8_t *)iv, AES_BLOCK_SIZE);
-    AES128_ECB_encrypt((uint8_t *)iv, tag);
+    aes128_encrypt_block(ctx, iv, tag);
     DPRINT("X_1 = AES(B_0)");
     DPRINT_DATA(tag, AES_BLOCK_SIZE);
 
@@ -113,11 +115,9 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
         DPRINT("Blk1");
         DPRINT_DATA(blk, AES_BLOCK_SIZE);
 
-        xor_aes_block(blk, tag);
-        DPRINT("X_1 XOR B_1");
-        DPRINT_DATA(blk, AES_BLOCK_SIZE);
+        xor_aes_block(tag, blk);
         /* X_2 = E(K, X_1 XOR B_1) */
-        AES128_ECB_encrypt(blk, tag);
+        aes128_encrypt_block(ctx, tag, tag);
         DPRINT("X_2 = AES(X_1 XOR B_1)");
         DPRINT_DATA(tag, AES_BLOCK_SIZE);
 
@@ -129,55 +129,68 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
             DPRINT("blk2");
             DPRINT_DATA(blk, AES_BLOCK_SIZE);
 
-            DPRINT("X_2 XOR B_2");
-            xor_aes_block(blk, tag);
+            xor_aes_block(tag, blk);
              /* X_3 = E(K, X_2 XOR B_2) */
-            AES128_ECB_encrypt(blk, tag);
-            DPRINT("X_3 = AES(X_1 XOR B_1)");
+            aes128_encrypt_block(ctx, tag, tag);
+            DPRINT("X_3 = AES(X_2 XOR B_2)");
             DPRINT_DATA(tag, AES_BLOCK_SIZE);
         }
     }
+}
 
-    remainders = length % AES_BLOCK_SIZE; /* Remaining bytes in the last non-full block */
-    DPRINT("Remainders %d length %d", remainders, length);
+static void cbc_mac_update(const aes128_ctx_t *ctx, uint8_t *tag, const uint8_t *blk, uint8_t blk_len)
+{
+    uint8_t i;
 
-    for (i = 0; i < length / AES_BLOCK_SIZE; i++)
-    {
-        DPRINT("Xi");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    /* X_i+1 = E(K, X_i XOR B_i), the last block is zero padded */
+    for (i = 0; i < blk_len; i++)
+        tag[i] ^= blk[i];
 
-        DPRINT("B_i");
-        DPRINT_DATA(payload, AES_BLOCK_SIZE);
+    aes128_encrypt_block(ctx, tag, tag);
+    DPRINT("X_i+1 = E(K, X_i XOR B_i)");
+    DPRINT_DATA(tag, AES_BLOCK_SIZE);
+}
 
-        /* X_i+1 = E(K, X_i XOR B_i) */
-        xor_aes_block(tag, payload);
-        DPRINT("X_i XOR B_i");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+/* XOR a block of the payload with the keystream of the counter block. The counter is only
+ * incremented after a full block, like AES128_CTR_encrypt() does */
+static void ctr_update(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint8_t blk_len, uint8_t *ctr_blk)
+{
+    uint8_t keystream[AES_BLOCK_SIZE];
+    uint8_t i;
 
-        payload += AES_BLOCK_SIZE;
+    aes128_encrypt_block(ctx, ctr_blk, keystream);
+    for (i = 0; i < blk_len; i++)
+        output[i] = input[i] ^ keystream[i];
 
-        AES128_ECB_encrypt(tag, tag);
-        DPRINT("X_i+1 = E(K, X_i XOR B_i)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-    }
+    if (blk_len == AES_BLOCK_SIZE)
+        aes128_ctr_increment(ctr_blk);
+}
 
-    if (remainders)
-    {
-        /* XOR zero-padded last block */
-        DPRINT("Xi");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+error_t aes128_cbc_mac(const aes128_ctx_t *ctx, uint8_t *auth, const uint8_t *payload, uint8_t length, const uint8_t *iv,
+                       const uint8_t *add, uint8_t add_len, uint8_t auth_len)
+{
+    uint8_t tag[AES_BLOCK_SIZE];
+    uint8_t blk_len;
 
-        DPRINT("B_i");
-        DPRINT_DATA(payload, AES_BLOCK_SIZE);
+    /* sanity checks */
+    if (auth_len != 4 && auth_len != 8 && auth_len != 16)
+        return EINVAL;
 
-        for (i = 0; i < remainders; i++)
-            tag[i] ^= *payload++;
-        DPRINT("X_i XOR B_i");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    if (add_len > (2 * AES_BLOCK_SIZE - 1))
+        return EINVAL;
 
-        AES128_ECB_encrypt(tag, tag);
-        DPRINT("X_i+1 = E(K, X_i XOR B_i)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    /* For DASH7, the payload length shall be less than 250 - authentication tag len */
+    if (length > (250 - auth_len))
+        return EINVAL;
+
+    cbc_mac_start(ctx, tag, iv, add, add_len);
+
+    while (length)
+    {
+        blk_len = length < AES_BLOCK_SIZE ? length : AES_BLOCK_SIZE;
+        cbc_mac_update(ctx, tag, payload, blk_len);
+        payload += blk_len;
+        length -= blk_len;
     }
 
     memcpy(auth, tag, auth_len);
@@ -190,52 +203,51 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
  *
  * Ensure that the output is sized to contain the encrypted message payload
  * + the encrypted authentication Tag.
+ *
+ * The CBC-MAC and the CTR encryption are done in a single pass over the payload: each block is
+ * first added to the MAC and then encrypted in place.
  */
-error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
-                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
-                            uint8_t auth_len )
+error_t aes128_ccm_encrypt(const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                           const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk, uint8_t auth_len)
 {
-    uint8_t auth[AES_BLOCK_SIZE];
-    uint8_t auth_crypted[AES_BLOCK_SIZE];
+    uint8_t tag[AES_BLOCK_SIZE];
+    uint8_t *blk = payload;
+    uint8_t remaining = length;
+    uint8_t blk_len;
     error_t ret;
 
     /* sanity checks */
-    if (auth_len != 4 && auth_len != 8 && auth_len != 16)
-        return EINVAL;
-
-     /* For DASH7, the payload length shall be less than 250 - Security header len - authentication tag len */
-    if (length > (250 - 5 - auth_len))
-        return EINVAL;
-
-    if (add_len > (2 * AES_BLOCK_SIZE - 1))
-        return EINVAL;
-
-    /* Authentication */
-    ret = AES128_CBC_MAC(auth, payload, length, iv, add, add_len, auth_len);
+    ret = check_lengths(length, add_len, auth_len);
     if (ret != SUCCESS)
         return ret;
 
-    DPRINT("Authentication tag:");
-    DPRINT_DATA(auth, auth_len);
-
-    /* Encryption with Counter (CTR) mode*/
+    cbc_mac_start(ctx, tag, iv, add, add_len);
 
     /* Encryption of the message payload, counter set to 1 */
     ctr_blk[0] = (ctr_blk[0] & 0xF0) + 1;
     DPRINT("ctr0");
     DPRINT_DATA(ctr_blk, AES_BLOCK_SIZE);
 
-    AES128_CTR_encrypt(payload, payload, length, ctr_blk);
+    while (remaining)
+    {
+        blk_len = remaining < AES_BLOCK_SIZE ? remaining : AES_BLOCK_SIZE;
+        cbc_mac_update(ctx, tag, blk, blk_len);
+        ctr_update(ctx, blk, blk, blk_len, ctr_blk);
+        blk += blk_len;
+        remaining -= blk_len;
+    }
+
+    DPRINT("Authentication tag:");
+    DPRINT_DATA(tag, auth_len);
     DPRINT("CTR output:");
     DPRINT_DATA(payload, length);
 
     /* Encryption of the authentication tag , reset counter to 0*/
     ctr_blk[0] = (ctr_blk[0] & 0xF0);
-    AES128_CTR_encrypt(auth_crypted, auth, auth_len, ctr_blk);
-    DPRINT("Encrypted authentication tag:");
-    DPRINT_DATA(auth_crypted, auth_len);
     // the 4, 8 or 16 MSB of the MAC are then appended to the payload
-    memcpy(payload + length, auth_crypted, auth_len);
+    ctr_update(ctx, payload + length, tag, auth_len, ctr_blk);
+    DPRINT("Encrypted authentication tag:");
+    DPRINT_DATA(payload + length, auth_len);
 
     return SUCCESS;
 }
@@ -243,40 +255,44 @@ error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
 /*
  * Authenticated decryption
  */
-error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
-                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
-                            const uint8_t *auth, uint8_t auth_len )
+error_t aes128_ccm_decrypt(const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                           const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                           const uint8_t *auth, uint8_t auth_len)
 {
-    uint8_t T[AES_BLOCK_SIZE];
+    uint8_t tag[AES_BLOCK_SIZE];
     uint8_t auth_decrypted[AES_BLOCK_SIZE];
+    uint8_t blk_len;
+    error_t ret;
 
     /* sanity checks */
-    if (auth_len != 4 && auth_len != 8 && auth_len != 16)
-        return EINVAL;
-
-    /* For DASH7, the payload length shall be less than 250 - Security header len - authentication tag len */
-    if (length > (250 - 5 - auth_len))
-        return EINVAL;
-
-    if (add_len > (2 * AES_BLOCK_SIZE - 1))
-        return EINVAL;
+    ret = check_lengths(length, add_len, auth_len);
+    if (ret != SUCCESS)
+        return ret;
 
     /* Decryption of the encrypted authentication Tag */
     ctr_blk[0] = (ctr_blk[0] & 0xF0);
-    AES128_CTR_encrypt(auth_decrypted, (uint8_t *)auth, auth_len, ctr_blk);
+    ctr_update(ctx, auth_decrypted, auth, auth_len, ctr_blk);
     DPRINT("Decrypted authentication tag:");
     DPRINT_DATA(auth_decrypted, auth_len);
 
+    cbc_mac_start(ctx, tag, iv, add, add_len);
+
     /* Decryption of the message payload, counter set to 1 */
     ctr_blk[0] = (ctr_blk[0] & 0xF0) + 1;
-    AES128_CTR_encrypt(payload, payload, length, ctr_blk);
+    while (length)
+    {
+        blk_len = length < AES_BLOCK_SIZE ? length : AES_BLOCK_SIZE;
+        ctr_update(ctx, payload, payload, blk_len, ctr_blk);
+        cbc_mac_update(ctx, tag, payload, blk_len);
+        payload += blk_len;
+        length -= blk_len;
+    }
 
-    /* Recompute the CBC-MAC and check the authentication Tag */
-    AES128_CBC_MAC(T, payload, length, iv, add, add_len, auth_len);
+    /* Check the authentication Tag */
     DPRINT("Computed authentication tag:");
-    DPRINT_DATA(T, auth_len);
+    DPRINT_DATA(tag, auth_len);
 
-    if (memcmp(T, auth_decrypted, auth_len) != 0)
+    if (memcmp(tag, auth_decrypted, auth_len) != 0)
     {
         DPRINT("CCM: Auth mismatch");
         return -1;
@@ -284,3 +300,23 @@ error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
 
     return SUCCESS;
 }
+
+error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                        const uint8_t *add, uint8_t add_len, uint8_t auth_len )
+{
+    return aes128_cbc_mac(aes128_default_ctx(), auth, payload, length, iv, add, add_len, auth_len);
+}
+
+error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                            uint8_t auth_len )
+{
+    return aes128_ccm_encrypt(aes128_default_ctx(), payload, length, iv, add, add_len, ctr_blk, auth_len);
+}
+
+error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                            const uint8_t *auth, uint8_t auth_len )
+{
+    return aes128_ccm_decrypt(aes128_default_ctx(), payload, length, iv, add, add_len, ctr_blk, auth, auth_len);
+}
@@ -22,22 +22,27 @@
 #include "debug.h"
 #include "compress.h"
 
+#ifdef FRAMEWORK_CT_DECOMPRESS_LUT
+#define LUT_4(ct) CT_DECOMPRESS(ct), CT_DECOMPRESS(ct + 1), CT_DECOMPRESS(ct + 2), CT_DECOMPRESS(ct + 3)
+#define LUT_16(ct) LUT_4(ct), LUT_4(ct + 4), LUT_4(ct + 8), LUT_4(ct + 12)
+#define LUT_64(ct) LUT_16(ct), LUT_16(ct + 16), LUT_16(ct + 32), LUT_16(ct + 48)
+
+const uint32_t ct_decompress_lut[256] = { LUT_64(0), LUT_64(64), LUT_64(128), LUT_64(192) };
+#endif
+
 uint8_t compress_data(uint16_t value, bool ceil)
 {
-    uint8_t mantissa;
-    uint16_t remainder;
-
-    for ( int i = 0; i < 8; i++)
+    // a value of b bits fits in a mantissa of 5 bits with exponent (b - 4) / 2, unless it is larger than 31 * 4^exp
+    uint8_t exponent = 0;
+    if (value > 31)
     {
-        if (value <= (pow(4, i) * 31))
-        {
-            mantissa = value / pow(4, i);
-            remainder = value % (uint16_t)(pow(4, i));
+        exponent = (32 - __builtin_clz(value) - 4) / 2;
+        exponent += value > (31UL << (2 * exponent));
+    }
 
-            if (ceil && remainder)
-                mantissa++;
+    uint8_t mantissa = value >> (2 * exponent);
+    if (ceil && (value & ((1UL << (2 * exponent)) - 1)))
+        mantissa++;
 
-            return (uint8_t)( i<<5 | mantissa);
-        }
-    }
+    return (uint8_t)(exponent << 5 | mantissa);
 }
@@ -105,6 +105,14 @@ inline void console_set_rx_interrupt_callback(uart_rx_inthandler_t uart_rx_cb) {
 #endif
 }
 
+inline void console_set_rx_block_callback(uart_rx_block_handler_t uart_rx_cb) {
+#ifdef PLATFORM_USE_USB_CDC
+	cdc_set_rx_block_callback(uart_rx_cb);
+#else
+  uart_set_rx_block_callback(uart, uart_rx_cb);
+#endif
+}
+
 inline void console_rx_interrupt_enable() {
   uart_rx_interrupt_enable(uart);
 }
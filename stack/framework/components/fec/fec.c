@@ -23,40 +23,12 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <stdio.h>
-#include <stdint.h>
 #include <string.h>
 
 #include "fec.h"
 
 #define INITIAL_FECSTATE 0x00
 #define TRELLIS_TERMINATOR 0x0B
-#define FEC_BUFFER_SIZE 256
-
-#define INTERLEAVING
-
-//#ifdef D7_PHY_USE_FEC
-
-const static uint8_t fec_lut[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1, 2};
-const static uint8_t trellis0_lut[8] = {0, 1, 3, 2, 3, 2, 0, 1};
-const static uint8_t trellis1_lut[8] = {3, 2, 0, 1, 0, 1, 3, 2};
-
-static uint8_t data_buffer[FEC_BUFFER_SIZE];
-static uint8_t* input_buffer;
-static uint8_t* output_buffer;
-
-static uint16_t packetlength;
-static uint16_t fecpacketlength;
-static uint16_t output_packet_length;
-
-static uint8_t processedbytes;
-static uint16_t fecprocessedbytes;
-
-static uint16_t pn9;
-static uint16_t fecstate;
-static VITERBISTATE vstate;
-
-static bool fec_decode(uint8_t* input);
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_PHY_LOG_ENABLED) // TODO more granular (LOG_PHY_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
@@ -66,61 +38,70 @@ static bool fec_decode(uint8_t* input);
 #define DPRINT_DATA(...)
 #endif
 
-//void print_array(uint8_t* buffer, uint8_t length)
-//	for (i = 0; i < length; i++)
-//void print_array(uint8_t* buffer, uint8_t length)
-//{
-//	int i = 0;
-//	for (; i < length; i++)
-//	{
-//	    printf("%02X", buffer[i]);
-//	}
-//	printf(" ");
-//
-//	for (i = 0; i < length; i++)
-//	{
-//		printf("%s", byte_to_binary(buffer[i]));
-//	}
-//}
-
-const char *int_to_binary(uint16_t x)
-{
-    static char b[17];
-    b[0] = '\0';
+// The convolutional code has constraint length 4: every input bit is encoded as a 2 bit symbol which
+// depends on the bit itself and the 3 previous bits (the state of the encoder).
+// encoder_lut[state][nibble] contains the 4 symbols of a nibble, first symbol in the MSBs.
+static const uint8_t encoder_lut[8][16] = {
+    {0x00, 0x03, 0x0d, 0x0e, 0x37, 0x34, 0x3a, 0x39, 0xdf, 0xdc, 0xd2, 0xd1, 0xe8, 0xeb, 0xe5, 0xe6},
+    {0x7c, 0x7f, 0x71, 0x72, 0x4b, 0x48, 0x46, 0x45, 0xa3, 0xa0, 0xae, 0xad, 0x94, 0x97, 0x99, 0x9a},
+    {0xf0, 0xf3, 0xfd, 0xfe, 0xc7, 0xc4, 0xca, 0xc9, 0x2f, 0x2c, 0x22, 0x21, 0x18, 0x1b, 0x15, 0x16},
+    {0x8c, 0x8f, 0x81, 0x82, 0xbb, 0xb8, 0xb6, 0xb5, 0x53, 0x50, 0x5e, 0x5d, 0x64, 0x67, 0x69, 0x6a},
+    {0xc0, 0xc3, 0xcd, 0xce, 0xf7, 0xf4, 0xfa, 0xf9, 0x1f, 0x1c, 0x12, 0x11, 0x28, 0x2b, 0x25, 0x26},
+    {0xbc, 0xbf, 0xb1, 0xb2, 0x8b, 0x88, 0x86, 0x85, 0x63, 0x60, 0x6e, 0x6d, 0x54, 0x57, 0x59, 0x5a},
+    {0x30, 0x33, 0x3d, 0x3e, 0x07, 0x04, 0x0a, 0x09, 0xef, 0xec, 0xe2, 0xe1, 0xd8, 0xdb, 0xd5, 0xd6},
+    {0x4c, 0x4f, 0x41, 0x42, 0x7b, 0x78, 0x76, 0x75, 0x93, 0x90, 0x9e, 0x9d, 0xa4, 0xa7, 0xa9, 0xaa}
+};
+
+// The Viterbi decoder keeps the cost of the 8 trellis states in the bytes (lanes) of a 64 bit word, so the
+// add-compare-select of all states is done at once. State k is reached from state (k >> 1) with input
+// bit (k & 1) or from state (k >> 1) + 4 with the same input bit.
+// branch_metric_lut[0][symbol] contains for each lane k the hamming distance between the received symbol
+// and the symbol expected on the transition from state (k >> 1), branch_metric_lut[1][symbol] the same for
+// the transition from state (k >> 1) + 4.
+// On 32 bit targets the states 0-3 and 4-7 are kept in two 32 bit words instead, which are processed one
+// after the other, so no emulated 64 bit arithmetic is needed.
+#ifdef FEC_VITERBI_32BIT_LANES
+static const uint32_t branch_metric_lut[2][4][2] = {
+    {{0x01010200, 0x01010002}, {0x02000101, 0x00020101}, {0x00020101, 0x02000101}, {0x01010002, 0x01010200}},
+    {{0x01010002, 0x01010200}, {0x00020101, 0x02000101}, {0x02000101, 0x00020101}, {0x01010200, 0x01010002}}
+};
+
+#define LANES(byte) ((uint32_t)(byte) * 0x01010101UL)
+#define COST(costs, state) ((uint8_t)((costs)[(state) >> 2] >> (8 * ((state) & 0x03))))
+#else
+static const uint64_t branch_metric_lut[2][4] = {
+    {0x0101000201010200ULL, 0x0002010102000101ULL, 0x0200010100020101ULL, 0x0101020001010002ULL},
+    {0x0101020001010002ULL, 0x0200010100020101ULL, 0x0002010102000101ULL, 0x0101000201010200ULL}
+};
 
-    uint16_t z;
-    for (z = 0x8000; z > 0; z >>= 1)
-    {
-        strcat(b, ((x & z) == z) ? "1" : "0");
-    }
+#define LANES(byte) ((uint64_t)(byte) * 0x0101010101010101ULL)
+#define COST(costs, state) ((uint8_t)((costs) >> (8 * (state))))
+#endif
 
-    return b;
-}
+#define LANE_MSB LANES(0x80)
 
-static void print_vstate()
-{
-//	typedef struct {
-//		uint8_t cost;
-//		uint16_t path;
-//	} VITERBIPATH;
-//	typedef struct {
-//		uint8_t path_size;
-//		VITERBIPATH* old;
-//		VITERBIPATH* new;
-//		VITERBIPATH states1[8];
-//		VITERBIPATH states2[8];
-//	} VITERBISTATE;
-
-  DPRINT("VSTATE:\n");
-  DPRINT(" - path_size: %d\n", vstate.path_size);
-	//printf(" - old: %03d - %s\n", vstate.old->cost, int_to_binary(vstate.old->path));
-	//printf(" - new: %03d - %s\n", vstate.new->cost, int_to_binary(vstate.new->path));
-	int i;
-	for (i=0;i<8;i++)
-    DPRINT(" - states - %d: %03d - %s\n", i, vstate.old[i].cost, int_to_binary(vstate.old[i].path));
+// the cost of the states which are not the start state, large enough to exclude them from the first decoded bits
+#define INITIAL_COST 100
 
+/*
+ * The 2 bit symbols of 2 input bytes are interleaved over 4 output bytes: bits 2n of output byte m
+ * are bits 2m of symbol byte n. This is a transposition of a 4x4 matrix of 2 bit elements, which
+ * is its own inverse so the same function deinterleaves.
+ */
+static uint32_t interleave(uint32_t x)
+{
+    uint32_t t;
+    t = (x ^ (x >> 6)) & 0x00CC00CC;
+    x ^= t ^ (t << 6);
+    t = (x ^ (x >> 12)) & 0x0000F0F0;
+    x ^= t ^ (t << 12);
+    return x;
 }
 
+static uint8_t input_byte(uint8_t *data, uint16_t nbytes, uint16_t index)
+{
+    return index < nbytes ? data[index] : TRELLIS_TERMINATOR;
+}
 
 uint16_t fec_calculated_decoded_length(uint16_t packet_length)
 {
@@ -130,275 +111,231 @@ uint16_t fec_calculated_decoded_length(uint16_t packet_length)
 /* Convolutional encoder */
 uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
 {
-	memcpy(data_buffer, data, nbytes);
-	uint8_t *input = data_buffer;
-	unsigned int encstate = 0;
-	int i;
-
-	int termintor_bytes = 2 + nbytes%2;
-	//printf("Length %d -> terminator %d\n", nbytes, termintor_bytes);
-	nbytes+=termintor_bytes;
-	uint16_t length = 0;
-	uint8_t fecbuffer[4] = {0,0,0,0};
-
-	int8_t buffer_pointer = 0;
-	while(nbytes-- > 0){
-		if (nbytes < termintor_bytes) *input = TRELLIS_TERMINATOR;
-
-		//printf("%02X:", *input);
-
-		int j = 6;
-		for(i=7;i>=0;i--){
-				encstate = (encstate << 1) | ((*input >> i) & 1);
-				fecbuffer[buffer_pointer] |= fec_lut[encstate & 0x0F] << j;
-				j -=2;
-
-				//printf("%d: %d - %d -> %s\n",j+2, ((*input >> i) & 1), encstate & 0x0F, byte_to_binary(fec_lut[encstate & 0x0F]));
-				if (j < 0)
-				{
-//						//fecbuffer[buffer_pointer] = 0;
-					buffer_pointer++;
-					j = 6;
-//						length++;
-				}
-		}
-
-		if (buffer_pointer == 4)
-		{
-#ifdef INTERLEAVING
-			//printf("Non: "); print_array(fecbuffer, 4); printf("\n");
-			//Interleaving and write to output buffer
-			*data++ = ((fecbuffer[0] & 0x03)) |\
-						((fecbuffer[1] & 0x03) << 2) |\
-						((fecbuffer[2] & 0x03) << 4) |\
-						((fecbuffer[3] & 0x03) << 6);
-			*data++ = (((fecbuffer[0] >> 2) & 0x03)) |\
-							(((fecbuffer[1] >> 2) & 0x03) << 2) |\
-							(((fecbuffer[2] >> 2) & 0x03) << 4) |\
-							(((fecbuffer[3] >> 2) & 0x03) << 6);
-			*data++ = (((fecbuffer[0] >> 4) & 0x03)) |\
-							(((fecbuffer[1] >> 4) & 0x03) << 2) |\
-							(((fecbuffer[2] >> 4) & 0x03) << 4) |\
-							(((fecbuffer[3] >> 4) & 0x03) << 6);
-			*data++ = (((fecbuffer[0] >> 6) & 0x03)) |\
-							(((fecbuffer[1] >> 6) & 0x03) << 2) |\
-							(((fecbuffer[2] >> 6) & 0x03) << 4) |\
-							(((fecbuffer[3] >> 6) & 0x03) << 6);
-			//printf("Int: "); print_array(output-4, 4); printf("\n");
-#else
-			*output++ = fecbuffer[0];
-			*output++ = fecbuffer[1];
-			*output++ = fecbuffer[2];
-			*output++ = fecbuffer[3];
+    // 2 or 3 terminator bytes are appended so an even number of bytes is encoded
+    uint16_t length = 2 * (nbytes + 2 + nbytes % 2);
 
-#endif
-			buffer_pointer=0;
-			fecbuffer[0] = 0;
-			fecbuffer[1] = 0;
-			fecbuffer[2] = 0;
-			fecbuffer[3] = 0;
-			length+=4;
-		}
+    // every 2 input bytes result in 4 output bytes: encode from the end of the buffer so the data is
+    // encoded in place without overwriting input which is not encoded yet
+    for(int16_t i = length / 2 - 2; i >= 0; i -= 2)
+    {
+        uint8_t byte0 = input_byte(data, nbytes, i);
+        uint8_t byte1 = input_byte(data, nbytes, i + 1);
+        uint8_t state = (i == 0) ? INITIAL_FECSTATE : (input_byte(data, nbytes, i - 1) & 0x07);
+
+        uint32_t symbols = encoder_lut[state][byte0 >> 4];
+        symbols |= (uint32_t)encoder_lut[(byte0 >> 4) & 0x07][byte0 & 0x0F] << 8;
+        symbols |= (uint32_t)encoder_lut[byte0 & 0x07][byte1 >> 4] << 16;
+        symbols |= (uint32_t)encoder_lut[(byte1 >> 4) & 0x07][byte1 & 0x0F] << 24;
+
+        symbols = interleave(symbols);
+        data[2 * i] = symbols;
+        data[2 * i + 1] = symbols >> 8;
+        data[2 * i + 2] = symbols >> 16;
+        data[2 * i + 3] = symbols >> 24;
+    }
 
+    return length;
+}
 
-		//printf("%02X%02X ", *(output-2), *(output-1));
+void fec_decoder_init(fec_decoder_t* decoder, uint8_t* output, uint16_t output_size)
+{
+    // the encoder starts in state 0
+#ifdef FEC_VITERBI_32BIT_LANES
+    decoder->costs[0] = LANES(INITIAL_COST) & ~0xFFUL;
+    decoder->costs[1] = LANES(INITIAL_COST);
+#else
+    decoder->costs = LANES(INITIAL_COST) & ~0xFFULL;
+#endif
+    decoder->bit_count = 0;
+    decoder->decoded_bytes = 0;
+    decoder->input_length = 0;
+    decoder->output = output;
+    decoder->output_size = output_size;
+    decoder->output_length = 0;
+}
 
-		input++;
+#ifdef FEC_VITERBI_32BIT_LANES
+// spreads the costs of 2 states over 4 lanes, so lane k contains the cost of state (k >> 1)
+static uint32_t spread_costs(uint32_t costs)
+{
+    costs = ((costs & 0xFFFF) | ((costs & 0xFFFF) << 8)) & 0x00FF00FF;
+    return costs | (costs << 8);
+}
 
-	}
+static void decode_symbol(fec_decoder_t* decoder, uint8_t symbol)
+{
+    uint32_t costs[2];
+    uint8_t decisions = 0;
+    for(uint8_t word = 0; word < 2; word++) {
+        // the states 4 * word ... 4 * word + 3 are reached from the states 2 * word, 2 * word + 1 and
+        // 2 * word + 4, 2 * word + 5
+        uint32_t cost0 = spread_costs(decoder->costs[0] >> (16 * word)) + branch_metric_lut[0][symbol][word];
+        uint32_t cost1 = spread_costs(decoder->costs[1] >> (16 * word)) + branch_metric_lut[1][symbol][word];
+
+        // costs never exceed 127 (they are normalised every byte), so the MSB of every lane is set when cost0 <= cost1
+        uint32_t select0 = ((cost1 | LANE_MSB) - cost0) & LANE_MSB;
+        uint32_t mask0 = (select0 >> 7) * 0xFF;
+        costs[word] = (cost0 & mask0) | (cost1 & ~mask0);
+        decisions |= ((((select0 ^ LANE_MSB) >> 7) * 0x01020408UL) >> 24) << (4 * word);
+    }
 
+    decoder->costs[0] = costs[0];
+    decoder->costs[1] = costs[1];
 
-	//printf("\n");
-	return length;
+    // keep which predecessor was selected by every state, packed in one byte, for the traceback
+    decoder->decisions[decoder->bit_count % FEC_TRACEBACK_LENGTH] = decisions;
+    decoder->bit_count++;
+}
+#else
+static void decode_symbol(fec_decoder_t* decoder, uint8_t symbol)
+{
+    // spread the costs of the states 0-3 and 4-7 so lane k contains the cost of state (k >> 1) respectively (k >> 1) + 4
+    uint64_t cost0 = decoder->costs & 0xFFFFFFFF;
+    uint64_t cost1 = decoder->costs >> 32;
+    cost0 = (cost0 | (cost0 << 16)) & 0x0000FFFF0000FFFFULL;
+    cost0 = (cost0 | (cost0 << 8)) & 0x00FF00FF00FF00FFULL;
+    cost1 = (cost1 | (cost1 << 16)) & 0x0000FFFF0000FFFFULL;
+    cost1 = (cost1 | (cost1 << 8)) & 0x00FF00FF00FF00FFULL;
+    cost0 = (cost0 | (cost0 << 8)) + branch_metric_lut[0][symbol];
+    cost1 = (cost1 | (cost1 << 8)) + branch_metric_lut[1][symbol];
+
+    // costs never exceed 127 (they are normalised every byte), so the MSB of every lane is set when cost0 <= cost1
+    uint64_t select0 = ((cost1 | LANE_MSB) - cost0) & LANE_MSB;
+    uint64_t mask0 = (select0 >> 7) * 0xFF;
+    decoder->costs = (cost0 & mask0) | (cost1 & ~mask0);
+
+    // keep which predecessor was selected by every state, packed in one byte, for the traceback
+    decoder->decisions[decoder->bit_count % FEC_TRACEBACK_LENGTH] = (((select0 ^ LANE_MSB) >> 7) * 0x0102040810204080ULL) >> 56;
+    decoder->bit_count++;
 }
+#endif
 
-uint16_t fec_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length)
+static uint8_t lowest_cost_state(fec_decoder_t* decoder)
 {
-	uint8_t* output = data_buffer;
-	if(output_length < packet_length)
-	{
-		DPRINT("FEC decoding error: buffer to small\n");
-		return 0;
-	}
+    uint8_t min_state = 0;
+    for(uint8_t state = 7; state != 0; state--) {
+        if(COST(decoder->costs, state) < COST(decoder->costs, min_state))
+            min_state = state;
+    }
 
-	if(packet_length % 4 != 0)
-	{
-		DPRINT("FEC decoding error: data 32 bit aligned\n");
-		return 0;
-	}
+    return min_state;
+}
 
-	output_buffer = output;
-	packetlength = packet_length;
-	output_packet_length = output_length;
+/*
+ * Follows the survivor path which ends in the given state back in time and returns the bits decoded
+ * on this path, skipping the most recent 'skip' bits. The decoded bit of a step is the LSB of the state.
+ */
+static uint8_t traceback(fec_decoder_t* decoder, uint8_t state, uint8_t skip)
+{
+    uint8_t byte = 0;
+    uint8_t bit_index = decoder->bit_count;
+    for(uint8_t step = 0; step < skip + 8; step++) {
+        bit_index--;
+        if(step >= skip)
+            byte |= (state & 0x01) << (step - skip);
+
+        state = (state >> 1) | (((decoder->decisions[bit_index % FEC_TRACEBACK_LENGTH] >> state) & 0x01) << 2);
+    }
 
-	processedbytes = 0;
-	fecprocessedbytes = 0;
+    return byte;
+}
 
-	vstate.path_size = 0;
+static void output_byte(fec_decoder_t* decoder, uint8_t byte)
+{
+    if(decoder->output_length < decoder->output_size)
+        decoder->output[decoder->output_length] = byte;
 
-	vstate.states1[0].cost = 0;
-	int16_t i;
-	for (i=1;i<8;i++)
-			vstate.states1[i].cost = 100;
+    decoder->output_length++;
+}
 
-	vstate.old = vstate.states1;
-	vstate.new = vstate.states2;
+static void decode_block(fec_decoder_t* decoder, uint8_t* input)
+{
+    // deinterleave (this reads the complete block, so decoding in place is possible)
+    uint32_t symbols = interleave(input[0] | (input[1] << 8) | ((uint32_t)input[2] << 16) | ((uint32_t)input[3] << 24));
+
+    for(uint8_t i = 0; i < 2; i++) {
+        uint16_t byte_symbols = ((symbols & 0xFF) << 8) | ((symbols >> 8) & 0xFF);
+        symbols >>= 16;
+
+        for(int8_t j = 14; j >= 0; j -= 2)
+            decode_symbol(decoder, (byte_symbols >> j) & 0x03);
+
+        decoder->decoded_bytes++;
+
+        // a byte is decided when 8 more bits have been decoded after it
+        if(decoder->decoded_bytes >= 2) {
+            // normalise the costs, only up to the lowest cost state itself like the original bit serial decoder
+            // did, so the decoded data remains identical
+            uint8_t min_state = lowest_cost_state(decoder);
+            uint8_t min_cost = COST(decoder->costs, min_state);
+#ifdef FEC_VITERBI_32BIT_LANES
+            uint32_t lanes = ((min_state & 0x03) == 3) ? ~0UL : ((1UL << (8 * ((min_state & 0x03) + 1))) - 1);
+            if(min_state < 4) {
+                decoder->costs[0] -= LANES(min_cost) & lanes;
+            } else {
+                decoder->costs[0] -= LANES(min_cost);
+                decoder->costs[1] -= LANES(min_cost) & lanes;
+            }
+#else
+            uint64_t lanes = (min_state == 7) ? ~0ULL : ((1ULL << (8 * (min_state + 1))) - 1);
+            decoder->costs -= LANES(min_cost) & lanes;
+#endif
+            output_byte(decoder, traceback(decoder, min_state, 8));
+        }
+    }
+}
 
-	uint16_t decoded_length = 0;
+uint16_t fec_decoder_feed(fec_decoder_t* decoder, uint8_t* data, uint16_t length)
+{
+    while(length > 0) {
+        if(decoder->input_length == 0 && length >= 4) {
+            decode_block(decoder, data);
+            data += 4;
+            length -= 4;
+            continue;
+        }
+
+        // keep bytes until a complete interleaved block is available
+        decoder->input[decoder->input_length++] = *data++;
+        length--;
+        if(decoder->input_length == 4) {
+            decode_block(decoder, decoder->input);
+            decoder->input_length = 0;
+        }
+    }
 
-	for(i = 0; i < packet_length; i = i + 4)
-	{
-		//printf("FEC encoding i = %d\n", i);
+    return decoder->output_length;
+}
 
-		bool err = fec_decode(&data[i]);
-		decoded_length+=2;
-		if (!err)
-			DPRINT("FEC encoding error\n");
-	}
+uint16_t fec_decoder_finish(fec_decoder_t* decoder)
+{
+    if(decoder->input_length != 0)
+        DPRINT("FEC decoding error: data 32 bit aligned\n");
 
-	memcpy(data, data_buffer, decoded_length);
+    // the last byte is decided on the path with the lowest cost
+    if(decoder->decoded_bytes > 0)
+        output_byte(decoder, traceback(decoder, lowest_cost_state(decoder), 0));
 
-	return decoded_length;
+    return decoder->output_length;
 }
 
-static bool fec_decode(uint8_t* input)
+uint16_t fec_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length)
 {
-	uint8_t i, k;
-	int8_t j;
-	uint8_t min_state;
-	uint8_t symbol;
-	uint16_t tmppn9;
-	uint8_t fecbuffer[4];
-	VITERBIPATH* vstate_tmp;
-
-	if(fecprocessedbytes >= packetlength)
-		return false;
-
-	//Deinterleaving (symbols are stored in reverse as this is easier for Viterbi decoding)
-
-#ifdef INTERLEAVING
-	//printf("Int: "); print_array(input, 4); printf("\n");
-	fecbuffer[0] = ((input[0] & 0x03)) |\
-					((input[1] & 0x03) << 2) |\
-					((input[2] & 0x03) << 4) |\
-					((input[3] & 0x03) << 6);
-	fecbuffer[1] = (((input[0] >> 2) & 0x03)) |\
-					(((input[1] >> 2) & 0x03) << 2) |\
-					(((input[2] >> 2) & 0x03) << 4) |\
-					(((input[3] >> 2) & 0x03) << 6);
-	fecbuffer[2] = (((input[0] >> 4) & 0x03)) |\
-					(((input[1] >> 4) & 0x03) << 2) |\
-					(((input[2] >> 4) & 0x03) << 4) |\
-					(((input[3] >> 4) & 0x03) << 6);
-	fecbuffer[3] = (((input[0] >> 6) & 0x03)) |\
-					(((input[1] >> 6) & 0x03) << 2) |\
-					(((input[2] >> 6) & 0x03) << 4) |\
-					(((input[3] >> 6) & 0x03) << 6);
-	//printf("DeI: "); print_array(fecbuffer, 4); printf("\n");
-#else
-	fecbuffer[0] = input[0];
-	fecbuffer[1] = input[1];
-	fecbuffer[2] = input[2];
-	fecbuffer[3] = input[3];
-#endif
-	//printf(" input = %04X%04X\n", fecbuffer[0],fecbuffer[1]);
-	fecprocessedbytes +=4;
-
-	for (i = 0; i < 3; i=i+2) {
-		//Viterbi decoding
-		//printf(" Encode i  %d -> %04X %s\n", i, fecbuffer[i], int_to_binary(fecbuffer[i]));
-
-		// todo: fix for loop
-		for (j = 7; j >= 0; j--) {
-			if (j>3)
-				symbol = (fecbuffer[i] >> (j-4)*2) & 0x03;
-			else
-				symbol = (fecbuffer[i+1] >> j*2) & 0x03;
-			//printf(" Symbol %d %x - %s\n", j, symbol, int_to_binary(symbol));
-			//fecbuffer[i] >>= 2;
-
-			for(k = 0; k < 8; k++) {
-				uint8_t cost0, cost1;
-				uint8_t state0, state1;
-				uint8_t hamming0, hamming1;
-
-				state0 = k >> 1;
-				state1 = state0 + 4;
-
-				cost0  = vstate.old[state0].cost;
-				cost1  = vstate.old[state1].cost;
-
-				//butterfly operation for 0
-				hamming0 = cost0 + (((trellis0_lut[state0] ^ symbol) + 1) >> 1);
-				hamming1 = cost1 + (((trellis0_lut[state1] ^ symbol) + 1) >> 1);
-
-				if(hamming0 <= hamming1) {
-					vstate.new[k].cost = hamming0;
-					vstate.new[k].path = vstate.old[state0].path << 1;
-				} else {
-					vstate.new[k].cost = hamming1;
-					vstate.new[k].path = vstate.old[state1].path << 1;
-				}
-
-				//printf("k %d part 1\n");
-				//print_vstate();
-
-				k++;
-
-				//butterfly operation for 1
-				hamming0 = cost0 + (((trellis1_lut[state0] ^ symbol) + 1) >> 1);
-				hamming1 = cost1 + (((trellis1_lut[state1] ^ symbol) + 1) >> 1);
-
-				if(hamming0 <= hamming1) {
-					vstate.new[k].cost = hamming0;
-					vstate.new[k].path = vstate.old[state0].path << 1 | 0x01;
-				} else {
-					vstate.new[k].cost = hamming1;
-					vstate.new[k].path = vstate.old[state1].path << 1 | 0x01;
-				}
-
-				//printf("k %d part 2\n");
-				//print_vstate();
-			}
-
-			//Swap Viterbi paths
-			vstate_tmp = vstate.new;
-			vstate.new = vstate.old;
-			vstate.old = vstate_tmp;
-
-			//print_vstate();
-		}
-
-		vstate.path_size++;
-
-		//Flush out byte if path is full
-		if ((vstate.path_size == 2) && (processedbytes < packetlength)) {
-			//Calculate path with lowest cost
-			min_state = 0;
-			for (j = 7; j != 0; j--) {
-				if(vstate.old[j].cost < vstate.old[min_state].cost)
-					min_state = j;
-			}
-
-	        //Normalize costs
-			if (vstate.old[min_state].cost > 0)
-				for (j = 0; j < 8; j++) vstate.old[j].cost -= vstate.old[min_state].cost;
-
-			*output_buffer++ = vstate.old[min_state].path >> 8;
-			vstate.path_size--;
-
-			processedbytes++;
-
-			if (processedbytes+ 2 == packetlength)
-				*output_buffer = (uint8_t) (vstate.old[min_state].path);
-		}
+	if(output_length < packet_length)
+	{
+		DPRINT("FEC decoding error: buffer to small\n");
+		return 0;
 	}
 
-	//print_vstate();
-
-
+	if(packet_length % 4 != 0)
+	{
+		DPRINT("FEC decoding error: data 32 bit aligned\n");
+		return 0;
+	}
 
-	return true;
+	// the decoded data is always behind the data which is still to be decoded, so decoding in place is safe
+	fec_decoder_t decoder;
+	fec_decoder_init(&decoder, data, output_length);
+	fec_decoder_feed(&decoder, data, packet_length);
+	return fec_decoder_finish(&decoder);
 }
-
-//#endif /* D7_PHY_USE_FEC */
@@ -25,6 +25,27 @@
 #include "errors.h"
 #include "debug.h"
 
+// wraps an index which is at most 2 * max_size - 1 into the buffer, without a division
+static inline uint16_t wrap_index(fifo_t const* fifo, uint32_t idx)
+{
+    if(fifo->index_mask)
+        return idx & fifo->index_mask;
+
+    return idx >= fifo->max_size ? idx - fifo->max_size : idx;
+}
+
+// describes the len bytes starting from idx as (at most) 2 contiguous spans in buffer
+static uint16_t get_spans(uint8_t* buffer, uint16_t max_size, uint16_t idx, uint16_t len, fifo_span_t spans[2])
+{
+    uint16_t part1 = max_size - idx;
+    if(part1 > len)
+        part1 = len;
+
+    spans[0] = (fifo_span_t){ .data = buffer + idx, .len = part1 };
+    spans[1] = (fifo_span_t){ .data = buffer, .len = len - part1 };
+    return len;
+}
+
 void fifo_init(fifo_t *fifo, uint8_t *buffer, uint16_t max_size)
 {
     fifo_init_filled(fifo, buffer, 0, max_size);
@@ -35,6 +56,7 @@ void fifo_init_filled(fifo_t *fifo, uint8_t *buffer, uint16_t filled_size, uint1
     fifo->buffer = buffer;
     fifo->head_idx = 0;
     fifo->max_size = max_size;
+    fifo->index_mask = (max_size & (max_size - 1)) == 0 ? max_size - 1 : 0;
     fifo->tail_idx = filled_size == 0 ? 0 : filled_size;
     fifo->tail_idx = filled_size == max_size ? 0 : filled_size;
     fifo->is_full = (filled_size == max_size);
@@ -46,9 +68,10 @@ error_t fifo_init_subview(fifo_t *subset_fifo, fifo_t* original_fifo, uint16_t o
         return ESIZE;
 
     subset_fifo->buffer = original_fifo->buffer;
-    subset_fifo->head_idx = (original_fifo->head_idx + offset) % original_fifo->max_size;
-    subset_fifo->tail_idx = (original_fifo->head_idx + offset + subset_size) % original_fifo->max_size;
+    subset_fifo->head_idx = wrap_index(original_fifo, original_fifo->head_idx + offset);
+    subset_fifo->tail_idx = wrap_index(original_fifo, original_fifo->head_idx + offset + subset_size);
     subset_fifo->max_size = original_fifo->max_size;
+    subset_fifo->index_mask = original_fifo->index_mask;
     subset_fifo->is_full = (subset_size == subset_fifo->max_size);
     subset_fifo->is_subview = true;
     return SUCCESS;
@@ -96,7 +119,17 @@ error_t fifo_put(fifo_t *fifo, uint8_t *data, uint16_t len)
 
 error_t fifo_put_byte(fifo_t* fifo, uint8_t byte)
 {
-    return fifo_put(fifo, &byte, 1);
+    // used a lot by the ALP encoders, so store directly instead of going through fifo_put()
+    if(fifo->is_subview)
+        return EINVAL;
+
+    if(fifo->is_full)
+        return ESIZE;
+
+    fifo->buffer[fifo->tail_idx] = byte;
+    fifo->tail_idx = wrap_index(fifo, fifo->tail_idx + 1);
+    fifo->is_full = (fifo->tail_idx == fifo->head_idx);
+    return SUCCESS;
 }
 
 static error_t check_len(fifo_t* fifo, uint16_t len) {
@@ -111,11 +144,7 @@ static error_t check_len(fifo_t* fifo, uint16_t len) {
 
 static void skip(fifo_t* fifo, uint16_t len) {
   // progress head to implement popping behaviour
-  fifo->head_idx = (fifo->head_idx + len);
-  if(fifo->head_idx >= fifo->max_size)
-  {
-    fifo->head_idx = fifo->head_idx % fifo->max_size;
-  }
+  fifo->head_idx = wrap_index(fifo, fifo->head_idx + len);
 
   if(len > 0)
     fifo->is_full = 0;
@@ -175,8 +204,8 @@ error_t fifo_peek(fifo_t* fifo, uint8_t* buffer, uint16_t offset, uint16_t len)
     return err;
 
   // determine start/end index (in circular buffer)
-  uint16_t start_idx = (fifo->head_idx + offset) % fifo->max_size;
-  uint16_t end_idx   = (start_idx      + len   ) % fifo->max_size;
+  uint16_t start_idx = wrap_index(fifo, fifo->head_idx + offset);
+  uint16_t end_idx   = wrap_index(fifo, start_idx      + len   );
 
   // simple case: the end doesn't wrap...
   // .............
@@ -223,8 +252,123 @@ void fifo_clear(fifo_t* fifo)
 {
     fifo->head_idx = 0;
     fifo->tail_idx = 0;
+    fifo->is_full = false;
 }
 
 bool fifo_is_full(fifo_t* fifo) {
     return fifo->is_full;
 }
+
+uint16_t fifo_reserve(fifo_t* fifo, fifo_span_t spans[2])
+{
+    uint16_t free_space = fifo->is_subview ? 0 : fifo->max_size - fifo_get_size(fifo);
+    return get_spans(fifo->buffer, fifo->max_size, fifo->tail_idx, free_space, spans);
+}
+
+error_t fifo_commit(fifo_t* fifo, uint16_t len)
+{
+    if(fifo->is_subview)
+        return EINVAL;
+
+    if(len > fifo->max_size - fifo_get_size(fifo))
+        return ESIZE;
+
+    if(len == 0)
+        return SUCCESS;
+
+    fifo->tail_idx = wrap_index(fifo, fifo->tail_idx + len);
+    fifo->is_full = (fifo->tail_idx == fifo->head_idx);
+    return SUCCESS;
+}
+
+uint16_t fifo_peek_spans(fifo_t* fifo, fifo_span_t spans[2])
+{
+    return get_spans(fifo->buffer, fifo->max_size, fifo->head_idx, fifo_get_size(fifo), spans);
+}
+
+error_t fifo_consume(fifo_t* fifo, uint16_t len)
+{
+    return fifo_skip(fifo, len);
+}
+
+// The SPSC fifo relies on each index being written by one side only. The acquire load of the index owned by the
+// other side makes sure its accesses to the buffer are visible before we use the space or data it released, the
+// release store of our own index makes sure our buffer accesses are done before the other side sees the update.
+// On a single core this boils down to compiler barriers (and a DMB where the architecture has one).
+#define SPSC_LOAD_OWN(idx)        __atomic_load_n(&(idx), __ATOMIC_RELAXED)
+#define SPSC_LOAD_OTHER(idx)      __atomic_load_n(&(idx), __ATOMIC_ACQUIRE)
+#define SPSC_STORE_OWN(idx, val)  __atomic_store_n(&(idx), (val), __ATOMIC_RELEASE)
+
+void fifo_spsc_init(fifo_spsc_t* fifo, uint8_t* buffer, uint16_t max_size)
+{
+    // the free running 16 bit indices only wrap correctly when max_size is a power of 2
+    assert(max_size > 0 && max_size <= 0x8000 && (max_size & (max_size - 1)) == 0);
+    fifo->buffer = buffer;
+    fifo->max_size = max_size;
+    fifo->head = 0;
+    fifo->tail = 0;
+}
+
+uint16_t fifo_spsc_get_size(fifo_spsc_t* fifo)
+{
+    // consistent for both sides, since the index owned by the caller can not change meanwhile
+    return (uint16_t)(SPSC_LOAD_OTHER(fifo->tail) - SPSC_LOAD_OTHER(fifo->head));
+}
+
+uint16_t fifo_spsc_reserve(fifo_spsc_t* fifo, fifo_span_t spans[2])
+{
+    uint16_t tail = SPSC_LOAD_OWN(fifo->tail);
+    uint16_t free_space = fifo->max_size - (uint16_t)(tail - SPSC_LOAD_OTHER(fifo->head));
+    return get_spans(fifo->buffer, fifo->max_size, tail & (fifo->max_size - 1), free_space, spans);
+}
+
+error_t fifo_spsc_commit(fifo_spsc_t* fifo, uint16_t len)
+{
+    uint16_t tail = SPSC_LOAD_OWN(fifo->tail);
+    if(len > fifo->max_size - (uint16_t)(tail - SPSC_LOAD_OTHER(fifo->head)))
+        return ESIZE;
+
+    SPSC_STORE_OWN(fifo->tail, (uint16_t)(tail + len));
+    return SUCCESS;
+}
+
+error_t fifo_spsc_put(fifo_spsc_t* fifo, uint8_t const* data, uint16_t len)
+{
+    fifo_span_t spans[2];
+    if(fifo_spsc_reserve(fifo, spans) < len)
+        return ESIZE;
+
+    uint16_t part1 = len < spans[0].len ? len : spans[0].len;
+    memcpy(spans[0].data, data, part1);
+    memcpy(spans[1].data, data + part1, len - part1);
+    return fifo_spsc_commit(fifo, len);
+}
+
+uint16_t fifo_spsc_peek_spans(fifo_spsc_t* fifo, fifo_span_t spans[2])
+{
+    uint16_t head = SPSC_LOAD_OWN(fifo->head);
+    uint16_t size = (uint16_t)(SPSC_LOAD_OTHER(fifo->tail) - head);
+    return get_spans(fifo->buffer, fifo->max_size, head & (fifo->max_size - 1), size, spans);
+}
+
+error_t fifo_spsc_consume(fifo_spsc_t* fifo, uint16_t len)
+{
+    uint16_t head = SPSC_LOAD_OWN(fifo->head);
+    if(len > (uint16_t)(SPSC_LOAD_OTHER(fifo->tail) - head))
+        return ESIZE;
+
+    SPSC_STORE_OWN(fifo->head, (uint16_t)(head + len));
+    return SUCCESS;
+}
+
+error_t fifo_spsc_pop(fifo_spsc_t* fifo, uint8_t* buffer, uint16_t len)
+{
+    fifo_span_t spans[2];
+    if(fifo_spsc_peek_spans(fifo, spans) < len)
+        return ESIZE;
+
+    uint16_t part1 = len < spans[0].len ? len : spans[0].len;
+    memcpy(buffer, spans[0].data, part1);
+    memcpy(buffer + part1, spans[1].data, len - part1);
+    return fifo_spsc_consume(fifo, len);
+}
@@ -34,6 +34,7 @@
 #include "errors.h"
 #include "platform.h"
 #include "hwblockdevice.h"
+#include "ng.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_FS_LOG_ENABLED)
   #define DPRINT(...) log_print_string( __VA_ARGS__)
@@ -43,18 +44,18 @@
 
 #define FS_BLOCKDEVICES_COUNT       3 // metadata, permanent and volatile
 
-static fs_file_t files[FRAMEWORK_FS_FILE_COUNT] = { 0 }; // TODO do not keep all file metadata in RAM but use smaller MRU cache to save RAM
+static fs_file_t NGDEF(files)[FRAMEWORK_FS_FILE_COUNT]; // TODO do not keep all file metadata in RAM but use smaller MRU cache to save RAM
 
-static bool is_fs_init_completed = false;  //set in _d7a_verify_magic()
+static bool NGDEF(is_fs_init_completed);  //set in _d7a_verify_magic()
 
 #define IS_SYSTEM_FILE(file_id)         (file_id <= 0x3F)
 
-static fs_modified_file_callback_t file_modified_callbacks[FRAMEWORK_FS_FILE_COUNT] = { NULL }; // TODO limit to lower number so save RAM?
+static fs_modified_file_callback_t NGDEF(file_modified_callbacks)[FRAMEWORK_FS_FILE_COUNT]; // TODO limit to lower number so save RAM?
 
-static uint32_t volatile_data_offset = 0;
-static uint32_t permanent_data_offset = 0;
+static uint32_t NGDEF(volatile_data_offset);
+static uint32_t NGDEF(permanent_data_offset);
 
-static blockdevice_t* bd[FS_BLOCKDEVICES_COUNT];
+static blockdevice_t* NGDEF(bd)[FS_BLOCKDEVICES_COUNT];
 
 /* forward internal declarations */
 static int _fs_init(void);
@@ -65,7 +66,7 @@ static int _fs_create_file(uint8_t file_id, fs_storage_class_t storage_class, co
 static inline bool _is_file_defined(uint8_t file_id)
 {
     //return files[file_id].storage == FS_STORAGE_INVALID;
-    return files[file_id].length != 0;
+    return NG(files)[file_id].length != 0;
 }
 
 static inline uint32_t _get_file_header_address(uint8_t file_id)
@@ -75,20 +76,20 @@ static inline uint32_t _get_file_header_address(uint8_t file_id)
 
 void fs_init()
 {
-    if (is_fs_init_completed)
+    if (NG(is_fs_init_completed))
         return /*0*/;
 
-    memset(files,0,sizeof(files));
+    memset(NG(files),0,sizeof(NG(files)));
 
     // inject the mandatory blockdevice types from the platform
     // for now, only metadata, permanent and volatile storage are supported
-    bd[FS_BLOCKDEVICE_TYPE_METADATA] = PLATFORM_METADATA_BLOCKDEVICE;
-    bd[FS_BLOCKDEVICE_TYPE_PERMANENT] = PLATFORM_PERMANENT_BLOCKDEVICE;
-    bd[FS_BLOCKDEVICE_TYPE_VOLATILE] = PLATFORM_VOLATILE_BLOCKDEVICE;
+    NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA] = PLATFORM_METADATA_BLOCKDEVICE;
+    NG(bd)[FS_BLOCKDEVICE_TYPE_PERMANENT] = PLATFORM_PERMANENT_BLOCKDEVICE;
+    NG(bd)[FS_BLOCKDEVICE_TYPE_VOLATILE] = PLATFORM_VOLATILE_BLOCKDEVICE;
 
     _fs_init();
 
-    is_fs_init_completed = true;
+    NG(is_fs_init_completed) = true;
     DPRINT("fs_init OK");
 }
 
@@ -103,7 +104,7 @@ int _fs_init()
 
     // initialise system file caching
     uint32_t number_of_files;
-    blockdevice_read(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&number_of_files, FS_NUMBER_OF_FILES_ADDRESS, FS_NUMBER_OF_FILES_SIZE);
+    blockdevice_read(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&number_of_files, FS_NUMBER_OF_FILES_ADDRESS, FS_NUMBER_OF_FILES_SIZE);
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
     number_of_files = __builtin_bswap32(number_of_files);
 #endif
@@ -111,37 +112,34 @@ int _fs_init()
     assert(number_of_files < FRAMEWORK_FS_FILE_COUNT);
     for(int file_id = 0; file_id < FRAMEWORK_FS_FILE_COUNT; file_id++)
     {
-        blockdevice_read(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&files[file_id],
+        blockdevice_read(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&NG(files)[file_id],
                          _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
 
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
         // FS headers are stored in big endian
-        files[file_id].addr = __builtin_bswap32(files[file_id].addr);
-        files[file_id].length = __builtin_bswap32(files[file_id].length);
+        NG(files)[file_id].addr = __builtin_bswap32(NG(files)[file_id].addr);
+        NG(files)[file_id].length = __builtin_bswap32(NG(files)[file_id].length);
 #endif
 
         if(_is_file_defined(file_id))
         {
-            switch(files[file_id].blockdevice_index)
+            switch(NG(files)[file_id].blockdevice_index)
             {
                 case FS_BLOCKDEVICE_TYPE_VOLATILE:
                 {
                     //copy defaults from permanent storage to volatile
-                    uint8_t data = 0x00;
-                    for(int i=0; i < files[file_id].length; i++)
-                    {
-                        blockdevice_read(bd[FS_BLOCKDEVICE_TYPE_PERMANENT], &data, files[file_id].addr + i, 1);
-                        blockdevice_program(bd[FS_BLOCKDEVICE_TYPE_VOLATILE], &data, volatile_data_offset + i, 1);
-    
-                    }
+                    blockdevice_copy(NG(bd)[FS_BLOCKDEVICE_TYPE_VOLATILE], NG(volatile_data_offset),
+                                     NG(bd)[FS_BLOCKDEVICE_TYPE_PERMANENT], NG(files)[file_id].addr,
+                                     NG(files)[file_id].length);
+
                     // update file header
-                    files[file_id].addr = volatile_data_offset;
-                    volatile_data_offset += files[file_id].length;
+                    NG(files)[file_id].addr = NG(volatile_data_offset);
+                    NG(volatile_data_offset) += NG(files)[file_id].length;
                     break;
                 }
                 case FS_BLOCKDEVICE_TYPE_PERMANENT:
                 {
-                    permanent_data_offset += files[file_id].length;
+                    NG(permanent_data_offset) += NG(files)[file_id].length;
                     break;
                 }
                 default:
@@ -155,7 +153,7 @@ int _fs_init()
 //TODO: CRC MAGIC
 static int _fs_create_magic()
 {
-    assert(!is_fs_init_completed);
+    assert(!NG(is_fs_init_completed));
     uint8_t magic[] = FS_MAGIC_NUMBER;
 
     /* verify */
@@ -166,11 +164,11 @@ static int _fs_create_magic()
 /* The magic number allows to check filesystem integrity.*/
 static int _fs_verify_magic(uint8_t* expected_magic_number)
 {
-    is_fs_init_completed = false;
+    NG(is_fs_init_completed) = false;
 
     uint8_t magic_number[FS_MAGIC_NUMBER_SIZE];
     memset(magic_number,0,FS_MAGIC_NUMBER_SIZE);
-    blockdevice_read(bd[FS_BLOCKDEVICE_TYPE_METADATA], magic_number, 0, FS_MAGIC_NUMBER_SIZE);
+    blockdevice_read(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], magic_number, 0, FS_MAGIC_NUMBER_SIZE);
     assert(memcmp(expected_magic_number, magic_number, FS_MAGIC_NUMBER_SIZE) == 0); // if not the FS on EEPROM is not compatible with the current code
 
     return 0;
@@ -189,36 +187,36 @@ int _fs_create_file(uint8_t file_id, fs_storage_class_t storage_class, const uin
     if(storage_class == FS_STORAGE_VOLATILE)
         bd_type = FS_BLOCKDEVICE_TYPE_VOLATILE;
 
-    files[file_id].blockdevice_index = (uint8_t)bd_type;
-    files[file_id].length = length;
+    NG(files)[file_id].blockdevice_index = (uint8_t)bd_type;
+    NG(files)[file_id].length = length;
 
     // only user files can be created
     assert(file_id >= 0x40);
 
     if (bd_type == FS_BLOCKDEVICE_TYPE_PERMANENT)
     {
-        files[file_id].addr = permanent_data_offset;
+        NG(files)[file_id].addr = NG(permanent_data_offset);
 
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
         fs_file_t file_header_big_endian;
-        memcpy(&file_header_big_endian, (void*)&files[file_id], sizeof (fs_file_t));
+        memcpy(&file_header_big_endian, (void*)&NG(files)[file_id], sizeof (fs_file_t));
         file_header_big_endian.length = __builtin_bswap32(file_header_big_endian.length);
         file_header_big_endian.addr = __builtin_bswap32(file_header_big_endian.addr);
-        blockdevice_program(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&file_header_big_endian, _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
+        blockdevice_program(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&file_header_big_endian, _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
 #else
-        blockdevice_program(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&files[file_id], _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
+        blockdevice_program(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&NG(files)[file_id], _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
 #endif
 
-        permanent_data_offset += length;
+        NG(permanent_data_offset) += length;
     }
     else
     {
-        files[file_id].addr = volatile_data_offset;
-        volatile_data_offset += length;
+        NG(files)[file_id].addr = NG(volatile_data_offset);
+        NG(volatile_data_offset) += length;
     }
 
     if(initial_data != NULL) {
-        blockdevice_program(bd[bd_type], initial_data, files[file_id].addr, length);
+        blockdevice_program(NG(bd)[bd_type], initial_data, NG(files)[file_id].addr, length);
     }
     else{
         // do not use variable length array to limit stack usage, do in chunks instead
@@ -227,21 +225,21 @@ int _fs_create_file(uint8_t file_id, fs_storage_class_t storage_class, const uin
         uint32_t remaining_length = length;
         int i = 0;
         while(remaining_length > 64) {
-          blockdevice_program(bd[bd_type], default_data, files[file_id].addr + (i * 64), 64);
+          blockdevice_program(NG(bd)[bd_type], default_data, NG(files)[file_id].addr + (i * 64), 64);
           remaining_length -= 64;
           i++;
         }
 
-        blockdevice_program(bd[bd_type], default_data, files[file_id].addr  + (i * 64), remaining_length);
+        blockdevice_program(NG(bd)[bd_type], default_data, NG(files)[file_id].addr  + (i * 64), remaining_length);
     }
 
-    DPRINT("fs init file(file_id %d, storage %d, addr %p, length %d)\n",file_id, storage_class, files[file_id].addr, length);
+    DPRINT("fs init file(file_id %d, storage %d, addr %p, length %d)\n",file_id, storage_class, NG(files)[file_id].addr, length);
     return 0;
 }
 
 int fs_init_file(uint8_t file_id, fs_storage_class_t storage_class, const uint8_t* initial_data, uint32_t length)
 {
-    assert(is_fs_init_completed);
+    assert(NG(is_fs_init_completed));
     assert(file_id < FRAMEWORK_FS_FILE_COUNT);
     assert(file_id >= 0x40); // system files may not be inited
     assert(storage_class == FS_STORAGE_VOLATILE || storage_class == FS_STORAGE_PERMANENT); // other options not implemented
@@ -253,47 +251,63 @@ int fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_t len
 {
     if(!_is_file_defined(file_id)) return -ENOENT;
 
-    if(files[file_id].length < offset + length) return -EINVAL;
+    if(NG(files)[file_id].length < offset + length) return -EINVAL;
 
-    error_t e = blockdevice_read(bd[files[file_id].blockdevice_index], buffer, files[file_id].addr + offset, length);
+    error_t e = blockdevice_read(NG(bd)[NG(files)[file_id].blockdevice_index], buffer, NG(files)[file_id].addr + offset, length);
     assert(e == SUCCESS);
 
-    DPRINT("fs read_file(file_id %d, offset %d, addr %p, length %d)\n",file_id, offset, files[file_id].addr, length);
+    DPRINT("fs read_file(file_id %d, offset %d, addr %p, length %d)\n",file_id, offset, NG(files)[file_id].addr, length);
     return 0;
 }
 
-int fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length)
+static int write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length, bool notify)
 {
     if(!_is_file_defined(file_id)) return -ENOENT;
 
-    if(files[file_id].length < offset + length) return -ENOBUFS;
+    if(NG(files)[file_id].length < offset + length) return -ENOBUFS;
 
-    blockdevice_program(bd[files[file_id].blockdevice_index], buffer, files[file_id].addr + offset, length);
+    blockdevice_program_changed(NG(bd)[NG(files)[file_id].blockdevice_index], buffer, NG(files)[file_id].addr + offset, length);
 
     DPRINT("fs write_file (file_id %d, offset %d, addr %p, length %d)\n",
-           file_id, offset, files[file_id].addr, length);
+           file_id, offset, NG(files)[file_id].addr, length);
 
-    if(file_modified_callbacks[file_id])
-         file_modified_callbacks[file_id](file_id);
+    if(notify)
+        fs_notify_file_modified(file_id);
 
     return 0;
 }
 
+int fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length)
+{
+    return write_file(file_id, offset, buffer, length, true);
+}
+
+int fs_persist_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length)
+{
+    return write_file(file_id, offset, buffer, length, false);
+}
+
+void fs_notify_file_modified(uint8_t file_id)
+{
+    if(NG(file_modified_callbacks)[file_id])
+         NG(file_modified_callbacks)[file_id](file_id);
+}
+
 fs_file_stat_t *fs_file_stat(uint8_t file_id)
 {
-    assert(is_fs_init_completed);
+    assert(NG(is_fs_init_completed));
 
     assert(file_id < FRAMEWORK_FS_FILE_COUNT);
 
     if (_is_file_defined(file_id))
-        return (fs_file_stat_t*)&files[file_id];
+        return (fs_file_stat_t*)&NG(files)[file_id];
     else
         return NULL;
 }
 
 bool fs_unregister_file_modified_callback(uint8_t file_id) {
-    if(file_modified_callbacks[file_id]) {
-        file_modified_callbacks[file_id] = NULL;
+    if(NG(file_modified_callbacks)[file_id]) {
+        NG(file_modified_callbacks)[file_id] = NULL;
         return true;
     } else
         return false;
@@ -303,9 +317,9 @@ bool fs_register_file_modified_callback(uint8_t file_id, fs_modified_file_callba
 {
     assert(_is_file_defined(file_id));
 
-    if(file_modified_callbacks[file_id])
+    if(NG(file_modified_callbacks)[file_id])
         return false; // already registered
 
-    file_modified_callbacks[file_id] = callback;
+    NG(file_modified_callbacks)[file_id] = callback;
     return true;
 }
@@ -32,6 +32,11 @@
 #include <unistd.h>
 #include "framework_defs.h"
 #include "hwsystem.h"
+#include "hwatomic.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "debug.h"
+#include "errors.h"
 
 #ifdef FRAMEWORK_LOG_ENABLED
 
@@ -44,6 +49,168 @@ __LINK_C void log_counter_reset()
 	NG(counter) = 0;
 }
 
+#ifdef FRAMEWORK_LOG_BINARY
+
+/*
+ * Binary log records, all multi-byte fields are little endian and words (addresses and arguments) have the size
+ * of a pointer on the target:
+ *
+ * |sync|kind|layer|length|timestamp (4)|payload (length)|
+ *
+ * The payload of a string record is the address of the format string followed by one word per argument. Data
+ * records contain the raw data, split over multiple records (the later ones of kind DATA_CONTINUED) when needed.
+ * A DROPPED record contains the number of records which were dropped because the buffer was full. The ANCHOR
+ * record contains the runtime address of log_binary_anchor, which lets the decoder relocate the addresses of
+ * position independent executables.
+ */
+#define LOG_RECORD_SYNC 0xA5
+#define LOG_RECORD_HEADER_SIZE 8
+#define LOG_RECORD_STRING 0x00
+#define LOG_RECORD_DATA 0x01
+#define LOG_RECORD_DATA_CONTINUED 0x02
+#define LOG_RECORD_DROPPED 0x03
+#define LOG_RECORD_ANCHOR 0x04
+
+#define LOG_MAX_ARGS 15
+#define LOG_DATA_CHUNK_SIZE 32
+#define LOG_DRAIN_CHUNK_SIZE 64 // limits the time the drain task occupies the scheduler
+
+const char log_binary_anchor[] = "log_binary_anchor";
+
+static uint8_t NGDEF(_log_buffer)[FRAMEWORK_LOG_BUFFER_SIZE];
+#define log_buffer NG(_log_buffer)
+
+// the producers (which can run in interrupt context) only move the head, the drain task only moves the tail
+static volatile uint16_t NGDEF(_log_head);
+#define log_head NG(_log_head)
+static volatile uint16_t NGDEF(_log_tail);
+#define log_tail NG(_log_tail)
+
+static uint32_t NGDEF(_log_dropped);
+#define log_dropped NG(_log_dropped)
+
+static sched_task_handle_t NGDEF(_drain_task_handle);
+#define drain_task_handle NG(_drain_task_handle)
+
+static void drain_log_buffer(void *arg)
+{
+  uint16_t head = log_head; // the records before the head are complete
+  uint16_t tail = log_tail;
+  if(head == tail)
+    return;
+
+  uint16_t length = head > tail ? head - tail : FRAMEWORK_LOG_BUFFER_SIZE - tail;
+  if(length > LOG_DRAIN_CHUNK_SIZE)
+    length = LOG_DRAIN_CHUNK_SIZE;
+
+  // goes to the console or to RTT through the _write() of the platform, like printf()
+  write(STDOUT_FILENO, log_buffer + tail, length);
+  tail = (tail + length) % FRAMEWORK_LOG_BUFFER_SIZE;
+  log_tail = tail;
+  if(log_head != tail)
+    sched_post_handle_prio(drain_task_handle, MIN_PRIORITY, NULL);
+}
+
+static inline void copy_to_buffer(uint16_t* idx, const uint8_t* data, uint8_t length)
+{
+  uint16_t part1_len = FRAMEWORK_LOG_BUFFER_SIZE - *idx;
+  if(part1_len > length)
+    part1_len = length;
+
+  memcpy(log_buffer + *idx, data, part1_len);
+  memcpy(log_buffer, data + part1_len, length - part1_len);
+  *idx = (*idx + length) % FRAMEWORK_LOG_BUFFER_SIZE;
+}
+
+// should be called in an atomic section
+static inline bool put_record(uint16_t* head, uint16_t* free, uint8_t* header, const uint8_t* payload, uint8_t length)
+{
+  if(*free < LOG_RECORD_HEADER_SIZE + length)
+    return false;
+
+  header[3] = length;
+  copy_to_buffer(head, header, LOG_RECORD_HEADER_SIZE);
+  copy_to_buffer(head, payload, length);
+  *free -= LOG_RECORD_HEADER_SIZE + length;
+  return true;
+}
+
+static void write_record(uint8_t kind, uint8_t layer, const uint8_t* payload, uint8_t length)
+{
+  uint8_t header[LOG_RECORD_HEADER_SIZE] = { LOG_RECORD_SYNC, kind, layer, length };
+  timer_tick_t timestamp = timer_get_counter_value();
+  memcpy(header + 4, &timestamp, sizeof(timestamp));
+
+  start_atomic();
+  uint16_t head = log_head;
+  uint16_t tail = log_tail;
+  // one byte is kept free to distinguish a full buffer from an empty one
+  uint16_t free = (tail + FRAMEWORK_LOG_BUFFER_SIZE - head - 1) % FRAMEWORK_LOG_BUFFER_SIZE;
+  bool was_empty = head == tail;
+
+  if(log_dropped > 0)
+  {
+    uint8_t dropped_header[LOG_RECORD_HEADER_SIZE];
+    memcpy(dropped_header, header, LOG_RECORD_HEADER_SIZE);
+    dropped_header[1] = LOG_RECORD_DROPPED;
+    if(put_record(&head, &free, dropped_header, (uint8_t*) &log_dropped, sizeof(log_dropped)))
+      log_dropped = 0;
+  }
+
+  if(log_dropped > 0 || !put_record(&head, &free, header, payload, length))
+    log_dropped++;
+
+  log_head = head;
+  end_atomic();
+
+  if(was_empty && head != tail)
+    sched_post_handle_prio(drain_task_handle, MIN_PRIORITY, NULL);
+}
+
+__LINK_C void log_init()
+{
+  log_head = 0;
+  log_tail = 0;
+  log_dropped = 0;
+  error_t err = sched_register_task_handle(&drain_log_buffer, &drain_task_handle);
+  assert(err == SUCCESS || err == EALREADY);
+
+  uintptr_t anchor = (uintptr_t) log_binary_anchor;
+  write_record(LOG_RECORD_ANCHOR, LOG_BINARY_LAYER_NONE, (uint8_t*) &anchor, sizeof(anchor));
+}
+
+__LINK_C void log_binary_print_string(uint8_t layer, uint8_t arg_count, const char* format, ...)
+{
+  uintptr_t words[1 + LOG_MAX_ARGS];
+  words[0] = (uintptr_t) format;
+
+  va_list args;
+  va_start(args, format);
+  for(uint8_t i = 0; i < arg_count; i++)
+    words[i + 1] = va_arg(args, uintptr_t); // arguments are promoted to at least int, wider types are not supported
+
+  va_end(args);
+  write_record(LOG_RECORD_STRING, layer, (uint8_t*) words, (1 + arg_count) * sizeof(uintptr_t));
+}
+
+__LINK_C void log_binary_print_data(uint8_t* message, uint32_t length)
+{
+  uint8_t kind = LOG_RECORD_DATA;
+  do {
+    uint8_t chunk_len = length > LOG_DATA_CHUNK_SIZE ? LOG_DATA_CHUNK_SIZE : length;
+    write_record(kind, LOG_BINARY_LAYER_NONE, message, chunk_len);
+    kind = LOG_RECORD_DATA_CONTINUED;
+    message += chunk_len;
+    length -= chunk_len;
+  } while(length > 0);
+}
+
+#else
+
+__LINK_C void log_init()
+{
+}
+
 __LINK_C void log_print_string(char* format, ...)
 {
     va_list args;
@@ -71,5 +238,7 @@ __LINK_C void log_print_data(uint8_t* message, uint32_t length)
     }
 }
 
+#endif //FRAMEWORK_LOG_BINARY
+
 
 #endif //FRAMEWORK_LOG_ENABLED
@@ -21,9 +21,10 @@
 #include "crc.h"
 
 #include "log.h"
+#include "perf_counters.h"
 
 
-#define RX_BUFFER_SIZE 256
+#define RX_BUFFER_SIZE 512 // room for at least one complete frame of the maximum size
 
 #define TX_FIFO_FLUSH_CHUNK_SIZE 10 // at a baudrate of 115200 this ensures completion within 1 ms
                                     // TODO baudrate dependent
@@ -43,15 +44,37 @@ static fifo_t rx_fifo;
 
 
 #define SERIAL_FRAME_SYNC_BYTE 0xC0
-#define SERIAL_FRAME_VERSION   0x00
+#define SERIAL_FRAME_VERSION_0 0x00
+#define SERIAL_FRAME_VERSION_1 0x01
 #define SERIAL_FRAME_HEADER_SIZE 7
 #define SERIAL_FRAME_SIZE 4
 #define SERIAL_FRAME_COUNTER 2
 #define SERIAL_FRAME_TYPE 3
 #define SERIAL_FRAME_CRC1   5
 #define SERIAL_FRAME_CRC2   6
-
-#define MODEM_INTERFACE_TX_FIFO_SIZE 255
+#define SERIAL_FRAME_MAX_PAYLOAD_SIZE UINT8_MAX
+
+// Protocol v1 replaces the counter and message type by a sequence number and a cumulative acknowledgement, which
+// are covered by the CRC as well. The payload consists of records (type, length, data), so several small messages
+// share a frame. Data frames are retransmitted until acknowledged, with at most MODEM_INTERFACE_WINDOW_SIZE
+// unacknowledged frames outstanding. Frames without records only carry an acknowledgement and do not consume a
+// sequence number. A v0 peer is detected when it sends a v0 frame, or when it does not acknowledge our frames.
+#define SERIAL_FRAME_SEQ 2
+#define SERIAL_FRAME_ACK 3
+#define SERIAL_RECORD_HEADER_SIZE 2
+#define SERIAL_RECORD_MAX_SIZE (SERIAL_FRAME_MAX_PAYLOAD_SIZE - SERIAL_RECORD_HEADER_SIZE)
+
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+#define ACK_TIMEOUT (TIMER_TICKS_PER_SEC / 4)
+#define MAX_RETRANSMISSIONS 3
+#define MODEM_INTERFACE_WINDOW_SIZE FRAMEWORK_MODEM_INTERFACE_WINDOW_SIZE
+// the records waiting for the next data frame, or a single message which is too large for a record
+#define TX_BATCH_SIZE (SERIAL_RECORD_HEADER_SIZE + SERIAL_FRAME_MAX_PAYLOAD_SIZE)
+#define MODEM_INTERFACE_TX_FIFO_SIZE (2 * (SERIAL_FRAME_HEADER_SIZE + SERIAL_FRAME_MAX_PAYLOAD_SIZE))
+#else
+// only v0 is used, messages are not batched or kept for retransmission, only the TX fifo holds them
+#define MODEM_INTERFACE_TX_FIFO_SIZE (SERIAL_FRAME_HEADER_SIZE + SERIAL_FRAME_MAX_PAYLOAD_SIZE)
+#endif
 static uint8_t modem_interface_tx_buffer[MODEM_INTERFACE_TX_FIFO_SIZE];
 static fifo_t modem_interface_tx_fifo;
 static bool request_pending = false;
@@ -60,10 +83,31 @@ uint8_t header[SERIAL_FRAME_HEADER_SIZE];
 static uint8_t payload_len = 0;
 static uint8_t packet_up_counter = 0;
 static uint8_t packet_down_counter = 0;
+
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+typedef struct {
+  uint8_t seq;
+  uint8_t length;
+  uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD_SIZE];
+} unacked_frame_t;
+
+static uint8_t tx_version = SERIAL_FRAME_VERSION_1;
+static bool peer_v1 = false;
+static uint8_t tx_seq = 0; // sequence number of the last data frame we transmitted
+static uint8_t rx_seq = 0; // sequence number of the last data frame received in order, which is acknowledged
+static bool ack_pending = false;
+static uint8_t retransmissions = 0;
+static uint8_t tx_batch[TX_BATCH_SIZE]; // records waiting for the next data frame, or for room in the TX fifo using v0
+static uint16_t tx_batch_len = 0;
+static unacked_frame_t unacked_frames[MODEM_INTERFACE_WINDOW_SIZE];
+static uint8_t unacked_head = 0;
+static uint8_t unacked_count = 0;
+#endif
 static pin_id_t uart_state_pin;
 static pin_id_t target_uart_state_pin;
 
 static bool modem_listen_uart_inited = false;
+static sched_task_handle_t process_rx_fifo_handle;
 static bool parsed_header = false;
 
 static cmd_handler_t alp_handler;
@@ -89,6 +133,11 @@ static state_t state = STATE_IDLE;
 
 static void process_rx_fifo(void *arg);
 static void execute_state_machine();
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+static bool has_pending_messages();
+static void send_batch(void *arg);
+static void retransmit(void *arg);
+#endif
 
 
 /** @Brief Enable UART interface and UART interrupt
@@ -130,13 +179,17 @@ static void release_receiver()
  */
 static void flush_modem_interface_tx_fifo(void *arg) 
 {
-  uint8_t len = fifo_get_size(&modem_interface_tx_fifo);
+  uint16_t len = fifo_get_size(&modem_interface_tx_fifo);
 
 #ifdef HAL_UART_USE_DMA_TX
   // when using DMA we transmit the whole FIFO at once
-  uint8_t buffer[MODEM_INTERFACE_TX_FIFO_SIZE];
+  static uint8_t buffer[MODEM_INTERFACE_TX_FIFO_SIZE];
   fifo_pop(&modem_interface_tx_fifo, buffer, len);
   uart_send_bytes(uart, buffer, len);
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+  if(has_pending_messages())
+    sched_post_task_prio(&send_batch, MIN_PRIORITY, NULL);
+#endif
 #else
   // only send small chunks over uart each invocation, to make sure
   // we don't interfer with critical stack timings.
@@ -151,6 +204,11 @@ static void flush_modem_interface_tx_fifo(void *arg)
     release_receiver();
 #ifdef PLATFORM_USE_MODEM_INTERRUPT_LINES
     sched_post_task(&execute_state_machine);
+#endif
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+    // frames which did not fit in the fifo yet
+    if(has_pending_messages())
+      sched_post_task_prio(&send_batch, MIN_PRIORITY, NULL);
 #endif
   } 
   else 
@@ -259,33 +317,35 @@ static void execute_state_machine()
 #endif
 }
 
-/** @Brief Check package counter and crc
+/** @Brief Check crc
  *  @return void
  */
 static bool verify_payload(fifo_t* bytes, uint8_t* header)
 {
-  static uint8_t payload[RX_BUFFER_SIZE - SERIAL_FRAME_HEADER_SIZE]; // statically allocated so this does not end up on stack
-  fifo_peek(bytes, (uint8_t*) &payload, 0, header[SERIAL_FRAME_SIZE]);
-
-  //check for missing packages
-  packet_down_counter++;
-  if(header[SERIAL_FRAME_COUNTER]!=packet_down_counter)
-  {
-    //TODO consequence? (save total missing packages?)
-    log_print_string("!!! missed packages: %i",(header[SERIAL_FRAME_COUNTER]-packet_down_counter));
-    packet_down_counter=header[SERIAL_FRAME_COUNTER]; //reset package counter
-  }
+  // bytes is a subview of exactly the payload, which can wrap around the end of the circular buffer.
+  // Calculate the CRC over both parts in place instead of copying the payload first
+  fifo_span_t payload[2];
+  fifo_peek_spans(bytes, payload);
 
   DPRINT("RX HEADER: ");
   DPRINT_DATA(header, SERIAL_FRAME_HEADER_SIZE);
   DPRINT("RX PAYLOAD: ");
-  DPRINT_DATA(payload, header[SERIAL_FRAME_SIZE]);
+  DPRINT_DATA(payload[0].data, payload[0].len);
+  DPRINT_DATA(payload[1].data, payload[1].len);
 
-  uint16_t calculated_crc = crc_calculate(payload, header[SERIAL_FRAME_SIZE]);
+  crc_ctx_t crc_ctx;
+  crc_init(&crc_ctx);
+  if(header[1] == SERIAL_FRAME_VERSION_1)
+    crc_update(&crc_ctx, header + SERIAL_FRAME_SEQ, SERIAL_FRAME_SIZE - SERIAL_FRAME_SEQ + 1);
+
+  crc_update(&crc_ctx, payload[0].data, payload[0].len);
+  crc_update(&crc_ctx, payload[1].data, payload[1].len);
+  uint16_t calculated_crc = crc_final(&crc_ctx);
  
   if(header[SERIAL_FRAME_CRC1]!=((calculated_crc >> 8) & 0x00FF) || header[SERIAL_FRAME_CRC2]!=(calculated_crc & 0x00FF))
   {
     //TODO consequence? (request repeat?)
+    PERF_COUNTER_INC(modem_crc_errors);
     log_print_string("CRC incorrect!");
     return false;
   }
@@ -293,11 +353,335 @@ static bool verify_payload(fifo_t* bytes, uint8_t* header)
     return true;
 }
 
+static uint16_t get_tx_fifo_free_space()
+{
+  return modem_interface_tx_fifo.max_size - fifo_get_size(&modem_interface_tx_fifo);
+}
+
+/** @brief Adds the header to the payload segments and puts the frame in the TX fifo
+ *  @return EBUSY when the complete frame does not fit in the TX fifo, nothing is put in that case
+ */
+static error_t put_frame(uint8_t version, uint8_t counter, uint8_t type, uint8_t* const* segments, const uint8_t* lengths, uint8_t segment_count)
+{
+  uint8_t header[SERIAL_FRAME_HEADER_SIZE];
+  uint16_t length = 0;
+  for(uint8_t i = 0; i < segment_count; i++)
+    length += lengths[i];
+
+  assert(length <= SERIAL_FRAME_MAX_PAYLOAD_SIZE);
+
+  // a frame header without its payload would corrupt the byte stream
+  if(get_tx_fifo_free_space() < SERIAL_FRAME_HEADER_SIZE + length)
+    return EBUSY;
+
+  header[0] = SERIAL_FRAME_SYNC_BYTE;
+  header[1] = version;
+  header[SERIAL_FRAME_COUNTER] = counter;
+  header[SERIAL_FRAME_TYPE] = type;
+  header[SERIAL_FRAME_SIZE] = length;
+
+  crc_ctx_t crc_ctx;
+  crc_init(&crc_ctx);
+  if(version == SERIAL_FRAME_VERSION_1)
+    crc_update(&crc_ctx, header + SERIAL_FRAME_SEQ, SERIAL_FRAME_SIZE - SERIAL_FRAME_SEQ + 1);
+
+  for(uint8_t i = 0; i < segment_count; i++)
+    crc_update(&crc_ctx, segments[i], lengths[i]);
+
+  uint16_t crc = crc_final(&crc_ctx);
+  header[SERIAL_FRAME_CRC1] = (crc >> 8) & 0x00FF;
+  header[SERIAL_FRAME_CRC2] = crc & 0x00FF;
+
+  DPRINT("TX HEADER:");
+  DPRINT_DATA(header, SERIAL_FRAME_HEADER_SIZE);
+  DPRINT("TX PAYLOAD:");
+  for(uint8_t i = 0; i < segment_count; i++)
+    DPRINT_DATA(segments[i], lengths[i]);
+
+  error_t err;
+  start_atomic();
+  request_pending = true;
+  err = fifo_put(&modem_interface_tx_fifo, (uint8_t*) &header, SERIAL_FRAME_HEADER_SIZE); assert(err == SUCCESS);
+  for(uint8_t i = 0; i < segment_count; i++)
+  {
+    err = fifo_put(&modem_interface_tx_fifo, segments[i], lengths[i]); assert(err == SUCCESS);
+  }
+  end_atomic();
+
+#ifdef PLATFORM_USE_MODEM_INTERRUPT_LINES
+  sched_post_task_prio(&execute_state_machine, MIN_PRIORITY, NULL);
+#else
+  sched_post_task_prio(&flush_modem_interface_tx_fifo, MIN_PRIORITY, NULL); // state machine is not used when not using interrupt lines
+#endif
+  return SUCCESS;
+}
+
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+/** @brief Transmits the records of a v1 payload as separate v0 frames, as far as they fit in the TX fifo
+ *  @return The number of bytes of the records which were transmitted
+ */
+static uint16_t put_records_v0(uint8_t* records, uint16_t length)
+{
+  uint16_t offset = 0;
+  while(offset + SERIAL_RECORD_HEADER_SIZE <= length)
+  {
+    uint8_t* data = records + offset + SERIAL_RECORD_HEADER_SIZE;
+    uint8_t data_len = records[offset + 1];
+    if(put_frame(SERIAL_FRAME_VERSION_0, packet_up_counter + 1, records[offset], &data, &data_len, 1) != SUCCESS)
+      break;
+
+    packet_up_counter++;
+    offset += SERIAL_RECORD_HEADER_SIZE + data_len;
+  }
+
+  return offset;
+}
+
+/** @brief Transmits the unacknowledged and pending messages as v0 frames, in order, as far as they fit in the TX fifo.
+ *  The remaining messages are kept and sent when the TX fifo has been flushed.
+ *  @return void
+ */
+static void send_pending_v0()
+{
+  while(unacked_count > 0)
+  {
+    unacked_frame_t* frame = &unacked_frames[unacked_head];
+    uint16_t sent = put_records_v0(frame->payload, frame->length);
+    memmove(frame->payload, frame->payload + sent, frame->length - sent);
+    frame->length -= sent;
+    if(frame->length > 0)
+      return;
+
+    unacked_head = (unacked_head + 1) % MODEM_INTERFACE_WINDOW_SIZE;
+    unacked_count--;
+  }
+
+  uint16_t sent = put_records_v0(tx_batch, tx_batch_len);
+  memmove(tx_batch, tx_batch + sent, tx_batch_len - sent);
+  tx_batch_len -= sent;
+}
+
+/** @brief Switches to v0 when the peer does not support v1, the unacknowledged and pending messages are resent as v0 frames
+ *  @return void
+ */
+static void fall_back_to_v0()
+{
+  log_print_string("peer does not support serial protocol v1, falling back to v0");
+  tx_version = SERIAL_FRAME_VERSION_0;
+  timer_cancel_task(&retransmit);
+  send_pending_v0();
+}
+
+static bool has_pending_messages()
+{
+  return tx_batch_len > 0 || ack_pending || (tx_version == SERIAL_FRAME_VERSION_0 && unacked_count > 0);
+}
+
+/** @brief Whether the batch consists of a single message which is too large for a record in a v1 frame
+ *  @return bool
+ */
+static bool is_oversized_batch()
+{
+  return tx_batch_len > 0 && tx_batch[1] > SERIAL_RECORD_MAX_SIZE;
+}
+
+static void send_data_frame(unacked_frame_t* frame)
+{
+  uint8_t* payload = frame->payload;
+  if(put_frame(SERIAL_FRAME_VERSION_1, frame->seq, rx_seq, &payload, &frame->length, 1) == SUCCESS)
+    ack_pending = false; // piggybacked
+}
+
+/** @brief Packs the pending records in a new data frame when the window allows, otherwise only sends a pending acknowledgement
+ *  @return void
+ */
+static void send_batch(void *arg)
+{
+  if(tx_version == SERIAL_FRAME_VERSION_0)
+    send_pending_v0();
+  else if(is_oversized_batch())
+  {
+    // sent in a v0 frame, which is not sequenced, so only when all previous frames are acknowledged to keep the order.
+    // It is not retransmitted.
+    if(unacked_count == 0 && put_records_v0(tx_batch, tx_batch_len) == tx_batch_len)
+      tx_batch_len = 0;
+  }
+  else if(tx_batch_len > 0 && unacked_count < MODEM_INTERFACE_WINDOW_SIZE
+     && get_tx_fifo_free_space() >= SERIAL_FRAME_HEADER_SIZE + tx_batch_len)
+  {
+    unacked_frame_t* frame = &unacked_frames[(unacked_head + unacked_count) % MODEM_INTERFACE_WINDOW_SIZE];
+    frame->seq = ++tx_seq;
+    frame->length = tx_batch_len;
+    memcpy(frame->payload, tx_batch, tx_batch_len);
+    tx_batch_len = 0;
+    unacked_count++;
+    send_data_frame(frame);
+    if(unacked_count == 1)
+    {
+      retransmissions = 0;
+      timer_post_task_delay(&retransmit, ACK_TIMEOUT);
+    }
+  }
+
+  if(ack_pending && put_frame(SERIAL_FRAME_VERSION_1, tx_seq, rx_seq, NULL, NULL, 0) == SUCCESS)
+    ack_pending = false;
+}
+
+/** @brief Resends all unacknowledged frames (go-back-N) when no acknowledgement was received in time
+ *  @return void
+ */
+static void retransmit(void *arg)
+{
+  if(unacked_count == 0)
+    return;
+
+  if(++retransmissions > MAX_RETRANSMISSIONS)
+  {
+    if(!peer_v1)
+    {
+      fall_back_to_v0();
+      return;
+    }
+
+    log_print_string("!!! no acknowledgement from peer, dropping %i frames", unacked_count);
+    unacked_count = 0;
+    sched_post_task_prio(&send_batch, MIN_PRIORITY, NULL);
+    return;
+  }
+
+  DPRINT("retransmit %i frames", unacked_count);
+  for(uint8_t i = 0; i < unacked_count; i++)
+  {
+    unacked_frame_t* frame = &unacked_frames[(unacked_head + i) % MODEM_INTERFACE_WINDOW_SIZE];
+    if(get_tx_fifo_free_space() < SERIAL_FRAME_HEADER_SIZE + frame->length)
+      break; // the remaining frames are resent on the next timeout
+
+    send_data_frame(frame);
+  }
+
+  timer_post_task_delay(&retransmit, ACK_TIMEOUT);
+}
+
+/** @brief Releases the frames up to and including sequence number ack
+ *  @return void
+ */
+static void process_ack(uint8_t ack)
+{
+  bool released = false;
+  while(unacked_count > 0 && (uint8_t)(ack - unacked_frames[unacked_head].seq) < 128)
+  {
+    unacked_head = (unacked_head + 1) % MODEM_INTERFACE_WINDOW_SIZE;
+    unacked_count--;
+    released = true;
+  }
+
+  if(!released)
+    return;
+
+  retransmissions = 0;
+  timer_cancel_task(&retransmit);
+  if(unacked_count > 0)
+    timer_post_task_delay(&retransmit, ACK_TIMEOUT);
+
+  if(tx_batch_len > 0)
+    sched_post_task_prio(&send_batch, MIN_PRIORITY, NULL);
+}
+#endif
+
+/** @brief Passes a received message to the handler of its type
+ *  @return void
+ */
+static void dispatch_message(uint8_t type, fifo_t* payload_fifo)
+{
+  if(type==SERIAL_MESSAGE_TYPE_ALP_DATA && alp_handler != NULL)
+    alp_handler(payload_fifo);
+  else if (type==SERIAL_MESSAGE_TYPE_PING_RESPONSE  && ping_response_handler != NULL)
+    ping_response_handler(payload_fifo);
+  else if (type==SERIAL_MESSAGE_TYPE_LOGGING && logging_handler != NULL)
+    logging_handler(payload_fifo);
+  else if (type==SERIAL_MESSAGE_TYPE_PING_REQUEST)
+  {
+    uint8_t ping_reply[1]={0x02};
+    fifo_skip(payload_fifo,1);
+    (void)modem_interface_transfer_bytes((uint8_t*) &ping_reply,1,SERIAL_MESSAGE_TYPE_PING_RESPONSE);
+  }
+  else if(type==SERIAL_MESSAGE_TYPE_REBOOTED)
+  {
+    uint8_t reboot_reason;
+    fifo_pop(payload_fifo, &reboot_reason, 1);
+    DPRINT("target rebooted, reason=%i\n", reboot_reason);
+    if(target_rebooted_cb)
+      target_rebooted_cb(reboot_reason);
+  }
+  else
+  {
+    fifo_skip(payload_fifo, fifo_get_size(payload_fifo));
+    DPRINT("!!!FRAME TYPE NOT IMPLEMENTED");
+  }
+}
+
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+/** @brief Processes the acknowledgement and the records of a v1 frame
+ *  @return void
+ */
+static void process_frame_v1(fifo_t* payload_fifo)
+{
+  uint8_t seq = header[SERIAL_FRAME_SEQ];
+  peer_v1 = true;
+  tx_version = SERIAL_FRAME_VERSION_1;
+
+  if(payload_len >= SERIAL_RECORD_HEADER_SIZE && seq != rx_seq)
+  {
+    uint8_t type;
+    fifo_peek(payload_fifo, &type, 0, 1);
+    if(type == SERIAL_MESSAGE_TYPE_REBOOTED)
+    {
+      // the peer restarted its sequence numbers and lost the frames in flight, resynchronise both directions
+      rx_seq = seq - 1;
+      tx_seq = 0;
+      unacked_count = 0;
+      timer_cancel_task(&retransmit);
+    }
+  }
+
+  process_ack(header[SERIAL_FRAME_ACK]);
+  if(payload_len == 0)
+    return; // acknowledgement only
+
+  ack_pending = true;
+  sched_post_task_prio(&send_batch, MIN_PRIORITY, NULL);
+  if(seq != (uint8_t)(rx_seq + 1))
+  {
+    DPRINT("unexpected seq %i, expected %i", seq, (uint8_t)(rx_seq + 1)); // duplicate or gap, the peer will retransmit
+    uint8_t distance = seq - rx_seq;
+    if(distance > 1 && distance < 128)
+      PERF_COUNTER_INC(modem_missed_frames); // a gap, not a duplicate
+    return;
+  }
+
+  rx_seq = seq;
+  while(fifo_get_size(payload_fifo) >= SERIAL_RECORD_HEADER_SIZE)
+  {
+    uint8_t record_header[SERIAL_RECORD_HEADER_SIZE];
+    fifo_pop(payload_fifo, record_header, SERIAL_RECORD_HEADER_SIZE);
+    fifo_t record_fifo;
+    if(fifo_init_subview(&record_fifo, payload_fifo, 0, record_header[1]) != SUCCESS)
+    {
+      DPRINT("!!!MALFORMED RECORD");
+      return;
+    }
+
+    dispatch_message(record_header[0], &record_fifo);
+    fifo_skip(payload_fifo, record_header[1]);
+  }
+}
+#endif
+
 /** @Brief Processes received uart data
  * 1) Search for sync bytes (always)
  * 2) get header size and parse header
  * 3) Wait for correct # of bytes (length present in header)
- * 4) Execute crc check and check message counter
+ * 4) Execute crc check and check message counter (v0) or sequence number (v1)
  * 5) send to corresponding service (alp, ping service, log service)
  *  @return void
  */
@@ -305,17 +689,19 @@ static void process_rx_fifo(void *arg)
 {
   if(!parsed_header) 
   {
-    if(fifo_get_size(&rx_fifo) > SERIAL_FRAME_HEADER_SIZE) 
+    if(fifo_get_size(&rx_fifo) >= SERIAL_FRAME_HEADER_SIZE) 
     {
         fifo_peek(&rx_fifo, header, 0, SERIAL_FRAME_HEADER_SIZE);
 
-        if(header[0] != SERIAL_FRAME_SYNC_BYTE || header[1] != SERIAL_FRAME_VERSION) 
+        bool supported_version = header[1] == SERIAL_FRAME_VERSION_0
+          || (header[1] == SERIAL_FRAME_VERSION_1 && FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1);
+        if(header[0] != SERIAL_FRAME_SYNC_BYTE || !supported_version) 
         {
           fifo_skip(&rx_fifo, 1);
           DPRINT("skip");
           parsed_header = false;
           payload_len = 0;
-          if(fifo_get_size(&rx_fifo) > SERIAL_FRAME_HEADER_SIZE)
+          if(fifo_get_size(&rx_fifo) >= SERIAL_FRAME_HEADER_SIZE)
             sched_post_task(&process_rx_fifo);
           return;
         }
@@ -337,55 +723,53 @@ static void process_rx_fifo(void *arg)
     fifo_t payload_fifo;
     fifo_init_subview(&payload_fifo, &rx_fifo, 0, payload_len);
   
-    if(verify_payload(&payload_fifo,(uint8_t *)&header))
+    if(!verify_payload(&payload_fifo,(uint8_t *)&header))
+      DPRINT("!!!PAYLOAD DATA INCORRECT");
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+    else if(header[1] == SERIAL_FRAME_VERSION_1)
     {
-      if(header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_ALP_DATA && alp_handler != NULL)
-        alp_handler(&payload_fifo);
-      else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_PING_RESPONSE  && ping_response_handler != NULL)
-        ping_response_handler(&payload_fifo);
-      else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_LOGGING && logging_handler != NULL)
-        logging_handler(&payload_fifo);
-      else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_PING_REQUEST)
-      {
-        uint8_t ping_reply[1]={0x02};
-        fifo_skip(&payload_fifo,1);
-        modem_interface_transfer_bytes((uint8_t*) &ping_reply,1,SERIAL_MESSAGE_TYPE_PING_RESPONSE);
-      }
-      else if(header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_REBOOTED)
-      {
-        uint8_t reboot_reason;
-        fifo_pop(&payload_fifo, &reboot_reason, 1);
-        DPRINT("target rebooted, reason=%i\n", reboot_reason);
-        if(target_rebooted_cb)
-          target_rebooted_cb(reboot_reason);
-      }
-      else
+      process_frame_v1(&payload_fifo);
+      fifo_skip(&rx_fifo, payload_len);
+    }
+#endif
+    else
+    {
+      //check for missing packages
+      packet_down_counter++;
+      if(header[SERIAL_FRAME_COUNTER]!=packet_down_counter)
       {
-        fifo_skip(&payload_fifo, payload_len);
-        DPRINT("!!!FRAME TYPE NOT IMPLEMENTED");
+        //TODO consequence? (save total missing packages?)
+        log_print_string("!!! missed packages: %i",(header[SERIAL_FRAME_COUNTER]-packet_down_counter));
+        PERF_COUNTER_ADD(modem_missed_frames, (uint8_t)(header[SERIAL_FRAME_COUNTER] - packet_down_counter));
+        packet_down_counter=header[SERIAL_FRAME_COUNTER]; //reset package counter
       }
+
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+      if(!peer_v1 && tx_version != SERIAL_FRAME_VERSION_0)
+        fall_back_to_v0();
+#endif
+
+      dispatch_message(header[SERIAL_FRAME_TYPE], &payload_fifo);
       fifo_skip(&rx_fifo, payload_len - fifo_get_size(&payload_fifo)); // pop parsed bytes from original fifo
     }
-    else
-      DPRINT("!!!PAYLOAD DATA INCORRECT");
     payload_len = 0;
     parsed_header = false;
-    if(fifo_get_size(&rx_fifo) > SERIAL_FRAME_HEADER_SIZE)
+    if(fifo_get_size(&rx_fifo) >= SERIAL_FRAME_HEADER_SIZE)
       sched_post_task(&process_rx_fifo);
   }
 }
-/** @Brief put received UART data in fifo
+/** @Brief put a span of received UART data in fifo
  *  @return void
  */
-static void uart_rx_cb(uint8_t data)
+static void uart_rx_cb(uint8_t const* data, size_t length)
 {
     error_t err;
     start_atomic();
-        err = fifo_put(&rx_fifo, &data, 1); assert(err == SUCCESS);
+        err = fifo_put(&rx_fifo, (uint8_t*) data, length); assert(err == SUCCESS);
     end_atomic();
 
 #ifndef PLATFORM_USE_MODEM_INTERRUPT_LINES
-    sched_post_task(&process_rx_fifo);
+    sched_post_handle(process_rx_fifo_handle);
 #endif
 }
 
@@ -398,11 +782,11 @@ static void uart_int_cb(void *arg)
   sched_post_task(&execute_state_machine);
 }
 
-static void modem_interface_set_rx_interrupt_callback(uart_rx_inthandler_t uart_rx_cb) {
+static void modem_interface_set_rx_block_callback(uart_rx_block_handler_t uart_rx_cb) {
 #ifdef PLATFORM_USE_USB_CDC
-	cdc_set_rx_interrupt_callback(uart_rx_cb);
+	cdc_set_rx_block_callback(uart_rx_cb);
 #else
-  uart_set_rx_interrupt_callback(uart, uart_rx_cb);
+  uart_set_rx_block_callback(uart, uart_rx_cb);
 #endif
 }
 
@@ -411,7 +795,11 @@ void modem_interface_init(uint8_t idx, uint32_t baudrate, pin_id_t uart_state_in
   fifo_init(&modem_interface_tx_fifo, modem_interface_tx_buffer, MODEM_INTERFACE_TX_FIFO_SIZE);
   sched_register_task(&flush_modem_interface_tx_fifo);
   sched_register_task(&execute_state_machine);
-  sched_register_task(&process_rx_fifo);
+  sched_register_task_handle(&process_rx_fifo, &process_rx_fifo_handle);
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+  sched_register_task(&send_batch);
+  sched_register_task(&retransmit);
+#endif
   state = STATE_IDLE;
   uart_state_pin=uart_state_int_pin;
   target_uart_state_pin=target_uart_state_int_pin;
@@ -420,7 +808,7 @@ void modem_interface_init(uint8_t idx, uint32_t baudrate, pin_id_t uart_state_in
   DPRINT("uart initialized");
   
   fifo_init(&rx_fifo, rx_buffer, sizeof(rx_buffer));
-  modem_interface_set_rx_interrupt_callback(&uart_rx_cb);
+  modem_interface_set_rx_block_callback(&uart_rx_cb);
 
 #ifdef PLATFORM_USE_MODEM_INTERRUPT_LINES
   assert(sched_register_task(&modem_listen) == SUCCESS);
@@ -441,44 +829,85 @@ void modem_interface_init(uint8_t idx, uint32_t baudrate, pin_id_t uart_state_in
 #endif
 
   uint8_t reboot_reason = (uint8_t)hw_system_reboot_reason();
-  modem_interface_transfer_bytes(&reboot_reason, 1, SERIAL_MESSAGE_TYPE_REBOOTED);
+  (void)modem_interface_transfer_bytes(&reboot_reason, 1, SERIAL_MESSAGE_TYPE_REBOOTED);
 }
 
-void modem_interface_transfer_bytes(uint8_t* bytes, uint8_t length, serial_message_type_t type) 
+error_t modem_interface_transfer_bytes(uint8_t* bytes, uint8_t length, serial_message_type_t type) 
 {
-  uint8_t header[SERIAL_FRAME_HEADER_SIZE];
-  uint16_t crc=crc_calculate(bytes,length);
+  return modem_interface_transfer_segments(&bytes, &length, 1, type);
+}
 
-  packet_up_counter++;
-  header[0] = SERIAL_FRAME_SYNC_BYTE;
-  header[1] = SERIAL_FRAME_VERSION;
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+/** @brief Whether a message of the given length can be added to the pending records
+ *  @return bool
+ */
+static bool fits_in_batch(uint16_t length)
+{
+  if(tx_version == SERIAL_FRAME_VERSION_0)
+    return tx_batch_len + SERIAL_RECORD_HEADER_SIZE + length <= TX_BATCH_SIZE;
 
-  header[SERIAL_FRAME_COUNTER] = packet_up_counter;
-  header[SERIAL_FRAME_TYPE] = type;
-  header[SERIAL_FRAME_SIZE] = length;
-  header[SERIAL_FRAME_CRC1] = (crc >> 8) & 0x00FF;
-  header[SERIAL_FRAME_CRC2] = crc & 0x00FF;
+  // a message which is too large for a record is kept on its own
+  if(length > SERIAL_RECORD_MAX_SIZE)
+    return tx_batch_len == 0;
 
-  DPRINT("TX HEADER:");
-  DPRINT_DATA(header, SERIAL_FRAME_HEADER_SIZE);
-  DPRINT("TX PAYLOAD:");
-  DPRINT_DATA(bytes, length);
-   
-  start_atomic();
-  request_pending = true;
-  fifo_put(&modem_interface_tx_fifo, (uint8_t*) &header, SERIAL_FRAME_HEADER_SIZE);
-  fifo_put(&modem_interface_tx_fifo, bytes, length);
-  end_atomic();
+  return !is_oversized_batch() && tx_batch_len + SERIAL_RECORD_HEADER_SIZE + length <= SERIAL_FRAME_MAX_PAYLOAD_SIZE;
+}
+#endif
 
-#ifdef PLATFORM_USE_MODEM_INTERRUPT_LINES
-  sched_post_task_prio(&execute_state_machine, MIN_PRIORITY, NULL);
+error_t modem_interface_transfer_segments(uint8_t* const* segments, const uint8_t* lengths, uint8_t segment_count, serial_message_type_t type)
+{
+  uint16_t length = 0;
+  for(uint8_t i = 0; i < segment_count; i++)
+    length += lengths[i];
+
+  assert(length <= UINT8_MAX);
+
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+  // using v0 the message is put in the TX fifo directly, unless older messages are still waiting for room
+  if(tx_version == SERIAL_FRAME_VERSION_0 && !has_pending_messages())
+  {
+    if(put_frame(SERIAL_FRAME_VERSION_0, packet_up_counter + 1, type, segments, lengths, segment_count) == SUCCESS)
+    {
+      packet_up_counter++;
+      return SUCCESS;
+    }
+  }
+
+  if(tx_version == SERIAL_FRAME_VERSION_1 && !fits_in_batch(length))
+    send_batch(NULL); // make room by closing the current batch
+
+  if(!fits_in_batch(length))
+  {
+    DPRINT("modem interface busy, message of %i bytes not accepted", length);
+    return EBUSY;
+  }
+
+  tx_batch[tx_batch_len++] = type;
+  tx_batch[tx_batch_len++] = length;
+  for(uint8_t i = 0; i < segment_count; i++)
+  {
+    memcpy(tx_batch + tx_batch_len, segments[i], lengths[i]);
+    tx_batch_len += lengths[i];
+  }
+
+  // posted with the lowest priority so the messages generated by the tasks which are already pending share a frame
+  sched_post_task_prio(&send_batch, MIN_PRIORITY, NULL);
+  return SUCCESS;
 #else
-  sched_post_task_prio(&flush_modem_interface_tx_fifo, MIN_PRIORITY, NULL); // state machine is not used when not using interrupt lines
-#endif  
+  // the message is put in the TX fifo directly, the caller retries when it is full
+  if(put_frame(SERIAL_FRAME_VERSION_0, packet_up_counter + 1, type, segments, lengths, segment_count) != SUCCESS)
+  {
+    DPRINT("modem interface busy, message of %i bytes not accepted", length);
+    return EBUSY;
+  }
+
+  packet_up_counter++;
+  return SUCCESS;
+#endif
 }
 
 void modem_interface_transfer(char* string) {
-  modem_interface_transfer_bytes((uint8_t*) string, strnlen(string, 100), SERIAL_MESSAGE_TYPE_LOGGING); 
+  (void)modem_interface_transfer_bytes((uint8_t*) string, strnlen(string, 100), SERIAL_MESSAGE_TYPE_LOGGING); 
 }
 
 
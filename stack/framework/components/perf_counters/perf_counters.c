@@ -0,0 +1,37 @@
+/*! \file perf_counters.c
+ *
+
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include "perf_counters.h"
+
+#ifdef FRAMEWORK_PERF_COUNTERS
+
+perf_counters_t NGDEF(perf_counters);
+
+__LINK_C const perf_counters_t* perf_counters_get(void)
+{
+    return &NG(perf_counters);
+}
+
+__LINK_C void perf_counters_reset(void)
+{
+    memset(&NG(perf_counters), 0, sizeof(perf_counters_t));
+}
+
+#endif // FRAMEWORK_PERF_COUNTERS
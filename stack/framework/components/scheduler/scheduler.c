@@ -41,10 +41,6 @@
 #include "framework_defs.h"
 #define SCHEDULER_MAX_TASKS FRAMEWORK_SCHEDULER_MAX_TASKS
 
-#ifdef NODE_GLOBALS
-    #warning NODE_GLOBALS is defined when using the default scheduler. Are you sure this is what you want ?
-#endif
-
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_SCHED_LOG_ENABLED)
   #define DPRINT(...) log_print_string( __VA_ARGS__)
 #else
@@ -60,6 +56,10 @@ enum
 	NO_TASK = SCHEDULER_MAX_TASKS,
 };
 
+//the ready bitmap keeps priority 0 (MAX_PRIORITY) in the MSB, so the highest
+//priority that has tasks waiting equals the number of leading zeros of the bitmap
+#define PRIORITY_BIT(priority) (UINT32_C(0x80000000) >> (priority))
+
 typedef struct
 {
 	task_t task;
@@ -82,8 +82,55 @@ task_info_t NGDEF(m_info)[NUM_TASKS];
 
 uint8_t NGDEF(m_head)[NUM_PRIORITIES];
 uint8_t NGDEF(m_tail)[NUM_PRIORITIES];
-volatile uint8_t NGDEF(current_priority);
+volatile uint32_t NGDEF(ready_priorities);
 unsigned int NGDEF(num_registered_tasks);
+
+#ifdef FRAMEWORK_SCHED_PROFILING
+//the profiles are only updated from the scheduler loop, except for the queue depths and post times
+static sched_task_profile_t NGDEF(task_profiles)[NUM_TASKS];
+static timer_tick_t NGDEF(post_times)[NUM_TASKS];
+static uint8_t NGDEF(queue_depths)[NUM_PRIORITIES];
+static sched_profile_t NGDEF(profile);
+
+static inline void profile_task_queued(uint8_t id, uint8_t priority)
+{
+	NG(post_times)[id] = timer_get_counter_value();
+	NG(queue_depths)[priority]++;
+	if(NG(queue_depths)[priority] > NG(profile).queue_high_watermark[priority])
+		NG(profile).queue_high_watermark[priority] = NG(queue_depths)[priority];
+}
+
+static inline void profile_task_dequeued(uint8_t priority)
+{
+	NG(queue_depths)[priority]--;
+}
+
+static void profile_task_run(uint8_t id, timer_tick_t start, timer_tick_t stop)
+{
+	sched_task_profile_t* task_profile = &NG(task_profiles)[id];
+	timer_tick_t latency = start - NG(post_times)[id];
+	timer_tick_t duration = stop - start;
+
+	task_profile->invocations++;
+	task_profile->total_run_time += duration;
+	task_profile->total_latency += latency;
+	if(duration > task_profile->max_run_time)
+		task_profile->max_run_time = duration;
+
+	if(latency > task_profile->max_latency)
+		task_profile->max_latency = latency;
+
+	uint8_t bucket = duration == 0 ? 0 : 32 - __builtin_clz(duration);
+	if(bucket >= SCHED_PROFILE_HISTOGRAM_BUCKETS)
+		bucket = SCHED_PROFILE_HISTOGRAM_BUCKETS - 1;
+
+	if(task_profile->run_time_histogram[bucket] != UINT16_MAX)
+		task_profile->run_time_histogram[bucket]++;
+}
+#else
+static inline void profile_task_queued(uint8_t id, uint8_t priority) {}
+static inline void profile_task_dequeued(uint8_t priority) {}
+#endif
 #ifdef SCHEDULER_DEBUG
 void check_structs_are_valid()
 {
@@ -130,15 +177,14 @@ void check_structs_are_valid()
 			prev_ind=cur_ind;
 		}
 		assert(NG(m_tail)[prio] == prev_ind);
+		assert(((NG(ready_priorities) & PRIORITY_BIT(prio)) != 0) == (NG(m_head)[prio] != NO_TASK));
 	}
 	for(int i = 0; i < NUM_TASKS; i++)
 	{
 		assert((visited[i]) || NG(m_info)[i].priority == NOT_SCHEDULED);
 	}
 
-	assert(NG(current_priority) <= NUM_PRIORITIES);
-	for(int i = 0; i < NG(current_priority); i++)
-		assert(NG(m_head)[i] == NO_TASK);
+	assert((NG(ready_priorities) & (PRIORITY_BIT(MIN_PRIORITY) - 1)) == 0);
 	//INT_Enable();
 	end_atomic();
 }
@@ -167,8 +213,14 @@ __LINK_C void scheduler_init()
 	}
 	memset(NG(m_head), NO_TASK, sizeof(NG(m_head)));
 	memset(NG(m_tail), NO_TASK, sizeof(NG(m_tail)));
-	NG(current_priority) = NUM_PRIORITIES;
+	NG(ready_priorities) = 0;
 	NG(num_registered_tasks) = 0;
+#ifdef FRAMEWORK_SCHED_PROFILING
+	//the timer is not initialised yet, so the start time of the first profile is 0
+	memset(NG(queue_depths), 0, sizeof(NG(queue_depths)));
+	memset(NG(task_profiles), 0, sizeof(NG(task_profiles)));
+	memset(&NG(profile), 0, sizeof(NG(profile)));
+#endif
 	check_structs_are_valid();
 #if defined FRAMEWORK_USE_WATCHDOG
 	__watchdog_init();
@@ -201,41 +253,61 @@ __LINK_C uint8_t get_task_id(task_t task)
 	return NO_TASK;
 }
 
-__LINK_C error_t sched_register_task(task_t task)
+__LINK_C error_t sched_register_task_handle(task_t task, sched_task_handle_t* handle)
 {
-  assert(NG(num_registered_tasks) <= NUM_TASKS);
-  if(get_task_id(task) != NO_TASK)
-    return EALREADY;
-
 	error_t retVal;
 	check_structs_are_valid();
 	//INT_Disable();
 	start_atomic();
 
-    for(int i = NG(num_registered_tasks); i >= 0; i--)
-    {
-        if (i == 0 || ((void*)NG(m_index)[i-1].task) < ((void*)task))
-        {
-            NG(m_index)[i].task = task;
-            NG(m_index)[i].index = NG(num_registered_tasks);
-            NG(m_info)[NG(m_index)[i].index].task = task;
-            NG(m_info)[NG(m_index)[i].index].arg = NULL;
-            break;
-        }
-        else
-        {
-            NG(m_index)[i] = NG(m_index)[i-1];
-        }
-    }
-    NG(num_registered_tasks)++;
-    retVal = SUCCESS;
+	uint8_t id = get_task_id(task);
+	if(id != NO_TASK)
+		retVal = EALREADY;
+	else
+	{
+		assert(NG(num_registered_tasks) < NUM_TASKS);
+		id = NG(num_registered_tasks);
+		for(int i = NG(num_registered_tasks); i >= 0; i--)
+		{
+			if (i == 0 || ((void*)NG(m_index)[i-1].task) < ((void*)task))
+			{
+				NG(m_index)[i].task = task;
+				NG(m_index)[i].index = id;
+				NG(m_info)[id].task = task;
+				NG(m_info)[id].arg = NULL;
+				break;
+			}
+			else
+			{
+				NG(m_index)[i] = NG(m_index)[i-1];
+			}
+		}
+		NG(num_registered_tasks)++;
+		retVal = SUCCESS;
+	}
 
 	//INT_Enable();
 	end_atomic();
 	check_structs_are_valid();
+	if(handle != NULL)
+		*handle = id;
+
 	return retVal;
 }
 
+__LINK_C error_t sched_register_task(task_t task)
+{
+	return sched_register_task_handle(task, NULL);
+}
+
+__LINK_C sched_task_handle_t sched_get_task_handle(task_t task)
+{
+	start_atomic();
+	uint8_t id = get_task_id(task);
+	end_atomic();
+	return id == NO_TASK ? SCHED_INVALID_TASK_HANDLE : id;
+}
+
 static inline bool is_scheduled(uint8_t id)
 {
 	assert(id < NUM_TASKS);
@@ -243,6 +315,72 @@ static inline bool is_scheduled(uint8_t id)
 	return NG(m_info)[id].priority != NOT_SCHEDULED;
 }
 
+static inline bool is_valid_id(uint8_t id)
+{
+	//handles are assigned in order of registration, so this also rejects NO_TASK
+	return id < NG(num_registered_tasks);
+}
+
+static error_t post_task(uint8_t task_id, uint8_t priority, void *arg)
+{
+	//this function should only be called from an atomic context
+	check_structs_are_valid();
+	if(!is_valid_id(task_id))
+		return EINVAL;
+	else if(priority > MIN_PRIORITY || priority < MAX_PRIORITY)
+		return ESIZE;
+	else if (is_scheduled(task_id))
+		return EALREADY;
+
+	if(NG(m_head)[priority] == NO_TASK)
+	{
+		NG(m_head)[priority] = task_id;
+		NG(m_tail)[priority] = task_id;
+		NG(ready_priorities) |= PRIORITY_BIT(priority);
+	}
+	else
+	{
+		NG(m_info)[NG(m_tail)[priority]].next = task_id;
+		NG(m_info)[task_id].prev = NG(m_tail)[priority];
+		NG(m_tail)[priority] = task_id;
+	}
+	NG(m_info)[task_id].priority = priority;
+	NG(m_info)[task_id].arg = arg;
+	profile_task_queued(task_id, priority);
+	check_structs_are_valid();
+	return SUCCESS;
+}
+
+static error_t cancel_task(uint8_t id)
+{
+	//this function should only be called from an atomic context
+	if(!is_valid_id(id))
+		return EINVAL;
+	else if(!is_scheduled(id))
+		return EALREADY;
+
+	uint8_t priority = NG(m_info)[id].priority;
+	if (NG(m_info)[id].prev == NO_TASK)
+		NG(m_head)[priority] = NG(m_info)[id].next;
+	else
+		NG(m_info)[NG(m_info)[id].prev].next = NG(m_info)[id].next;
+
+	if (NG(m_info)[id].next == NO_TASK)
+		NG(m_tail)[priority] = NG(m_info)[id].prev;
+	else
+		NG(m_info)[NG(m_info)[id].next].prev = NG(m_info)[id].prev;
+
+	if(NG(m_head)[priority] == NO_TASK)
+		NG(ready_priorities) &= ~PRIORITY_BIT(priority);
+
+	profile_task_dequeued(priority);
+	NG(m_info)[id].prev = NO_TASK;
+	NG(m_info)[id].next = NO_TASK;
+	NG(m_info)[id].priority = NOT_SCHEDULED;
+	check_structs_are_valid();
+	return SUCCESS;
+}
+
 __LINK_C bool sched_is_scheduled(task_t task)
 {
 	//INT_Disable();
@@ -256,154 +394,165 @@ __LINK_C bool sched_is_scheduled(task_t task)
 	return retVal;
 }
 
+__LINK_C bool sched_is_handle_scheduled(sched_task_handle_t handle)
+{
+	if(!is_valid_id(handle))
+		return false;
+
+	return NG(m_info)[handle].priority != NOT_SCHEDULED;
+}
+
 __LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg)
 {
-	error_t retVal;
 	start_atomic();
-	check_structs_are_valid();
-	uint8_t task_id = get_task_id(task);
-	if(task_id == NO_TASK)
-		retVal = EINVAL;
-	else if(priority > MIN_PRIORITY || priority < MAX_PRIORITY)
-		retVal = ESIZE;
-	else if (is_scheduled(task_id))
-		retVal = EALREADY;
-	else
-	{
-		if(NG(m_head)[priority] == NO_TASK)
-		{
-			NG(m_head)[priority] = task_id;
-			NG(m_tail)[priority] = task_id;
-		}
-		else
-		{
-			NG(m_info)[NG(m_tail)[priority]].next = task_id;
-			NG(m_info)[task_id].prev = NG(m_tail)[priority];
-			NG(m_tail)[priority] = task_id;
-		}
-		NG(m_info)[task_id].priority = priority;
-                NG(m_info)[task_id].arg = arg;
-		//if our priority is higher than the currently known maximum priority
-		if((priority < NG(current_priority)))
-			NG(current_priority) = priority;
-		check_structs_are_valid();
-		retVal = SUCCESS;
-	}
+	error_t retVal = post_task(get_task_id(task), priority, arg);
 	end_atomic();
 	check_structs_are_valid();
 	return retVal;
 }
 
+__LINK_C error_t sched_post_handle_prio(sched_task_handle_t handle, uint8_t priority, void *arg)
+{
+	start_atomic();
+	error_t retVal = post_task(handle, priority, arg);
+	end_atomic();
+	return retVal;
+}
+
 __LINK_C error_t sched_cancel_task(task_t task)
 {
 	check_structs_are_valid();
-	error_t retVal;
-
 	start_atomic();
-	uint8_t id = get_task_id(task);
-	if(id == NO_TASK)
-		retVal = EINVAL;
-	else if(!is_scheduled(id))
-		retVal = EALREADY;
-	else
-	{
-		if (NG(m_info)[id].prev == NO_TASK)
-			NG(m_head)[NG(m_info)[id].priority] = NG(m_info)[id].next;
-		else
-			NG(m_info)[NG(m_info)[id].prev].next = NG(m_info)[id].next;
-
-		if (NG(m_info)[id].next == NO_TASK)
-			NG(m_tail)[NG(m_info)[id].priority] = NG(m_info)[id].prev;
-		else
-			NG(m_info)[NG(m_info)[id].next].prev = NG(m_info)[id].prev;
+	error_t retVal = cancel_task(get_task_id(task));
+	end_atomic();
+	return retVal;
+}
 
-		NG(m_info)[id].prev = NO_TASK;
-		NG(m_info)[id].next = NO_TASK;
-		NG(m_info)[id].priority = NOT_SCHEDULED;
-		check_structs_are_valid();
-		retVal = SUCCESS;
-	}
+__LINK_C error_t sched_cancel_handle(sched_task_handle_t handle)
+{
+	start_atomic();
+	error_t retVal = cancel_task(handle);
 	end_atomic();
 	return retVal;
 }
 
-static uint8_t pop_task(int priority)
+static uint8_t pop_task()
 {
 	uint8_t id = NO_TASK;
 	check_structs_are_valid();
 	start_atomic();
-	if (NG(m_head)[priority] != NO_TASK)
+	if (NG(ready_priorities) != 0)
 	{
+		uint8_t priority = __builtin_clz(NG(ready_priorities));
 		id = NG(m_head)[priority];
-		NG(m_head)[priority] = NG(m_info)[NG(m_head)[priority]].next;
+		NG(m_head)[priority] = NG(m_info)[id].next;
 		if(NG(m_head)[priority] == NO_TASK)
+		{
 			NG(m_tail)[priority] = NO_TASK;
+			NG(ready_priorities) &= ~PRIORITY_BIT(priority);
+		}
 		else
 			NG(m_info)[NG(m_head)[priority]].prev = NO_TASK;
 
 		NG(m_info)[id].next = NO_TASK;
 		NG(m_info)[id].prev = NO_TASK;
 		NG(m_info)[id].priority = NOT_SCHEDULED;
+		profile_task_dequeued(priority);
 	}
 	end_atomic();
 	check_structs_are_valid();
 	return id;
 }
 
-static inline bool tasks_waiting(int priority)
-{
-	return NG(m_head)[priority] != NO_TASK;
-}
-
-static uint8_t low_power_mode = FRAMEWORK_SCHEDULER_LP_MODE;
+static uint8_t NGDEF(low_power_mode) = NGINIT(FRAMEWORK_SCHEDULER_LP_MODE);
 
 uint8_t sched_get_low_power_mode(void) {
-  return low_power_mode;
+  return NG(low_power_mode);
 }
 
 void sched_set_low_power_mode(uint8_t mode) {
-  low_power_mode = mode;
+  NG(low_power_mode) = mode;
 }
 
-__LINK_C void scheduler_run()
+__LINK_C void scheduler_run_pending_tasks()
 {
-	while(1)
+	//pop_task() always returns the oldest task of the highest priority that is waiting,
+	//so a higher priority task posted by the running task (or an ISR) runs next
+	for(uint8_t id = pop_task(); id != NO_TASK; id = pop_task())
 	{
-		while(NG(current_priority) < NUM_PRIORITIES)
-		{
-			check_structs_are_valid();
-			for(uint8_t id = pop_task((NG(current_priority))); id != NO_TASK; id = pop_task(NG(current_priority)))
-			{
 #if defined FRAMEWORK_USE_WATCHDOG
-				hw_watchdog_feed();
+		hw_watchdog_feed();
 #endif
-				check_structs_are_valid();
+		check_structs_are_valid();
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_SCHED_LOG_ENABLED)
-        timer_tick_t start = timer_get_counter_value();
-        log_print_string("SCHED start %p at %i", NG(m_info)[id].task, start);
+		timer_tick_t start = timer_get_counter_value();
+		log_print_string("SCHED start %p at %i", NG(m_info)[id].task, start);
 #endif
-        NG(m_info)[id].task(NG(m_info)[id].arg);
-#if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_SCHED_LOG_ENABLED)
-        timer_tick_t stop = timer_get_counter_value();
-        timer_tick_t duration = stop - start;
-        log_print_string("SCHED stop %p at %i took %i", NG(m_info)[id].task, stop, duration);
+#ifdef FRAMEWORK_SCHED_PROFILING
+		timer_tick_t profile_start = timer_get_counter_value();
 #endif
-			}
-			//this needs to be done atomically since otherwise we risk decrementing the current priority
-			//while a higher priority task is waiting in the queue
-			start_atomic();
-			if (!tasks_waiting(NG(current_priority)))
-				NG(current_priority)++;
-#ifndef NDEBUG
-			for(int i = 0; i < NG(current_priority); i++)
-				assert(!tasks_waiting(i));
+		NG(m_info)[id].task(NG(m_info)[id].arg);
+#ifdef FRAMEWORK_SCHED_PROFILING
+		profile_task_run(id, profile_start, timer_get_counter_value());
 #endif
-			end_atomic();
-		}
+#if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_SCHED_LOG_ENABLED)
+		timer_tick_t stop = timer_get_counter_value();
+		timer_tick_t duration = stop - start;
+		log_print_string("SCHED stop %p at %i took %i", NG(m_info)[id].task, stop, duration);
+#endif
+	}
+}
+
+__LINK_C void scheduler_run()
+{
+	while(1)
+	{
+		scheduler_run_pending_tasks();
 #if defined FRAMEWORK_USE_WATCHDOG
 		timer_post_task_prio_delay(&__feed_watchdog_task, hw_watchdog_get_timeout() * TIMER_TICKS_PER_SEC, MAX_PRIORITY);
 #endif		
-		hw_enter_lowpower_mode(low_power_mode);
+#ifdef FRAMEWORK_SCHED_PROFILING
+		timer_tick_t lowpower_start = timer_get_counter_value();
+		hw_enter_lowpower_mode(NG(low_power_mode));
+		NG(profile).lowpower_time += timer_get_counter_value() - lowpower_start;
+		NG(profile).lowpower_count++;
+#else
+		hw_enter_lowpower_mode(NG(low_power_mode));
+#endif
 	}
 
 }
+
+#ifdef FRAMEWORK_SCHED_PROFILING
+__LINK_C uint8_t sched_get_task_count(void)
+{
+	return NG(num_registered_tasks);
+}
+
+__LINK_C task_t sched_get_task(sched_task_handle_t handle)
+{
+	return is_valid_id(handle) ? NG(m_info)[handle].task : NULL;
+}
+
+__LINK_C const sched_task_profile_t* sched_get_task_profile(sched_task_handle_t handle)
+{
+	return is_valid_id(handle) ? &NG(task_profiles)[handle] : NULL;
+}
+
+__LINK_C const sched_profile_t* sched_get_profile(void)
+{
+	return &NG(profile);
+}
+
+__LINK_C void sched_reset_profile(void)
+{
+	start_atomic();
+	memset(NG(task_profiles), 0, sizeof(NG(task_profiles)));
+	//the watermarks restart from the tasks which are waiting right now
+	memcpy(NG(profile).queue_high_watermark, NG(queue_depths), sizeof(NG(profile).queue_high_watermark));
+	NG(profile).lowpower_time = 0;
+	NG(profile).lowpower_count = 0;
+	NG(profile).start_time = timer_get_counter_value();
+	end_atomic();
+}
+#endif
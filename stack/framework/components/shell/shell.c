@@ -42,7 +42,7 @@
 
 #include "ng.h"
 
-static uint8_t NGDEF(_cmd_buffer)[CMD_BUFFER_SIZE] = { 0 };
+static uint8_t NGDEF(_cmd_buffer)[CMD_BUFFER_SIZE] = NGINIT({ 0 });
 #define cmd_buffer NG(_cmd_buffer)
 
 static fifo_t NGDEF(_cmd_fifo);
@@ -135,17 +135,19 @@ static void process_cmd_fifo()
     }
 }
 
-static void uart_rx_cb(uint8_t data)
+static void uart_rx_cb(uint8_t const* data, size_t length)
 {
     if( echo ) {
-      console_print_byte(data);
-      if( data == '\r' ) { console_print_byte('\n'); }
+      for(size_t i = 0; i < length; i++) {
+        console_print_byte(data[i]);
+        if( data[i] == '\r' ) { console_print_byte('\n'); }
+      }
     }
 
     error_t err;
 
     start_atomic();
-        err = fifo_put(&cmd_fifo, &data, 1); assert(err == SUCCESS);
+        err = fifo_put(&cmd_fifo, (uint8_t*) data, length); assert(err == SUCCESS);
     end_atomic();
 
     if(!sched_is_scheduled(&process_cmd_fifo))
@@ -162,7 +164,7 @@ void shell_init()
 
     fifo_init(&cmd_fifo, cmd_buffer, sizeof(cmd_buffer));
 
-    console_set_rx_interrupt_callback(&uart_rx_cb);
+    console_set_rx_block_callback(&uart_rx_cb);
     console_rx_interrupt_enable();
 
     sched_register_task(&process_cmd_fifo);
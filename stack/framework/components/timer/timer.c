@@ -32,10 +32,6 @@
 #endif
 
 
-#ifdef NODE_GLOBALS
-    #warning Default Timer implementation used when NODE_GLOBALS is active. Are you sure this is what you want ??
-#endif
-
 #define HW_TIMER_ID 0
 
 #define COUNTER_OVERFLOW_INCREASE (UINT32_C(1) << (8*sizeof(hwtimer_tick_t)))
@@ -47,12 +43,20 @@ extern inline error_t timer_post_task_delay(task_t task, timer_tick_t delay);
 extern inline error_t timer_add_event(timer_event* event);
 
 static timer_event NGDEF(timers)[FRAMEWORK_TIMER_STACK_SIZE];
+static sched_task_handle_t NGDEF(timer_task_handles)[FRAMEWORK_TIMER_STACK_SIZE];
+// min-heap of timer slots ordered by next_event. The first heap_size entries are the scheduled events,
+// the remaining entries are the free slots so allocating a slot does not require a search.
+static uint8_t NGDEF(heap)[FRAMEWORK_TIMER_STACK_SIZE];
+static uint8_t NGDEF(heap_pos)[FRAMEWORK_TIMER_STACK_SIZE];
+static uint8_t NGDEF(heap_size);
+// slot of the event scheduled for each scheduler task handle, or NO_EVENT
+static uint8_t NGDEF(task_slot)[FRAMEWORK_SCHEDULER_MAX_TASKS];
 static volatile timer_tick_t NGDEF(next_event);
 static volatile bool NGDEF(hw_event_scheduled);
 static volatile timer_tick_t NGDEF(timer_offset);
 static const hwtimer_info_t* timer_info;
-static bool timer_busy_programming = false;
-static bool fired_by_interrupt = true;
+static bool NGDEF(timer_busy_programming);
+static bool NGDEF(fired_by_interrupt) = NGINIT(true);
 enum
 {
     NO_EVENT = FRAMEWORK_TIMER_STACK_SIZE,
@@ -64,8 +68,16 @@ static void timer_fired();
 __LINK_C void timer_init()
 {
     for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-	NG(timers)[i].f = 0x0;
+    {
+        NG(timers)[i].f = 0x0;
+        NG(heap)[i] = i;
+        NG(heap_pos)[i] = i;
+    }
 
+    for(uint32_t i = 0; i < FRAMEWORK_SCHEDULER_MAX_TASKS; i++)
+        NG(task_slot)[i] = NO_EVENT;
+
+    NG(heap_size) = 0;
     NG(next_event) = NO_EVENT;
     NG(timer_offset) = 0;
     NG(hw_event_scheduled) = false;
@@ -85,6 +97,75 @@ error_t timer_init_event(timer_event* event, task_t callback)
     return (sched_register_task(callback)); // register the function callback to be called at the end of the timeout
 }
 
+//trick borrowed from AODV: by using signed integers in this way we know that slot a fires before slot b
+//regardless of any (pending) overflows, as long as all events are less than 2^31 ticks apart
+static inline bool fires_before(uint8_t a, uint8_t b)
+{
+    return ((int32_t)(NG(timers)[a].next_event - NG(timers)[b].next_event)) < 0;
+}
+
+static inline void heap_swap(uint8_t i, uint8_t j)
+{
+    uint8_t slot = NG(heap)[i];
+    NG(heap)[i] = NG(heap)[j];
+    NG(heap)[j] = slot;
+    NG(heap_pos)[NG(heap)[i]] = i;
+    NG(heap_pos)[NG(heap)[j]] = j;
+}
+
+static void heap_sift_up(uint8_t pos)
+{
+    while(pos > 0)
+    {
+        uint8_t parent = (pos - 1) / 2;
+        if(!fires_before(NG(heap)[pos], NG(heap)[parent]))
+            break;
+
+        heap_swap(pos, parent);
+        pos = parent;
+    }
+}
+
+static void heap_sift_down(uint8_t pos)
+{
+    while(true)
+    {
+        uint8_t smallest = pos;
+        uint8_t child = 2 * pos + 1;
+        if(child < NG(heap_size) && fires_before(NG(heap)[child], NG(heap)[smallest]))
+            smallest = child;
+
+        child++;
+        if(child < NG(heap_size) && fires_before(NG(heap)[child], NG(heap)[smallest]))
+            smallest = child;
+
+        if(smallest == pos)
+            break;
+
+        heap_swap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+static void heap_update(uint8_t slot)
+{
+    heap_sift_up(NG(heap_pos)[slot]);
+    heap_sift_down(NG(heap_pos)[slot]);
+}
+
+static void remove_event(uint8_t slot)
+{
+    //this function should only be called from an atomic context
+    uint8_t pos = NG(heap_pos)[slot];
+    NG(heap_size)--;
+    heap_swap(pos, NG(heap_size));
+    if(pos < NG(heap_size))
+        heap_update(NG(heap)[pos]);
+
+    NG(task_slot)[NG(timer_task_handles)[slot]] = NO_EVENT;
+    NG(timers)[slot].f = 0x0;
+}
+
 static void configure_next_event();
 __LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t fire_time, uint8_t priority, timer_tick_t period, void *arg)
 {
@@ -101,71 +182,58 @@ __LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t fire_time, uint8
     }
 
     start_atomic();
-    uint32_t empty_index = FRAMEWORK_TIMER_STACK_SIZE;
-    for (uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+    sched_task_handle_t handle = sched_get_task_handle(task);
+    if(handle == SCHED_INVALID_TASK_HANDLE)
     {
-        if (NG(timers)[i].f == 0x0 && empty_index == FRAMEWORK_TIMER_STACK_SIZE)
-        {
-            empty_index = i;
-        }
-        else if (NG(timers)[i].f == task)
-        {
-            // it is allowed to update only the fire time
-            if (NG(timers)[i].priority == priority)
-            {
-                NG(timers)[i].period = period;
-                NG(timers)[i].next_event = fire_time;
-                goto config;
-            }
-            else
-            //for now: do not allow an event to be scheduled more than once
-            //otherwise we risk having the same task being scheduled twice and only executed once
-            //because the scheduler disallows the same task to be scheduled multiple times
-                status = EALREADY;
-            break;
-        }
-    }
-
-    if (status != EALREADY && empty_index != FRAMEWORK_TIMER_STACK_SIZE)
-    {
-        NG(timers)[empty_index].f = task;
-        NG(timers)[empty_index].next_event = fire_time;
-        NG(timers)[empty_index].priority = priority;
-        NG(timers)[empty_index].arg = arg;
-        NG(timers)[empty_index].period = period;
-    }
-    else
+        status = EINVAL;
         goto end;
+    }
 
-config:
-
-    //if there is no event scheduled, this event will run before the next scheduled event
+    uint8_t slot = NG(task_slot)[handle];
+    if(slot != NO_EVENT)
     {
-        bool do_config = NG(next_event) == NO_EVENT;
-
-        if (!do_config)
+        // it is allowed to update only the fire time
+        if (NG(timers)[slot].priority == priority)
         {
-            uint32_t counter = timer_get_counter_value();
-
-            DPRINT("timer_post_task_prio counter value <%lu>" , counter);
+            NG(timers)[slot].period = period;
+            NG(timers)[slot].next_event = fire_time;
+            heap_update(slot);
+            goto config;
+        }
 
-            //if the new event should fire sooner than the old event --> trigger reconfig
-            //this is done using signed ints (compared to the current counter)
-            //to ensure propper handling of timer overflows
-            int32_t next_fire_delay = ((int32_t)fire_time) - ((int32_t)counter);
+        //for now: do not allow an event to be scheduled more than once
+        //otherwise we risk having the same task being scheduled twice and only executed once
+        //because the scheduler disallows the same task to be scheduled multiple times
+        status = EALREADY;
+        goto end;
+    }
 
-            DPRINT("next_fire_delay <%lu>" , next_fire_delay);
+    if(NG(heap_size) == FRAMEWORK_TIMER_STACK_SIZE)
+        goto end;
 
-            int32_t old_fire_delay = ((int32_t)NG(timers)[NG(next_event)].next_event) - ((int32_t)counter);
-            do_config = (next_fire_delay < old_fire_delay) || NG(next_event) == empty_index; //when same index is overwritten, also update
-        }
+    slot = NG(heap)[NG(heap_size)];
+    NG(timers)[slot].f = task;
+    NG(timers)[slot].next_event = fire_time;
+    NG(timers)[slot].priority = priority;
+    NG(timers)[slot].arg = arg;
+    NG(timers)[slot].period = period;
+    NG(timer_task_handles)[slot] = handle;
+    NG(task_slot)[handle] = slot;
+    NG(heap_size)++;
+    heap_sift_up(NG(heap_pos)[slot]);
 
-        if (do_config)
-            configure_next_event();
+config:
 
-        status = SUCCESS;
+    //reconfigure when this event is now the first to fire (this includes the case where there was no event
+    //scheduled) or when the fire time of the first event was updated
+    if (NG(next_event) != NG(heap)[0] || NG(next_event) == slot)
+    {
+        DPRINT("timer_post_task_prio reconfigure for slot <%d>" , slot);
+        configure_next_event();
     }
 
+    status = SUCCESS;
+
 end:
     end_atomic(); //this end_atomic does not do anything when configure_next_event got called
     return status;
@@ -177,18 +245,16 @@ __LINK_C error_t timer_cancel_task(task_t task)
     
     start_atomic();
 
-    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+    sched_task_handle_t handle = sched_get_task_handle(task);
+    if(handle != SCHED_INVALID_TASK_HANDLE && NG(task_slot)[handle] != NO_EVENT)
     {
-      if(NG(timers)[i].f == task)
-      {
-        NG(timers)[i].f = 0x0;
+        uint8_t slot = NG(task_slot)[handle];
+        remove_event(slot);
         //if we were the first event to fire --> trigger a reconfiguration
-        if(NG(next_event) == i)
+        if(NG(next_event) == slot)
           configure_next_event();
 
         status = SUCCESS;
-        break;
-      }
     }
     end_atomic();
 
@@ -212,15 +278,11 @@ __LINK_C bool timer_is_task_scheduled(task_t task)
 
     start_atomic();
 
-     for (uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-     {
-       if (NG(timers)[i].f == task)
-       {
-          present = true;
-          break;
-       }
-     }
-     end_atomic();
+    sched_task_handle_t handle = sched_get_task_handle(task);
+    if(handle != SCHED_INVALID_TASK_HANDLE)
+        present = NG(task_slot)[handle] != NO_EVENT;
+
+    end_atomic();
 
      return present;
 }
@@ -243,25 +305,10 @@ __LINK_C timer_tick_t timer_get_counter_value()
 static uint32_t get_next_event()
 {
     //this function should only be called from an atomic context
-    int32_t min_delay;
-    uint32_t next_fire_event = NO_EVENT;
-    uint32_t counter = timer_get_counter_value();
+    if(NG(heap_size) == 0)
+        return NO_EVENT;
 
-    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-    {
-    	if(NG(timers)[i].f == 0x0)
-    		continue;
-    	//trick borrowed from AODV: by using signed integers in this way
-    	//we know that if the event has already passed delay_ticks will be < 0
-    	// --> events are sorted from past -> future regardless of any (pending) overflows
-    	int32_t delay_ticks = ((int32_t)NG(timers)[i].next_event) - ((int32_t)counter);
-    	if(next_fire_event == NO_EVENT || delay_ticks < min_delay)
-		{
-    		min_delay = delay_ticks;
-			next_fire_event = i;
-		}
-    }
-    return next_fire_event;
+    return NG(heap)[0];
 }
 
 static void configure_next_event()
@@ -270,7 +317,7 @@ static void configure_next_event()
 	timer_tick_t next_fire_time;
     timer_tick_t current_time = timer_get_counter_value();
 
-    timer_busy_programming = true;
+    NG(timer_busy_programming) = true;
 
     do
     {
@@ -287,7 +334,7 @@ static void configure_next_event()
                 if(NG(timers)[NG(next_event)].f == 0)
                     DPRINT("function was empty, skipping");
                 else {
-                    fired_by_interrupt = false;
+                    NG(fired_by_interrupt) = false;
                     timer_fired();
                 }
 			}
@@ -296,7 +343,7 @@ static void configure_next_event()
     while(NG(next_event) != NO_EVENT && ( (((int32_t)next_fire_time) - ((int32_t)current_time)  - timer_info->min_delay_ticks) <= 0  ) );
 
     // if recursive event was scheduled immediately, don't set hw timer delay until last time in configure next event
-    if(!fired_by_interrupt)
+    if(!NG(fired_by_interrupt))
         return;
 
     //at this point NG(next_event) is eiter equal to NO_EVENT (no tasks left)
@@ -335,9 +382,11 @@ static void configure_next_event()
 			//set hw_event_scheduled explicitly to false to allow timer_overflow
 			//to schedule the event when needed
 			NG(hw_event_scheduled) = false;
+			//and make sure a compare programmed for a previous first event does not fire this one early
+			hw_timer_cancel(HW_TIMER_ID);
 		}
     }
-    timer_busy_programming = false;
+    NG(timer_busy_programming) = false;
 }
 static void timer_overflow()
 {
@@ -368,21 +417,21 @@ static void timer_overflow()
 
 static void timer_fired()
 {
-    if(timer_busy_programming && fired_by_interrupt)
+    if(NG(timer_busy_programming) && NG(fired_by_interrupt))
         return;
     assert(NG(next_event) != NO_EVENT);
     assert(NG(timers)[NG(next_event)].f != 0x0);
-    sched_post_task_prio(NG(timers)[NG(next_event)].f, NG(timers)[NG(next_event)].priority, NG(timers)[NG(next_event)].arg);
+    sched_post_handle_prio(NG(timer_task_handles)[NG(next_event)], NG(timers)[NG(next_event)].priority, NG(timers)[NG(next_event)].arg);
     if(NG(timers)[NG(next_event)].period > 0) {
         task_t recursive_task = NG(timers)[NG(next_event)].f;
-        NG(timers)[NG(next_event)].f = 0x0;
+        remove_event(NG(next_event));
         timer_post_task_prio(recursive_task, timer_get_counter_value() + NG(timers)[NG(next_event)].period, NG(timers)[NG(next_event)].priority, NG(timers)[NG(next_event)].period, NG(timers)[NG(next_event)].arg);
-        fired_by_interrupt = true;
+        NG(fired_by_interrupt) = true;
         return;
     }
-    NG(timers)[NG(next_event)].f = 0x0;
-    if(fired_by_interrupt)
+    remove_event(NG(next_event));
+    if(NG(fired_by_interrupt))
         configure_next_event();
     else
-        fired_by_interrupt = true;
+        NG(fired_by_interrupt) = true;
 }
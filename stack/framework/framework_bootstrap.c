@@ -34,7 +34,8 @@ void __framework_bootstrap()
     timer_init();
     //initialise libc RNG with the unique device id
     set_rng_seed((unsigned int)hw_get_unique_id());
-    //reset the log counter
+    //initialise the logging and reset the log counter
+    log_init();
     log_counter_reset();
 
 #ifdef FRAMEWORK_CONSOLE_ENABLED
@@ -30,9 +30,12 @@
 #include "platform.h"
 #include "modem_interface.h"
 #include "alp_layer.h"
+#include "framework_defs.h"
 
 #define RX_BUFFER_SIZE 256
 #define CMD_BUFFER_SIZE 256
+#define MODEM_MAX_ACTIVE_COMMANDS FRAMEWORK_MODEM_MAX_ACTIVE_COMMANDS
+#define COMMAND_TIMEOUT (FRAMEWORK_MODEM_COMMAND_TIMEOUT * TIMER_TICKS_PER_SEC)
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_MODEM_LOG_ENABLED)
   #define DPRINT(...) log_print_string(__VA_ARGS__)
@@ -43,39 +46,93 @@
 #endif
 
 
+// commands are tracked by their tag until the modem reports completion, or until they time out when the completion
+// is lost. The ALP command is only built in cmd_buffer, since it is copied by the modem interface when it is transferred.
 typedef struct {
   uint8_t tag_id;
   bool is_active;
-  fifo_t fifo;
-  uint8_t buffer[256];
+  timer_tick_t start_time;
 } command_t;
 
 static uart_handle_t* uart_handle;
 static modem_callbacks_t* callbacks;
 static fifo_t rx_fifo;
 static uint8_t rx_buffer[RX_BUFFER_SIZE];
-static command_t command; // TODO only one active command supported for now
+static command_t commands[MODEM_MAX_ACTIVE_COMMANDS];
+static uint8_t active_command_count = 0;
+static fifo_t cmd_fifo;
+static uint8_t cmd_buffer[CMD_BUFFER_SIZE];
 static uint8_t next_tag_id = 0;
 static bool parsed_header = false;
 static uint8_t payload_len = 0;
 
+static command_t* find_active_command(uint8_t tag_id)
+{
+  for(uint8_t i = 0; i < MODEM_MAX_ACTIVE_COMMANDS; i++) {
+    if(commands[i].is_active && commands[i].tag_id == tag_id)
+      return &commands[i];
+  }
+
+  return NULL;
+}
+
+static void complete_command(command_t* command, bool with_error)
+{
+  DPRINT("command with tag %i completed @ %i", command->tag_id, timer_get_counter_value());
+  command->is_active = false;
+  active_command_count--;
+  if(callbacks->command_completed_callback)
+    callbacks->command_completed_callback(with_error, command->tag_id);
+}
+
+// releases the commands for which the modem did not report completion in time, otherwise their slots are never reused
+static void expire_commands(void *arg)
+{
+  timer_tick_t now = timer_get_counter_value();
+  timer_tick_t next_expiry = COMMAND_TIMEOUT;
+  for(uint8_t i = 0; i < MODEM_MAX_ACTIVE_COMMANDS; i++) {
+    if(!commands[i].is_active)
+      continue;
+
+    timer_tick_t age = now - commands[i].start_time;
+    if(age >= COMMAND_TIMEOUT) {
+      log_print_string("!!! command with tag %i timed out", commands[i].tag_id);
+      complete_command(&commands[i], true);
+    } else if(COMMAND_TIMEOUT - age < next_expiry) {
+      next_expiry = COMMAND_TIMEOUT - age;
+    }
+  }
+
+  // a completion callback can have sent a new command, which scheduled this task already
+  timer_cancel_task(&expire_commands);
+  if(active_command_count > 0)
+    timer_post_task_delay(&expire_commands, next_expiry);
+}
+
 static void process_serial_frame(fifo_t* fifo) {
-  bool command_completed = false;
+  command_t* completed_command = NULL;
   bool completed_with_error = false;
   while(fifo_get_size(fifo)) {
     alp_action_t action;
     alp_parse_action(fifo, &action);
 
     switch(action.operation) {
-      case ALP_OP_RESPONSE_TAG:
-        if(action.tag_response.tag_id == command.tag_id) {
-          command_completed = action.tag_response.completed;
-          completed_with_error = action.tag_response.error;
-        } else {
-          DPRINT("received resp with unexpected tag_id (%i vs %i)", action.tag_response.tag_id, command.tag_id);
+      case ALP_OP_RESPONSE_TAG: {
+        // the actions of the previous response are processed, so it can be completed before the next one starts
+        if(completed_command)
+          complete_command(completed_command, completed_with_error);
+
+        completed_command = NULL;
+        command_t* command = find_active_command(action.tag_response.tag_id);
+        if(command == NULL) {
+          DPRINT("received resp with unexpected tag_id %i", action.tag_response.tag_id);
           // TODO unsolicited responses
+        } else if(action.tag_response.completed) {
+          completed_command = command;
+          completed_with_error = action.tag_response.error;
         }
         break;
+      }
       case ALP_OP_WRITE_FILE_DATA:
         if(callbacks->write_file_data_callback)
           callbacks->write_file_data_callback(action.file_data_operand.file_offset.file_id,
@@ -107,14 +164,8 @@ static void process_serial_frame(fifo_t* fifo) {
   }
 
 
-  if(command_completed) {
-    DPRINT("command with tag %i completed @ %i", command.tag_id, timer_get_counter_value());
-    if(callbacks->command_completed_callback)
-      callbacks->command_completed_callback(completed_with_error,command.tag_id);
-
-    command.is_active = false;
-  }
-
+  if(completed_command)
+    complete_command(completed_command, completed_with_error);
 }
 
 void modem_cb_init(modem_callbacks_t* cbs)
@@ -128,11 +179,16 @@ void modem_init()
 {
   modem_interface_init(PLATFORM_MODEM_INTERFACE_UART, PLATFORM_MODEM_INTERFACE_BAUDRATE, MCU2MODEM_INT_PIN, MODEM2MCU_INT_PIN);
   modem_interface_register_handler(&process_serial_frame, SERIAL_MESSAGE_TYPE_ALP_DATA); 
-  command.is_active = false;
+  sched_register_task(&expire_commands);
+  modem_reinit();
 }
 
 void modem_reinit() {
-  command.is_active = false;
+  for(uint8_t i = 0; i < MODEM_MAX_ACTIVE_COMMANDS; i++)
+    commands[i].is_active = false;
+
+  active_command_count = 0;
+  timer_cancel_task(&expire_commands);
 }
 
 void modem_send_ping() {
@@ -141,137 +197,165 @@ void modem_send_ping() {
 }
 
 bool modem_execute_raw_alp(uint8_t* alp, uint8_t len) {
-  modem_interface_transfer_bytes(alp, len, SERIAL_MESSAGE_TYPE_ALP_DATA);
+  return modem_interface_transfer_bytes(alp, len, SERIAL_MESSAGE_TYPE_ALP_DATA) == SUCCESS;
 }
 
-bool alloc_command() {
-  if(command.is_active) {
-    DPRINT("prev command still active @ %i", timer_get_counter_value());
-    return false;
+static command_t* alloc_command() {
+  command_t* command = NULL;
+  for(uint8_t i = 0; i < MODEM_MAX_ACTIVE_COMMANDS; i++) {
+    if(!commands[i].is_active) {
+      command = &commands[i];
+      break;
+    }
   }
 
-  command.is_active = true;
-  fifo_init(&command.fifo, command.buffer, CMD_BUFFER_SIZE);
-  command.tag_id = next_tag_id;
+  if(command == NULL) {
+    DPRINT("max number of commands active @ %i", timer_get_counter_value());
+    return NULL;
+  }
+
+  // skip tags which are still in use, after wrapping around
+  while(find_active_command(next_tag_id) != NULL)
+    next_tag_id++;
+
+  command->is_active = true;
+  command->tag_id = next_tag_id;
+  command->start_time = timer_get_counter_value();
   next_tag_id++;
+  active_command_count++;
+  if(!timer_is_task_scheduled(&expire_commands))
+    timer_post_task_delay(&expire_commands, COMMAND_TIMEOUT);
 
-  alp_append_tag_request_action(&command.fifo, command.tag_id, true);
-  return true;
+  fifo_init(&cmd_fifo, cmd_buffer, CMD_BUFFER_SIZE);
+  alp_append_tag_request_action(&cmd_fifo, command->tag_id, true);
+  return command;
+}
+
+// transfers the command built in cmd_buffer, the command is released again when the modem interface has no room for it
+static bool transfer_command(command_t* command) {
+  if(modem_interface_transfer_bytes(cmd_buffer, fifo_get_size(&cmd_fifo), SERIAL_MESSAGE_TYPE_ALP_DATA) == SUCCESS)
+    return true;
+
+  DPRINT("command with tag %i not accepted by the modem interface", command->tag_id);
+  command->is_active = false;
+  active_command_count--;
+  return false;
 }
 
 bool modem_create_and_write_file(uint8_t file_id, uint32_t offset, uint32_t length, uint8_t* data, fs_storage_class_t storage_class) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
 
-  alp_append_create_new_file_data_action(&command.fifo, file_id, length, storage_class, true, false);
-
-  alp_append_write_file_data_action(&command.fifo, file_id, offset, length, data, true, false);
+  alp_append_create_new_file_data_action(&cmd_fifo, file_id, length, storage_class, true, false);
 
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
+  alp_append_write_file_data_action(&cmd_fifo, file_id, offset, length, data, true, false);
 
-  return true;
+  return transfer_command(command);
 }
 
 bool modem_create_file(uint8_t file_id, uint32_t length, fs_storage_class_t storage_class) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
   
-  alp_append_create_new_file_data_action(&command.fifo, file_id, length, storage_class, true, false);
+  alp_append_create_new_file_data_action(&cmd_fifo, file_id, length, storage_class, true, false);
 
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
-
-  return true;
+  return transfer_command(command);
 }
 
 bool modem_read_file(uint8_t file_id, uint32_t offset, uint32_t size) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
 
-  alp_append_read_file_data_action(&command.fifo, file_id, offset, size, true, false);
-
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
+  alp_append_read_file_data_action(&cmd_fifo, file_id, offset, size, true, false);
 
-  return true;
+  return transfer_command(command);
 }
 
 bool modem_write_file(uint8_t file_id, uint32_t offset, uint32_t size, uint8_t* data) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
 
-  alp_append_write_file_data_action(&command.fifo, file_id, offset, size, data, true, false);
+  alp_append_write_file_data_action(&cmd_fifo, file_id, offset, size, data, true, false);
 
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
-
-  return true;
+  return transfer_command(command);
 }
 
 bool modem_send_unsolicited_response(uint8_t file_id, uint32_t offset, uint32_t length, uint8_t* data,
                                      session_config_t* session_config) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
 
   if(session_config->interface_type==DASH7)
-    alp_append_forward_action(&command.fifo, ALP_ITF_ID_D7ASP, (uint8_t *) &session_config->d7ap_session_config, sizeof(d7ap_session_config_t));
+    alp_append_forward_action(&cmd_fifo, ALP_ITF_ID_D7ASP, (uint8_t *) &session_config->d7ap_session_config, sizeof(d7ap_session_config_t));
   else if(session_config->interface_type==LORAWAN_OTAA)
-    alp_append_forward_action(&command.fifo, ALP_ITF_ID_LORAWAN_OTAA, (uint8_t *) &session_config->lorawan_session_config_otaa, sizeof(lorawan_session_config_otaa_t));
+    alp_append_forward_action(&cmd_fifo, ALP_ITF_ID_LORAWAN_OTAA, (uint8_t *) &session_config->lorawan_session_config_otaa, sizeof(lorawan_session_config_otaa_t));
   else if(session_config->interface_type==LORAWAN_ABP)
-    alp_append_forward_action(&command.fifo, ALP_ITF_ID_LORAWAN_ABP, (uint8_t *) &session_config->lorawan_session_config_abp, sizeof(lorawan_session_config_abp_t));
+    alp_append_forward_action(&cmd_fifo, ALP_ITF_ID_LORAWAN_ABP, (uint8_t *) &session_config->lorawan_session_config_abp, sizeof(lorawan_session_config_abp_t));
 
-  alp_append_return_file_data_action(&command.fifo, file_id, offset, length, data);
+  alp_append_return_file_data_action(&cmd_fifo, file_id, offset, length, data);
 
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
-  return true;
+  return transfer_command(command);
 }
 
 bool modem_send_raw_unsolicited_response(uint8_t* alp_command, uint32_t length,
                                          session_config_t* session_config) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
 
   //sends alp to modem
 
    if(session_config->interface_type==DASH7)
-    alp_append_forward_action(&command.fifo, ALP_ITF_ID_D7ASP, (uint8_t *) &session_config->d7ap_session_config, sizeof(d7ap_session_config_t));
+    alp_append_forward_action(&cmd_fifo, ALP_ITF_ID_D7ASP, (uint8_t *) &session_config->d7ap_session_config, sizeof(d7ap_session_config_t));
   else if(session_config->interface_type==LORAWAN_OTAA)
-    alp_append_forward_action(&command.fifo, ALP_ITF_ID_LORAWAN_OTAA, (uint8_t *) &session_config->lorawan_session_config_otaa, sizeof(lorawan_session_config_otaa_t));
+    alp_append_forward_action(&cmd_fifo, ALP_ITF_ID_LORAWAN_OTAA, (uint8_t *) &session_config->lorawan_session_config_otaa, sizeof(lorawan_session_config_otaa_t));
   else if(session_config->interface_type==LORAWAN_ABP)
-    alp_append_forward_action(&command.fifo, ALP_ITF_ID_LORAWAN_ABP, (uint8_t *) &session_config->lorawan_session_config_abp, sizeof(lorawan_session_config_abp_t));
+    alp_append_forward_action(&cmd_fifo, ALP_ITF_ID_LORAWAN_ABP, (uint8_t *) &session_config->lorawan_session_config_abp, sizeof(lorawan_session_config_abp_t));
 
-  fifo_put(&command.fifo, alp_command, length);
+  fifo_put(&cmd_fifo, alp_command, length);
 
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
-  return true;
+  return transfer_command(command);
 }
 
 bool modem_send_indirect_unsolicited_response(uint8_t data_file_id, uint32_t offset, uint32_t length, uint8_t* data, 
                                               uint8_t interface_file_id, bool overload, d7ap_addressee_t* d7_addressee) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
   
   //overload only D7 implemented
-  alp_append_indirect_forward_action(&command.fifo, interface_file_id, overload, (uint8_t *) &d7_addressee, d7ap_addressee_id_length(d7_addressee->ctrl.id_type));
+  alp_append_indirect_forward_action(&cmd_fifo, interface_file_id, overload, (uint8_t *) &d7_addressee, d7ap_addressee_id_length(d7_addressee->ctrl.id_type));
 
-  alp_append_return_file_data_action(&command.fifo, data_file_id, offset, length, data);
+  alp_append_return_file_data_action(&cmd_fifo, data_file_id, offset, length, data);
 
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
-  return true;
+  return transfer_command(command);
 }
 
 bool modem_send_raw_indirect_unsolicited_response(uint8_t* alp_command, uint32_t length,
                                                   uint8_t interface_file_id, bool overload, d7ap_addressee_t* d7_addressee) {
-  if(!alloc_command())
+  command_t* command = alloc_command();
+  if(command == NULL)
     return false;
   
   //overload only D7 implemented
-  alp_append_indirect_forward_action(&command.fifo, interface_file_id, overload, (uint8_t *) &d7_addressee, sizeof(d7_addressee));
+  alp_append_indirect_forward_action(&cmd_fifo, interface_file_id, overload, (uint8_t *) &d7_addressee, sizeof(d7_addressee));
 
-  fifo_put(&command.fifo, alp_command, length);
+  fifo_put(&cmd_fifo, alp_command, length);
 
-  modem_interface_transfer_bytes(command.buffer, fifo_get_size(&command.fifo), SERIAL_MESSAGE_TYPE_ALP_DATA);
-  return true;
+  return transfer_command(command);
 }
 
 uint8_t modem_get_active_tag_id()
 {
   return next_tag_id;
 }
+
+uint8_t modem_get_active_command_count()
+{
+  return active_command_count;
+}
@@ -57,5 +57,7 @@ bool modem_send_indirect_unsolicited_response(uint8_t data_file_id, uint32_t off
 bool modem_send_raw_indirect_unsolicited_response(uint8_t* alp_command, uint32_t length,
                                                   uint8_t interface_file_id, bool overload, d7ap_addressee_t* d7_addressee);
 uint8_t modem_get_active_tag_id();
+/*! \brief Returns the number of commands which are sent to the modem and not completed yet, at most FRAMEWORK_MODEM_MAX_ACTIVE_COMMANDS */
+uint8_t modem_get_active_command_count();
 
 #endif
@@ -15,6 +15,7 @@ blockdevice_driver_t blockdevice_driver_stm32_eeprom = {
     .init = init,
     .read = read,
     .program = program,
+    .program_changed = program, // program() already skips the unchanged words
 };
 
 
@@ -45,14 +46,34 @@ static error_t program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, ui
   addr += DATA_EEPROM_BASE + bd_eeprom->offset;
   if(addr + size > DATA_EEPROM_BANK2_END) return -ESIZE;
 
-  // TODO optimize by writing per word when possible
+  // the EEPROM is memory mapped so comparing is cheap, while programming a byte takes as long as programming a
+  // word. Program per word where aligned, and skip the words and bytes which are not changed.
   HAL_FLASHEx_DATAEEPROM_Unlock();
-  for (size_t i = 0; i < size; i++) {
-    while (FLASH->SR & FLASH_SR_BSY); // TODO timeout
-    *(uint8_t*)(addr + i) = data[i];
-    while (FLASH->SR & FLASH_SR_BSY); // TODO timeout
+  while (size > 0) {
+    if ((addr & 3) == 0 && size >= 4) {
+      uint32_t word;
+      memcpy(&word, data, 4);
+      if (*(volatile uint32_t*)addr != word) {
+        while (FLASH->SR & FLASH_SR_BSY); // TODO timeout
+        *(volatile uint32_t*)addr = word;
+      }
+
+      addr += 4;
+      data += 4;
+      size -= 4;
+    } else {
+      if (*(volatile uint8_t*)addr != *data) {
+        while (FLASH->SR & FLASH_SR_BSY); // TODO timeout
+        *(volatile uint8_t*)addr = *data;
+      }
+
+      addr++;
+      data++;
+      size--;
+    }
   }
 
+  while (FLASH->SR & FLASH_SR_BSY); // TODO timeout
   HAL_FLASHEx_DATAEEPROM_Lock();
 
   return SUCCESS;
@@ -27,6 +27,7 @@
 #include "stm32_device.h"
 #include "stm32_common_gpio.h"
 #include "platform.h"
+#include "hal_defs.h"
 #include "string.h"
 #include "ports.h"
 #include "errors.h"
@@ -37,6 +38,11 @@ struct uart_handle {
   UART_HandleTypeDef handle;
   uint32_t baudrate;
   uart_rx_inthandler_t rx_cb;
+  uart_rx_block_handler_t rx_block_cb;
+  // received bytes are collected here and passed to rx_block_cb at once when the line becomes idle or the
+  // threshold is reached, which saves the consumer a fifo_put() and a task post for every byte
+  uint8_t rx_block[HAL_UART_RX_BLOCK_THRESHOLD];
+  uint8_t rx_block_len;
 };
 
 // private storage of handles, pointers to these records are passed around
@@ -46,6 +52,8 @@ uart_handle_t* uart_init(uint8_t port_idx, uint32_t baudrate, uint8_t pins) {
   assert(port_idx < UART_COUNT);
   handle[port_idx].uart_port = &uart_ports[port_idx];
   handle[port_idx].rx_cb = NULL;
+  handle[port_idx].rx_block_cb = NULL;
+  handle[port_idx].rx_block_len = 0;
   handle[port_idx].baudrate = baudrate;
   return &handle[port_idx];
 }
@@ -158,6 +166,14 @@ void uart_set_rx_interrupt_callback(uart_handle_t* uart,
                                     uart_rx_inthandler_t rx_handler)
 {
   uart->rx_cb = rx_handler;
+  uart->rx_block_cb = NULL;
+}
+
+void uart_set_rx_block_callback(uart_handle_t* uart, uart_rx_block_handler_t rx_handler)
+{
+  uart->rx_block_cb = rx_handler;
+  uart->rx_cb = NULL;
+  uart->rx_block_len = 0;
 }
 
 void uart_send_byte(uart_handle_t* uart, uint8_t data) {
@@ -190,7 +206,7 @@ void uart_send_string(uart_handle_t* uart, const char *string) {
 }
 
 error_t uart_rx_interrupt_enable(uart_handle_t* uart) {
-  if(uart->rx_cb == NULL) { return EOFF; }
+  if(uart->rx_cb == NULL && uart->rx_block_cb == NULL) { return EOFF; }
   //   USART_IntClear(uart->channel, _UART_IF_MASK);
   //   USART_IntEnable(uart->channel, UART_IF_RXDATAV);
   //   NVIC_ClearPendingIRQ(uart->irq.tx);
@@ -201,6 +217,9 @@ error_t uart_rx_interrupt_enable(uart_handle_t* uart) {
   HAL_NVIC_EnableIRQ(uart->uart_port->irq);
   LL_USART_EnableIT_RXNE(uart->handle.Instance);
   LL_USART_EnableIT_ERROR(uart->handle.Instance);
+  if(uart->rx_block_cb != NULL)
+    LL_USART_EnableIT_IDLE(uart->handle.Instance);
+
   return SUCCESS;
 }
 
@@ -209,6 +228,16 @@ void uart_rx_interrupt_disable(uart_handle_t* uart) {
   HAL_NVIC_DisableIRQ(uart->uart_port->irq);
   LL_USART_DisableIT_RXNE(uart->handle.Instance);
   LL_USART_DisableIT_ERROR(uart->handle.Instance);
+  LL_USART_DisableIT_IDLE(uart->handle.Instance);
+}
+
+static void flush_rx_block(uart_handle_t* uart)
+{
+  if(uart->rx_block_len == 0)
+    return;
+
+  uart->rx_block_cb(uart->rx_block, uart->rx_block_len);
+  uart->rx_block_len = 0;
 }
 
 static void uart_irq_handler(USART_TypeDef* uart) {
@@ -238,19 +267,34 @@ static void uart_irq_handler(USART_TypeDef* uart) {
     // TODO other flags?
   }
 
+  uart_handle_t* h = NULL;
+  for(uint8_t idx = 0; idx < UART_COUNT; idx++) {
+    if(handle[idx].uart_port != NULL && handle[idx].handle.Instance == uart) {
+      h = &handle[idx];
+      break;
+    }
+  }
+
+  assert(h != NULL); // we should not reach this point
+
   if(LL_USART_IsActiveFlag_RXNE(uart) && LL_USART_IsEnabledIT_RXNE(uart))
   {
-    uint8_t idx = 0;
-    do {
-      if(handle[idx].uart_port != NULL && handle[idx].handle.Instance == uart) {
-        handle[idx].rx_cb(LL_USART_ReceiveData8(uart)); // RXNE flag will be cleared by reading of DR register
-        return;
-      }
+    uint8_t data = LL_USART_ReceiveData8(uart); // RXNE flag will be cleared by reading of DR register
+    if(h->rx_block_cb == NULL) {
+      h->rx_cb(data);
+      return;
+    }
 
-      idx++;
-    } while(idx < UART_COUNT);
+    h->rx_block[h->rx_block_len++] = data;
+    if(h->rx_block_len == HAL_UART_RX_BLOCK_THRESHOLD)
+      flush_rx_block(h);
+  }
 
-    assert(false); // we should not reach this point
+  // checked after RXNE since clearing the IDLE flag reads the data register on some families
+  if(LL_USART_IsActiveFlag_IDLE(uart) && LL_USART_IsEnabledIT_IDLE(uart))
+  {
+    LL_USART_ClearFlag_IDLE(uart);
+    flush_rx_block(h);
   }
 }
 
@@ -43,6 +43,7 @@ blockdevice_driver_t blockdevice_driver_ram = {
     .init = init,
     .read = read,
     .program = program,
+    .program_changed = program, // comparing is not cheaper than copying
 };
 
 
@@ -17,6 +17,62 @@ error_t blockdevice_program(blockdevice_t* bd, const uint8_t* data, uint32_t add
   return bd->driver->program(bd, data, addr, size);
 }
 
+error_t blockdevice_program_changed(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size) {
+  assert(bd && bd->driver && bd->driver->program);
+  if(bd->driver->program_changed)
+    return bd->driver->program_changed(bd, data, addr, size);
+
+  uint8_t stored[BLOCKDEVICE_BUFFER_SIZE];
+  while(size > 0) {
+    uint32_t chunk = size < BLOCKDEVICE_BUFFER_SIZE ? size : BLOCKDEVICE_BUFFER_SIZE;
+    error_t e = bd->driver->read(bd, stored, addr, chunk);
+    if(e != SUCCESS) return e;
+
+    // program each run of changed bytes with a single call
+    uint32_t i = 0;
+    while(i < chunk) {
+      if(stored[i] == data[i]) {
+        i++;
+        continue;
+      }
+
+      uint32_t start = i;
+      while(i < chunk && stored[i] != data[i])
+        i++;
+
+      e = bd->driver->program(bd, data + start, addr + start, i - start);
+      if(e != SUCCESS) return e;
+    }
+
+    data += chunk;
+    addr += chunk;
+    size -= chunk;
+  }
+
+  return SUCCESS;
+}
+
+error_t blockdevice_copy(blockdevice_t* dst, uint32_t dst_addr, blockdevice_t* src, uint32_t src_addr, uint32_t size) {
+  assert(src && src->driver && src->driver->read);
+  assert(dst && dst->driver && dst->driver->program);
+
+  uint8_t buffer[BLOCKDEVICE_BUFFER_SIZE];
+  while(size > 0) {
+    uint32_t chunk = size < BLOCKDEVICE_BUFFER_SIZE ? size : BLOCKDEVICE_BUFFER_SIZE;
+    error_t e = src->driver->read(src, buffer, src_addr, chunk);
+    if(e != SUCCESS) return e;
+
+    e = dst->driver->program(dst, buffer, dst_addr, chunk);
+    if(e != SUCCESS) return e;
+
+    src_addr += chunk;
+    dst_addr += chunk;
+    size -= chunk;
+  }
+
+  return SUCCESS;
+}
+
 error_t blockdevice_erase_chip(blockdevice_t* bd){
   assert(bd && bd->driver && bd->driver->erase_chip);
   return bd->driver->erase_chip(bd);
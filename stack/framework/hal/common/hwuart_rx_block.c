@@ -0,0 +1,68 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Fallback for the UART block RX API on drivers which only deliver received bytes one by one (and for USB CDC).
+// Each registered block handler gets a per-byte trampoline which passes the byte on as a span of length 1.
+// Drivers with a native implementation override uart_set_rx_block_callback().
+
+#include "hwuart.h"
+#include "debug.h"
+#include "platform_defs.h"
+
+// the shell and the modem interface are the only block consumers, on separate UARTs
+#define RX_BLOCK_ADAPTER_COUNT 2
+
+static uart_rx_block_handler_t adapter_handlers[RX_BLOCK_ADAPTER_COUNT];
+
+static void adapter_rx_byte_0(uint8_t byte) { adapter_handlers[0](&byte, 1); }
+static void adapter_rx_byte_1(uint8_t byte) { adapter_handlers[1](&byte, 1); }
+
+static const uart_rx_inthandler_t adapters[RX_BLOCK_ADAPTER_COUNT] = {
+  &adapter_rx_byte_0,
+  &adapter_rx_byte_1
+};
+
+static uart_rx_inthandler_t get_adapter(uart_rx_block_handler_t rx_handler)
+{
+  if(rx_handler == NULL)
+    return NULL;
+
+  for(uint8_t i = 0; i < RX_BLOCK_ADAPTER_COUNT; i++)
+  {
+    if(adapter_handlers[i] == NULL)
+      adapter_handlers[i] = rx_handler;
+
+    if(adapter_handlers[i] == rx_handler)
+      return adapters[i];
+  }
+
+  assert(false); // increase RX_BLOCK_ADAPTER_COUNT
+  return NULL;
+}
+
+__attribute__((weak)) void uart_set_rx_block_callback(uart_handle_t* uart, uart_rx_block_handler_t rx_handler)
+{
+  uart_set_rx_interrupt_callback(uart, get_adapter(rx_handler));
+}
+
+#ifdef PLATFORM_USE_USB_CDC
+void cdc_set_rx_block_callback(uart_rx_block_handler_t rx_handler)
+{
+  cdc_set_rx_interrupt_callback(get_adapter(rx_handler));
+}
+#endif
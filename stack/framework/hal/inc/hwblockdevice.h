@@ -8,10 +8,16 @@
 
 typedef struct blockdevice blockdevice_t;
 
+// the size of the buffer used on the stack for bulk transfers and compares
+#define BLOCKDEVICE_BUFFER_SIZE 64
+
 typedef struct {
   void (*init)(blockdevice_t* bd);
   error_t (*read)(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size);
   error_t (*program)(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
+  // optional, programs only the (aligned words containing) bytes which differ from the stored data. When not
+  // implemented the stored data is read back in chunks and only the changed runs are passed to program()
+  error_t (*program_changed)(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
   error_t (*erase_chip)(blockdevice_t* bd);
   error_t (*erase_block32k)(blockdevice_t* bd, uint32_t addr);
   error_t (*erase_sector4k)(blockdevice_t* bd, uint32_t addr);
@@ -24,6 +30,18 @@ struct blockdevice {
 void blockdevice_init(blockdevice_t* bd);
 error_t blockdevice_read(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size);
 error_t blockdevice_program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
+/*! \brief Program only the bytes which differ from the current content of the blockdevice.
+ *
+ *  Use this instead of blockdevice_program() to rewrite data which is mostly unchanged on memories which wear out
+ *  or where programming is slow, like EEPROM.
+ */
+error_t blockdevice_program_changed(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
+
+/*! \brief Copy size bytes from src_addr on src to dst_addr on dst, in chunks of BLOCKDEVICE_BUFFER_SIZE bytes.
+ *
+ *  src and dst can be the same blockdevice when the regions do not overlap.
+ */
+error_t blockdevice_copy(blockdevice_t* dst, uint32_t dst_addr, blockdevice_t* src, uint32_t src_addr, uint32_t size);
 error_t blockdevice_erase_chip(blockdevice_t* bd);
 error_t blockdevice_erase_block32k(blockdevice_t* bd, uint32_t addr);
 error_t blockdevice_erase_sector4k(blockdevice_t* bd, uint32_t addr);
@@ -108,6 +108,8 @@ typedef struct
 typedef struct
 {
     timer_tick_t timestamp;	/**< The clock_tick of the framework timer at which the whole frame is transmitted. */
+    uint8_t data_offset;	/**< The frame to transmit starts at data[data_offset], this leaves headroom in front of
+                             *   the frame so headers can be prepended in place. */
 
     // TODO optimize struct for size. This was packed but resulted in alignment issues on Cortex-M0 so removed for now.
 } hw_tx_metadata_t;
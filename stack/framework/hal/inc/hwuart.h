@@ -42,6 +42,11 @@ typedef struct uart_handle uart_handle_t;
 // callback handler for received byte
 typedef void (*uart_rx_inthandler_t)(uint8_t byte);
 
+// callback handler for a block of received bytes. The span points into the RX buffer owned by the
+// driver and is only valid for the duration of the callback, which is called from interrupt context
+// when the line becomes idle or when HAL_UART_RX_BLOCK_THRESHOLD bytes are pending.
+typedef void (*uart_rx_block_handler_t)(uint8_t const* data, size_t length);
+
 __LINK_C uart_handle_t* uart_init(uint8_t port_idx, uint32_t baudrate, uint8_t pins);
 __LINK_C bool           uart_disable(uart_handle_t* uart);
 __LINK_C bool           uart_get_rx_port_state(uart_handle_t* uart);
@@ -57,7 +62,16 @@ __LINK_C void           uart_rx_interrupt_disable(uart_handle_t* uart);
 __LINK_C void           uart_set_rx_interrupt_callback(uart_handle_t* uart,
                                                        uart_rx_inthandler_t rx_handler);
 
+/*! \brief Registers a handler which receives the incoming bytes as spans instead of one by one.
+ *
+ * This replaces a handler set using uart_set_rx_interrupt_callback(). Drivers without native support
+ * fall back to delivering spans of a single byte.
+ */
+__LINK_C void           uart_set_rx_block_callback(uart_handle_t* uart,
+                                                   uart_rx_block_handler_t rx_handler);
+
 __LINK_C void           cdc_set_rx_interrupt_callback(uart_rx_inthandler_t rx_handler);
+__LINK_C void           cdc_set_rx_block_callback(uart_rx_block_handler_t rx_handler);
 
 #endif
 
@@ -0,0 +1,123 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file blockdevice_sim_eeprom.c
+ *
+ *  \brief RAM blockdevice which models the program latency and the wear of an embedded EEPROM
+ */
+
+#include <string.h>
+
+#include "blockdevice_sim_eeprom.h"
+#include "debug.h"
+#include "errors.h"
+
+static void init(blockdevice_t* bd);
+static error_t read(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size);
+static error_t program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
+static error_t program_changed(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
+
+blockdevice_driver_t blockdevice_driver_sim_eeprom = {
+    .init = init,
+    .read = read,
+    .program = program,
+    .program_changed = program_changed,
+};
+
+static void init(blockdevice_t* bd)
+{
+    blockdevice_sim_eeprom_t* bd_eeprom = (blockdevice_sim_eeprom_t*)bd;
+    assert(bd_eeprom->buffer != NULL && bd_eeprom->wear != NULL);
+}
+
+void blockdevice_sim_eeprom_reset_stats(blockdevice_sim_eeprom_t* bd)
+{
+    memset(&bd->stats, 0, sizeof(bd->stats));
+    memset(bd->wear, 0, ((bd->size + BLOCKDEVICE_SIM_EEPROM_WORD_SIZE - 1) / BLOCKDEVICE_SIM_EEPROM_WORD_SIZE) * sizeof(uint32_t));
+}
+
+static error_t read(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size)
+{
+    blockdevice_sim_eeprom_t* bd_eeprom = (blockdevice_sim_eeprom_t*)bd;
+    if(size == 0) return SUCCESS;
+    if(addr + size > bd_eeprom->size) return -ESIZE;
+
+    memcpy(data, bd_eeprom->buffer + addr, size);
+    return SUCCESS;
+}
+
+static void wear_word(blockdevice_sim_eeprom_t* bd_eeprom, uint32_t addr)
+{
+    uint32_t* wear = &bd_eeprom->wear[addr / BLOCKDEVICE_SIM_EEPROM_WORD_SIZE];
+    (*wear)++;
+    if(*wear > bd_eeprom->stats.max_wear)
+        bd_eeprom->stats.max_wear = *wear;
+}
+
+static error_t program_words(blockdevice_sim_eeprom_t* bd_eeprom, const uint8_t* data, uint32_t addr, uint32_t size,
+                             bool skip_unchanged)
+{
+    if(size == 0) return SUCCESS;
+    if(addr + size > bd_eeprom->size) return -ESIZE;
+
+    bd_eeprom->stats.program_calls++;
+    bd_eeprom->stats.bytes_requested += size;
+
+    while(size > 0)
+    {
+        // a word is programmed at once when the address is aligned, otherwise a single byte
+        uint32_t unit = ((addr % BLOCKDEVICE_SIM_EEPROM_WORD_SIZE) == 0 && size >= BLOCKDEVICE_SIM_EEPROM_WORD_SIZE) ?
+                        BLOCKDEVICE_SIM_EEPROM_WORD_SIZE : 1;
+
+        if(skip_unchanged && memcmp(bd_eeprom->buffer + addr, data, unit) == 0)
+        {
+            bd_eeprom->stats.bytes_skipped += unit;
+        }
+        else
+        {
+            memcpy(bd_eeprom->buffer + addr, data, unit);
+            wear_word(bd_eeprom, addr);
+            if(unit == 1)
+            {
+                bd_eeprom->stats.byte_programs++;
+                bd_eeprom->stats.program_time_us += bd_eeprom->byte_program_time_us;
+            }
+            else
+            {
+                bd_eeprom->stats.word_programs++;
+                bd_eeprom->stats.program_time_us += bd_eeprom->word_program_time_us;
+            }
+        }
+
+        addr += unit;
+        data += unit;
+        size -= unit;
+    }
+
+    return SUCCESS;
+}
+
+static error_t program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size)
+{
+    return program_words((blockdevice_sim_eeprom_t*)bd, data, addr, size, false);
+}
+
+static error_t program_changed(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size)
+{
+    return program_words((blockdevice_sim_eeprom_t*)bd, data, addr, size, true);
+}
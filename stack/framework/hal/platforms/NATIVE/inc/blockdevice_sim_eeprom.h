@@ -0,0 +1,61 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file blockdevice_sim_eeprom.h
+ *
+ *  \brief RAM blockdevice which models the program latency and the wear of an embedded EEPROM, so the time spent
+ *  programming and the write amplification of the stack can be measured on a PC.
+ *
+ *  Programming is done per aligned word where possible and per byte otherwise, like the STM32 EEPROM driver.
+ *  program() programs every word and byte, program_changed() skips the ones which already contain the data.
+ */
+
+#ifndef __BLOCKDEVICE_SIM_EEPROM_H_
+#define __BLOCKDEVICE_SIM_EEPROM_H_
+
+#include "hwblockdevice.h"
+
+#define BLOCKDEVICE_SIM_EEPROM_WORD_SIZE 4
+
+typedef struct {
+  uint32_t program_calls;
+  uint32_t bytes_requested;   // the number of bytes passed to program() and program_changed()
+  uint32_t word_programs;
+  uint32_t byte_programs;
+  uint32_t bytes_skipped;     // unchanged bytes which were not programmed by program_changed()
+  uint64_t program_time_us;   // the time the EEPROM was busy programming
+  uint32_t max_wear;          // the highest number of programs of a single word
+} blockdevice_sim_eeprom_stats_t;
+
+// extend blockdevice_t
+typedef struct {
+  blockdevice_t base;
+  uint32_t size;
+  uint8_t* buffer;
+  uint32_t* wear;             // the number of programs of every word, (size + 3) / 4 entries
+  uint32_t word_program_time_us;
+  uint32_t byte_program_time_us;
+  blockdevice_sim_eeprom_stats_t stats;
+} blockdevice_sim_eeprom_t;
+
+extern blockdevice_driver_t blockdevice_driver_sim_eeprom;
+
+/*! \brief Clear the statistics and the wear counters, for example to only measure the writes after booting */
+void blockdevice_sim_eeprom_reset_stats(blockdevice_sim_eeprom_t* bd);
+
+#endif //__BLOCKDEVICE_SIM_EEPROM_H_
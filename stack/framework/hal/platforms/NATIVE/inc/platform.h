@@ -21,9 +21,12 @@
 
 #include "platform_defs.h"
 
+#include "errors.h"
+
 #include "fs.h"
 #include "hwblockdevice.h"
 #include "blockdevice_ram.h"
+#include "blockdevice_sim_eeprom.h"
 
 #ifndef PLATFORM_NATIVE
     #error Mismatch between the configured platform and the actual platform. Expected PLATFORM_NATIVE to be defined
@@ -37,5 +40,33 @@ extern blockdevice_t * const volatile_blockdevice;
 #define PLATFORM_PERMANENT_BLOCKDEVICE persistent_files_blockdevice
 #define PLATFORM_VOLATILE_BLOCKDEVICE volatile_blockdevice
 
+/** UARTs are backed by a pseudo-terminal, returns the path of the slave side or NULL when not initialised */
+const char* native_uart_get_pty_name(uint8_t port_idx);
+
+/** Delivers data received on the UARTs to the RX handlers, waiting at most timeout_ms (-1 blocks). Returns true
+ *  when data was received. */
+bool native_uart_poll(int timeout_ms);
+
+// returns the command line arguments of the process, *count is set to the number of arguments
+char** native_get_args(int* count);
+
+/** The metadata and the permanent files are stored in a simulated EEPROM, see blockdevice_sim_eeprom.h. Copies the
+ *  statistics of both blockdevices, either pointer can be NULL. */
+void native_get_blockdevice_stats(blockdevice_sim_eeprom_stats_t* metadata_stats, blockdevice_sim_eeprom_stats_t* permanent_stats);
+
+/** Clears the statistics and the wear counters of the simulated EEPROMs, for example to only measure what follows the boot */
+void native_reset_blockdevice_stats(void);
+
+/** Delivers a frame to the stack as if it was received by the radio. The data is the frame as read from the radio
+ *  FIFO, so still PN9 and FEC coded. Returns EOFF when the radio is not in RX, ESIZE when the frame does not fit the
+ *  FIFO and ENOMEM when no packet could be allocated. */
+error_t native_radio_inject_frame(const uint8_t* data, uint16_t length, int16_t rssi, uint8_t lqi);
+
+/** The HW timer only advances when requested, starting from 0. Advancing delivers the timer interrupts which become
+ *  due, each followed by running the tasks they posted. */
+void native_timer_advance(uint64_t ticks);
+uint64_t native_timer_get_ticks(void);
+uint32_t native_timer_get_ticks_per_sec(void);
+
 #endif
 
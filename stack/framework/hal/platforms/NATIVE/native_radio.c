@@ -0,0 +1,216 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_radio.c
+ *
+ *  \brief Radio driver for the NATIVE platform, without a medium
+ *
+ *  This allows running the complete stack on the host, for benchmarks and tools. The radio only keeps its state:
+ *  transmitted frames are dropped, the transmission completes immediately (from a task, like the TX done interrupt
+ *  of a real transceiver). Refills are not requested, so background advertising ends after the first chunk. Frames
+ *  are only received when injected by the application using native_radio_inject_frame(), for example to replay a
+ *  capture. Use the NATIVE_SIM platform to simulate a network.
+ */
+
+#include <string.h>
+
+#include "hwradio.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "debug.h"
+#include "errors.h"
+#include "platform.h"
+
+// the size of the FIFO of a typical transceiver, the frames are still coded
+#define MAX_FRAME_SIZE 255
+
+static hwradio_init_args_t callbacks;
+static hw_radio_state_t opmode = HW_STATE_OFF;
+static bool preloading_enabled = false;
+static bool preloaded = false;
+
+static void tx_done(void* arg)
+{
+    if(opmode != HW_STATE_TX)
+        return; // aborted
+
+    opmode = HW_STATE_STANDBY;
+    callbacks.tx_packet_cb(timer_get_counter_value());
+}
+
+static void start_tx(void)
+{
+    opmode = HW_STATE_TX;
+    sched_post_task(&tx_done);
+}
+
+error_t native_radio_inject_frame(const uint8_t* data, uint16_t length, int16_t rssi, uint8_t lqi)
+{
+    if(opmode != HW_STATE_RX)
+        return EOFF;
+
+    if(length == 0 || length > MAX_FRAME_SIZE)
+        return ESIZE;
+
+    hw_radio_packet_t* packet = callbacks.alloc_packet_cb(length);
+    if(packet == NULL)
+        return ENOMEM;
+
+    memcpy(packet->data, data, length);
+    packet->length = length;
+    packet->rx_meta.timestamp = timer_get_counter_value();
+    packet->rx_meta.rssi = rssi;
+    packet->rx_meta.lqi = lqi;
+    packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+    callbacks.rx_packet_cb(packet);
+    return SUCCESS;
+}
+
+error_t hw_radio_init(hwradio_init_args_t* init_args)
+{
+    if(init_args == NULL || init_args->alloc_packet_cb == NULL || init_args->release_packet_cb == NULL
+       || init_args->rx_packet_cb == NULL || init_args->tx_packet_cb == NULL)
+        return EINVAL;
+
+    callbacks = *init_args;
+    opmode = HW_STATE_SLEEP;
+    sched_register_task(&tx_done);
+    return SUCCESS;
+}
+
+void hw_radio_stop(void)
+{
+    hw_radio_set_idle();
+}
+
+error_t hw_radio_set_idle(void)
+{
+    hw_radio_set_opmode(HW_STATE_SLEEP);
+    return SUCCESS;
+}
+
+bool hw_radio_is_idle(void)
+{
+    return opmode == HW_STATE_SLEEP || opmode == HW_STATE_OFF;
+}
+
+bool hw_radio_is_rx(void)
+{
+    return opmode == HW_STATE_RX;
+}
+
+bool hw_radio_tx_busy(void)
+{
+    return opmode == HW_STATE_TX;
+}
+
+bool hw_radio_rx_busy(void)
+{
+    return false;
+}
+
+bool hw_radio_rssi_valid(void)
+{
+    return true;
+}
+
+int16_t hw_radio_get_rssi(void)
+{
+    return -140; // the channel is always free
+}
+
+hw_radio_state_t hw_radio_get_opmode(void)
+{
+    return opmode;
+}
+
+void hw_radio_set_opmode(hw_radio_state_t new_opmode)
+{
+    switch(new_opmode)
+    {
+        case HW_STATE_TX:
+            if(opmode != HW_STATE_TX && preloaded)
+            {
+                preloaded = false;
+                start_tx();
+            }
+            break;
+        case HW_STATE_RX:
+        case HW_STATE_IDLE:
+            opmode = HW_STATE_RX;
+            break;
+        case HW_STATE_STANDBY:
+            opmode = HW_STATE_STANDBY;
+            break;
+        case HW_STATE_OFF:
+        case HW_STATE_SLEEP:
+        case HW_STATE_RESET:
+            opmode = HW_STATE_SLEEP;
+            break;
+    }
+}
+
+error_t hw_radio_send_payload(uint8_t* data, uint16_t len)
+{
+    if(len == 0)
+        return ESIZE;
+
+    if(opmode == HW_STATE_TX)
+        return SUCCESS; // refill, dropped as well
+
+    if(preloading_enabled)
+    {
+        // transmitted on the next switch to TX
+        preloaded = true;
+        preloading_enabled = false;
+        return SUCCESS;
+    }
+
+    start_tx();
+    return SUCCESS;
+}
+
+void hw_radio_enable_preloading(bool enable)
+{
+    preloading_enabled = enable;
+}
+
+// settings which do not influence a radio without a medium
+void hw_radio_enable_refill(bool enable) {}
+void hw_radio_set_center_freq(uint32_t center_freq) {}
+void hw_radio_set_bitrate(uint32_t bps) {}
+void hw_radio_set_rx_bw_hz(uint32_t bw_hz) {}
+void hw_radio_set_rssi_config(uint8_t rssi_smoothing, uint8_t rssi_offset) {}
+void hw_radio_set_preamble_size(uint16_t size) {}
+void hw_radio_set_sync_word(uint8_t* sync_word, uint8_t sync_size) {}
+void hw_radio_set_payload_length(uint16_t length) {}
+void hw_radio_set_tx_power(int8_t eirp) {}
+void hw_radio_set_rx_timeout(uint32_t timeout) {}
+void hw_radio_switch_longRangeMode(bool use_lora) {}
+void hw_radio_set_tx_fdev(uint32_t fdev) {}
+void hw_radio_set_preamble_detector(uint8_t preamble_detector_size, uint8_t preamble_tol) {}
+void hw_radio_set_modulation_shaping(uint8_t shaping) {}
+void hw_radio_set_preamble_polarity(uint8_t polarity) {}
+void hw_radio_set_rssi_threshold(uint8_t rssi_thr) {}
+void hw_radio_set_rssi_smoothing(uint8_t rssi_samples) {}
+void hw_radio_set_sync_word_size(uint8_t sync_size) {}
+void hw_radio_set_sync_on(uint8_t enable) {}
+void hw_radio_set_preamble_detect_on(uint8_t enable) {}
+void hw_radio_set_dc_free(uint8_t scheme) {}
+void hw_radio_set_crc_on(uint8_t enable) {}
+void hw_radio_set_lora_mode(uint32_t lora_bw, uint8_t lora_SF) {}
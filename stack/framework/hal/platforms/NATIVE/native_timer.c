@@ -0,0 +1,168 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_timer.c
+ *
+ *  \brief Virtual time implementation of the HW timer API for the NATIVE platform
+ *
+ *  The counter only advances when the application calls native_timer_advance(), so by default the time stays 0 and
+ *  timers never fire, which keeps tests and benchmarks deterministic. Tools which need the protocol timers to run,
+ *  like the capture replay, advance the time explicitly: the compare and overflow interrupts which are due are
+ *  delivered in order, each followed by the tasks they posted.
+ */
+
+#include "hwtimer.h"
+#include "scheduler.h"
+#include "errors.h"
+#include "debug.h"
+#include "platform.h"
+
+#define COUNTER_RANGE 0x10000
+
+static const hwtimer_info_t timer_info = {
+    .min_delay_ticks = 1,
+};
+
+static bool initialised = false;
+static uint32_t ticks_per_sec;
+static uint64_t counter = 0;
+static bool compare_armed = false;
+static uint64_t compare_at;
+static uint64_t overflows_delivered = 0;
+static timer_callback_t compare_callback;
+static timer_callback_t overflow_callback;
+
+error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_cb, timer_callback_t overflow_cb)
+{
+    if(timer_id != 0)
+        return ESIZE;
+
+    if(initialised)
+        return EALREADY;
+
+    if(frequency != HWTIMER_FREQ_1MS && frequency != HWTIMER_FREQ_32K)
+        return EINVAL;
+
+    initialised = true;
+    ticks_per_sec = (frequency == HWTIMER_FREQ_1MS) ? HWTIMER_TICKS_1MS : HWTIMER_TICKS_32K;
+    compare_callback = compare_cb;
+    overflow_callback = overflow_cb;
+    return SUCCESS;
+}
+
+const hwtimer_info_t* hw_timer_get_info(hwtimer_id_t timer_id)
+{
+    if(timer_id != 0)
+        return NULL;
+
+    return &timer_info;
+}
+
+hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id)
+{
+    return (hwtimer_tick_t)counter;
+}
+
+error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick)
+{
+    if(timer_id != 0)
+        return ESIZE;
+
+    if(!initialised)
+        return EOFF;
+
+    // like a HW comparator: fire the next time the counter reaches 'tick', after a full loop if it equals the counter now
+    uint32_t delay = (hwtimer_tick_t)(tick - (hwtimer_tick_t)counter);
+    if(delay == 0)
+        delay = COUNTER_RANGE;
+
+    compare_at = counter + delay;
+    compare_armed = true;
+    return SUCCESS;
+}
+
+error_t hw_timer_cancel(hwtimer_id_t timer_id)
+{
+    if(timer_id != 0)
+        return ESIZE;
+
+    if(!initialised)
+        return EOFF;
+
+    compare_armed = false;
+    return SUCCESS;
+}
+
+error_t hw_timer_counter_reset(hwtimer_id_t timer_id)
+{
+    // not supported: the overflows are aligned to the start of the counter
+    return EINVAL;
+}
+
+bool hw_timer_is_overflow_pending(hwtimer_id_t timer_id)
+{
+    return counter / COUNTER_RANGE > overflows_delivered;
+}
+
+bool hw_timer_is_interrupt_pending(hwtimer_id_t timer_id)
+{
+    // interrupts are delivered by native_timer_advance(), they are never pending while the application executes
+    return false;
+}
+
+uint32_t native_timer_get_ticks_per_sec(void)
+{
+    return ticks_per_sec;
+}
+
+uint64_t native_timer_get_ticks(void)
+{
+    return counter;
+}
+
+void native_timer_advance(uint64_t ticks)
+{
+    assert(initialised);
+    uint64_t target = counter + ticks;
+    while(true)
+    {
+        uint64_t next_overflow = (overflows_delivered + 1) * COUNTER_RANGE;
+        bool is_compare = compare_armed && compare_at < next_overflow;
+        uint64_t next = is_compare ? compare_at : next_overflow;
+        if(next > target)
+            break;
+
+        counter = next;
+        if(is_compare)
+        {
+            compare_armed = false; // the timer only fires once
+            if(compare_callback)
+                compare_callback();
+        }
+        else
+        {
+            overflows_delivered++;
+            if(overflow_callback)
+                overflow_callback();
+        }
+
+        scheduler_run_pending_tasks();
+    }
+
+    counter = target;
+}
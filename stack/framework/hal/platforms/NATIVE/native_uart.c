@@ -0,0 +1,192 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// UART driver for the NATIVE platform, backed by a pseudo-terminal per port. The slave side of the pty can be
+// opened by a host program (or by a test) to exchange data with the stack. Received data is delivered from
+// native_uart_poll(), which is called when the scheduler has nothing left to do and so plays the role of the
+// RX interrupt.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+
+#include "hwuart.h"
+#include "platform.h"
+#include "hal_defs.h"
+#include "debug.h"
+#include "errors.h"
+
+#define UART_COUNT 2
+
+// private definition of the UART handle, passed around publicly as a pointer
+struct uart_handle {
+  int master_fd;
+  int slave_fd; // kept open so reads on the master do not fail while no peer has the slave opened
+  char slave_name[64];
+  bool rx_enabled;
+  uart_rx_inthandler_t rx_cb;
+  uart_rx_block_handler_t rx_block_cb;
+};
+
+static uart_handle_t handle[UART_COUNT] = {
+  { .master_fd = -1, .slave_fd = -1 },
+  { .master_fd = -1, .slave_fd = -1 }
+};
+
+uart_handle_t* uart_init(uint8_t port_idx, uint32_t baudrate, uint8_t pins)
+{
+  assert(port_idx < UART_COUNT);
+  uart_handle_t* uart = &handle[port_idx];
+  if(uart->master_fd >= 0)
+    return uart;
+
+  uart->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  assert(uart->master_fd >= 0);
+  assert(grantpt(uart->master_fd) == 0);
+  assert(unlockpt(uart->master_fd) == 0);
+  assert(fcntl(uart->master_fd, F_SETFL, fcntl(uart->master_fd, F_GETFL) | O_NONBLOCK) == 0);
+
+  strncpy(uart->slave_name, ptsname(uart->master_fd), sizeof(uart->slave_name) - 1);
+  uart->slave_fd = open(uart->slave_name, O_RDWR | O_NOCTTY);
+  assert(uart->slave_fd >= 0);
+
+  // binary data, no echo or line editing
+  struct termios tio;
+  assert(tcgetattr(uart->slave_fd, &tio) == 0);
+  cfmakeraw(&tio);
+  assert(tcsetattr(uart->slave_fd, TCSANOW, &tio) == 0);
+
+  uart->rx_enabled = false;
+  uart->rx_cb = NULL;
+  uart->rx_block_cb = NULL;
+  fprintf(stderr, "uart %i available on %s\n", port_idx, uart->slave_name);
+  return uart;
+}
+
+bool uart_enable(uart_handle_t* uart) { return true; }
+
+bool uart_disable(uart_handle_t* uart) { return true; }
+
+bool uart_get_rx_port_state(uart_handle_t* uart) { return true; }
+
+void uart_send_bytes(uart_handle_t* uart, void const *data, size_t length)
+{
+  uint8_t const* bytes = data;
+  while(length > 0)
+  {
+    ssize_t written = write(uart->master_fd, bytes, length);
+    if(written < 0)
+    {
+      assert(errno == EAGAIN);
+      struct pollfd fd = { .fd = uart->master_fd, .events = POLLOUT };
+      poll(&fd, 1, -1);
+      continue;
+    }
+
+    bytes += written;
+    length -= written;
+  }
+}
+
+void uart_send_byte(uart_handle_t* uart, uint8_t data)
+{
+  uart_send_bytes(uart, &data, 1);
+}
+
+void uart_send_string(uart_handle_t* uart, const char *string)
+{
+  uart_send_bytes(uart, string, strlen(string));
+}
+
+error_t uart_rx_interrupt_enable(uart_handle_t* uart)
+{
+  if(uart->rx_cb == NULL && uart->rx_block_cb == NULL) { return EOFF; }
+
+  uart->rx_enabled = true;
+  return SUCCESS;
+}
+
+void uart_rx_interrupt_disable(uart_handle_t* uart)
+{
+  uart->rx_enabled = false;
+}
+
+void uart_set_rx_interrupt_callback(uart_handle_t* uart, uart_rx_inthandler_t rx_handler)
+{
+  uart->rx_cb = rx_handler;
+  uart->rx_block_cb = NULL;
+}
+
+void uart_set_rx_block_callback(uart_handle_t* uart, uart_rx_block_handler_t rx_handler)
+{
+  uart->rx_block_cb = rx_handler;
+  uart->rx_cb = NULL;
+}
+
+const char* native_uart_get_pty_name(uint8_t port_idx)
+{
+  assert(port_idx < UART_COUNT);
+  return handle[port_idx].master_fd >= 0 ? handle[port_idx].slave_name : NULL;
+}
+
+bool native_uart_poll(int timeout_ms)
+{
+  struct pollfd fds[UART_COUNT];
+  uart_handle_t* uarts[UART_COUNT];
+  uint8_t count = 0;
+  for(uint8_t i = 0; i < UART_COUNT; i++)
+  {
+    if(handle[i].master_fd >= 0 && handle[i].rx_enabled)
+    {
+      fds[count] = (struct pollfd){ .fd = handle[i].master_fd, .events = POLLIN };
+      uarts[count] = &handle[i];
+      count++;
+    }
+  }
+
+  if(count == 0 || poll(fds, count, timeout_ms) <= 0)
+    return false;
+
+  // deliver at most one block per UART, the consumers get the chance to process it before the next poll
+  bool received = false;
+  for(uint8_t i = 0; i < count; i++)
+  {
+    if(!(fds[i].revents & POLLIN))
+      continue;
+
+    uint8_t block[HAL_UART_RX_BLOCK_THRESHOLD];
+    ssize_t length = read(uarts[i]->master_fd, block, sizeof(block));
+    if(length <= 0)
+      continue;
+
+    received = true;
+    if(uarts[i]->rx_block_cb != NULL)
+      uarts[i]->rx_block_cb(block, length);
+    else
+      for(ssize_t j = 0; j < length; j++)
+        uarts[i]->rx_cb(block[j]);
+  }
+
+  return received;
+}
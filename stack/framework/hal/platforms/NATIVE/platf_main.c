@@ -16,6 +16,8 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+
 #include "bootstrap.h"
 #include "hwgpio.h"
 #include "hwleds.h"
@@ -24,27 +26,45 @@
 #include "hwdebug.h"
 #include "hwradio.h"
 #include "hwuart.h"
+#include "hwwatchdog.h"
 #include "errors.h"
 #include "blockdevice_ram.h"
+#include "blockdevice_sim_eeprom.h"
 #include "framework_defs.h"
+#include "platform.h"
 
 #define METADATA_SIZE (4 + 4 + (12 * FRAMEWORK_FS_FILE_COUNT))
 
-// on native we use a RAM blockdevice as NVM as well for now
+// on native the NVM is simulated in RAM, the metadata and the permanent files are stored in a simulated EEPROM
+// to be able to measure the time spent programming and the wear
 extern uint8_t d7ap_fs_metadata[METADATA_SIZE];
 extern uint8_t d7ap_files_data[FRAMEWORK_FS_PERMANENT_STORAGE_SIZE];
 extern uint8_t d7ap_volatile_files_data[FRAMEWORK_FS_VOLATILE_STORAGE_SIZE];
 
-static blockdevice_ram_t metadata_bd = (blockdevice_ram_t){
-    .base.driver = &blockdevice_driver_ram,
+#define WEAR_SIZE(size) (((size) + BLOCKDEVICE_SIM_EEPROM_WORD_SIZE - 1) / BLOCKDEVICE_SIM_EEPROM_WORD_SIZE)
+
+static uint32_t metadata_wear[WEAR_SIZE(METADATA_SIZE)];
+static uint32_t permanent_wear[WEAR_SIZE(FRAMEWORK_FS_PERMANENT_STORAGE_SIZE)];
+
+// programming a byte or a word of the STM32L0 data EEPROM takes 3.2 ms (erase and program)
+#define EEPROM_PROGRAM_TIME_US 3200
+
+static blockdevice_sim_eeprom_t metadata_bd = (blockdevice_sim_eeprom_t){
+    .base.driver = &blockdevice_driver_sim_eeprom,
     .size = METADATA_SIZE,
-    .buffer = d7ap_fs_metadata
+    .buffer = d7ap_fs_metadata,
+    .wear = metadata_wear,
+    .word_program_time_us = EEPROM_PROGRAM_TIME_US,
+    .byte_program_time_us = EEPROM_PROGRAM_TIME_US
 };
 
-static blockdevice_ram_t permanent_bd = (blockdevice_ram_t){
-    .base.driver = &blockdevice_driver_ram,
+static blockdevice_sim_eeprom_t permanent_bd = (blockdevice_sim_eeprom_t){
+    .base.driver = &blockdevice_driver_sim_eeprom,
     .size = FRAMEWORK_FS_PERMANENT_STORAGE_SIZE,
-    .buffer = d7ap_files_data
+    .buffer = d7ap_files_data,
+    .wear = permanent_wear,
+    .word_program_time_us = EEPROM_PROGRAM_TIME_US,
+    .byte_program_time_us = EEPROM_PROGRAM_TIME_US
 };
 
 static blockdevice_ram_t volatile_bd = (blockdevice_ram_t){
@@ -69,8 +89,36 @@ void __platform_post_framework_init()
 {
 }
 
-int main()
+void native_get_blockdevice_stats(blockdevice_sim_eeprom_stats_t* metadata_stats, blockdevice_sim_eeprom_stats_t* permanent_stats)
+{
+    if(metadata_stats)
+        *metadata_stats = metadata_bd.stats;
+
+    if(permanent_stats)
+        *permanent_stats = permanent_bd.stats;
+}
+
+void native_reset_blockdevice_stats()
+{
+    blockdevice_sim_eeprom_reset_stats(&metadata_bd);
+    blockdevice_sim_eeprom_reset_stats(&permanent_bd);
+}
+
+static int argc;
+static char** argv;
+
+char** native_get_args(int* count)
 {
+    *count = argc;
+    return argv;
+}
+
+int main(int process_argc, char* process_argv[])
+{
+    // kept for applications which take options on the host
+    argc = process_argc;
+    argv = process_argv;
+
     //initialise the platform itself
     __platform_init();
     //do not initialise the scheduler, this is done by __framework_bootstrap()
@@ -83,21 +131,15 @@ int main()
 }
 
 // empty stubs
-__LINK_C uart_handle_t* uart_init(uint8_t port_idx, uint32_t baudrate, uint8_t pins) {}
-__LINK_C bool uart_enable(uart_handle_t* uart) {}
-__LINK_C bool uart_disable(uart_handle_t* uart) {}
-__LINK_C void uart_send_bytes(uart_handle_t* uart, void const *data, size_t length) {}
-__LINK_C error_t uart_rx_interrupt_enable(uart_handle_t* uart) {}
-__LINK_C void uart_set_rx_interrupt_callback(uart_handle_t* uart, uart_rx_inthandler_t rx_handler) {}
 __LINK_C error_t hw_gpio_set(pin_id_t pin_id) {}
 system_reboot_reason_t hw_system_reboot_reason(void) {}
-__LINK_C void hw_enter_lowpower_mode(uint8_t mode) {}
-__LINK_C hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id) {}
-__LINK_C const hwtimer_info_t* hw_timer_get_info(hwtimer_id_t timer_id) {}
-__LINK_C error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick ) {}
-__LINK_C error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_callback, timer_callback_t overflow_callback) {}
-__LINK_C bool hw_timer_is_overflow_pending(hwtimer_id_t id) {}
-__LINK_C error_t hw_timer_cancel(hwtimer_id_t timer_id) {}
+// sleep until data is received on one of the UARTs, which is the only source of interrupts on this platform
+__LINK_C void hw_enter_lowpower_mode(uint8_t mode) { native_uart_poll(-1); }
+__LINK_C void __watchdog_init(void) {}
+__LINK_C void hw_watchdog_feed(void) {}
+__LINK_C uint8_t hw_watchdog_get_timeout(void) { return 0; }
 __LINK_C uint64_t hw_get_unique_id(void) { return 0xFFFFFFFFFFFFFF;}
+__LINK_C void hw_busy_wait(int16_t microseconds) { usleep(microseconds); }
+__LINK_C void hw_reset(void) { assert(false); }
 
 
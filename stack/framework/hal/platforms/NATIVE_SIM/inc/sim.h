@@ -0,0 +1,84 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sim.h
+ * \addtogroup NATIVE_SIM
+ * \ingroup platforms
+ * @{
+ * \brief Discrete event simulation of a network of nodes running the full stack
+ *
+ * All nodes are linked into one process. Before any code of a node runs, the engine selects the node
+ * using set_node_global_id(), so all state declared using NGDEF() is private to that node.
+ * Time is virtual: code executes in zero time and the clock only advances from one event to the next.
+ * Events of different nodes at the same time are executed in the order they were scheduled, which
+ * makes a simulation run fully reproducible for a given seed.
+ */
+
+#ifndef __SIM_H_
+#define __SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "link_c.h"
+
+typedef void (*sim_event_handler_t)(uint32_t arg);
+
+typedef struct
+{
+    uint16_t node_count;            /**< Number of nodes, node 0 is placed in the center of the area */
+    uint32_t duration_s;            /**< Simulated time after which the simulation stops */
+    uint32_t seed;                  /**< Seed for the RNG used by the simulator and the nodes */
+    float area_size_m;              /**< The other nodes are placed randomly in a square with this side */
+    float path_loss_1m_db;          /**< Path loss at 1 meter distance */
+    float path_loss_exponent;       /**< Exponent of the log-distance path loss model */
+    float shadowing_sigma_db;       /**< Standard deviation of the (fixed, symmetric) shadowing of each link */
+    int16_t noise_floor_dbm;        /**< Thermal noise, the energy measured on an idle channel */
+    int16_t sensitivity_dbm;        /**< Minimum signal level needed to detect a sync word */
+    uint8_t capture_threshold_db;   /**< Minimum SINR for a frame to survive interference */
+} sim_config_t;
+
+extern sim_config_t sim_config;
+
+/*! \brief The current virtual time in microseconds since the start of the simulation */
+__LINK_C uint64_t sim_get_time_us(void);
+
+/*! \brief Schedule an event
+ *
+ * The handler is called at the given (absolute) time with the given node selected. After the
+ * handler returns, the tasks which became pending on that node are executed.
+ * Events can not be cancelled, handlers are expected to ignore stale events (for example
+ * by passing a generation counter as argument).
+ */
+__LINK_C void sim_schedule_event(uint64_t time_us, uint16_t node, sim_event_handler_t handler, uint32_t arg);
+
+/*! \brief Process events in chronological order until no events are left or the configured duration passed */
+__LINK_C void sim_run(void);
+
+/*! \brief Place the nodes and calculate the link budget and propagation delay of every link */
+__LINK_C void sim_radio_setup(void);
+
+/*! \brief Print the statistics of the simulated medium and of the radio of each node */
+__LINK_C void sim_radio_print_stats(void);
+
+/*! \brief Allocate and initialise the storage of all nodes with the default file system content */
+__LINK_C void sim_blockdevice_setup(void);
+
+#endif
+
+/** @}*/
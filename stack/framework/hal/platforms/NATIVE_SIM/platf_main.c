@@ -0,0 +1,139 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bootstrap.h"
+#include "hwgpio.h"
+#include "hwsystem.h"
+#include "hwuart.h"
+#include "hwwatchdog.h"
+#include "errors.h"
+#include "debug.h"
+#include "ng.h"
+#include "platform.h"
+#include "sim.h"
+
+// all nodes get the same UID prefix, the last byte is the node id
+#define SIM_UID_BASE 0xAA00000000000000ULL
+
+sim_config_t sim_config = {
+    .node_count = 10,
+    .duration_s = 600,
+    .seed = 1,
+    .area_size_m = 300,
+    .path_loss_1m_db = 31.5,
+    .path_loss_exponent = 3.0,
+    .shadowing_sigma_db = 4.0,
+    .noise_floor_dbm = -115,
+    .sensitivity_dbm = -100,
+    .capture_threshold_db = 8,
+};
+
+// the nodes do not boot at the same time, like in a real deployment
+#define BOOT_SPREAD_US 1000000
+
+void __platform_init()
+{
+    blockdevice_init(metadata_blockdevice);
+    blockdevice_init(persistent_files_blockdevice);
+    blockdevice_init(volatile_blockdevice);
+}
+
+void __platform_post_framework_init()
+{
+}
+
+static void boot_node(uint32_t arg)
+{
+    __platform_init();
+    __framework_bootstrap();
+    __platform_post_framework_init();
+}
+
+static void usage(const char* name)
+{
+    printf("usage: %s [-n nodes] [-t duration_s] [-s seed] [-a area_size_m] [-e path_loss_exponent]\n", name);
+    printf("          [-d shadowing_sigma_db] [-c capture_threshold_db]\n");
+}
+
+static void parse_arguments(int argc, char** argv)
+{
+    int opt;
+    while((opt = getopt(argc, argv, "n:t:s:a:e:d:c:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n': sim_config.node_count = atoi(optarg); break;
+            case 't': sim_config.duration_s = atoi(optarg); break;
+            case 's': sim_config.seed = strtoul(optarg, NULL, 0); break;
+            case 'a': sim_config.area_size_m = atof(optarg); break;
+            case 'e': sim_config.path_loss_exponent = atof(optarg); break;
+            case 'd': sim_config.shadowing_sigma_db = atof(optarg); break;
+            case 'c': sim_config.capture_threshold_db = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+
+    if(sim_config.node_count == 0 || sim_config.node_count > NODE_GLOBALS_MAX_NODES)
+    {
+        printf("the number of nodes should be between 1 and %d (PLATFORM_NATIVE_SIM_MAX_NODES)\n", NODE_GLOBALS_MAX_NODES);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    parse_arguments(argc, argv);
+    printf("simulating %u nodes during %u s (seed %u)\n", sim_config.node_count, sim_config.duration_s, sim_config.seed);
+
+    srand(sim_config.seed);
+    sim_blockdevice_setup();
+    sim_radio_setup();
+
+    for(uint16_t node = 0; node < sim_config.node_count; node++)
+        sim_schedule_event(rand() % BOOT_SPREAD_US, node, &boot_node, 0);
+
+    sim_run();
+    sim_radio_print_stats();
+    return 0;
+}
+
+uint64_t hw_get_unique_id(void)
+{
+    return SIM_UID_BASE | get_node_global_id();
+}
+
+// empty stubs
+__LINK_C uart_handle_t* uart_init(uint8_t port_idx, uint32_t baudrate, uint8_t pins) { return NULL; }
+__LINK_C bool uart_enable(uart_handle_t* uart) { return true; }
+__LINK_C bool uart_disable(uart_handle_t* uart) { return true; }
+__LINK_C void uart_send_bytes(uart_handle_t* uart, void const *data, size_t length) {}
+__LINK_C error_t uart_rx_interrupt_enable(uart_handle_t* uart) { return SUCCESS; }
+__LINK_C void uart_set_rx_interrupt_callback(uart_handle_t* uart, uart_rx_inthandler_t rx_handler) {}
+__LINK_C error_t hw_gpio_set(pin_id_t pin_id) { return SUCCESS; }
+system_reboot_reason_t hw_system_reboot_reason(void) { return REBOOT_REASON_POR; }
+__LINK_C void hw_enter_lowpower_mode(uint8_t mode) {}
+__LINK_C void __watchdog_init(void) {}
+__LINK_C void hw_watchdog_feed(void) {}
+__LINK_C uint8_t hw_watchdog_get_timeout(void) { return 0; }
+__LINK_C void hw_reset(void) { assert(false); }
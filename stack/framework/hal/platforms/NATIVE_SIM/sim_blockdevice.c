@@ -0,0 +1,125 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sim_blockdevice.c
+ *
+ *  \brief RAM blockdevices for the NATIVE_SIM platform, each node accesses its own copy of the storage
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "sim.h"
+#include "ng.h"
+#include "debug.h"
+#include "errors.h"
+#include "framework_defs.h"
+
+#define METADATA_SIZE (4 + 4 + (12 * FRAMEWORK_FS_FILE_COUNT))
+
+// default content of the file system, generated by the d7ap_fs module
+extern uint8_t d7ap_fs_metadata[METADATA_SIZE];
+extern uint8_t d7ap_files_data[FRAMEWORK_FS_PERMANENT_STORAGE_SIZE];
+extern uint8_t d7ap_volatile_files_data[FRAMEWORK_FS_VOLATILE_STORAGE_SIZE];
+
+// extend blockdevice_t
+typedef struct {
+  blockdevice_t base;
+  uint32_t size;
+  const uint8_t* initial_data;
+  uint8_t* buffers; // one buffer of 'size' bytes for every node
+} blockdevice_sim_t;
+
+static void init(blockdevice_t* bd);
+static error_t read(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size);
+static error_t program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
+
+static blockdevice_driver_t blockdevice_driver_sim = {
+    .init = init,
+    .read = read,
+    .program = program,
+    .program_changed = program, // comparing is not cheaper than copying
+};
+
+static blockdevice_sim_t metadata_bd = (blockdevice_sim_t){
+    .base.driver = &blockdevice_driver_sim,
+    .size = METADATA_SIZE,
+    .initial_data = d7ap_fs_metadata
+};
+
+static blockdevice_sim_t permanent_bd = (blockdevice_sim_t){
+    .base.driver = &blockdevice_driver_sim,
+    .size = FRAMEWORK_FS_PERMANENT_STORAGE_SIZE,
+    .initial_data = d7ap_files_data
+};
+
+static blockdevice_sim_t volatile_bd = (blockdevice_sim_t){
+    .base.driver = &blockdevice_driver_sim,
+    .size = FRAMEWORK_FS_VOLATILE_STORAGE_SIZE,
+    .initial_data = d7ap_volatile_files_data
+};
+
+blockdevice_t * const metadata_blockdevice = (blockdevice_t* const) &metadata_bd;
+blockdevice_t * const persistent_files_blockdevice = (blockdevice_t* const) &permanent_bd;
+blockdevice_t * const volatile_blockdevice = (blockdevice_t* const) &volatile_bd;
+
+static void setup(blockdevice_sim_t* bd_sim)
+{
+    bd_sim->buffers = malloc(bd_sim->size * sim_config.node_count);
+    assert(bd_sim->buffers != NULL);
+    for(uint16_t node = 0; node < sim_config.node_count; node++)
+        memcpy(bd_sim->buffers + node * bd_sim->size, bd_sim->initial_data, bd_sim->size);
+}
+
+void sim_blockdevice_setup(void)
+{
+    setup(&metadata_bd);
+    setup(&permanent_bd);
+    setup(&volatile_bd);
+}
+
+static uint8_t* get_node_buffer(blockdevice_sim_t* bd_sim)
+{
+    return bd_sim->buffers + get_node_global_id() * bd_sim->size;
+}
+
+static void init(blockdevice_t* bd)
+{
+    assert(((blockdevice_sim_t*)bd)->buffers != NULL);
+}
+
+static error_t read(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size)
+{
+    blockdevice_sim_t* bd_sim = (blockdevice_sim_t*)bd;
+    if(size == 0) return SUCCESS;
+    if(addr + size > bd_sim->size) return -ESIZE;
+
+    memcpy(data, get_node_buffer(bd_sim) + addr, size);
+    return SUCCESS;
+}
+
+static error_t program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size)
+{
+    blockdevice_sim_t* bd_sim = (blockdevice_sim_t*)bd;
+    if(size == 0) return SUCCESS;
+    if(addr + size > bd_sim->size) return -ESIZE;
+
+    memcpy(get_node_buffer(bd_sim) + addr, data, size);
+    return SUCCESS;
+}
@@ -0,0 +1,138 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sim_engine.c
+ *
+ *  \brief Event queue and virtual clock of the NATIVE_SIM platform
+ *
+ */
+
+#include <stdlib.h>
+
+#include "sim.h"
+#include "ng.h"
+#include "scheduler.h"
+#include "debug.h"
+
+typedef struct
+{
+    uint64_t time_us;
+    uint32_t seq;       // keeps events at the same time in scheduling order
+    uint16_t node;
+    sim_event_handler_t handler;
+    uint32_t arg;
+} sim_event_t;
+
+// binary min-heap ordered on (time_us, seq)
+static sim_event_t* events = NULL;
+static uint32_t events_size = 0;
+static uint32_t events_capacity = 0;
+static uint32_t next_seq = 0;
+static uint64_t now_us = 0;
+
+static inline bool is_before(const sim_event_t* a, const sim_event_t* b)
+{
+    if(a->time_us != b->time_us)
+        return a->time_us < b->time_us;
+
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static void swap_events(uint32_t a, uint32_t b)
+{
+    sim_event_t tmp = events[a];
+    events[a] = events[b];
+    events[b] = tmp;
+}
+
+uint64_t sim_get_time_us(void)
+{
+    return now_us;
+}
+
+void sim_schedule_event(uint64_t time_us, uint16_t node, sim_event_handler_t handler, uint32_t arg)
+{
+    assert(time_us >= now_us);
+    assert(node < sim_config.node_count);
+
+    if(events_size == events_capacity)
+    {
+        events_capacity = events_capacity ? events_capacity * 2 : 256;
+        events = realloc(events, events_capacity * sizeof(sim_event_t));
+        assert(events != NULL);
+    }
+
+    uint32_t pos = events_size++;
+    events[pos] = (sim_event_t){
+        .time_us = time_us,
+        .seq = next_seq++,
+        .node = node,
+        .handler = handler,
+        .arg = arg
+    };
+
+    while(pos > 0 && is_before(&events[pos], &events[(pos - 1) / 2]))
+    {
+        swap_events(pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+}
+
+static sim_event_t pop_event(void)
+{
+    sim_event_t first = events[0];
+    events[0] = events[--events_size];
+
+    uint32_t pos = 0;
+    while(true)
+    {
+        uint32_t smallest = pos;
+        uint32_t left = 2 * pos + 1;
+        uint32_t right = left + 1;
+        if(left < events_size && is_before(&events[left], &events[smallest]))
+            smallest = left;
+
+        if(right < events_size && is_before(&events[right], &events[smallest]))
+            smallest = right;
+
+        if(smallest == pos)
+            break;
+
+        swap_events(pos, smallest);
+        pos = smallest;
+    }
+
+    return first;
+}
+
+void sim_run(void)
+{
+    uint64_t end_us = (uint64_t)sim_config.duration_s * 1000000;
+
+    while(events_size > 0 && events[0].time_us <= end_us)
+    {
+        sim_event_t event = pop_event();
+        now_us = event.time_us;
+        set_node_global_id(event.node);
+        event.handler(event.arg);
+        // run everything the event made pending, the node goes back to sleep afterwards
+        scheduler_run_pending_tasks();
+    }
+
+    now_us = end_us;
+}
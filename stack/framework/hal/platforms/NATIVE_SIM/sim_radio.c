@@ -0,0 +1,832 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sim_radio.c
+ *
+ *  \brief Simulated radio and shared wireless medium of the NATIVE_SIM platform
+ *
+ *  The driver follows the behaviour of the sx127x driver as seen by phy.c: the first chunk written to the
+ *  FIFO is prefixed by the configured preamble and sync word, refill chunks are transmitted as is (the
+ *  background advertising chunks contain their own preamble and sync word), the packet handler either
+ *  uses a fixed payload length or calls rx_packet_header_cb() after 4 bytes when the length is unknown.
+ *
+ *  Every chunk transmitted on the medium is an emission. Emissions reach the other nodes after the
+ *  propagation delay of the link, attenuated by the path loss of the link. A receiver locks on an
+ *  emission when it detects a matching sync word with a sufficient SINR, the frame is lost when an
+ *  interferer drops the SINR below the capture threshold during the reception.
+ *  The energy of all emissions on the channel is reported by hw_radio_get_rssi(), so CCA works as expected.
+ *  LoRa is not modelled.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "hwradio.h"
+#include "errors.h"
+#include "debug.h"
+#include "ng.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "hwsystem.h"
+#include "sim.h"
+
+#define SIM_MAX_EMISSIONS 1024
+#define EMISSION_MAX_LENGTH 1024
+#define TX_MAX_QUEUED_CHUNKS 4
+#define HEADER_LENGTH 4
+#define SPEED_OF_LIGHT_M_PER_US 300.0
+#define PREAMBLE_BYTE 0xAA
+#define RX_STARTUP_TIME_US 250
+
+typedef struct
+{
+    uint32_t id;                // 0 when the slot is free
+    uint16_t tx_node;
+    uint32_t center_freq;
+    uint32_t bitrate;
+    int8_t eirp;
+    uint64_t start_us;
+    uint64_t sync_end_us;       // start of the payload
+    uint64_t end_us;
+    bool has_sync;
+    uint16_t sync_word;
+    uint16_t length;            // length of the payload following the sync word
+    uint8_t data[EMISSION_MAX_LENGTH];
+} emission_t;
+
+typedef enum
+{
+    RX_STATE_IDLE,
+    RX_STATE_HEADER,
+    RX_STATE_PAYLOAD
+} rx_state_t;
+
+typedef struct
+{
+    uint32_t tx_frames;
+    uint32_t tx_chunks;
+    uint64_t tx_airtime_us;
+    uint32_t rx_frames;
+    uint32_t rx_lost_interference;  // the sync word was detected but the frame was corrupted
+    uint32_t rx_aborted;            // the reception was stopped by the stack
+    uint32_t rx_dropped;            // no packet buffer available
+    uint32_t cca_measurements;
+} sim_radio_stats_t;
+
+typedef struct
+{
+    hwradio_init_args_t callbacks;
+    hw_radio_state_t opmode;
+    bool packet_handler_enabled;
+    bool lora;
+    uint32_t center_freq;
+    uint32_t bitrate;
+    uint32_t rx_bw_hz;
+    uint8_t rssi_samples;
+    uint16_t preamble_size;
+    uint16_t sync_word;
+    int8_t eirp;
+    uint16_t payload_length;
+    bool refill_enabled;
+    bool preloading_enabled;
+
+    // TX
+    uint32_t tx_generation;
+    uint64_t tx_end_us;
+    uint16_t preloaded_length;
+    uint8_t preloaded_data[EMISSION_MAX_LENGTH];
+    uint32_t tx_emissions[TX_MAX_QUEUED_CHUNKS];
+    uint8_t tx_emissions_count;
+
+    // RX
+    rx_state_t rx_state;
+    uint32_t rx_generation;
+    uint32_t rx_emission;
+    bool rx_variable_length;
+    bool rx_corrupted;
+    int16_t rx_rssi;
+    uint64_t rx_sync_end_us;
+    uint16_t rx_size;
+    uint16_t rx_length;
+    uint8_t rx_data[EMISSION_MAX_LENGTH];
+    hw_radio_packet_t* rx_packet;
+
+    sim_radio_stats_t stats;
+} sim_radio_t;
+
+static sim_radio_t radios[NODE_GLOBALS_MAX_NODES];
+static emission_t emissions[SIM_MAX_EMISSIONS];
+static uint32_t next_emission_id = 1;
+static uint32_t emissions_total = 0;
+
+// link budget, symmetric
+static float positions[NODE_GLOBALS_MAX_NODES][2];
+static float path_loss_db[NODE_GLOBALS_MAX_NODES][NODE_GLOBALS_MAX_NODES];
+static uint32_t propagation_delay_us[NODE_GLOBALS_MAX_NODES][NODE_GLOBALS_MAX_NODES];
+
+// the simulator has its own RNG so the topology does not depend on what the nodes do with rand()
+static uint32_t rng_state;
+
+#define CURRENT_NODE get_node_global_id()
+#define CURRENT_RADIO (&radios[get_node_global_id()])
+
+static void rx_timeout(void* arg);
+
+static uint32_t rng_next(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float rng_uniform(void)
+{
+    return (rng_next() >> 8) / (float)(1 << 24);
+}
+
+static float rng_gaussian(void)
+{
+    // Box-Muller
+    float u1 = rng_uniform();
+    float u2 = rng_uniform();
+    if(u1 < 1e-7f)
+        u1 = 1e-7f;
+
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+static uint64_t bytes_to_us(uint32_t bitrate, uint32_t bytes)
+{
+    assert(bitrate > 0);
+    return ((uint64_t)bytes * 8 * 1000000 + bitrate - 1) / bitrate;
+}
+
+static inline double dbm_to_mw(double dbm)
+{
+    return pow(10.0, dbm / 10.0);
+}
+
+static inline double mw_to_dbm(double mw)
+{
+    return 10.0 * log10(mw);
+}
+
+static emission_t* get_emission(uint32_t id)
+{
+    emission_t* emission = &emissions[id % SIM_MAX_EMISSIONS];
+    if(emission->id != id)
+        return NULL;
+
+    return emission;
+}
+
+static inline int16_t get_received_power(emission_t* emission, uint16_t rx_node)
+{
+    return emission->eirp - (int16_t)lroundf(path_loss_db[emission->tx_node][rx_node]);
+}
+
+// whether the emission is on the air at the receiver at the current time
+static bool is_emission_active(emission_t* emission, uint16_t rx_node, uint32_t center_freq)
+{
+    if(emission->id == 0 || emission->tx_node == rx_node || emission->center_freq != center_freq)
+        return false;
+
+    uint64_t now = sim_get_time_us();
+    uint32_t delay = propagation_delay_us[emission->tx_node][rx_node];
+    return emission->start_us + delay <= now && now < emission->end_us + delay;
+}
+
+// the noise and the energy of all emissions on the channel, except the given one, in mW
+static double get_interference_mw(uint16_t rx_node, uint32_t center_freq, uint32_t except_id)
+{
+    double total = dbm_to_mw(sim_config.noise_floor_dbm);
+    for(uint32_t i = 0; i < SIM_MAX_EMISSIONS; i++)
+    {
+        emission_t* emission = &emissions[i];
+        if(emission->id != except_id && is_emission_active(emission, rx_node, center_freq))
+            total += dbm_to_mw(get_received_power(emission, rx_node));
+    }
+
+    return total;
+}
+
+static bool is_sinr_sufficient(uint16_t rx_node, emission_t* emission)
+{
+    double interference_dbm = mw_to_dbm(get_interference_mw(rx_node, emission->center_freq, emission->id));
+    return get_received_power(emission, rx_node) - interference_dbm >= sim_config.capture_threshold_db;
+}
+
+static emission_t* alloc_emission(void)
+{
+    uint64_t now = sim_get_time_us();
+    for(uint32_t attempt = 0; attempt < SIM_MAX_EMISSIONS; attempt++)
+    {
+        uint32_t id = next_emission_id++;
+        if(next_emission_id == 0)
+            next_emission_id = 1;
+
+        emission_t* emission = &emissions[id % SIM_MAX_EMISSIONS];
+        // keep an emission until it has passed every receiver, the area is only a few km so 100 us is plenty
+        if(emission->id == 0 || emission->end_us + 100 < now)
+        {
+            memset(emission, 0, offsetof(emission_t, data));
+            emission->id = id;
+            emissions_total++;
+            return emission;
+        }
+    }
+
+    assert(false); // too many simultaneous emissions
+    return NULL;
+}
+
+static void release_rx_packet(sim_radio_t* radio)
+{
+    if(radio->rx_packet)
+    {
+        radio->callbacks.release_packet_cb(radio->rx_packet);
+        radio->rx_packet = NULL;
+    }
+}
+
+static void reinit_rx(sim_radio_t* radio)
+{
+    radio->rx_state = RX_STATE_IDLE;
+    radio->rx_generation++;
+    radio->rx_packet = NULL;
+    if(radio->rx_variable_length)
+        radio->payload_length = 0; // keep listening in unlimited length mode
+}
+
+static void abort_rx(sim_radio_t* radio)
+{
+    if(radio->rx_state == RX_STATE_IDLE)
+        return;
+
+    radio->stats.rx_aborted++;
+    release_rx_packet(radio);
+    reinit_rx(radio);
+}
+
+static void abort_tx(sim_radio_t* radio)
+{
+    uint64_t now = sim_get_time_us();
+    for(uint8_t i = 0; i < radio->tx_emissions_count; i++)
+    {
+        emission_t* emission = get_emission(radio->tx_emissions[i]);
+        if(emission == NULL || emission->end_us <= now)
+            continue;
+
+        if(emission->start_us >= now)
+        {
+            emission->id = 0; // not started yet, the start event will be ignored
+            continue;
+        }
+
+        // truncate the emission, the receivers locked on it will not receive the frame
+        emission->end_us = now;
+        for(uint16_t node = 0; node < sim_config.node_count; node++)
+        {
+            if(radios[node].rx_state != RX_STATE_IDLE && radios[node].rx_emission == emission->id)
+                radios[node].rx_corrupted = true;
+        }
+    }
+
+    radio->tx_emissions_count = 0;
+    radio->preloaded_length = 0;
+    radio->tx_generation++;
+}
+
+static void rx_done_event(uint32_t generation)
+{
+    sim_radio_t* radio = CURRENT_RADIO;
+    if(generation != radio->rx_generation || radio->rx_state != RX_STATE_PAYLOAD)
+        return;
+
+    if(radio->rx_corrupted || radio->rx_size > radio->rx_length)
+    {
+        radio->stats.rx_lost_interference++;
+        release_rx_packet(radio);
+        reinit_rx(radio);
+        return;
+    }
+
+    hw_radio_packet_t* packet = radio->rx_packet;
+    if(packet == NULL)
+    {
+        // fixed length mode: the packet is only allocated when it is completely received
+        packet = radio->callbacks.alloc_packet_cb(radio->rx_size);
+        if(packet == NULL)
+        {
+            radio->stats.rx_dropped++;
+            reinit_rx(radio);
+            return;
+        }
+    }
+
+    memcpy(packet->data, radio->rx_data, radio->rx_size);
+    packet->length = radio->rx_size;
+    packet->rx_meta.timestamp = timer_get_counter_value();
+    packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+    packet->rx_meta.rssi = radio->rx_rssi;
+    packet->rx_meta.lqi = 0;
+
+    radio->stats.rx_frames++;
+    reinit_rx(radio);
+    radio->callbacks.rx_packet_cb(packet);
+}
+
+static void header_received_event(uint32_t generation)
+{
+    sim_radio_t* radio = CURRENT_RADIO;
+    if(generation != radio->rx_generation || radio->rx_state != RX_STATE_HEADER)
+        return;
+
+    if(radio->rx_corrupted || radio->rx_length < HEADER_LENGTH)
+    {
+        // a corrupted header results in a garbage length, the frame is lost anyway
+        radio->stats.rx_lost_interference++;
+        reinit_rx(radio);
+        return;
+    }
+
+    // the callback decodes the header in place, so pass a copy
+    uint8_t header[HEADER_LENGTH];
+    memcpy(header, radio->rx_data, HEADER_LENGTH);
+    radio->callbacks.rx_packet_header_cb(header, HEADER_LENGTH); // sets the payload length
+    if(radio->rx_state != RX_STATE_HEADER || generation != radio->rx_generation)
+        return; // the stack stopped the reception from the callback
+
+    if(radio->payload_length == 0)
+    {
+        reinit_rx(radio); // the length is not valid
+        return;
+    }
+
+    radio->rx_size = radio->payload_length;
+    radio->rx_packet = radio->callbacks.alloc_packet_cb(radio->rx_size);
+    if(radio->rx_packet == NULL)
+    {
+        radio->stats.rx_dropped++;
+        reinit_rx(radio);
+        return;
+    }
+
+    radio->rx_state = RX_STATE_PAYLOAD;
+    sim_schedule_event(radio->rx_sync_end_us + bytes_to_us(radio->bitrate, radio->rx_size), CURRENT_NODE,
+                       &rx_done_event, radio->rx_generation);
+}
+
+static void sync_detected_event(uint32_t emission_id)
+{
+    uint16_t node = CURRENT_NODE;
+    sim_radio_t* radio = CURRENT_RADIO;
+    emission_t* emission = get_emission(emission_id);
+    if(emission == NULL || emission->end_us < emission->sync_end_us)
+        return; // cancelled or truncated before the sync word was transmitted
+
+    if(radio->opmode != HW_STATE_RX || !radio->packet_handler_enabled || radio->rx_state != RX_STATE_IDLE
+       || radio->lora || radio->center_freq != emission->center_freq || radio->bitrate != emission->bitrate
+       || radio->sync_word != emission->sync_word)
+        return;
+
+    if(!is_sinr_sufficient(node, emission))
+    {
+        radio->stats.rx_lost_interference++;
+        return;
+    }
+
+    radio->rx_emission = emission_id;
+    radio->rx_rssi = get_received_power(emission, node);
+    radio->rx_sync_end_us = sim_get_time_us();
+    radio->rx_corrupted = false;
+    radio->rx_packet = NULL;
+    radio->rx_length = emission->length;
+    memcpy(radio->rx_data, emission->data, emission->length);
+    radio->rx_generation++;
+    radio->rx_variable_length = (radio->payload_length == 0);
+    if(radio->rx_variable_length)
+    {
+        radio->rx_state = RX_STATE_HEADER;
+        sim_schedule_event(radio->rx_sync_end_us + bytes_to_us(radio->bitrate, HEADER_LENGTH), node,
+                           &header_received_event, radio->rx_generation);
+    }
+    else
+    {
+        radio->rx_state = RX_STATE_PAYLOAD;
+        radio->rx_size = radio->payload_length;
+        sim_schedule_event(radio->rx_sync_end_us + bytes_to_us(radio->bitrate, radio->rx_size), node,
+                           &rx_done_event, radio->rx_generation);
+    }
+}
+
+static void emission_start_event(uint32_t emission_id)
+{
+    emission_t* emission = get_emission(emission_id);
+    if(emission == NULL)
+        return;
+
+    for(uint16_t node = 0; node < sim_config.node_count; node++)
+    {
+        if(node == emission->tx_node)
+            continue;
+
+        sim_radio_t* radio = &radios[node];
+        if(radio->rx_state != RX_STATE_IDLE && !radio->rx_corrupted && radio->center_freq == emission->center_freq)
+        {
+            emission_t* received = get_emission(radio->rx_emission);
+            if(received != NULL && !is_sinr_sufficient(node, received))
+                radio->rx_corrupted = true;
+        }
+
+        if(emission->has_sync && get_received_power(emission, node) >= sim_config.sensitivity_dbm)
+            sim_schedule_event(emission->sync_end_us + propagation_delay_us[emission->tx_node][node], node,
+                               &sync_detected_event, emission_id);
+    }
+}
+
+static void refill_event(uint32_t generation)
+{
+    sim_radio_t* radio = CURRENT_RADIO;
+    if(generation != radio->tx_generation || radio->opmode != HW_STATE_TX || !radio->refill_enabled)
+        return;
+
+    radio->callbacks.tx_refill_cb(0);
+}
+
+static void chunk_end_event(uint32_t generation)
+{
+    sim_radio_t* radio = CURRENT_RADIO;
+    if(generation != radio->tx_generation || radio->opmode != HW_STATE_TX)
+        return;
+
+    if(sim_get_time_us() < radio->tx_end_us)
+        return; // a next chunk is queued
+
+    // packet sent, the transceiver returns to standby
+    radio->opmode = HW_STATE_STANDBY;
+    radio->tx_emissions_count = 0;
+    radio->tx_generation++;
+    radio->callbacks.tx_packet_cb(timer_get_counter_value());
+}
+
+static void queue_chunk(sim_radio_t* radio, uint8_t* data, uint16_t len, bool first_chunk)
+{
+    uint64_t now = sim_get_time_us();
+    emission_t* emission = alloc_emission();
+    emission->tx_node = CURRENT_NODE;
+    emission->center_freq = radio->center_freq;
+    emission->bitrate = radio->bitrate;
+    emission->eirp = radio->eirp;
+    emission->start_us = (first_chunk || radio->tx_end_us < now) ? now : radio->tx_end_us;
+
+    uint16_t sync_offset;
+    if(first_chunk)
+    {
+        // the transceiver prefixes the preamble and the sync word
+        emission->has_sync = true;
+        emission->sync_word = radio->sync_word;
+        emission->sync_end_us = emission->start_us + bytes_to_us(radio->bitrate, radio->preamble_size + 2);
+        emission->end_us = emission->sync_end_us + bytes_to_us(radio->bitrate, len);
+        sync_offset = 0;
+    }
+    else
+    {
+        // refill chunks contain an explicit preamble and sync word, padding chunks contain only preamble
+        uint16_t preamble_len = 0;
+        while(preamble_len < len && data[preamble_len] == PREAMBLE_BYTE)
+            preamble_len++;
+
+        emission->has_sync = (preamble_len + 2 <= len);
+        sync_offset = emission->has_sync ? preamble_len + 2 : len;
+        if(emission->has_sync)
+            emission->sync_word = (data[preamble_len] << 8) | data[preamble_len + 1];
+
+        emission->sync_end_us = emission->start_us + bytes_to_us(radio->bitrate, sync_offset);
+        emission->end_us = emission->start_us + bytes_to_us(radio->bitrate, len);
+    }
+
+    emission->length = len - sync_offset;
+    assert(emission->length <= EMISSION_MAX_LENGTH);
+    memcpy(emission->data, data + sync_offset, emission->length);
+
+    // forget the chunks which are already on the air completely
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < radio->tx_emissions_count; i++)
+    {
+        emission_t* queued = get_emission(radio->tx_emissions[i]);
+        if(queued != NULL && queued->end_us > now)
+            radio->tx_emissions[count++] = radio->tx_emissions[i];
+    }
+
+    assert(count < TX_MAX_QUEUED_CHUNKS);
+    radio->tx_emissions[count++] = emission->id;
+    radio->tx_emissions_count = count;
+    radio->tx_end_us = emission->end_us;
+
+    radio->stats.tx_chunks++;
+    radio->stats.tx_airtime_us += emission->end_us - emission->start_us;
+    if(emission->has_sync)
+        radio->stats.tx_frames++;
+
+    sim_schedule_event(emission->start_us, CURRENT_NODE, &emission_start_event, emission->id);
+    sim_schedule_event(emission->end_us, CURRENT_NODE, &chunk_end_event, radio->tx_generation);
+    if(radio->refill_enabled)
+    {
+        // request the next chunk shortly before the FIFO runs empty
+        uint64_t refill_us = emission->end_us - bytes_to_us(radio->bitrate, 2);
+        sim_schedule_event(refill_us > now ? refill_us : now, CURRENT_NODE, &refill_event, radio->tx_generation);
+    }
+}
+
+void sim_radio_setup(void)
+{
+    rng_state = sim_config.seed ? sim_config.seed : 1;
+    assert(sim_config.node_count <= NODE_GLOBALS_MAX_NODES);
+
+    positions[0][0] = sim_config.area_size_m / 2;
+    positions[0][1] = sim_config.area_size_m / 2;
+    for(uint16_t node = 1; node < sim_config.node_count; node++)
+    {
+        positions[node][0] = rng_uniform() * sim_config.area_size_m;
+        positions[node][1] = rng_uniform() * sim_config.area_size_m;
+    }
+
+    for(uint16_t a = 0; a < sim_config.node_count; a++)
+    {
+        for(uint16_t b = a + 1; b < sim_config.node_count; b++)
+        {
+            float dx = positions[a][0] - positions[b][0];
+            float dy = positions[a][1] - positions[b][1];
+            float distance = sqrtf(dx * dx + dy * dy);
+            if(distance < 1.0f)
+                distance = 1.0f;
+
+            float loss = sim_config.path_loss_1m_db + 10.0f * sim_config.path_loss_exponent * log10f(distance)
+                         + sim_config.shadowing_sigma_db * rng_gaussian();
+            path_loss_db[a][b] = path_loss_db[b][a] = loss;
+            propagation_delay_us[a][b] = propagation_delay_us[b][a] = (uint32_t)(distance / SPEED_OF_LIGHT_M_PER_US);
+        }
+    }
+}
+
+void sim_radio_print_stats(void)
+{
+    uint64_t duration_us = sim_get_time_us();
+    printf("medium: %u emissions in %u s\n", emissions_total, (uint32_t)(duration_us / 1000000));
+    printf("node  x(m)   y(m)   PL0(dB) tx_frames tx_chunks duty(%%) rx_frames lost aborted dropped cca\n");
+    for(uint16_t node = 0; node < sim_config.node_count; node++)
+    {
+        sim_radio_stats_t* stats = &radios[node].stats;
+        printf("%4u %6.1f %6.1f %7.1f %9u %9u %7.3f %9u %4u %7u %7u %u\n", node, positions[node][0], positions[node][1],
+               path_loss_db[0][node], stats->tx_frames, stats->tx_chunks,
+               duration_us ? 100.0 * stats->tx_airtime_us / duration_us : 0.0,
+               stats->rx_frames, stats->rx_lost_interference, stats->rx_aborted, stats->rx_dropped,
+               stats->cca_measurements);
+    }
+}
+
+error_t hw_radio_init(hwradio_init_args_t* init_args)
+{
+    sim_radio_t* radio = CURRENT_RADIO;
+    if(init_args == NULL || init_args->alloc_packet_cb == NULL || init_args->release_packet_cb == NULL
+       || init_args->rx_packet_cb == NULL || init_args->tx_packet_cb == NULL)
+        return EINVAL;
+
+    radio->callbacks = *init_args;
+    radio->opmode = HW_STATE_SLEEP;
+    sched_register_task(&rx_timeout);
+    return SUCCESS;
+}
+
+void hw_radio_stop(void)
+{
+    hw_radio_set_idle();
+}
+
+static void rx_timeout(void* arg)
+{
+    hw_radio_set_idle();
+}
+
+error_t hw_radio_set_idle(void)
+{
+    hw_radio_set_opmode(HW_STATE_SLEEP);
+    timer_cancel_task(&rx_timeout);
+    return SUCCESS;
+}
+
+bool hw_radio_is_idle(void)
+{
+    return CURRENT_RADIO->opmode == HW_STATE_SLEEP || CURRENT_RADIO->opmode == HW_STATE_OFF;
+}
+
+bool hw_radio_is_rx(void)
+{
+    return CURRENT_RADIO->opmode == HW_STATE_RX;
+}
+
+bool hw_radio_tx_busy(void)
+{
+    return CURRENT_RADIO->opmode == HW_STATE_TX;
+}
+
+bool hw_radio_rx_busy(void)
+{
+    return CURRENT_RADIO->rx_state != RX_STATE_IDLE;
+}
+
+bool hw_radio_rssi_valid(void)
+{
+    return true;
+}
+
+int16_t hw_radio_get_rssi(void)
+{
+    // like the real transceiver the packet handler is not used while measuring
+    sim_radio_t* radio = CURRENT_RADIO;
+    abort_tx(radio);
+    abort_rx(radio);
+    radio->opmode = HW_STATE_RX;
+    radio->packet_handler_enabled = false;
+    radio->stats.cca_measurements++;
+
+    // the driver busy waits until the receiver started up and averaged the RSSI samples
+    uint32_t rx_bw_khz = radio->rx_bw_hz >= 1000 ? radio->rx_bw_hz / 1000 : 1;
+    hw_busy_wait(RX_STARTUP_TIME_US + (radio->rssi_samples * 1000) / (4 * rx_bw_khz));
+    return (int16_t)lround(mw_to_dbm(get_interference_mw(CURRENT_NODE, radio->center_freq, 0)));
+}
+
+hw_radio_state_t hw_radio_get_opmode(void)
+{
+    return CURRENT_RADIO->opmode;
+}
+
+void hw_radio_set_opmode(hw_radio_state_t opmode)
+{
+    sim_radio_t* radio = CURRENT_RADIO;
+    switch(opmode)
+    {
+        case HW_STATE_TX:
+            if(radio->opmode == HW_STATE_TX)
+                return;
+
+            abort_rx(radio);
+            radio->opmode = HW_STATE_TX;
+            radio->packet_handler_enabled = false;
+            if(radio->preloaded_length)
+            {
+                queue_chunk(radio, radio->preloaded_data, radio->preloaded_length, true);
+                radio->preloaded_length = 0;
+            }
+            break;
+        case HW_STATE_RX:
+        case HW_STATE_IDLE:
+            abort_tx(radio);
+            abort_rx(radio);
+            radio->opmode = HW_STATE_RX;
+            radio->packet_handler_enabled = true;
+            break;
+        case HW_STATE_STANDBY:
+            abort_tx(radio);
+            abort_rx(radio);
+            radio->opmode = HW_STATE_STANDBY;
+            radio->packet_handler_enabled = false;
+            break;
+        case HW_STATE_OFF:
+        case HW_STATE_SLEEP:
+        case HW_STATE_RESET:
+            abort_tx(radio);
+            abort_rx(radio);
+            radio->opmode = HW_STATE_SLEEP;
+            radio->packet_handler_enabled = false;
+            break;
+    }
+}
+
+error_t hw_radio_send_payload(uint8_t* data, uint16_t len)
+{
+    sim_radio_t* radio = CURRENT_RADIO;
+    if(len == 0 || len > EMISSION_MAX_LENGTH)
+        return ESIZE;
+
+    if(radio->opmode == HW_STATE_RX)
+        hw_radio_set_opmode(HW_STATE_STANDBY);
+
+    if(radio->opmode == HW_STATE_TX)
+    {
+        queue_chunk(radio, data, len, false); // refill
+    }
+    else if(radio->preloading_enabled)
+    {
+        // transmitted on the next switch to TX
+        memcpy(radio->preloaded_data, data, len);
+        radio->preloaded_length = len;
+        radio->preloading_enabled = false;
+    }
+    else
+    {
+        abort_rx(radio);
+        radio->opmode = HW_STATE_TX;
+        radio->packet_handler_enabled = false;
+        queue_chunk(radio, data, len, true);
+    }
+
+    return SUCCESS;
+}
+
+void hw_radio_set_center_freq(uint32_t center_freq)
+{
+    CURRENT_RADIO->center_freq = center_freq;
+}
+
+void hw_radio_set_bitrate(uint32_t bps)
+{
+    CURRENT_RADIO->bitrate = bps;
+}
+
+void hw_radio_set_rx_bw_hz(uint32_t bw_hz)
+{
+    CURRENT_RADIO->rx_bw_hz = bw_hz;
+}
+
+void hw_radio_set_rssi_config(uint8_t rssi_smoothing, uint8_t rssi_offset)
+{
+    CURRENT_RADIO->rssi_samples = 2 << rssi_smoothing;
+}
+
+void hw_radio_set_preamble_size(uint16_t size)
+{
+    CURRENT_RADIO->preamble_size = size;
+}
+
+void hw_radio_set_sync_word(uint8_t* sync_word, uint8_t sync_size)
+{
+    assert(sync_size == 2);
+    // stored the same way as the sx127x driver does, the high byte is transmitted first
+    CURRENT_RADIO->sync_word = *(uint16_t*)sync_word;
+}
+
+void hw_radio_set_payload_length(uint16_t length)
+{
+    CURRENT_RADIO->payload_length = length;
+}
+
+void hw_radio_enable_refill(bool enable)
+{
+    CURRENT_RADIO->refill_enabled = enable;
+}
+
+void hw_radio_enable_preloading(bool enable)
+{
+    CURRENT_RADIO->preloading_enabled = enable;
+}
+
+void hw_radio_set_tx_power(int8_t eirp)
+{
+    CURRENT_RADIO->eirp = eirp;
+}
+
+void hw_radio_set_rx_timeout(uint32_t timeout)
+{
+    timer_post_task_delay(&rx_timeout, timeout);
+}
+
+void hw_radio_switch_longRangeMode(bool use_lora)
+{
+    // frames sent using LoRa are not simulated, a radio in LoRa mode does not receive anything
+    CURRENT_RADIO->lora = use_lora;
+    hw_radio_set_opmode(HW_STATE_SLEEP);
+}
+
+// settings which do not influence the simulation
+void hw_radio_set_tx_fdev(uint32_t fdev) {}
+void hw_radio_set_preamble_detector(uint8_t preamble_detector_size, uint8_t preamble_tol) {}
+void hw_radio_set_modulation_shaping(uint8_t shaping) {}
+void hw_radio_set_preamble_polarity(uint8_t polarity) {}
+void hw_radio_set_rssi_threshold(uint8_t rssi_thr) {}
+void hw_radio_set_rssi_smoothing(uint8_t rssi_samples) {}
+void hw_radio_set_sync_word_size(uint8_t sync_size) {}
+void hw_radio_set_sync_on(uint8_t enable) {}
+void hw_radio_set_preamble_detect_on(uint8_t enable) {}
+void hw_radio_set_dc_free(uint8_t scheme) {}
+void hw_radio_set_crc_on(uint8_t enable) {}
+void hw_radio_set_lora_mode(uint32_t lora_bw, uint8_t lora_SF) {}
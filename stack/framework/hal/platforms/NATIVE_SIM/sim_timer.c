@@ -0,0 +1,199 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sim_timer.c
+ *
+ *  \brief Virtual time implementation of the HW timer API for the NATIVE_SIM platform
+ *
+ *  Each node has a free running 16 bit counter which starts at 0 when the node initialises its timer.
+ *  Compare and overflow interrupts are delivered as simulation events.
+ *  Code executes in zero time, except for hw_busy_wait(): during a busy wait the clock of the node advances
+ *  while the rest of the simulation does not, so from then on the node runs slightly ahead of the simulation.
+ *  Interrupts which are due on the node but not yet in the simulation are delivered a bit late, like an
+ *  interrupt which is delayed by a busy loop running with interrupts disabled.
+ */
+
+#include "hwtimer.h"
+#include "hwsystem.h"
+#include "errors.h"
+#include "debug.h"
+#include "ng.h"
+#include "sim.h"
+
+typedef struct
+{
+    bool initialised;
+    uint32_t ticks_per_sec;
+    uint64_t start_us;               // in node time
+    uint64_t busy_us;                // total time spent in busy waits, node time = simulation time + busy_us
+    timer_callback_t compare_callback;
+    timer_callback_t overflow_callback;
+    uint32_t compare_generation;     // events of a cancelled or rescheduled compare carry an older generation
+    uint64_t overflows_delivered;
+} sim_timer_t;
+
+static sim_timer_t timers[NODE_GLOBALS_MAX_NODES];
+
+static const hwtimer_info_t timer_info = {
+    .min_delay_ticks = 1,
+};
+
+#define CURRENT_TIMER (&timers[get_node_global_id()])
+#define COUNTER_RANGE 0x10000
+
+static inline uint64_t get_node_time_us(sim_timer_t* timer)
+{
+    return sim_get_time_us() + timer->busy_us;
+}
+
+// number of ticks elapsed since the timer of the node was started
+static uint64_t get_ticks(sim_timer_t* timer)
+{
+    return ((get_node_time_us(timer) - timer->start_us) * timer->ticks_per_sec) / 1000000;
+}
+
+// the first point in simulation time at which the given number of ticks has elapsed (or now, if this already happened)
+static uint64_t get_tick_time_us(sim_timer_t* timer, uint64_t ticks)
+{
+    uint64_t node_time_us = timer->start_us + (ticks * 1000000 + timer->ticks_per_sec - 1) / timer->ticks_per_sec;
+    if(node_time_us < get_node_time_us(timer))
+        return sim_get_time_us();
+
+    return node_time_us - timer->busy_us;
+}
+
+static void compare_event(uint32_t generation)
+{
+    sim_timer_t* timer = CURRENT_TIMER;
+    if(generation != timer->compare_generation)
+        return;
+
+    timer->compare_generation++; // the timer only fires once
+    if(timer->compare_callback)
+        timer->compare_callback();
+}
+
+static void overflow_event(uint32_t arg)
+{
+    sim_timer_t* timer = CURRENT_TIMER;
+    timer->overflows_delivered++;
+    sim_schedule_event(get_tick_time_us(timer, (timer->overflows_delivered + 1) * COUNTER_RANGE),
+                       get_node_global_id(), &overflow_event, 0);
+    if(timer->overflow_callback)
+        timer->overflow_callback();
+}
+
+error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_callback, timer_callback_t overflow_callback)
+{
+    if(timer_id != 0)
+        return ESIZE;
+
+    sim_timer_t* timer = CURRENT_TIMER;
+    if(timer->initialised)
+        return EALREADY;
+
+    if(frequency != HWTIMER_FREQ_1MS && frequency != HWTIMER_FREQ_32K)
+        return EINVAL;
+
+    timer->initialised = true;
+    timer->ticks_per_sec = (frequency == HWTIMER_FREQ_1MS) ? HWTIMER_TICKS_1MS : HWTIMER_TICKS_32K;
+    timer->start_us = get_node_time_us(timer);
+    timer->compare_callback = compare_callback;
+    timer->overflow_callback = overflow_callback;
+    timer->compare_generation = 0;
+    timer->overflows_delivered = 0;
+    sim_schedule_event(get_tick_time_us(timer, COUNTER_RANGE), get_node_global_id(), &overflow_event, 0);
+    return SUCCESS;
+}
+
+const hwtimer_info_t* hw_timer_get_info(hwtimer_id_t timer_id)
+{
+    if(timer_id != 0)
+        return NULL;
+
+    return &timer_info;
+}
+
+hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id)
+{
+    sim_timer_t* timer = CURRENT_TIMER;
+    if(timer_id != 0 || !timer->initialised)
+        return 0;
+
+    return (hwtimer_tick_t)get_ticks(timer);
+}
+
+error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick)
+{
+    sim_timer_t* timer = CURRENT_TIMER;
+    if(timer_id != 0)
+        return ESIZE;
+
+    if(!timer->initialised)
+        return EOFF;
+
+    // like a HW comparator: fire the next time the counter reaches 'tick', after a full loop if it equals the counter now
+    uint64_t now = get_ticks(timer);
+    uint32_t delay = (hwtimer_tick_t)(tick - (hwtimer_tick_t)now);
+    if(delay == 0)
+        delay = COUNTER_RANGE;
+
+    timer->compare_generation++;
+    sim_schedule_event(get_tick_time_us(timer, now + delay), get_node_global_id(), &compare_event, timer->compare_generation);
+    return SUCCESS;
+}
+
+error_t hw_timer_cancel(hwtimer_id_t timer_id)
+{
+    sim_timer_t* timer = CURRENT_TIMER;
+    if(timer_id != 0)
+        return ESIZE;
+
+    if(!timer->initialised)
+        return EOFF;
+
+    timer->compare_generation++;
+    return SUCCESS;
+}
+
+error_t hw_timer_counter_reset(hwtimer_id_t timer_id)
+{
+    // not supported: the overflow events of the node are aligned to the start of its counter
+    return EINVAL;
+}
+
+bool hw_timer_is_overflow_pending(hwtimer_id_t timer_id)
+{
+    sim_timer_t* timer = CURRENT_TIMER;
+    if(timer_id != 0 || !timer->initialised)
+        return false;
+
+    return get_ticks(timer) / COUNTER_RANGE > timer->overflows_delivered;
+}
+
+bool hw_timer_is_interrupt_pending(hwtimer_id_t timer_id)
+{
+    // interrupts are delivered as events, they are never pending while a node executes
+    return false;
+}
+
+void hw_busy_wait(int16_t microseconds)
+{
+    if(microseconds > 0)
+        CURRENT_TIMER->busy_us += microseconds;
+}
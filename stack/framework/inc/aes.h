@@ -50,6 +50,53 @@
   #define CTR 1
 #endif
 
+/*! \brief An AES-128 key with its expanded round keys.
+ *
+ * The key schedule is computed once by aes128_init(), all operations on the context only use the
+ * cached round keys. Multiple contexts can be used at the same time, for example one per network key.
+ * The raw key is kept as well for platforms which define HAL_SUPPORT_HW_AES.
+ */
+typedef struct
+{
+    uint32_t round_keys[44];
+    uint8_t key[AES_BLOCK_SIZE];
+} aes128_ctx_t;
+
+/*! \brief Expand the key into the context. */
+void aes128_init(aes128_ctx_t *ctx, const uint8_t *key);
+
+/*! \brief Encrypt a single 16 byte block. input and output may point to the same buffer. */
+void aes128_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+
+/*! \brief Decrypt a single 16 byte block. input and output may point to the same buffer. */
+void aes128_decrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+
+/*! \brief AES CTR encryption (or decryption, which is the same operation).
+ *
+ * The counter block is incremented (starting from the first byte) after each full block, a trailing
+ * partial block does not increment the counter.
+ */
+void aes128_ctr_encrypt(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, uint8_t *ctr_blk);
+
+/*! \brief Increment the counter block the way aes128_ctr_encrypt() does. */
+void aes128_ctr_increment(uint8_t *ctr_blk);
+
+/*! \brief AES CBC-MAC, see AES128_CBC_MAC() for the parameters. */
+error_t aes128_cbc_mac(const aes128_ctx_t *ctx, uint8_t *auth, const uint8_t *payload, uint8_t length, const uint8_t *iv,
+                       const uint8_t *add, uint8_t add_len, uint8_t auth_len);
+
+/*! \brief AES-CCM encryption in a single pass over the payload, see AES128_CCM_encrypt() for the parameters. */
+error_t aes128_ccm_encrypt(const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                           const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk, uint8_t auth_len);
+
+/*! \brief AES-CCM decryption in a single pass over the payload, see AES128_CCM_decrypt() for the parameters. */
+error_t aes128_ccm_decrypt(const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                           const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                           const uint8_t *auth, uint8_t auth_len);
+
+/*! \brief The context used by the AES128_xxx() functions below, which use the key set by AES128_init(). */
+const aes128_ctx_t *aes128_default_ctx(void);
+
 void AES128_init(const uint8_t *key);
 
 #if defined(ECB) && ECB
@@ -52,6 +52,9 @@
 
 #define ALP_PAYLOAD_MAX_SIZE D7A_PAYLOAD_MAX_SIZE // TODO configurable?
 #define ALP_ITF_CONFIG_SIZE 43
+// the number of actions alp_parse_command() stores at once. Each command slot of the ALP layer embeds them in its
+// alp_command_desc_t: 8 actions of up to 20 bytes, about 170 bytes per slot on a 32-bit MCU
+#define ALP_MAX_PARSED_ACTION_COUNT 8
 
 typedef enum
 {
@@ -241,13 +244,52 @@ typedef struct {
 
 } alp_action_t;
 
+/*! \brief An ALP action located by alp_parse_command().
+ *
+ * The operands are not copied, variable length operands are referenced by their index in the command buffer.
+ */
+typedef struct {
+    alp_control_t ctrl;
+    uint8_t start;              // the index of the control byte in the command
+    uint8_t size;               // the size of the complete action, including the control byte
+    uint8_t id;                 // the file ID, interface ID or tag ID operand, depending on the operation
+    uint8_t query_code;         // the query code of a break query
+    uint8_t data;               // the index of the data, file header, interface configuration, interface status or compare value
+    uint8_t response_length;    // the number of bytes this action adds to the response
+    uint32_t offset;            // the file offset operand
+    uint32_t length;            // the length of the (requested) data, interface configuration, interface status or compare value
+} alp_action_desc_t;
+
+/*! \brief The result of parsing an ALP command with alp_parse_command() */
+typedef struct {
+    uint8_t* alp_command;
+    uint8_t length;
+    uint8_t end;                        // the index following the last action in actions
+    uint8_t action_count;
+    uint8_t expected_response_length;   // of all actions which follow the start index, not only the stored ones
+    alp_status_codes_t status;          // the reason why parsing stopped before the end of the command, or ALP_STATUS_OK
+    alp_action_desc_t actions[ALP_MAX_PARSED_ACTION_COUNT];
+} alp_command_desc_t;
+
 typedef void (*interface_deinit)();
 
+/*!
+ * \brief A part of a command which is sent as a whole by send_command_segments
+ */
+typedef struct {
+    uint8_t* data;
+    uint8_t length;
+} alp_segment_t;
+
+#define ALP_MAX_SEGMENT_COUNT 4
+
 typedef struct {
     alp_itf_id_t itf_id;
     uint8_t itf_cfg_len;
     uint8_t itf_status_len;
     error_t (*send_command)(uint8_t* payload, uint8_t payload_length, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* itf_cfg);
+    // optional, sends the concatenation of the segments without copying them into one buffer first
+    error_t (*send_command_segments)(const alp_segment_t* segments, uint8_t segment_count, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* itf_cfg);
     void (*init)(alp_interface_config_t* itf_cfg);
     interface_deinit deinit;
     bool unique; // TODO
@@ -262,9 +304,34 @@ typedef struct {
 alp_operation_t alp_get_operation(uint8_t* alp_command);
 
 
-uint8_t alp_get_expected_response_length(fifo_t fifo);
+/*!
+ * \brief Parses the actions of an ALP command in a single pass, without copying operands
+ *
+ * The actions following index start are parsed until the end of the command or the first action which is incomplete
+ * or not supported. At most ALP_MAX_PARSED_ACTION_COUNT actions are stored, parsed->end is the index where parsing
+ * should continue for longer commands. The expected response length is determined for all actions following start.
+ * \param parsed the result, the actions reference alp_command which has to stay valid while they are used
+ * \return ALP_STATUS_OK when all actions following start could be parsed, the error otherwise (also in parsed->status)
+ */
+alp_status_codes_t alp_parse_command(alp_command_desc_t* parsed, uint8_t* alp_command, uint8_t length, uint8_t start);
+
+/*!
+ * \brief Returns the expected response length of the parsed actions starting with action_index and all actions following them
+ */
+uint8_t alp_get_remaining_response_length(const alp_command_desc_t* parsed, uint8_t action_index);
+
+/*!
+ * \brief Returns the expected response length of an ALP command, use alp_parse_command() when the actions are needed as well
+ */
+uint8_t alp_get_expected_response_length(uint8_t* alp_command, uint8_t length);
 
 alp_status_codes_t alp_register_interface(alp_interface_t* itf);
+
+/*!
+ * \brief Returns the registered interface with the given ID, or NULL
+ */
+alp_interface_t* alp_get_interface(uint8_t itf_id);
+
 void alp_append_tag_request_action(fifo_t* fifo, uint8_t tag_id, bool eop);
 void alp_append_read_file_data_action(fifo_t* fifo, uint8_t file_id, uint32_t offset, uint32_t length, bool resp, bool group);
 void alp_append_write_file_data_action(fifo_t* fifo, uint8_t file_id, uint32_t offset, uint32_t length, uint8_t* data, bool resp, bool group);
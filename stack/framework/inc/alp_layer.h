@@ -67,6 +67,31 @@ typedef struct {
     alp_unhandled_read_action_callback alp_unhandled_read_action_cb;
 } alp_init_args_t;
 
+/*!
+ * \brief Usage of the ALP command pool and of the buffer pool shared by the commands and their responses
+ */
+typedef struct {
+    uint8_t active_commands;
+    uint8_t max_active_commands;
+    uint16_t buffer_bytes_used;
+    uint16_t max_buffer_bytes_used;
+    uint32_t command_alloc_failures;
+    uint32_t buffer_alloc_failures;
+} alp_layer_command_pool_stats_t;
+
+/*!
+ * \brief Usage of the queue of received commands waiting for execution
+ */
+typedef struct {
+    uint8_t queued_commands;
+    uint8_t max_queued_commands;
+    uint32_t enqueued_commands;
+    uint32_t executed_commands;
+    uint32_t batches; // the number of times the queue was processed, at most MODULE_ALP_COMMAND_BATCH_SIZE commands each
+    uint32_t dropped_commands; // received commands rejected because no command slot or buffer was available
+    uint32_t dropped_responses; // responses forwarded to the serial interface which were truncated or not accepted
+} alp_layer_queue_stats_t;
+
 
 
 /*!
@@ -82,8 +107,9 @@ void alp_layer_init(alp_init_args_t* init_args, bool shell_enabled);
  * \param alp_command
  * \param alp_command_length
  * \param session_config
+ * \return ENOMEM when all command slots are in use, or the error of the interface
  */
-void alp_layer_execute_command_over_itf(uint8_t* alp_command, uint8_t alp_command_length,  alp_interface_config_t* itf_cfg);
+error_t alp_layer_execute_command_over_itf(uint8_t* alp_command, uint8_t alp_command_length,  alp_interface_config_t* itf_cfg);
 
 /*!
  * \brief Register a new interface in alp_layer
@@ -91,11 +117,28 @@ void alp_layer_execute_command_over_itf(uint8_t* alp_command, uint8_t alp_comman
  */
 void alp_layer_register_interface(alp_interface_t* interface);
 
+/*!
+ * \brief Queues a received ALP command for execution
+ * \return true when the command will initiate a response. False as well when the command is dropped because no
+ * command slot or buffer is available, which is counted in alp_layer_queue_stats_t.dropped_commands
+ */
 bool alp_layer_process_command(uint8_t* payload, uint8_t payload_length, alp_itf_id_t origin_itf_id, alp_interface_status_t* itf_status);
 void alp_layer_received_response(uint16_t trans_id, uint8_t* payload, uint8_t payload_length, alp_interface_status_t* itf_status); // TODO merge with alp_layer_process_command()?
 void alp_layer_command_completed(uint16_t trans_id, error_t* error, alp_interface_status_t* itf_status);
 void alp_layer_process_d7aactp(d7ap_session_config_t* session_config, uint8_t* alp_command, uint32_t alp_command_length);
 
+/*!
+ * \brief Returns the current and peak usage of the ALP command and buffer pools
+ * \param stats
+ */
+void alp_layer_get_command_pool_stats(alp_layer_command_pool_stats_t* stats);
+
+/*!
+ * \brief Returns the current and peak depth of the queue of commands waiting for execution
+ * \param stats
+ */
+void alp_layer_get_queue_stats(alp_layer_queue_stats_t* stats);
+
 
 #endif /* ALP_LAYER_H_ */
 
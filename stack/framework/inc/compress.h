@@ -29,6 +29,9 @@
  * The compressed format allows compressing a unit ranged from 0 to 507904 to 1 byte with variable resolution.
  *
  * It can be converted back to units using the formula T = (4^EXP)·(MANT).
+ *
+ * Both directions only use integer shifts, so no (soft) floating point support is pulled in. CT_DECOMPRESS() and
+ * CT_COMPRESS() are constant expressions when their argument is, which allows using them in initializers.
  * \author philippe.nunes@cortus.com
  */
 
@@ -36,7 +39,8 @@
 #define COMPRESS_H_
 
 #include <stdbool.h>
-#include "math.h"
+#include <stdint.h>
+#include "framework_defs.h"
 
 typedef union{
   uint8_t raw;
@@ -46,8 +50,32 @@ typedef union{
   };
 } compressed_time_t;
 
-#define CT_DECOMPRESS(ct) (pow(4, ct >> 5) * (ct & 0b11111))
+#define CT_DECOMPRESS(ct) ((uint32_t)((ct) & 0x1F) << (2 * (((ct) >> 5) & 0x07)))
+
+// the smallest exponent for which the value fits, the maximum value for exponent e is 31 * 4^e
+#define CT_EXPONENT(value) ((value) <= 31 ? 0 : (value) <= 124 ? 1 : (value) <= 496 ? 2 : (value) <= 1984 ? 3 : \
+                            (value) <= 7936 ? 4 : (value) <= 31744 ? 5 : (value) <= 126976 ? 6 : 7)
+
+/*! \brief Compress a value, rounding up when ceil is true and down otherwise. Equivalent to compress_data(), meant
+ * for constants since the value is evaluated multiple times. */
+#define CT_COMPRESS(value, ceil) ((uint8_t)((CT_EXPONENT(value) << 5) | \
+  (((value) >> (2 * CT_EXPONENT(value))) + (((ceil) && ((value) & ((1UL << (2 * CT_EXPONENT(value))) - 1))) ? 1 : 0))))
+
+#ifdef FRAMEWORK_CT_DECOMPRESS_LUT
+extern const uint32_t ct_decompress_lut[256];
+#endif
+
+/*! \brief Decompress a compressed time, using a lookup table when FRAMEWORK_CT_DECOMPRESS_LUT is set */
+static inline uint32_t ct_decompress(uint8_t ct)
+{
+#ifdef FRAMEWORK_CT_DECOMPRESS_LUT
+  return ct_decompress_lut[ct];
+#else
+  return CT_DECOMPRESS(ct);
+#endif
+}
 
+/*! \brief Compress a value, rounding up when ceil is true and down otherwise */
 uint8_t compress_data(uint16_t value, bool ceil);
 
 #endif /* COMPRESS_H_ */
@@ -23,6 +23,7 @@ __LINK_C void console_print_bytes(uint8_t* bytes, uint8_t length);
 __LINK_C void console_print(char* string);
 
 __LINK_C void console_set_rx_interrupt_callback(uart_rx_inthandler_t handler);
+__LINK_C void console_set_rx_block_callback(uart_rx_block_handler_t handler);
 __LINK_C void console_rx_interrupt_enable();
 
 // a few utilty wrappers
@@ -54,6 +55,7 @@ __LINK_C void console_rx_interrupt_enable();
 #define console_print(...)                     ((void)0)
 
 #define console_set_rx_interrupt_callback(...) ((void)0)
+#define console_set_rx_block_callback(...)     ((void)0)
 #define console_rx_interrupt_enable()          ((void)0)
 
 #define console_printf(...)                    ((void)0)
@@ -33,7 +33,25 @@
 
 #include <stdint.h>
 
-uint16_t crc_calculate(uint8_t* data, uint8_t length);
+/*! \brief Context of a CRC calculation which is split over several buffers
+ *
+ * The context is owned by the caller, so multiple calculations can be in progress at the same time.
+ */
+typedef struct {
+    uint16_t crc;
+} crc_ctx_t;
+
+/*! \brief Start a new CRC calculation */
+void crc_init(crc_ctx_t* ctx);
+
+/*! \brief Add the next length bytes of data to the CRC calculation */
+void crc_update(crc_ctx_t* ctx, const uint8_t* data, uint16_t length);
+
+/*! \brief Returns the CRC of all data passed to crc_update() since crc_init() */
+uint16_t crc_final(crc_ctx_t* ctx);
+
+/*! \brief Calculate the CRC of a single buffer, equivalent to crc_init(), crc_update() and crc_final() */
+uint16_t crc_calculate(const uint8_t* data, uint16_t length);
 
 #endif /* CRC_H_ */
 
@@ -34,6 +34,8 @@
 
 #include "dae.h"
 #include "fs.h"
+#include "scheduler.h"
+#include "perf_counters.h"
 
 #define D7A_FILE_UID_FILE_ID 0x00
 #define D7A_FILE_UID_SIZE 8
@@ -72,7 +74,26 @@
 #define D7A_FILE_NWL_SECURITY_KEY_SIZE	16
 
 #define D7A_FILE_NWL_SECURITY_STATE_REG			0x0F
-#define D7A_FILE_NWL_SECURITY_STATE_REG_SIZE	2 + (FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE)*(D7A_FILE_NWL_SECURITY_SIZE + D7A_FILE_UID_SIZE)
+#define D7A_FILE_NWL_SECURITY_STATE_REG_HEADER_SIZE	2
+#define D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE	(D7A_FILE_NWL_SECURITY_SIZE + D7A_FILE_UID_SIZE)
+#define D7A_FILE_NWL_SECURITY_STATE_REG_SIZE	(D7A_FILE_NWL_SECURITY_STATE_REG_HEADER_SIZE + (FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE)*D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE)
+
+// Proprietary file, using the first system file id not used by the specification. The file is only available when
+// FRAMEWORK_SCHED_PROFILING is set and its content is generated from the scheduler profile when it is read, writing
+// it resets the profile. All fields are big endian, times are in timer ticks:
+// |version|task count|priority count|histogram bucket count|time since reset (4)|low power time (4)|low power count (4)|
+// |queue high watermark per priority|task records|
+// with each task record:
+// |task address (4)|invocations (4)|total run time (4)|max run time (4)|total latency (4)|max latency (4)|histogram (2 per bucket)|
+#define D7A_FILE_SCHED_PROFILE_FILE_ID 0x2F
+#define D7A_FILE_SCHED_PROFILE_VERSION 0x00
+#define D7A_FILE_SCHED_PROFILE_HEADER_SIZE (16 + MIN_PRIORITY + 1)
+#define D7A_FILE_SCHED_PROFILE_TASK_SIZE (24 + 2 * SCHED_PROFILE_HISTOGRAM_BUCKETS)
+
+// Proprietary file containing the fields of perf_counters_t as big endian uint32_t, only available when
+// FRAMEWORK_PERF_COUNTERS is set. Like the scheduler profile it is generated when read and writing it resets the counters.
+#define D7A_FILE_PERF_COUNTERS_FILE_ID 0x30
+#define D7A_FILE_PERF_COUNTERS_SIZE sizeof(perf_counters_t)
 
 #define D7AP_FS_SYSTEMFILES_COUNT 0x2F // reserved up until 0x3F but used only until 0x2F so use this for limiting memory usage
 #define D7AP_FS_USERFILES_COUNT (FRAMEWORK_FS_FILE_COUNT - D7AP_FS_SYSTEMFILES_COUNT)
@@ -88,7 +109,23 @@ typedef enum {
 } engineering_mode_t;
 
 
+/*! \brief Statistics of the d7ap_fs cache
+ *
+ * The saved writes and bytes are the number of writes and bytes written by the callers minus the ones
+ * which were actually written to the blockdevice when flushing the written back files.
+ */
+typedef struct {
+  uint32_t header_reads_saved;
+  int32_t writes_saved;
+  int32_t bytes_saved;
+  uint32_t flushes;
+} d7ap_fs_cache_stats_t;
+
 void d7ap_fs_init();
+
+/*! \brief Write the pending changes of the files kept in the cache to the blockdevice */
+void d7ap_fs_flush();
+const d7ap_fs_cache_stats_t* d7ap_fs_get_cache_stats();
 int d7ap_fs_init_file(uint8_t file_id, const d7ap_fs_file_header_t* file_header, const uint8_t* initial_data);
 
 int d7ap_fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_t length);
@@ -111,8 +148,10 @@ int d7ap_fs_read_nwl_security_key(uint8_t* key);
 int d7ap_fs_read_nwl_security(dae_nwl_security_t *nwl_security);
 int d7ap_fs_write_nwl_security(dae_nwl_security_t *nwl_security);
 int d7ap_fs_read_nwl_security_state_register(dae_nwl_ssr_t *node_security_state);
-int d7ap_fs_add_nwl_security_state_register_entry(dae_nwl_trusted_node_t *trusted_node, uint8_t trusted_node_nb);
-int d7ap_fs_update_nwl_security_state_register(dae_nwl_trusted_node_t *trusted_node, uint8_t trusted_node_index);
+int d7ap_fs_write_nwl_security_state_register(const dae_nwl_ssr_t *node_security_state);
+uint16_t d7ap_fs_get_nwl_security_state_register_capacity(void);
+int d7ap_fs_read_nwl_security_state_register_entry(uint16_t index, dae_nwl_trusted_node_t *trusted_node);
+int d7ap_fs_write_nwl_security_state_register_entry(uint16_t index, const dae_nwl_trusted_node_t *trusted_node);
 
 uint32_t d7ap_fs_get_file_length(uint8_t file_id);
 
@@ -138,10 +138,10 @@ typedef struct {
     //bool used;  /* to be used if it is possible to remove a trusted node from the table */
 } dae_nwl_trusted_node_t;
 
+/* The header of the security state register file, the trusted node entries follow */
 typedef struct {
     uint8_t filter_mode;
     uint8_t trusted_node_nb;
-    dae_nwl_trusted_node_t trusted_node_table[FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE];
 } dae_nwl_ssr_t;
 
 #endif /* DAE_H_ */
@@ -44,25 +44,61 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
-typedef struct {
-	uint8_t cost;
-	uint16_t path;
-} VITERBIPATH;
+#define FEC_TRACEBACK_LENGTH 16
 
-typedef struct {
-	uint8_t path_size;
-	VITERBIPATH* old;
-	VITERBIPATH* new;
-	VITERBIPATH states1[8];
-	VITERBIPATH states2[8];
-} VITERBISTATE;
+// the Viterbi decoder works on 32 bit words on 32 bit targets, where 64 bit arithmetic is emulated in software
+#if !defined(FEC_VITERBI_32BIT_LANES) && UINTPTR_MAX <= 0xFFFFFFFF
+#define FEC_VITERBI_32BIT_LANES
+#endif
 
-//void print_array(uint8_t* buffer, uint8_t length);
+/*! \brief State of the Viterbi decoder of a single packet
+ *
+ * All decoder state is kept in this structure, so several packets (for example a packet header and
+ * a complete packet) can be decoded at the same time.
+ */
+typedef struct {
+#ifdef FEC_VITERBI_32BIT_LANES
+    uint32_t costs[2];                              /**< The path cost of the trellis states 0-3 and 4-7, one per byte */
+#else
+    uint64_t costs;                                 /**< The path cost of the 8 trellis states, one per byte */
+#endif
+    uint8_t decisions[FEC_TRACEBACK_LENGTH];        /**< The survivor decisions of the last bits, one bit per state */
+    uint8_t bit_count;                              /**< The number of decoded bits (modulo 256) */
+    uint16_t decoded_bytes;                         /**< The number of decoded bytes, including the undecided ones */
+    uint8_t input[4];                               /**< Input bytes of an incomplete interleaved block */
+    uint8_t input_length;
+    uint8_t* output;
+    uint16_t output_size;
+    uint16_t output_length;
+} fec_decoder_t;
 
 uint16_t fec_encode(uint8_t *data, uint16_t nbytes);
 uint16_t fec_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length);
 uint16_t fec_calculated_decoded_length(uint16_t packet_length);
 
+/*! \brief Start decoding a new packet
+ *
+ * \param output       The buffer where the decoded data is written, this can be the input buffer
+ *                     since the output never overtakes the input.
+ * \param output_size  The size of the output buffer, decoded data beyond this size is dropped.
+ */
+void fec_decoder_init(fec_decoder_t* decoder, uint8_t* output, uint16_t output_size);
+
+/*! \brief Decode the next part of a packet
+ *
+ * The data can be fed in parts of any size (for example the content of the radio FIFO), the
+ * decoder decides a byte when the 8 bits following it have been received.
+ *
+ * \return The number of bytes which are decoded so far
+ */
+uint16_t fec_decoder_feed(fec_decoder_t* decoder, uint8_t* data, uint16_t length);
+
+/*! \brief Decode the last byte of the packet
+ *
+ * \return The number of decoded bytes
+ */
+uint16_t fec_decoder_finish(fec_decoder_t* decoder);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,10 +41,36 @@ typedef struct {
     uint16_t tail_idx;      /**< The index in buffer to first empty byte of the FIFO */
     uint16_t max_size;      /**< The maximum number of bytes contained in the FIFO */
     uint8_t* buffer;        /**< The buffer where the data is stored*/
+    uint16_t index_mask;    /**< max_size - 1 when max_size is a power of 2, which allows wrapping indices by masking. 0 otherwise */
     bool is_full;          /**< Used to discern between full and empty when tail_idx == head_idx */
     bool is_subview;
 } fifo_t;
 
+/**
+ * @brief A contiguous region in the buffer of a FIFO
+ *
+ * The free space or the contents of a FIFO can wrap around the end of the buffer, so these are described by
+ * (at most) 2 spans. When the region does not wrap the second span has length 0.
+ **/
+typedef struct {
+    uint8_t* data;          /**< Pointer to the first byte of the region, inside the FIFO buffer */
+    uint16_t len;           /**< Number of bytes in the region */
+} fifo_span_t;
+
+/**
+ * @brief Single-producer/single-consumer FIFO state
+ *
+ * The head is only written by the consumer and the tail only by the producer. Both are free running counters
+ * which are wrapped into the buffer by masking, so max_size has to be a power of 2. This allows using the FIFO
+ * between an ISR and a task without start_atomic(), as long as there is only one producer and one consumer.
+ **/
+typedef struct {
+    uint16_t head;          /**< Free running count of bytes read, only written by the consumer */
+    uint16_t tail;          /**< Free running count of bytes written, only written by the producer */
+    uint16_t max_size;      /**< The maximum number of bytes contained in the FIFO, a power of 2 */
+    uint8_t* buffer;        /**< The buffer where the data is stored*/
+} fifo_spsc_t;
+
 /**
  * @brief Initializes the fifo.
  * @param fifo          Fifo state, initialized by this function
@@ -136,6 +162,40 @@ uint16_t fifo_get_size(fifo_t* fifo);
  */
 bool fifo_is_full(fifo_t* fifo);
 
+/**
+ * @brief Returns the free space in the FIFO as (at most) 2 contiguous spans starting from the tail, so the caller can
+ * produce data in place, for example by DMA. The data becomes part of the FIFO when calling fifo_commit().
+ * @param fifo      Pointer to the fifo object
+ * @param spans     Filled with the free regions, the second one has length 0 when the free space does not wrap
+ * @return Total number of free bytes, 0 when the FIFO is full or a subview
+ */
+uint16_t fifo_reserve(fifo_t* fifo, fifo_span_t spans[2]);
+
+/**
+ * @brief Appends len bytes, which were written in the spans returned by fifo_reserve(), to the FIFO
+ * @param fifo      Pointer to the fifo object
+ * @param len       Number of bytes to append
+ * @returns SUCCESS, ESIZE when len exceeds the free space or EINVAL when fifo is a subview
+ */
+error_t fifo_commit(fifo_t* fifo, uint16_t len);
+
+/**
+ * @brief Returns the contents of the FIFO as (at most) 2 contiguous spans starting from the head, so the caller can
+ * process the data in place. The data is removed from the FIFO by calling fifo_consume().
+ * @param fifo      Pointer to the fifo object
+ * @param spans     Filled with the regions containing data, the second one has length 0 when the data does not wrap
+ * @return Number of bytes currently in the FIFO
+ */
+uint16_t fifo_peek_spans(fifo_t* fifo, fifo_span_t spans[2]);
+
+/**
+ * @brief Removes len bytes, previously accessed using fifo_peek_spans(), from the head of the FIFO
+ * @param fifo      Pointer to the fifo object
+ * @param len       Number of bytes to remove
+ * @returns SUCCESS or ESIZE if len > current size
+ */
+error_t fifo_consume(fifo_t* fifo, uint16_t len);
+
 /**
  * @brief Remove the last byte put in the FIFO
  * @param fifo      Pointer to the fifo object
@@ -143,6 +203,59 @@ bool fifo_is_full(fifo_t* fifo);
  */
 error_t fifo_remove_last_byte(fifo_t* fifo);
 
+/**
+ * @brief Initializes the single-producer/single-consumer fifo.
+ * @param fifo          Fifo state, initialized by this function
+ * @param buffer        The buffer used for the fifo, the caller is responsible for allocating this to be big enough for max_size
+ * @param max_size      The maximum size of bytes contained in the FIFO, has to be a power of 2
+ */
+void fifo_spsc_init(fifo_spsc_t* fifo, uint8_t* buffer, uint16_t max_size);
+
+/**
+ * @brief Returns the number of bytes currently in the FIFO. Can be called from both the producer and the consumer.
+ * @param fifo      Pointer to the fifo object
+ * @return Number of bytes currently in the FIFO
+ */
+uint16_t fifo_spsc_get_size(fifo_spsc_t* fifo);
+
+/**
+ * @brief Put bytes in to the FIFO. Only to be called by the producer.
+ * @param fifo  Pointer to the fifo object
+ * @param data  Pointer to the data to be put in the FIFO
+ * @param len   Number of bytes to put in the FIFO
+ * @returns SUCCESS or ESIZE when data would overwrite head of FIFO, in which case nothing is added
+ */
+error_t fifo_spsc_put(fifo_spsc_t* fifo, uint8_t const* data, uint16_t len);
+
+/**
+ * @brief Read and pop bytes from the FIFO. Only to be called by the consumer.
+ * @param fifo      Pointer to the fifo object
+ * @param buffer    Pointer to buffer where the first len bytes of FIFO can be copied to
+ * @param len       number of bytes to read/pop
+ * @returns SUCCESS or ESIZE if len > current size
+ */
+error_t fifo_spsc_pop(fifo_spsc_t* fifo, uint8_t* buffer, uint16_t len);
+
+/**
+ * @brief Same as fifo_reserve(), only to be called by the producer
+ */
+uint16_t fifo_spsc_reserve(fifo_spsc_t* fifo, fifo_span_t spans[2]);
+
+/**
+ * @brief Same as fifo_commit(), only to be called by the producer
+ */
+error_t fifo_spsc_commit(fifo_spsc_t* fifo, uint16_t len);
+
+/**
+ * @brief Same as fifo_peek_spans(), only to be called by the consumer
+ */
+uint16_t fifo_spsc_peek_spans(fifo_spsc_t* fifo, fifo_span_t spans[2]);
+
+/**
+ * @brief Same as fifo_consume(), only to be called by the consumer
+ */
+error_t fifo_spsc_consume(fifo_spsc_t* fifo, uint16_t len);
+
 #endif // FIFO_H
 
 /** @}*/
@@ -93,6 +93,16 @@ void fs_init();
 int fs_init_file(uint8_t file_id, fs_storage_class_t storage, const uint8_t* initial_data, uint32_t length);
 int fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_t length);
 int fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length);
+
+/* \brief Writes to the file like fs_write_file(), but without calling the file modified callback
+ *
+ * For caches which notify the modification when the file is written and only persist it later, using fs_notify_file_modified()
+ * **/
+int fs_persist_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length);
+
+/* \brief Calls the file modified callback of the file, if one is registered
+ * **/
+void fs_notify_file_modified(uint8_t file_id);
 fs_file_stat_t *fs_file_stat(uint8_t file_id);
 
 bool fs_register_file_modified_callback(uint8_t file_id, fs_modified_file_callback_t callback);
@@ -29,6 +29,11 @@
  * Logging can be globally enabled or disabled by setting or clearing the 
  * 'FRAMEWORK_LOG_ENABLED' CMake option.
  *
+ * When the 'FRAMEWORK_LOG_BINARY' option is set the messages are not formatted on the target. The address of
+ * the format string, the arguments (as pointer sized words), a timestamp and the layer are stored in a buffer instead,
+ * which is written out by an idle priority task. tools/log/decode_binary_log.py expands the messages using the
+ * strings in the ELF file. '%s' arguments are only expanded when they point to a constant string.
+ *
  * \author maarten.weyn@uantwerpen.be
  * \author glenn.ergeerts@uantwerpen.be
  * \author daniel.vandenakker@uantwerpen.be
@@ -58,9 +63,33 @@ typedef enum
 
 #ifdef FRAMEWORK_LOG_ENABLED
 
+/*! \brief Initialise the logging, called during framework bootstrap after the scheduler */
+__LINK_C void log_init(void);
+
 /*! \brief Reset the log counter back to zero */
 __LINK_C void log_counter_reset(void);
 
+#ifdef FRAMEWORK_LOG_BINARY
+
+// the layer of messages logged using log_print_string()
+#define LOG_BINARY_LAYER_NONE 0x00
+
+// the number of arguments passed, including the format string (at most 16)
+#define LOG_NARGS(...) LOG_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define LOG_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+
+/*! \brief Store a binary log record for a message with arg_count arguments following the format string */
+__LINK_C void log_binary_print_string(uint8_t layer, uint8_t arg_count, const char* format, ...);
+
+/*! \brief Store binary log records containing the raw data */
+__LINK_C void log_binary_print_data(uint8_t* message, uint32_t length);
+
+#define log_print_string(...) log_binary_print_string(LOG_BINARY_LAYER_NONE, LOG_NARGS(__VA_ARGS__) - 1, __VA_ARGS__)
+#define log_print_stack_string(type, ...) log_binary_print_string(type, LOG_NARGS(__VA_ARGS__) - 1, __VA_ARGS__)
+#define log_print_data(message, length) log_binary_print_data(message, length)
+
+#else
+
 /*! \brief Log a string which can be optionally formatted using printf() style
  * format specifiers. */
 __LINK_C void log_print_string(char* format,...);
@@ -72,7 +101,10 @@ __LINK_C void log_print_stack_string(log_stack_layer_t type, char* format, ...);
 /*! \brief Log raw data */
 __LINK_C void log_print_data(uint8_t* message, uint32_t length);
 
+#endif // FRAMEWORK_LOG_BINARY
+
 #else
+    #define log_init() ((void)0)
     #define log_counter_reset() ((void)0)
     #define log_print_string(...) ((void)0)
     #define log_print_stack_string(...) ((void)0)
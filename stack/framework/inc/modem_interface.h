@@ -20,9 +20,18 @@ typedef void (*cmd_handler_t)(fifo_t* cmd_fifo);
 typedef void (*target_rebooted_callback_t)(system_reboot_reason_t reboot_reason);
 
 /*
+v0, one message per frame:
 ---------------HEADER(bytes)---------------------
 |sync|sync|counter|message type|length|crc1|crc2|
 -------------------------------------------------
+
+v1, the payload is a sequence of records which each contain a message, the crc also covers seq, ack and length:
+---------------HEADER(bytes)---------------------
+|sync|sync|seq|ack|length|crc1|crc2|
+-------------------------------------
+-----------RECORD(bytes)----------
+|message type|length|message ...|
+----------------------------------
 */
 
 /** @brief Initialize the modem interface by registering
@@ -39,9 +48,20 @@ void modem_interface_init(uint8_t idx, uint32_t baudrate, pin_id_t mcu2modem, pi
  *  @param bytes Bytes that need to be transmitted
  *  @param length Length of bytes
  *  @param type type of message (SERIAL_MESSAGE_TYPE_ALP, SERIAL_MESSAGE_TYPE_PING_REQUEST, SERIAL_MESSAGE_TYPE_LOGGING, ...)
- *  @return Void.
+ *  @return SUCCESS, or EBUSY when there is no room for the message yet, it is not transmitted in that case
+ */
+error_t modem_interface_transfer_bytes(uint8_t* bytes, uint8_t length, serial_message_type_t type);
+/** @brief Transmits the concatenation of the segments as one message, without copying them into one buffer first
+ *  @param segments The data of each segment
+ *  @param lengths The length of each segment, the total length should not exceed 255 bytes
+ *  @param segment_count The number of segments
+ *  @param type type of message
+ *  @return SUCCESS, or EBUSY when there is no room for the message yet, it is not transmitted in that case
+ *
+ *  Using protocol v1 the message is batched with other messages transferred before the pending tasks complete,
+ *  and kept until the peer acknowledges it. The messages are transmitted in the order they were accepted.
  */
-void modem_interface_transfer_bytes(uint8_t* bytes, uint8_t length, serial_message_type_t type);
+error_t modem_interface_transfer_segments(uint8_t* const* segments, const uint8_t* lengths, uint8_t segment_count, serial_message_type_t type);
 /** @brief Transmits a string by adding a header and putting it in the UART fifo
  *  @param string Bytes that need to be transmitted
  *  @return Void.
@@ -43,11 +43,14 @@ static inline size_t get_node_global_id() { assert(__ng_node_id__ < __ng_max_nod
 
 #define NG(var)			(__ng_glob_ ## var ## __[(get_node_global_id())])
 #define NGDEF(var)		(__ng_glob_ ## var ## __[__ng_max_nodes__])
+// initialises the instance of every node with the same value (uses a GNU range designator)
+#define NGINIT(...)		{ [0 ... __ng_max_nodes__ - 1] = __VA_ARGS__ }
 
 #else
 
 #define NGDEF(var)	(__ng_single_ ## var ## __)
 #define NG(var)		(__ng_single_ ## var ## __)
+#define NGINIT(...)	__VA_ARGS__
 
 
 #endif //defined(NODE_GLOBALS)
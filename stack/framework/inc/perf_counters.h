@@ -0,0 +1,84 @@
+/*! \file perf_counters.h
+ *
+
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*! \file perf_counters.h
+ * \addtogroup perf_counters
+ * \ingroup framework
+ * @{
+ * \brief Event counters of the whole stack, for diagnosing capacity problems in the field
+ *
+ * The counters are only kept when the 'FRAMEWORK_PERF_COUNTERS' CMake option is set, otherwise the macros
+ * compile to nothing. They are incremented without atomic sections, an increment from an interrupt which
+ * preempts another increment of the same counter can be lost, which is acceptable for statistics.
+ * The counters can be read (and reset by writing) over ALP through the performance counters D7A system file.
+ */
+
+#ifndef PERF_COUNTERS_H_
+#define PERF_COUNTERS_H_
+
+#include <stdint.h>
+#include "framework_defs.h"
+#include "link_c.h"
+#include "ng.h"
+
+/*! \brief The counters, all fields are uint32_t and the order is the order of the fields in the D7A file */
+typedef struct
+{
+    uint32_t phy_rx_frames;
+    uint32_t phy_rx_bytes;
+    uint32_t phy_tx_frames;
+    uint32_t phy_tx_bytes;
+    uint32_t phy_crc_failures;
+    uint32_t phy_fec_errors;
+    uint32_t dll_cca_attempts;
+    uint32_t dll_cca_failures; // CSMA-CA gave up, the frame was not transmitted
+    uint32_t dll_csma_ca_retries; // a CCA found the channel busy and the next slot is tried
+    uint32_t d7anp_replay_rejections;
+    uint32_t d7atp_response_period_timeouts;
+    uint32_t d7asp_request_retries;
+    uint32_t d7asp_request_drops; // the retry limit was reached
+    uint32_t packet_queue_alloc_failures;
+    uint32_t alp_command_alloc_failures;
+    uint32_t modem_crc_errors;
+    uint32_t modem_missed_frames;
+} perf_counters_t;
+
+#ifdef FRAMEWORK_PERF_COUNTERS
+
+extern perf_counters_t NGDEF(perf_counters);
+
+#define PERF_COUNTER_INC(counter) (NG(perf_counters).counter++)
+#define PERF_COUNTER_ADD(counter, value) (NG(perf_counters).counter += (value))
+
+/*! \brief Returns the current values of the counters */
+__LINK_C const perf_counters_t* perf_counters_get(void);
+
+/*! \brief Reset all counters to zero */
+__LINK_C void perf_counters_reset(void);
+
+#else
+
+#define PERF_COUNTER_INC(counter) ((void)0)
+#define PERF_COUNTER_ADD(counter, value) ((void)0)
+
+#endif // FRAMEWORK_PERF_COUNTERS
+
+#endif /* PERF_COUNTERS_H_ */
+
+/** @}*/
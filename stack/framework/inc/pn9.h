@@ -34,11 +34,22 @@
 
 #define PN9_INITIALIZER (0x1ff)
 
+/*
+ * Length of the PN9 sequence in bytes, after this the whitening sequence repeats itself
+ */
+#define PN9_PERIOD (511)
+
 /*
  * PN9 Encoder used for data whitening
  */
 void pn9_encode(uint8_t *data, uint16_t length);
 
+/*
+ * PN9 Encoder which resumes the whitening sequence at byte 'offset', this allows to (de)whiten
+ * a packet in several parts. Whitening data at offset 0 is equivalent to pn9_encode().
+ */
+void pn9_encode_offset(uint8_t *data, uint16_t length, uint16_t offset);
+
 #endif // PN9_H_
 
 /** @}*/
@@ -0,0 +1,74 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2019 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file radio_capture.h
+ * \addtogroup radio_capture
+ * \ingroup framework
+ * @{
+ * \brief The format of radio captures, as recorded by the sniffer app and replayed on the NATIVE platform
+ *
+ * A capture file starts with a radio_capture_header_t, followed by one radio_capture_record_t per received frame,
+ * each followed by the bytes of the frame. The frames are stored coded (PN9 whitening and FEC) as read from the
+ * radio, unless the radio decoded them already, which is indicated by the flags. All fields are little endian.
+ *
+ * Coded frames contain the bit errors of the air, so a replay exercises the FEC correction and counts phy_fec_errors
+ * like the receiver did. A replay codes decoded frames again without errors, so it does not reproduce these.
+ *
+ * The sniffer sends the records over the console, each preceded by RADIO_CAPTURE_SERIAL_SYNC and
+ * RADIO_CAPTURE_SERIAL_RECORD, tools/capture/sniffer_to_capture.py converts this into a capture file.
+ */
+
+#ifndef RADIO_CAPTURE_H_
+#define RADIO_CAPTURE_H_
+
+#include "types.h"
+
+#define RADIO_CAPTURE_MAGIC 0x43413744 // "D7AC"
+#define RADIO_CAPTURE_VERSION 1
+
+#define RADIO_CAPTURE_SERIAL_SYNC 0xC0
+#define RADIO_CAPTURE_SERIAL_RECORD 0x02
+
+/*! \brief The PN9 whitening is removed */
+#define RADIO_CAPTURE_FLAG_PN9_DECODED (1 << 0)
+/*! \brief The FEC is decoded, only relevant for frames received on a FEC channel */
+#define RADIO_CAPTURE_FLAG_FEC_DECODED (1 << 1)
+
+typedef struct __attribute__((__packed__))
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t _rfu[3];
+    uint32_t ticks_per_sec;         /**< The resolution of the timestamps of the records */
+} radio_capture_header_t;
+
+typedef struct __attribute__((__packed__))
+{
+    uint32_t timestamp;             /**< The time at which the frame was received, wraps around */
+    uint8_t channel_header;         /**< The raw D7A channel header of the channel the radio was tuned to */
+    uint16_t center_freq_index;
+    uint8_t syncword_class;
+    int16_t rssi;                   /**< In dBm */
+    uint8_t lqi;
+    uint8_t flags;                  /**< RADIO_CAPTURE_FLAG_* */
+    uint16_t length;                /**< The number of bytes of the frame, following this record */
+} radio_capture_record_t;
+
+#endif /* RADIO_CAPTURE_H_ */
+
+/** @}*/
@@ -30,12 +30,25 @@
 
 #include "link_c.h"
 #include "types.h"
+#include "framework_defs.h"
 
 /*! \brief Type definition for tasks
  *
  */
 typedef void (*task_t)(void *arg);
 
+/*! \brief Handle to a registered task
+ *
+ * Handles are assigned by sched_register_task_handle() and allow posting and cancelling a task
+ * without looking up the function pointer first. Use these from hot paths such as interrupt handlers.
+ */
+typedef uint8_t sched_task_handle_t;
+
+/*! \brief The handle returned by sched_get_task_handle() for a task that is not registered
+ *
+ */
+#define SCHED_INVALID_TASK_HANDLE 0xFF
+
 /*! \brief Initialise the scheduler sub system. 
  *
  * This function is called while bootstrapping the framework. On no account should you call this function 
@@ -57,6 +70,16 @@ __LINK_C void scheduler_init();
  */
 __LINK_C void scheduler_run();
 
+/*! \brief Execute the tasks that are pending and return as soon as no task is ready anymore
+ *
+ * This is the task loop of scheduler_run() without entering low power mode. It is meant for platforms
+ * that drive the framework themselves, for instance a simulator hosting several nodes in one process
+ * which runs the pending tasks of a node after delivering an (interrupt) event to it.
+ * Like scheduler_run() this function should NOT be called by the application.
+ *
+ */
+__LINK_C void scheduler_run_pending_tasks();
+
 enum
 {
 	/*! \brief The minimum allowed priority for scheduled tasks
@@ -85,6 +108,27 @@ enum
  */
 __LINK_C error_t sched_register_task(task_t task);
 
+/*! \brief Register a task with the task scheduler and retrieve its handle.
+ *
+ * Behaves like sched_register_task() but also returns the handle of the task, which can be passed to
+ * sched_post_handle_prio(), sched_cancel_handle() and sched_is_handle_scheduled().
+ *
+ * \param task		The task to register
+ * \param handle	Set to the handle of the task, also when the task was already registered. May be NULL.
+ *
+ * \return error_t 	SUCCESS if the task was registered successfully
+ *                  EALREADY if the task was already registered
+ */
+__LINK_C error_t sched_register_task_handle(task_t task, sched_task_handle_t* handle);
+
+/*! \brief Retrieve the handle of a registered task
+ *
+ * \param task		The task to look up
+ *
+ * \return sched_task_handle_t	The handle of the task or SCHED_INVALID_TASK_HANDLE if the task is not registered
+ */
+__LINK_C sched_task_handle_t sched_get_task_handle(task_t task);
+
 /*! \brief Post a task with the given priority
  *
  * \param task		The task to be executed by the scheduler
@@ -109,6 +153,27 @@ __LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg);
  */
 static inline error_t sched_post_task(task_t task) { return sched_post_task_prio(task,DEFAULT_PRIORITY, NULL);}
 
+/*! \brief Post a task, identified by its handle, with the given priority
+ *
+ * Equivalent to sched_post_task_prio() but indexes the task directly instead of searching
+ * the registered function pointers.
+ *
+ * \param handle	The handle of the task, as returned by sched_register_task_handle()
+ * \param priority	The priority of the task
+ *
+ * \return error_t	SUCCESS if the task was successfully scheduled
+ *			EINVAL if the handle does not belong to a registered task
+ *			ESIZE if the priority is not between MAX_PRIORITY and MIN_PRIORITY
+ *			EALREADY if the task was already scheduled. If this is the case,
+ *			the task will be executed but only once.
+ */
+__LINK_C error_t sched_post_handle_prio(sched_task_handle_t handle, uint8_t priority, void *arg);
+
+/*! \brief Post a task, identified by its handle, at the default priority
+ *
+ */
+static inline error_t sched_post_handle(sched_task_handle_t handle) { return sched_post_handle_prio(handle, DEFAULT_PRIORITY, NULL);}
+
 /*! \brief Cancel an already scheduled task
  *
  * \param task		The task to cancel
@@ -119,16 +184,95 @@ static inline error_t sched_post_task(task_t task) { return sched_post_task_prio
  */
 __LINK_C error_t sched_cancel_task(task_t task);
 
+/*! \brief Cancel an already scheduled task, identified by its handle
+ *
+ * \param handle	The handle of the task to cancel
+ *
+ * \return error_t	SUCCESS if the task was cancelled successfully
+ * 			EINVAL if the handle does not belong to a registered task
+ *			EALREADY if the task was not scheduled or has already been executed
+ */
+__LINK_C error_t sched_cancel_handle(sched_task_handle_t handle);
+
 /*! \brief Check whether a task is scheduled to be executed
  *
  * \return bool		TRUE if the task is scheduled, FALSE otherwise
  */
 __LINK_C bool sched_is_scheduled(task_t task);
 
+/*! \brief Check whether a task, identified by its handle, is scheduled to be executed
+ *
+ * \return bool		TRUE if the task is scheduled, FALSE otherwise
+ */
+__LINK_C bool sched_is_handle_scheduled(sched_task_handle_t handle);
+
 
 __LINK_C uint8_t sched_get_low_power_mode(void);
 __LINK_C void    sched_set_low_power_mode(uint8_t mode);
 
+#ifdef FRAMEWORK_SCHED_PROFILING
+
+/*! \brief The number of run time histogram buckets per task
+ *
+ * Bucket 0 counts the runs which took 0 timer ticks, bucket i the ones which took between 2^(i-1) and
+ * 2^i - 1 ticks. The last bucket also counts all longer runs.
+ */
+#define SCHED_PROFILE_HISTOGRAM_BUCKETS 8
+
+/*! \brief The profile of a single task, all times are in timer ticks
+ *
+ * The latency is the time between posting the task and the start of its execution.
+ */
+typedef struct
+{
+	uint32_t invocations;
+	uint32_t total_run_time;
+	uint32_t max_run_time;
+	uint32_t total_latency;
+	uint32_t max_latency;
+	uint16_t run_time_histogram[SCHED_PROFILE_HISTOGRAM_BUCKETS]; // saturating
+} sched_task_profile_t;
+
+/*! \brief The profile of the scheduler itself, all times are in timer ticks
+ *
+ */
+typedef struct
+{
+	uint32_t start_time; // the time the profile was reset
+	uint32_t lowpower_time;
+	uint32_t lowpower_count;
+	uint8_t queue_high_watermark[MIN_PRIORITY + 1]; // the maximum number of tasks waiting per priority
+} sched_profile_t;
+
+/*! \brief Retrieve the number of registered tasks, the valid handles are 0 up to this number
+ *
+ */
+__LINK_C uint8_t sched_get_task_count(void);
+
+/*! \brief Retrieve the task registered with the given handle
+ *
+ * \return task_t	The task or NULL if the handle is not valid
+ */
+__LINK_C task_t sched_get_task(sched_task_handle_t handle);
+
+/*! \brief Retrieve the profile of the task registered with the given handle
+ *
+ * \return sched_task_profile_t*	The profile or NULL if the handle is not valid
+ */
+__LINK_C const sched_task_profile_t* sched_get_task_profile(sched_task_handle_t handle);
+
+/*! \brief Retrieve the profile of the scheduler
+ *
+ */
+__LINK_C const sched_profile_t* sched_get_profile(void);
+
+/*! \brief Clear the profiles of the scheduler and of all tasks
+ *
+ */
+__LINK_C void sched_reset_profile(void);
+
+#endif
+
 #endif /* SCHEDULER_H_ */
 
 /** @}*/
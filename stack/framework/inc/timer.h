@@ -117,7 +117,7 @@ __LINK_C timer_tick_t timer_get_counter_value();
  *
  * Please note that posting a task with the framework timers does NOT automatically register
  * it with the scheduler. If the posted task is not registered with the scheduler, the task
- * will not be executed.
+ * is rejected with EINVAL (unless time is 0, in which case it is posted to the scheduler directly).
  *
  * \param task		The task to be scheduled at the given time.
  * \param time		The time at which to schedule the task for execution.
@@ -128,7 +128,8 @@ __LINK_C timer_tick_t timer_get_counter_value();
  *					ENOMEM if the task could not be posted there are already too
  *						   many tasks waiting for execution.
  * 					EALREADY if the task was already scheduled.
- *					EINVAL if an invalid priority was specified.
+ *					EINVAL if an invalid priority was specified or the task is not
+ *						   registered with the scheduler.
  *
  */
 __LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t time, uint8_t priority, timer_tick_t period, void *arg);
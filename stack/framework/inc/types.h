@@ -38,4 +38,13 @@ typedef int error_t;	//use 'int' since it matches the value expected for errors
 
 typedef const char * string_t;
 
+/* \brief Rounds x (at most 16 bit) up to the next power of 2, usable in constant expressions, for example to size
+ * hash tables at compile time
+ */
+#define ROUND_UP_POW2(x) (__SMEAR8((x) - 1) + 1)
+#define __SMEAR1(x) ((x) | ((x) >> 1))
+#define __SMEAR2(x) (__SMEAR1(x) | (__SMEAR1(x) >> 2))
+#define __SMEAR4(x) (__SMEAR2(x) | (__SMEAR2(x) >> 4))
+#define __SMEAR8(x) (__SMEAR4(x) | (__SMEAR4(x) >> 8))
+
 #endif // __FRM_TYPES_H__
@@ -29,6 +29,7 @@
 #include "fifo.h"
 #include "d7ap.h"
 #include "log.h"
+#include "ng.h"
 #include "lorawan_stack.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_ALP_LOG_ENABLED)
@@ -37,22 +38,54 @@
   #define DPRINT(...)
 #endif
 
-alp_interface_t* interfaces[MODULE_ALP_INTERFACE_SIZE];
+// the interfaces are stored on their ID, using linear probing on collisions. Interfaces are never removed so a
+// probe can stop at the first empty slot.
+#define INTERFACE_TABLE_SIZE 16
+#define INTERFACE_TABLE_MASK (INTERFACE_TABLE_SIZE - 1)
+
+#if MODULE_ALP_INTERFACE_SIZE > INTERFACE_TABLE_SIZE
+  #error MODULE_ALP_INTERFACE_SIZE too large for the interface table
+#endif
+
+static alp_interface_t* NGDEF(_interface_table)[INTERFACE_TABLE_SIZE];
+#define interface_table NG(_interface_table)
+
+static uint8_t NGDEF(_interface_count);
+#define interface_count NG(_interface_count)
 
 alp_status_codes_t alp_register_interface(alp_interface_t* itf)
 {
-  for(uint8_t i=0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-    if(interfaces[i] == NULL) {                 //interface empty, add new one
-      interfaces[i] = itf;
+  uint8_t slot = itf->itf_id & INTERFACE_TABLE_MASK;
+  for(uint8_t i = 0; i < INTERFACE_TABLE_SIZE; i++, slot = (slot + 1) & INTERFACE_TABLE_MASK) {
+    if(interface_table[slot] == NULL) {                 //interface empty, add new one
+      if(interface_count == MODULE_ALP_INTERFACE_SIZE)
+        break;
+
+      interface_table[slot] = itf;
+      interface_count++;
       return ALP_STATUS_OK;
-    } else if(interfaces[i]->itf_id == itf->itf_id) { //interface already present, only update
-      interfaces[i] = itf;
-      return ALP_STATUS_PARTIALLY_COMPLETED; 
+    } else if(interface_table[slot]->itf_id == itf->itf_id) { //interface already present, only update
+      interface_table[slot] = itf;
+      return ALP_STATUS_PARTIALLY_COMPLETED;
     }
   }
   return ALP_STATUS_UNKNOWN_ERROR;                  //all slots are taken, return error
 }
 
+alp_interface_t* alp_get_interface(uint8_t itf_id)
+{
+  uint8_t slot = itf_id & INTERFACE_TABLE_MASK;
+  for(uint8_t i = 0; i < INTERFACE_TABLE_SIZE; i++, slot = (slot + 1) & INTERFACE_TABLE_MASK) {
+    if(interface_table[slot] == NULL)
+      return NULL;
+
+    if(interface_table[slot]->itf_id == itf_id)
+      return interface_table[slot];
+  }
+
+  return NULL;
+}
+
 alp_operation_t alp_get_operation(uint8_t* alp_command)
 {
     alp_control_t alp_ctrl;
@@ -277,73 +310,235 @@ void alp_parse_action(fifo_t* fifo, alp_action_t* action) {
   DPRINT("parsed action");
 }
 
-uint8_t alp_get_expected_response_length(fifo_t fifo) {
-  uint8_t expected_response_length = 0;
-
-  while(fifo_get_size(&fifo) > 0) {
-    alp_control_t control;
-    fifo_pop(&fifo, (uint8_t*)&control.raw, 1);
-    switch(control.operation) {
-      case ALP_OP_READ_FILE_DATA:
-        fifo_skip(&fifo, 1); // skip file ID
-        uint32_t offset = alp_parse_length_operand(&fifo); // offset
-        expected_response_length += alp_parse_length_operand(&fifo); // the file length
-        expected_response_length += alp_length_operand_coded_length(expected_response_length); // the length of the provided data operand
-        expected_response_length += alp_length_operand_coded_length(offset) + 1; // the length of the offset operand
-        expected_response_length += 1; // the opcode
-        break;
-      case ALP_OP_READ_FILE_PROPERTIES:
-        fifo_skip(&fifo, 1); //skip file ID
-        break;
-      case ALP_OP_REQUEST_TAG:
-        fifo_skip(&fifo, 1); // skip tag ID operand
-        break;
-      case ALP_OP_RETURN_FILE_DATA:
-      case ALP_OP_WRITE_FILE_DATA:
-        fifo_skip(&fifo, 1); // skip file ID
-        alp_parse_length_operand(&fifo); // offset
-        fifo_skip(&fifo, alp_parse_length_operand(&fifo));
-        break;
-      case ALP_OP_FORWARD: ;
-        uint8_t itf_id;
-        fifo_pop(&fifo, &itf_id, 1);
-        for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-          if((interfaces[i] != NULL) && (itf_id == interfaces[i]->itf_id)) {
-            if(interfaces[i]->itf_id == ALP_ITF_ID_D7ASP) {
-              fifo_skip(&fifo, 2);
-              d7ap_addressee_ctrl_t addressee_ctrl;
-              fifo_pop(&fifo, (uint8_t*)&addressee_ctrl.raw, 1);
-              fifo_skip(&fifo, 1 + d7ap_addressee_id_length(addressee_ctrl.id_type)); // skip addressee ctrl, access class
-            } else 
-              fifo_skip(&fifo, interfaces[i]->itf_cfg_len);
-          }
+// the parse_* functions return false when the operand does not fit in the remaining bytes of the command
+
+static bool parse_byte(const uint8_t* alp_command, uint8_t length, uint8_t* index, uint8_t* value) {
+  if(*index >= length)
+    return false;
+
+  *value = alp_command[(*index)++];
+  return true;
+}
+
+static bool parse_length(const uint8_t* alp_command, uint8_t length, uint8_t* index, uint32_t* value) {
+  uint8_t byte;
+  if(!parse_byte(alp_command, length, index, &byte))
+    return false;
+
+  // the 2 MSBs are the number of additional bytes, which follow in big endian
+  uint8_t field_len = byte >> 6;
+  *value = byte & 0x3F;
+  while(field_len--) {
+    if(!parse_byte(alp_command, length, index, &byte))
+      return false;
+
+    *value = (*value << 8) | byte;
+  }
+
+  return true;
+}
+
+static bool skip_bytes(uint8_t length, uint8_t* index, uint32_t size) {
+  if(size > (uint32_t)(length - *index))
+    return false;
+
+  *index += size;
+  return true;
+}
+
+static alp_status_codes_t parse_action(const uint8_t* alp_command, uint8_t length, uint8_t* index, alp_action_desc_t* action) {
+  uint8_t i = *index;
+  action->start = i;
+  action->response_length = 0;
+  action->data = 0;
+  action->offset = 0;
+  action->length = 0;
+  if(!parse_byte(alp_command, length, &i, &action->ctrl.raw))
+    return ALP_STATUS_INCOMPLETE_OPERAND;
+
+  switch(action->ctrl.operation) {
+    case ALP_OP_READ_FILE_DATA:
+      if(!parse_byte(alp_command, length, &i, &action->id) ||
+         !parse_length(alp_command, length, &i, &action->offset) ||
+         !parse_length(alp_command, length, &i, &action->length))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      // return file data action: opcode, file ID, offset, length and data
+      uint32_t response_length = 2 + alp_length_operand_coded_length(action->offset)
+          + alp_length_operand_coded_length(action->length) + action->length;
+      action->response_length = response_length > UINT8_MAX ? UINT8_MAX : response_length;
+      break;
+    case ALP_OP_READ_FILE_PROPERTIES:
+    case ALP_OP_REQUEST_TAG:
+    case ALP_OP_RESPONSE_TAG:
+      if(!parse_byte(alp_command, length, &i, &action->id))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      break;
+    case ALP_OP_RETURN_FILE_DATA:
+    case ALP_OP_WRITE_FILE_DATA:
+      if(!parse_byte(alp_command, length, &i, &action->id) ||
+         !parse_length(alp_command, length, &i, &action->offset) ||
+         !parse_length(alp_command, length, &i, &action->length))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      action->data = i;
+      if(!skip_bytes(length, &i, action->length))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      break;
+    case ALP_OP_WRITE_FILE_PROPERTIES:
+    case ALP_OP_CREATE_FILE:
+    case ALP_OP_RETURN_FILE_PROPERTIES:
+      if(!parse_byte(alp_command, length, &i, &action->id))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      action->data = i;
+      action->length = sizeof(d7ap_fs_file_header_t);
+      if(!skip_bytes(length, &i, action->length))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      break;
+    case ALP_OP_BREAK_QUERY:
+      if(!parse_byte(alp_command, length, &i, &action->query_code) ||
+         !parse_length(alp_command, length, &i, &action->length))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      action->data = i;
+      if(!skip_bytes(length, &i, action->length) ||
+         !parse_byte(alp_command, length, &i, &action->id) ||
+         !parse_length(alp_command, length, &i, &action->offset))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      break;
+    case ALP_OP_STATUS:
+      if(action->ctrl.b6) {
+        // interface status
+        if(!parse_byte(alp_command, length, &i, &action->id) ||
+           !parse_length(alp_command, length, &i, &action->length))
+          return ALP_STATUS_INCOMPLETE_OPERAND;
+
+        action->data = i;
+        if(!skip_bytes(length, &i, action->length))
+          return ALP_STATUS_INCOMPLETE_OPERAND;
+      } else {
+        // action status, only the status code
+        action->data = i;
+        action->length = 1;
+        if(!skip_bytes(length, &i, action->length))
+          return ALP_STATUS_INCOMPLETE_OPERAND;
+      }
+
+      break;
+    case ALP_OP_FORWARD:
+      if(!parse_byte(alp_command, length, &i, &action->id))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      action->data = i;
+      if(action->id == ALP_ITF_ID_D7ASP) {
+        // QoS, dormant timeout, addressee control, access class and the addressee ID
+        if(!skip_bytes(length, &i, 4))
+          return ALP_STATUS_INCOMPLETE_OPERAND;
+
+        d7ap_addressee_ctrl_t addressee_ctrl;
+        addressee_ctrl.raw = alp_command[action->data + 2];
+        action->length = 4 + d7ap_addressee_id_length(addressee_ctrl.id_type);
+      } else {
+        alp_interface_t* itf = alp_get_interface(action->id);
+        if(itf == NULL) {
+          DPRINT("FORWARD interface %02X not registered", action->id);
+          return ALP_STATUS_UNKNOWN_ERROR;
         }
-        break;
-      case ALP_OP_INDIRECT_FORWARD: ;
-        fifo_skip(&fifo, 1);
-        if(control.b7 && (itf_id == ALP_ITF_ID_D7ASP))
-          fifo_skip(&fifo, 10);
-        break;
-      case ALP_OP_WRITE_FILE_PROPERTIES:
-      case ALP_OP_CREATE_FILE:
-      case ALP_OP_RETURN_FILE_PROPERTIES:
-        fifo_skip(&fifo, 1 + sizeof(d7ap_fs_file_header_t)); // skip file ID & header
-        break;
-      case ALP_OP_BREAK_QUERY:
-        fifo_skip(&fifo, 1);
-        fifo_skip(&fifo, (uint16_t)alp_parse_length_operand(&fifo));
-        fifo_skip(&fifo, 1);
-        alp_parse_length_operand(&fifo);
-        break;
-      // TODO other operations
-      default:
-        DPRINT("op %i not implemented", control.operation);
-        assert(false);
+
+        action->length = itf->itf_cfg_len;
+      }
+
+      i = action->data;
+      if(!skip_bytes(length, &i, action->length))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      break;
+    case ALP_OP_INDIRECT_FORWARD:
+      if(!parse_byte(alp_command, length, &i, &action->id))
+        return ALP_STATUS_INCOMPLETE_OPERAND;
+
+      action->data = i;
+      if(action->ctrl.b7) {
+        // the overloaded part of the D7ASP configuration: addressee control, access class and the addressee ID
+        if(i >= length)
+          return ALP_STATUS_INCOMPLETE_OPERAND;
+
+        d7ap_addressee_ctrl_t addressee_ctrl;
+        addressee_ctrl.raw = alp_command[i];
+        action->length = 2 + d7ap_addressee_id_length(addressee_ctrl.id_type);
+        if(!skip_bytes(length, &i, action->length))
+          return ALP_STATUS_INCOMPLETE_OPERAND;
+      }
+
+      break;
+    // TODO other operations
+    default:
+      DPRINT("op %i not implemented", action->ctrl.operation);
+      return ALP_STATUS_UNKNOWN_OPERATION;
+  }
+
+  action->size = i - action->start;
+  *index = i;
+  return ALP_STATUS_OK;
+}
+
+alp_status_codes_t alp_parse_command(alp_command_desc_t* parsed, uint8_t* alp_command, uint8_t length, uint8_t start) {
+  alp_action_desc_t action;
+  uint32_t expected_response_length = 0;
+  uint8_t index = start;
+
+  parsed->alp_command = alp_command;
+  parsed->length = length;
+  parsed->end = start;
+  parsed->action_count = 0;
+  parsed->status = ALP_STATUS_OK;
+
+  while(index < length) {
+    parsed->status = parse_action(alp_command, length, &index, &action);
+    if(parsed->status != ALP_STATUS_OK)
+      break;
+
+    // the actions which do not fit are only parsed for the response length
+    if(parsed->action_count < ALP_MAX_PARSED_ACTION_COUNT) {
+      parsed->actions[parsed->action_count++] = action;
+      parsed->end = index;
     }
+
+    expected_response_length += action.response_length;
   }
 
+  parsed->expected_response_length = expected_response_length > UINT8_MAX ? UINT8_MAX : expected_response_length;
+  DPRINT("parsed %i actions, expected ALP response length=%i", parsed->action_count, parsed->expected_response_length);
+  return parsed->status;
+}
+
+uint8_t alp_get_remaining_response_length(const alp_command_desc_t* parsed, uint8_t action_index) {
+  uint8_t response_length = parsed->expected_response_length;
+  for(uint8_t i = 0; i < action_index && i < parsed->action_count; i++) {
+    if(parsed->actions[i].response_length >= response_length)
+      return 0; // the total saturated
+
+    response_length -= parsed->actions[i].response_length;
+  }
+
+  return response_length;
+}
+
+uint8_t alp_get_expected_response_length(uint8_t* alp_command, uint8_t length) {
+  alp_action_desc_t action;
+  uint32_t expected_response_length = 0;
+  uint8_t index = 0;
+
+  while(index < length && parse_action(alp_command, length, &index, &action) == ALP_STATUS_OK)
+    expected_response_length += action.response_length;
+
   DPRINT("Expected ALP response length=%i", expected_response_length);
-  return expected_response_length;
+  return expected_response_length > UINT8_MAX ? UINT8_MAX : expected_response_length;
 }
 
 void alp_append_tag_request_action(fifo_t* fifo, uint8_t tag_id, bool eop) {
@@ -50,6 +50,7 @@ static uint8_t alp_resp[ALP_CMD_MAX_SIZE] = { 0x00 };
 alp_interface_t alp_modem_interface;
 
 error_t alp_cmd_send_output(uint8_t* payload, uint8_t payload_length, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* session_config);
+error_t alp_cmd_send_output_segments(const alp_segment_t* segments, uint8_t segment_count, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* session_config);
 
 void modem_interface_cmd_handler(fifo_t* cmd_fifo)
 {
@@ -70,6 +71,7 @@ void alp_cmd_handler_register_interface() {
         .itf_cfg_len = 0,
         .itf_status_len = 0,
         .send_command = alp_cmd_send_output,
+        .send_command_segments = alp_cmd_send_output_segments,
         .init = NULL,
         .deinit = NULL,
         .unique = false
@@ -85,6 +87,20 @@ void alp_cmd_handler_register_interface() {
 error_t alp_cmd_send_output(uint8_t* payload, uint8_t payload_length, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* session_config) {
     DPRINT("sending payload to modem");
     DPRINT_DATA(payload, payload_length);
-    modem_interface_transfer_bytes(payload, payload_length, SERIAL_MESSAGE_TYPE_ALP_DATA);
+    return modem_interface_transfer_bytes(payload, payload_length, SERIAL_MESSAGE_TYPE_ALP_DATA);
+}
+
+error_t alp_cmd_send_output_segments(const alp_segment_t* segments, uint8_t segment_count, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* session_config) {
+    uint8_t* data[ALP_MAX_SEGMENT_COUNT];
+    uint8_t lengths[ALP_MAX_SEGMENT_COUNT];
+    assert(segment_count <= ALP_MAX_SEGMENT_COUNT);
+    DPRINT("sending %i payload segments to modem", segment_count);
+    for(uint8_t i = 0; i < segment_count; i++) {
+        data[i] = segments[i].data;
+        lengths[i] = segments[i].length;
+        DPRINT_DATA(data[i], lengths[i]);
+    }
+
+    return modem_interface_transfer_segments(data, lengths, segment_count, SERIAL_MESSAGE_TYPE_ALP_DATA);
 }
 
@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "types.h"
 #include "debug.h"
 #include "ng.h"
 
@@ -32,6 +33,7 @@
 #include "log.h"
 #include "shell.h"
 #include "timer.h"
+#include "scheduler.h"
 #include "modules_defs.h"
 #include "MODULE_ALP_defs.h"
 
@@ -46,6 +48,7 @@
 #include "alp_layer.h"
 #include "alp_cmd_handler.h"
 #include "modem_interface.h"
+#include "perf_counters.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_ALP_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_ALP, __VA_ARGS__)
@@ -56,85 +59,329 @@
 #endif
 
 static bool NGDEF(_shell_enabled);
-static alp_itf_id_t current_lorawan_interface_type = ALP_ITF_ID_LORAWAN_OTAA;
-static interface_deinit current_itf_deinit = NULL;
+static alp_itf_id_t NGDEF(current_lorawan_interface_type) = NGINIT(ALP_ITF_ID_LORAWAN_OTAA);
+static interface_deinit NGDEF(current_itf_deinit);
 #define shell_enabled NG(_shell_enabled)
 
+// the command and response buffers are allocated from a pool of blocks, sized to what the command needs
+#define BUFFER_BLOCK_SIZE 16
+#if MODULE_ALP_BUFFER_POOL_SIZE == 0
+// room for a typical command and response per active command. Larger ones are served while the pool has room,
+// otherwise the command is refused or the action fails with an error status, counted in the pool stats
+#define BUFFER_POOL_SIZE (MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT * 128)
+#else
+#define BUFFER_POOL_SIZE MODULE_ALP_BUFFER_POOL_SIZE
+#endif
+#define BUFFER_BLOCK_COUNT ((BUFFER_POOL_SIZE + BUFFER_BLOCK_SIZE - 1) / BUFFER_BLOCK_SIZE)
+#define BUFFER_BLOCKS(size) (((size) + BUFFER_BLOCK_SIZE - 1) / BUFFER_BLOCK_SIZE)
+#define RESPONSE_MAX_SIZE UINT8_MAX
+
+#if MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT > 127
+  #error MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT too large
+#endif
+
+// the transaction ID index has at least twice the number of slots as commands, rounded up to a power of 2
+#define TRANS_ID_INDEX_SIZE ROUND_UP_POW2(2 * MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT)
+#define TRANS_ID_INDEX_MASK (TRANS_ID_INDEX_SIZE - 1)
+#define NO_COMMAND 0xFF
+
+// the operation, interface ID and length bytes followed by the status itself
+#define ALP_INTERFACE_STATUS_MAX_SIZE (3 + sizeof(((alp_interface_status_t*)0)->itf_status))
+
 typedef struct {
   bool is_active;
+  bool has_trans_id;        // trans_id is assigned by the interface the command or its response is sent over
   uint16_t trans_id;
   uint8_t tag_id;
   bool respond_when_completed;
   alp_itf_id_t origin_itf_id;
-  fifo_t alp_command_fifo;
-  fifo_t alp_response_fifo;
-  uint8_t alp_command[ALP_PAYLOAD_MAX_SIZE];
-  uint8_t alp_response[ALP_PAYLOAD_MAX_SIZE];
+  alp_command_desc_t parsed_command;
+  fifo_t alp_response_fifo; // the buffer is allocated when the first response data is added
+  uint8_t* alp_command;     // allocated from the buffer pool, alp_command_size bytes
+  uint8_t alp_command_size;
+  uint8_t next_ready;       // the next command of the same ready lane, or NO_COMMAND
 } alp_command_t;
 
+// commands waiting for execution, queued per origin interface. The lanes are served round robin so a burst
+// on one interface does not delay the commands of the others.
+typedef struct {
+  alp_itf_id_t origin_itf_id;
+  uint8_t head;
+  uint8_t tail;
+  uint8_t count;
+} ready_lane_t;
+
+#define READY_LANE_COUNT MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT
+
 static alp_command_t NGDEF(_commands)[MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT];
 #define commands NG(_commands)
 
+// the indices of the inactive commands, used as a stack
+static uint8_t NGDEF(_free_commands)[MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT];
+#define free_commands NG(_free_commands)
+
+static uint8_t NGDEF(_free_command_count);
+#define free_command_count NG(_free_command_count)
+
+// direct mapped on the lower bits of the transaction ID, a miss falls back to searching the active commands
+static uint8_t NGDEF(_trans_id_index)[TRANS_ID_INDEX_SIZE];
+#define trans_id_index NG(_trans_id_index)
+
+static uint8_t NGDEF(_buffer_pool)[BUFFER_BLOCK_COUNT * BUFFER_BLOCK_SIZE];
+#define buffer_pool NG(_buffer_pool)
+
+static uint32_t NGDEF(_buffer_bitmap)[(BUFFER_BLOCK_COUNT + 31) / 32]; // a set bit marks an allocated block
+#define buffer_bitmap NG(_buffer_bitmap)
+
+static alp_layer_command_pool_stats_t NGDEF(_pool_stats);
+#define pool_stats NG(_pool_stats)
+
+static ready_lane_t NGDEF(_ready_lanes)[READY_LANE_COUNT];
+#define ready_lanes NG(_ready_lanes)
+
+static uint8_t NGDEF(_next_ready_lane);
+#define next_ready_lane NG(_next_ready_lane)
+
+static sched_task_handle_t NGDEF(_process_ready_commands_handle);
+#define process_ready_commands_handle NG(_process_ready_commands_handle)
+
+static alp_layer_queue_stats_t NGDEF(_queue_stats);
+#define queue_stats NG(_queue_stats)
+
 static alp_interface_status_t NGDEF( current_status);
 #define current_status NG(current_status)
 
 static alp_init_args_t* NGDEF(_init_args);
 #define init_args NG(_init_args)
 
-static uint8_t alp_client_id = 0;
-static timer_event alp_layer_process_command_timer;
+static uint8_t NGDEF(alp_client_id);
 
-static uint8_t previous_interface_file_id = 0;
-static bool interface_file_changed = true;
-static alp_interface_config_t session_config_saved;
+static uint8_t NGDEF(previous_interface_file_id);
+static bool NGDEF(interface_file_changed) = NGINIT(true);
+static alp_interface_config_t NGDEF(session_config_saved);
 static uint8_t alp_data[ALP_PAYLOAD_MAX_SIZE]; // temp buffer statically allocated to prevent runtime stackoverflows
 static uint8_t alp_data2[ALP_PAYLOAD_MAX_SIZE]; // temp buffer statically allocated to prevent runtime stackoverflows
-static alp_operand_file_data_t file_data_operand; // statically allocated to prevent runtime stackoverflows
 
-extern alp_interface_t* interfaces[MODULE_ALP_INTERFACE_SIZE];
+static alp_interface_config_t* NGDEF(session_config_buffer);
+static bool NGDEF(expect_completed);
 
-static alp_interface_config_t* session_config_buffer;
-static bool expect_completed = false;
-
-static void _async_process_command(void* arg);
+static void _async_process_command(alp_command_t* command);
+static void process_ready_commands();
 static void alp_layer_lorawan_init();
 static void lorawan_error_handler(uint16_t* trans_id, lorawan_stack_status_t status);
 
 
+static bool is_block_allocated(uint16_t block) {
+  return buffer_bitmap[block / 32] & (1UL << (block % 32));
+}
+
+static void set_blocks(uint16_t first_block, uint16_t block_count, bool allocated) {
+  for(uint16_t block = first_block; block < first_block + block_count; block++) {
+    if(allocated)
+      buffer_bitmap[block / 32] |= 1UL << (block % 32);
+    else
+      buffer_bitmap[block / 32] &= ~(1UL << (block % 32));
+  }
+}
+
+static uint8_t* alloc_buffer(uint16_t size) {
+  uint16_t block_count = BUFFER_BLOCKS(size);
+  uint16_t run = 0;
+  // first fit
+  for(uint16_t block = 0; block < BUFFER_BLOCK_COUNT; block++) {
+    if(is_block_allocated(block)) {
+      run = 0;
+      continue;
+    }
+
+    if(++run == block_count) {
+      uint16_t first_block = block + 1 - block_count;
+      set_blocks(first_block, block_count, true);
+      pool_stats.buffer_bytes_used += block_count * BUFFER_BLOCK_SIZE;
+      if(pool_stats.buffer_bytes_used > pool_stats.max_buffer_bytes_used)
+        pool_stats.max_buffer_bytes_used = pool_stats.buffer_bytes_used;
+
+      return buffer_pool + first_block * BUFFER_BLOCK_SIZE;
+    }
+  }
+
+  DPRINT("Could not alloc buffer of %i bytes", size);
+  pool_stats.buffer_alloc_failures++;
+  return NULL;
+}
+
+static void free_buffer(uint8_t* buffer, uint16_t size) {
+  if(buffer == NULL)
+    return;
+
+  uint16_t block_count = BUFFER_BLOCKS(size);
+  set_blocks((buffer - buffer_pool) / BUFFER_BLOCK_SIZE, block_count, false);
+  pool_stats.buffer_bytes_used -= block_count * BUFFER_BLOCK_SIZE;
+}
+
+/* makes sure size bytes can be added to the response, the content is moved to a larger buffer when needed */
+static bool reserve_response(alp_command_t* command, uint16_t size) {
+  fifo_t* fifo = &command->alp_response_fifo;
+  uint16_t response_size = fifo_get_size(fifo);
+  uint16_t needed = response_size + size;
+  if(needed <= fifo->max_size)
+    return true;
+
+  if(needed > RESPONSE_MAX_SIZE)
+    return false;
+
+  uint16_t capacity = BUFFER_BLOCKS(needed) * BUFFER_BLOCK_SIZE;
+  uint8_t* buffer = alloc_buffer(capacity);
+  if(buffer == NULL)
+    return false;
+
+  fifo_pop(fifo, buffer, response_size);
+  free_buffer(fifo->buffer, fifo->max_size);
+  fifo_init_filled(fifo, buffer, response_size, capacity);
+  return true;
+}
+
+// responses are only appended until they are sent, so the data starts at the beginning of the buffer
+static uint8_t* take_response(alp_command_t* command, uint8_t* size) {
+  fifo_t* fifo = &command->alp_response_fifo;
+  *size = (uint8_t)fifo_get_size(fifo);
+  fifo_init(fifo, fifo->buffer, fifo->max_size);
+  return fifo->buffer;
+}
+
+/* sends the segments over the interface, they are gathered in alp_data when the interface cannot send segments itself */
+static error_t send_segments(alp_interface_t* itf, const alp_segment_t* segments, uint8_t segment_count,
+                             uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* itf_cfg) {
+  if(itf->send_command_segments != NULL)
+    return itf->send_command_segments(segments, segment_count, expected_response_length, trans_id, itf_cfg);
+
+  uint8_t length = 0;
+  for(uint8_t i = 0; i < segment_count; i++) {
+    if(segments[i].length > sizeof(alp_data) - length)
+      return ESIZE;
+
+    memcpy(alp_data + length, segments[i].data, segments[i].length);
+    length += segments[i].length;
+  }
+
+  return itf->send_command(alp_data, length, expected_response_length, trans_id, itf_cfg);
+}
+
+/* serializes the interface status operation into buffer, which should hold ALP_INTERFACE_STATUS_MAX_SIZE bytes */
+static uint8_t serialize_interface_status(alp_interface_status_t* status, uint8_t* buffer) {
+  fifo_t fifo;
+  fifo_init(&fifo, buffer, ALP_INTERFACE_STATUS_MAX_SIZE);
+  alp_append_interface_status(&fifo, status);
+  return fifo_get_size(&fifo);
+}
+
+static void remove_ready_command(alp_command_t* command);
+
 static void free_command(alp_command_t* command) {
+  if(!command->is_active)
+    return;
+
   DPRINT("Free cmd %02x", command->trans_id);
-  memset(command, 0, sizeof (alp_command_t));
+  uint8_t index = command - commands;
+  remove_ready_command(command);
+  if(trans_id_index[command->trans_id & TRANS_ID_INDEX_MASK] == index)
+    trans_id_index[command->trans_id & TRANS_ID_INDEX_MASK] = NO_COMMAND;
+
+  // only the header is reset, other fields are initialized on usage
+  free_buffer(command->alp_command, command->alp_command_size);
+  free_buffer(command->alp_response_fifo.buffer, command->alp_response_fifo.max_size);
   command->is_active = false;
-  fifo_init(&command->alp_command_fifo, command->alp_command, ALP_PAYLOAD_MAX_SIZE);
-  fifo_init(&command->alp_response_fifo, command->alp_response, ALP_PAYLOAD_MAX_SIZE);
-  // other fields are initialized on usage
+  command->alp_command = NULL;
+  command->alp_command_size = 0;
+  fifo_init(&command->alp_response_fifo, NULL, 0);
+
+  free_commands[free_command_count++] = index;
+  pool_stats.active_commands--;
 }
 
 static void init_commands()
 {
+  memset(buffer_bitmap, 0, sizeof(buffer_bitmap));
+  memset(trans_id_index, NO_COMMAND, sizeof(trans_id_index));
+  memset(&pool_stats, 0, sizeof(pool_stats));
+  free_command_count = 0;
   for(uint8_t i = 0; i < MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT; i++) {
-    free_command(&commands[i]);
+    commands[i].is_active = false;
+    commands[i].alp_command = NULL;
+    commands[i].alp_command_size = 0;
+    fifo_init(&commands[i].alp_response_fifo, NULL, 0);
+    // the lowest slots are allocated first
+    free_commands[free_command_count++] = MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT - 1 - i;
   }
 }
 
-static alp_command_t* alloc_command()
+/* allocates a command with a buffer of alp_command_size bytes for the command itself (which can be 0) */
+static alp_command_t* alloc_command(uint8_t alp_command_size)
 {
-  for(uint8_t i = 0; i < MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT; i++) {
-    if(commands[i].is_active == false) {
-      commands[i].is_active = true;
-      DPRINT("alloc cmd %p in slot %i", &commands[i], i);
-      return &(commands[i]);
+  if(free_command_count == 0) {
+    DPRINT("Could not alloc command, all %i reserved slots active", MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT);
+    pool_stats.command_alloc_failures++;
+    PERF_COUNTER_INC(alp_command_alloc_failures);
+    return NULL;
+  }
+
+  uint8_t* buffer = NULL;
+  if(alp_command_size > 0) {
+    buffer = alloc_buffer(alp_command_size);
+    if(buffer == NULL) {
+      PERF_COUNTER_INC(alp_command_alloc_failures);
+      return NULL;
     }
   }
 
-  DPRINT("Could not alloc command, all %i reserved slots active", MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT);
-  return NULL;
+  uint8_t index = free_commands[--free_command_count];
+  alp_command_t* command = &commands[index];
+  command->is_active = true;
+  command->has_trans_id = false;
+  command->trans_id = 0;
+  command->tag_id = 0;
+  command->respond_when_completed = false;
+  command->origin_itf_id = ALP_ITF_ID_HOST;
+  command->parsed_command.action_count = 0;
+  command->next_ready = NO_COMMAND;
+  command->alp_command = buffer;
+  command->alp_command_size = alp_command_size;
+
+  pool_stats.active_commands++;
+  if(pool_stats.active_commands > pool_stats.max_active_commands)
+    pool_stats.max_active_commands = pool_stats.active_commands;
+
+  DPRINT("alloc cmd %p in slot %i", command, index);
+  return command;
+}
+
+/* makes the command quickly found by get_command_by_transid(), to be called when the transaction ID is assigned */
+static void index_command(alp_command_t* command) {
+  trans_id_index[command->trans_id & TRANS_ID_INDEX_MASK] = command - commands;
+}
+
+/* sends over the interface, which assigns the transaction ID. The command can already be completed before the
+ * interface returns, so it is found by its transaction ID from the start */
+static error_t send_command(alp_command_t* command, alp_interface_t* itf, uint8_t* payload, uint8_t length,
+                            uint8_t expected_response_length, alp_interface_config_t* itf_cfg) {
+  command->has_trans_id = true;
+  error_t err = itf->send_command(payload, length, expected_response_length, &command->trans_id, itf_cfg);
+  if(!err)
+    index_command(command);
+
+  return err;
 }
 
 static alp_command_t* get_command_by_transid(uint16_t trans_id) {
+  uint8_t index = trans_id_index[trans_id & TRANS_ID_INDEX_MASK];
+  if(index != NO_COMMAND && commands[index].is_active && commands[index].trans_id == trans_id)
+    return &(commands[index]);
+
+  // the commands which were not sent yet have no transaction ID, their trans_id of 0 is not a match
   for(uint8_t i = 0; i < MODULE_ALP_MAX_ACTIVE_COMMAND_COUNT; i++) {
-    if(commands[i].trans_id == trans_id && commands[i].is_active) {
-        DPRINT("command trans Id %i in slot %i", trans_id, i);  
+    if(commands[i].is_active && commands[i].has_trans_id && commands[i].trans_id == trans_id) {
+        DPRINT("command trans Id %i in slot %i", trans_id, i);
+        index_command(&commands[i]);
         return &(commands[i]);
     }
   }
@@ -143,11 +390,106 @@ static alp_command_t* get_command_by_transid(uint16_t trans_id) {
   return NULL;
 }
 
+void alp_layer_get_command_pool_stats(alp_layer_command_pool_stats_t* stats) {
+  *stats = pool_stats;
+}
+
+static void init_ready_queue() {
+  memset(ready_lanes, 0, sizeof(ready_lanes));
+  memset(&queue_stats, 0, sizeof(queue_stats));
+  next_ready_lane = 0;
+}
+
+static void enqueue_ready_command(alp_command_t* command) {
+  uint8_t index = command - commands;
+  ready_lane_t* free_lane = NULL;
+  ready_lane_t* lane = NULL;
+  for(uint8_t i = 0; i < READY_LANE_COUNT; i++) {
+    if(ready_lanes[i].count == 0) {
+      if(free_lane == NULL)
+        free_lane = &ready_lanes[i];
+    } else if(ready_lanes[i].origin_itf_id == command->origin_itf_id) {
+      lane = &ready_lanes[i];
+      break;
+    }
+  }
+
+  command->next_ready = NO_COMMAND;
+  if(lane == NULL) {
+    // there are as many lanes as commands so there is always a free lane
+    assert(free_lane != NULL);
+    lane = free_lane;
+    lane->origin_itf_id = command->origin_itf_id;
+    lane->head = index;
+  } else
+    commands[lane->tail].next_ready = index;
+
+  lane->tail = index;
+  lane->count++;
+
+  queue_stats.queued_commands++;
+  queue_stats.enqueued_commands++;
+  if(queue_stats.queued_commands > queue_stats.max_queued_commands)
+    queue_stats.max_queued_commands = queue_stats.queued_commands;
+}
+
+/* takes the next command, from the lanes in turn */
+static alp_command_t* dequeue_ready_command() {
+  for(uint8_t i = 0; i < READY_LANE_COUNT; i++) {
+    ready_lane_t* lane = &ready_lanes[next_ready_lane];
+    next_ready_lane = (next_ready_lane + 1) % READY_LANE_COUNT;
+    if(lane->count == 0)
+      continue;
+
+    alp_command_t* command = &commands[lane->head];
+    lane->head = command->next_ready;
+    lane->count--;
+    queue_stats.queued_commands--;
+    return command;
+  }
+
+  return NULL;
+}
+
+/* unlinks a command which is freed while it waits for execution */
+static void remove_ready_command(alp_command_t* command) {
+  uint8_t index = command - commands;
+  for(uint8_t i = 0; i < READY_LANE_COUNT; i++) {
+    ready_lane_t* lane = &ready_lanes[i];
+    uint8_t previous = NO_COMMAND;
+    uint8_t current = lane->head;
+    for(uint8_t n = 0; n < lane->count; n++) {
+      if(current == index) {
+        if(previous == NO_COMMAND)
+          lane->head = command->next_ready;
+        else
+          commands[previous].next_ready = command->next_ready;
+
+        if(lane->tail == index)
+          lane->tail = previous;
+
+        lane->count--;
+        queue_stats.queued_commands--;
+        command->next_ready = NO_COMMAND;
+        return;
+      }
+
+      previous = current;
+      current = commands[current].next_ready;
+    }
+  }
+}
+
+void alp_layer_get_queue_stats(alp_layer_queue_stats_t* stats) {
+  *stats = queue_stats;
+}
+
 void alp_layer_init(alp_init_args_t* alp_init_args, bool is_shell_enabled)
 {
   init_args = alp_init_args;
   shell_enabled = is_shell_enabled;
   init_commands();
+  init_ready_queue();
 
   alp_cmd_handler_register_interface();
 
@@ -155,19 +497,18 @@ void alp_layer_init(alp_init_args_t* alp_init_args, bool is_shell_enabled)
   alp_layer_lorawan_init();
 #endif
 
-  timer_init_event(&alp_layer_process_command_timer, &_async_process_command);
+  sched_register_task_handle(&process_ready_commands, &process_ready_commands_handle);
 }
 
 void alp_layer_register_interface(alp_interface_t* interface) {
   alp_register_interface(interface);
 }
 
-static alp_status_codes_t process_op_read_file_data(alp_command_t* command) {
+static alp_status_codes_t process_op_read_file_data(alp_command_t* command, const alp_action_desc_t* action) {
   alp_operand_file_data_request_t operand;
-  error_t err;
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  operand.file_offset = alp_parse_file_offset_operand(&command->alp_command_fifo);
-  operand.requested_data_length = alp_parse_length_operand(&command->alp_command_fifo);
+  operand.file_offset.file_id = action->id;
+  operand.file_offset.offset = action->offset;
+  operand.requested_data_length = action->length;
   DPRINT("READ FILE %i LEN %i", operand.file_offset.file_id, operand.requested_data_length);
 
   if(operand.requested_data_length <= 0 || operand.requested_data_length > ALP_PAYLOAD_MAX_SIZE)
@@ -180,6 +521,11 @@ static alp_status_codes_t process_op_read_file_data(alp_command_t* command) {
       rc = init_args->alp_unhandled_read_action_cb(&current_status, operand, alp_data);
   }
 
+  uint16_t response_size = 2 + alp_length_operand_coded_length(operand.file_offset.offset)
+      + alp_length_operand_coded_length(operand.requested_data_length) + operand.requested_data_length;
+  if(rc == 0 && !reserve_response(command, response_size))
+    return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific error
+
   if(rc == 0) {
     // fill response
     alp_append_return_file_data_action(&command->alp_response_fifo, operand.file_offset.file_id, operand.file_offset.offset,
@@ -189,11 +535,9 @@ static alp_status_codes_t process_op_read_file_data(alp_command_t* command) {
   return ALP_STATUS_OK;
 }
 
-static alp_status_codes_t process_op_read_file_properties(alp_command_t* command) {
-  uint8_t file_id;
+static alp_status_codes_t process_op_read_file_properties(alp_command_t* command, const alp_action_desc_t* action) {
+  uint8_t file_id = action->id;
   error_t err;
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  err = fifo_pop(&command->alp_command_fifo, &file_id, 1); assert(err == SUCCESS);
   DPRINT("READ FILE PROPERTIES %i", file_id);
 
   d7ap_fs_file_header_t file_header;
@@ -203,6 +547,9 @@ static alp_status_codes_t process_op_read_file_properties(alp_command_t* command
   file_header.length = __builtin_bswap32(file_header.length);
   file_header.allocated_length = __builtin_bswap32(file_header.allocated_length);
 
+  if(alp_status == ALP_STATUS_OK && !reserve_response(command, 2 + sizeof(d7ap_fs_file_header_t)))
+    return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific error
+
   if(alp_status == ALP_STATUS_OK) {
     // fill response
     err = fifo_put_byte(&command->alp_response_fifo, ALP_OP_RETURN_FILE_PROPERTIES); assert(err == SUCCESS);
@@ -213,13 +560,10 @@ static alp_status_codes_t process_op_read_file_properties(alp_command_t* command
   return alp_status;
 }
 
-static alp_status_codes_t process_op_write_file_properties(alp_command_t* command) {
-  uint8_t file_id;
-  error_t err;
+static alp_status_codes_t process_op_write_file_properties(alp_command_t* command, const alp_action_desc_t* action) {
+  uint8_t file_id = action->id;
   d7ap_fs_file_header_t file_header;
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  err = fifo_pop(&command->alp_command_fifo, &file_id, 1); assert(err == SUCCESS);
-  err = fifo_pop(&command->alp_command_fifo, (uint8_t*)&file_header, sizeof(d7ap_fs_file_header_t)); assert(err == SUCCESS);
+  memcpy(&file_header, command->alp_command + action->data, sizeof(d7ap_fs_file_header_t));
   DPRINT("WRITE FILE PROPERTIES %i", file_id);
 
   // convert to little endian (native)
@@ -233,18 +577,14 @@ static alp_status_codes_t process_op_write_file_properties(alp_command_t* comman
   return ALP_STATUS_OK;
 }
 
-static alp_status_codes_t process_op_write_file_data(alp_command_t* command) {
-  error_t err;
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  file_data_operand.file_offset = alp_parse_file_offset_operand(&command->alp_command_fifo);
-  file_data_operand.provided_data_length = alp_parse_length_operand(&command->alp_command_fifo);
-  DPRINT("WRITE FILE %i LEN %i", file_data_operand.file_offset.file_id, file_data_operand.provided_data_length);
+static alp_status_codes_t process_op_write_file_data(alp_command_t* command, const alp_action_desc_t* action) {
+  DPRINT("WRITE FILE %i LEN %i", action->id, action->length);
 
-  if(file_data_operand.provided_data_length > ALP_PAYLOAD_MAX_SIZE)
+  if(action->length > ALP_PAYLOAD_MAX_SIZE)
     return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific error
 
-  err = fifo_pop(&command->alp_command_fifo, alp_data, (uint16_t)file_data_operand.provided_data_length);
-  int rc = d7ap_fs_write_file(file_data_operand.file_offset.file_id, file_data_operand.file_offset.offset, alp_data, file_data_operand.provided_data_length);
+  // the data is written directly from the command buffer
+  int rc = d7ap_fs_write_file(action->id, action->offset, command->alp_command + action->data, action->length);
   if(rc != 0)
     return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific error
 
@@ -281,12 +621,9 @@ bool process_arithm_predicate(uint8_t* value1, uint8_t* value2, uint32_t len, al
   assert(false); // should not reach here
 }
 
-static alp_status_codes_t process_op_break_query(alp_command_t* command) {
-  uint8_t query_code;
-  error_t err;
+static alp_status_codes_t process_op_break_query(alp_command_t* command, const alp_action_desc_t* action) {
+  uint8_t query_code = action->query_code;
   DPRINT("BREAK QUERY");
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  err = fifo_pop(&command->alp_command_fifo, &query_code, 1); assert(err == SUCCESS);
   assert((query_code & 0xE0) == 0x40); // TODO only arithm comp with value type is implemented for now
   assert((query_code & 0x10) == 0); // TODO mask value not implemented for now
 
@@ -296,128 +633,93 @@ static alp_status_codes_t process_op_break_query(alp_command_t* command) {
     use_signed_comparison = false;
 
   alp_query_arithmetic_comparison_type_t comp_type = query_code & 0x07;
-  uint32_t comp_length = alp_parse_length_operand(&command->alp_command_fifo);
+  uint32_t comp_length = action->length;
   // TODO assuming no compare mask for now + assume compare value present + only 1 file offset operand
 
   if(comp_length > ALP_PAYLOAD_MAX_SIZE)
-    goto error;
-
-  memset(alp_data, 0, comp_length);
-  err = fifo_pop(&command->alp_command_fifo, alp_data, (uint16_t)comp_length); assert(err == SUCCESS);
-  alp_operand_file_offset_t offset_a = alp_parse_file_offset_operand(&command->alp_command_fifo);
+    return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific
 
-  d7ap_fs_read_file(offset_a.file_id, offset_a.offset, alp_data2, comp_length);
+  d7ap_fs_read_file(action->id, action->offset, alp_data2, comp_length);
 
-  if(!process_arithm_predicate(alp_data2, alp_data, comp_length, comp_type)) {
-    DPRINT("predicate failed, clearing ALP command to stop further processing");
-    goto error;
+  if(!process_arithm_predicate(alp_data2, command->alp_command + action->data, comp_length, comp_type)) {
+    DPRINT("predicate failed, stop further processing of the ALP command");
+    return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific
   }
 
   return ALP_STATUS_OK;
-
-error:
-  fifo_clear(&command->alp_command_fifo);
-  return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific
 }
 
 static void interface_file_changed_callback(uint8_t file_id) {
-  interface_file_changed = true;
+  NG(interface_file_changed) = true;
 }
 
-static alp_status_codes_t process_op_indirect_forward(alp_command_t* command, uint8_t* itf_id, alp_interface_config_t* session_config) {
-  error_t err;
+static alp_status_codes_t process_op_indirect_forward(alp_command_t* command, const alp_action_desc_t* action, uint8_t* itf_id, alp_interface_config_t* session_config) {
   bool re_read = false;
-  bool found = false;
-  alp_control_t ctrl;
-  err = fifo_pop(&command->alp_command_fifo, &ctrl.raw, 1); assert(err == SUCCESS);
-  uint8_t interface_file_id;
-  err = fifo_pop(&command->alp_command_fifo, &interface_file_id, 1);
-  if((previous_interface_file_id != interface_file_id) || interface_file_changed) {
+  alp_control_t ctrl = action->ctrl;
+  uint8_t interface_file_id = action->id;
+  if((NG(previous_interface_file_id) != interface_file_id) || NG(interface_file_changed)) {
     re_read = true;
-    interface_file_changed = false;
-    if(previous_interface_file_id != interface_file_id) {
+    NG(interface_file_changed) = false;
+    if(NG(previous_interface_file_id) != interface_file_id) {
       if(fs_file_stat(interface_file_id)!=NULL) {
-        fs_unregister_file_modified_callback(previous_interface_file_id);
-        fs_register_file_modified_callback(interface_file_changed, &interface_file_changed_callback);
+        fs_unregister_file_modified_callback(NG(previous_interface_file_id));
+        fs_register_file_modified_callback(NG(interface_file_changed), &interface_file_changed_callback);
         d7ap_fs_read_file(interface_file_id, 0, itf_id, 1);
-        previous_interface_file_id = interface_file_id;
+        NG(previous_interface_file_id) = interface_file_id;
       } else {
         DPRINT("given file is not defined");
         assert(false);
       }
     } else
-      *itf_id = session_config_saved.itf_id;
+      *itf_id = NG(session_config_saved).itf_id;
   } else
-    *itf_id = session_config_saved.itf_id;
-  for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-    if(*itf_id == interfaces[i]->itf_id) {
-      session_config->itf_id = *itf_id;
-      if(re_read) {
-        session_config_saved.itf_id = *itf_id;
-        d7ap_fs_read_file(interface_file_id, 1, session_config_saved.itf_config, interfaces[i]->itf_cfg_len);
-      }
-      if(!ctrl.b7) 
-        memcpy(session_config->itf_config, session_config_saved.itf_config, interfaces[i]->itf_cfg_len);
-#ifdef MODULE_D7AP
-      else { //overload bit set
-          // TODO
-        memcpy(session_config->itf_config, session_config_saved.itf_config, interfaces[i]->itf_cfg_len - 10);
-        err = fifo_pop(&command->alp_command_fifo, &session_config->itf_config[interfaces[i]->itf_cfg_len - 10], 2); assert(err == SUCCESS);
-        uint8_t id_len = d7ap_addressee_id_length(session_config->d7ap_session_config.addressee.ctrl.id_type);
-        err = fifo_pop(&command->alp_command_fifo, &session_config->itf_config[interfaces[i]->itf_cfg_len - 8], id_len); assert(err == SUCCESS);
-      }
-#endif
-      found = true;
-      DPRINT("indirect forward %02X", *itf_id);
-      break;
-    }
-  }
-  if(!found) {
+    *itf_id = NG(session_config_saved).itf_id;
+  alp_interface_t* itf = alp_get_interface(*itf_id);
+  if(itf == NULL) {
     DPRINT("interface %02X is not registered", *itf_id);
     assert(false);
   }
 
+  session_config->itf_id = *itf_id;
+  if(re_read) {
+    NG(session_config_saved).itf_id = *itf_id;
+    d7ap_fs_read_file(interface_file_id, 1, NG(session_config_saved).itf_config, itf->itf_cfg_len);
+  }
+  if(!ctrl.b7) 
+    memcpy(session_config->itf_config, NG(session_config_saved).itf_config, itf->itf_cfg_len);
+#ifdef MODULE_D7AP
+  else { //overload bit set
+      // TODO
+    memcpy(session_config->itf_config, NG(session_config_saved).itf_config, itf->itf_cfg_len - 10);
+    // addressee control, access class and ID
+    memcpy(&session_config->itf_config[itf->itf_cfg_len - 10], command->alp_command + action->data, action->length);
+  }
+#endif
+  DPRINT("indirect forward %02X", *itf_id);
+
   return ALP_STATUS_PARTIALLY_COMPLETED;
 }
 
-static alp_status_codes_t process_op_forward(alp_command_t* command, uint8_t* itf_id, alp_interface_config_t* session_config) {
+static alp_status_codes_t process_op_forward(alp_command_t* command, const alp_action_desc_t* action, uint8_t* itf_id, alp_interface_config_t* session_config) {
   // TODO move session config to alp_command_t struct
-  error_t err;
-  bool found = false;
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  err = fifo_pop(&command->alp_command_fifo, itf_id, 1); assert(err == SUCCESS);
-  for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-    if(*itf_id == interfaces[i]->itf_id) {
-      session_config->itf_id = *itf_id;
-      if(*itf_id == ALP_ITF_ID_D7ASP) {
-#ifdef MODULE_D7AP
-        uint8_t min_size = interfaces[i]->itf_cfg_len - 8; // substract max size of responder ID
-        err = fifo_pop(&command->alp_command_fifo, session_config->itf_config, min_size); assert(err == SUCCESS);
-        uint8_t id_len = d7ap_addressee_id_length(session_config->d7ap_session_config.addressee.ctrl.id_type);
-        err = fifo_pop(&command->alp_command_fifo, session_config->itf_config + min_size, id_len); assert(err == SUCCESS);
-#endif
-      } else {
-        err = fifo_pop(&command->alp_command_fifo, session_config->itf_config, interfaces[i]->itf_cfg_len); assert(err == SUCCESS);
-      }
-      found = true;
-      DPRINT("FORWARD %02X", *itf_id);
-      break;
-    }
-  }
-  if(!found) {
+  *itf_id = action->id;
+  if(alp_get_interface(*itf_id) == NULL) {
     DPRINT("FORWARD interface %02X not found", *itf_id);
     assert(false);
   }
 
+  session_config->itf_id = *itf_id;
+  // for D7ASP the configuration only contains the used part of the addressee ID
+  assert(action->length <= sizeof(session_config->itf_config));
+  memcpy(session_config->itf_config, command->alp_command + action->data, action->length);
+  DPRINT("FORWARD %02X", *itf_id);
+
   return ALP_STATUS_PARTIALLY_COMPLETED;
 }
 
-static alp_status_codes_t process_op_response_tag(alp_command_t* command) {
-  error_t err;
-  alp_control_t ctrl;
-  uint8_t tag_id;
-  err = fifo_pop(&command->alp_command_fifo, (uint8_t*)&ctrl, 1); assert(err == SUCCESS);
-  err = fifo_pop(&command->alp_command_fifo, &tag_id, 1); assert(err == SUCCESS);
+static alp_status_codes_t process_op_response_tag(alp_command_t* command, const alp_action_desc_t* action) {
+  alp_control_t ctrl = action->ctrl;
+  uint8_t tag_id = action->id;
   if(tag_id == command->tag_id && ctrl.b7) {
     if(init_args != NULL && init_args->alp_command_completed_cb != NULL) {
       init_args->alp_command_completed_cb(command->tag_id, !ctrl.b6);
@@ -429,318 +731,287 @@ static alp_status_codes_t process_op_response_tag(alp_command_t* command) {
   return ALP_STATUS_UNKNOWN_ERROR;
 }
 
-static alp_status_codes_t process_op_status(alp_command_t* command) {
-  error_t err;
-  alp_control_t ctrl;
-  err = fifo_pop(&command->alp_command_fifo, (uint8_t*)&ctrl, 1);
-  uint8_t ext = (ctrl.b7 < 1) + ctrl.b6;
-  switch(ext) {
-    case 0: ; //action status operation
-      uint8_t status_code;
-      fifo_pop(&command->alp_command_fifo, &status_code, 1);
-      //TO DO implement handling of action status
-      break;
-    case 1: ;//interface status operation
-      alp_interface_status_t status;
-      fifo_pop(&command->alp_command_fifo, &status.itf_id, 1);
-      status.len = (uint8_t)alp_parse_length_operand(&command->alp_command_fifo);
-      fifo_pop(&command->alp_command_fifo, status.itf_status, status.len);
-      if((init_args != NULL) &&(init_args->alp_command_result_cb != NULL))
-          init_args->alp_command_result_cb(&status, NULL, 0);
-      break;
-    case 2: //RFU
-    case 3: //RFU
-    default:
-      DPRINT("op_status ext %i not defined", ext);
-      assert(false);
-
+static alp_status_codes_t process_op_status(alp_command_t* command, const alp_action_desc_t* action) {
+  if(!action->ctrl.b6) {
+    //action status operation
+    //TO DO implement handling of action status
+    return ALP_STATUS_OK;
   }
 
+  //interface status operation
+  alp_interface_status_t status;
+  if(action->length > sizeof(status.itf_status))
+    return ALP_STATUS_UNKNOWN_ERROR;
+
+  status.itf_id = action->id;
+  status.len = (uint8_t)action->length;
+  memcpy(status.itf_status, command->alp_command + action->data, status.len);
+  if((init_args != NULL) &&(init_args->alp_command_result_cb != NULL))
+      init_args->alp_command_result_cb(&status, NULL, 0);
+
   return ALP_STATUS_OK;
 }
 
-static alp_status_codes_t process_op_request_tag(alp_command_t* command, bool respond_when_completed) {
-  error_t err;
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  err = fifo_pop(&command->alp_command_fifo, &command->tag_id, 1); assert(err == SUCCESS);
-  command->respond_when_completed = respond_when_completed;
+static alp_status_codes_t process_op_request_tag(alp_command_t* command, const alp_action_desc_t* action) {
+  alp_control_tag_request_t tag_request = { .raw = action->ctrl.raw };
+  command->tag_id = action->id;
+  command->respond_when_completed = tag_request.respond_when_completed;
   return ALP_STATUS_OK;
 }
 
-static alp_status_codes_t process_op_return_file_data(alp_command_t* command) {
-  // determine total size of alp
-  uint8_t total_len = 2; // ALP control byte + File ID byte
-  uint8_t len; // b7 b6 of length field
-  uint32_t data_len;
-  uint16_t fifo_skip_size;
-
-  // TODO refactor to reuse alp_parse_file_offset_operand() etc but in a way that does not pop() from fifo ..
-
-  // parse file offset length
-  error_t e = fifo_peek(&command->alp_command_fifo, (uint8_t*)&len, total_len, 1);
-  if(e != SUCCESS) goto incomplete_error;
-
-  uint8_t field_len = len >> 6;
-  data_len = (uint32_t)(len & 0x3F) << ( 8 * field_len); // mask field length specificier bits and shift before adding other length bytes
-  total_len += 1;
-  if(field_len > 0) {
-    e = fifo_peek(&command->alp_command_fifo, (uint8_t*)&data_len, total_len, field_len);
-    total_len += field_len;
-    if(e != SUCCESS) goto incomplete_error;
-  }
-
-  DPRINT("Return file data:");
-  DPRINT("offset size: %d", field_len + 1);
-
-  // parse file length length
-  e = fifo_peek(&command->alp_command_fifo, (uint8_t*)&len, total_len, 1);
-  if(e != SUCCESS) goto incomplete_error;
-
-  field_len = len >> 6;
-  data_len = (uint32_t)(len & 0x3F) << ( 8 * field_len); // mask field length specificier bits and shift before adding other length bytes
-  total_len += 1;
-  if(field_len > 0) {
-    e = fifo_peek(&command->alp_command_fifo, (uint8_t*)&data_len, total_len, field_len);
-    total_len += field_len;
-    if(e != SUCCESS) goto incomplete_error;
-  }
-
-  DPRINT("length size: %d", field_len + 1);
-  DPRINT("data size: %d", data_len);
-  total_len += data_len;
-
-  if(fifo_get_size(&command->alp_command_fifo) < total_len) goto incomplete_error;
+static alp_status_codes_t process_op_return_file_data(alp_command_t* command, const alp_action_desc_t* action) {
+  uint8_t* action_data = command->alp_command + action->start;
+  DPRINT("Return file data: file %i offset %i data size %i", action->id, action->offset, action->length);
 
   if(shell_enabled) {
-    // TODO refactor
-    bool found = false;
-    for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-      if((interfaces[i] != NULL) && (interfaces[i]->itf_id == ALP_ITF_ID_SERIAL)) {
-        DPRINT("serial itf found, sending");
-        found = true;
-        fifo_t serial_fifo;
-        fifo_init(&serial_fifo, alp_data, sizeof(alp_data));
-        alp_append_interface_status(&serial_fifo, &current_status);
-        fifo_pop(&command->alp_command_fifo, alp_data + fifo_get_size(&serial_fifo), total_len);
-        interfaces[i]->send_command(alp_data, total_len+current_status.len, 0, NULL, NULL);
-        break;
-      }
-    }
-    if(!found) {
+    alp_interface_t* serial_itf = alp_get_interface(ALP_ITF_ID_SERIAL);
+    if(serial_itf == NULL) {
       DPRINT("serial itf not found");
       assert(false);
     }
-  } else {
-    fifo_pop(&command->alp_command_fifo, alp_data, total_len);
-  } 
-
-  if(init_args != NULL && init_args->alp_received_unsolicited_data_cb != NULL)
-    init_args->alp_received_unsolicited_data_cb(&current_status, &alp_data[shell_enabled * current_status.len], total_len);
 
-  return ALP_STATUS_OK;  
+    // the action is forwarded from the command buffer, behind the interface status
+    uint8_t status[ALP_INTERFACE_STATUS_MAX_SIZE];
+    alp_segment_t segments[] = {
+      { .data = status, .length = serialize_interface_status(&current_status, status) },
+      { .data = action_data, .length = action->size }
+    };
+    DPRINT("serial itf found, sending");
+    send_segments(serial_itf, segments, 2, 0, NULL, NULL);
+  }
 
-incomplete_error:
-  // pop processed bytes
-  fifo_skip_size = fifo_get_size(&command->alp_command_fifo);
-  if(total_len < fifo_skip_size)
-    fifo_skip_size = total_len;
+  if(init_args != NULL && init_args->alp_received_unsolicited_data_cb != NULL)
+    init_args->alp_received_unsolicited_data_cb(&current_status, action_data, action->size);
 
-  DPRINT("incomplete operand, skipping %i\n", fifo_skip_size);
-  fifo_skip(&command->alp_command_fifo, fifo_skip_size);
-  return ALP_STATUS_INCOMPLETE_OPERAND;
+  return ALP_STATUS_OK;
 }
 
-static alp_status_codes_t process_op_create_file(alp_command_t* command) {
+static alp_status_codes_t process_op_create_file(alp_command_t* command, const alp_action_desc_t* action) {
   alp_operand_file_header_t operand;
-  error_t err;
-  err = fifo_skip(&command->alp_command_fifo, 1); assert(err == SUCCESS); // skip the control byte
-  operand = alp_parse_file_header_operand(&command->alp_command_fifo);
+  operand.file_id = action->id;
+  memcpy(&operand.file_header, command->alp_command + action->data, sizeof(d7ap_fs_file_header_t));
+
+  // convert to little endian (native)
+  operand.file_header.length = __builtin_bswap32(operand.file_header.length);
+  operand.file_header.allocated_length = __builtin_bswap32(operand.file_header.allocated_length);
   DPRINT("CREATE FILE %i", operand.file_id);
 
   d7ap_fs_init_file(operand.file_id, &operand.file_header, NULL);
+  return ALP_STATUS_OK;
+}
+
+static void serialize_tag_response(alp_command_t* command, bool eop, bool error, uint8_t* buffer) {
+  buffer[0] = ALP_OP_RESPONSE_TAG | (eop << 7) | (error << 6);
+  buffer[1] = command->tag_id;
 }
 
 static void add_tag_response(alp_command_t* command, bool eop, bool error) {
   // fill response with tag response
   DPRINT("add_tag_response %i", command->tag_id);
-  uint8_t op_return_tag = ALP_OP_RESPONSE_TAG | (eop << 7);
-  op_return_tag |= (error << 6);
-  error_t err = fifo_put_byte(&command->alp_response_fifo, op_return_tag); assert(err == SUCCESS);
-  err = fifo_put_byte(&command->alp_response_fifo, command->tag_id); assert(err == SUCCESS);
+  uint8_t tag_response[2];
+  serialize_tag_response(command, eop, error, tag_response);
+  if(!reserve_response(command, sizeof(tag_response))) {
+    DPRINT("no buffer for the tag response");
+    return;
+  }
+
+  error_t err = fifo_put(&command->alp_response_fifo, tag_response, sizeof(tag_response)); assert(err == SUCCESS);
 }
 
-void alp_layer_execute_command_over_itf(uint8_t* alp_command, uint8_t alp_command_length, alp_interface_config_t* itf_cfg) {
-    bool found = false;
+error_t alp_layer_execute_command_over_itf(uint8_t* alp_command, uint8_t alp_command_length, alp_interface_config_t* itf_cfg) {
     DPRINT("alp cmd size %i", alp_command_length);
     assert(alp_command_length <= ALP_PAYLOAD_MAX_SIZE);
 
-    alp_command_t* command = alloc_command();
-    assert(command != NULL);
+    alp_command_t* command = alloc_command(0); // the command is sent from the buffer of the caller
+    if(command == NULL)
+      return ENOMEM;
 
-    fifo_init_filled(&command->alp_command_fifo, alp_command, alp_command_length, alp_command_length+1);
-    error_t err;
-
-    for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-      if((interfaces[i] != NULL) && (interfaces[i]->itf_id == itf_cfg->itf_id)) {
-        err = interfaces[i]->send_command(alp_command, alp_command_length, alp_get_expected_response_length(command->alp_command_fifo), &command->trans_id, itf_cfg);
-        found = true;
-        break;
-      }
-    }
-    if(!found) {
+    uint8_t expected_response_length = alp_get_expected_response_length(alp_command, alp_command_length);
+    alp_interface_t* itf = alp_get_interface(itf_cfg->itf_id);
+    if(itf == NULL) {
       DPRINT("interface %i not found", itf_cfg->itf_id);
       assert(false);
     }
 
+    error_t err = send_command(command, itf, alp_command, alp_command_length, expected_response_length, itf_cfg);
     if(err) {
       DPRINT("transmit returned an error %x", err);
       free_command(command);
     }
+
+    return err;
+}
+
+static void forward_command(alp_command_t* command, uint8_t action_index, uint8_t forward_itf_id, alp_interface_config_t* session_config) {
+  alp_command_desc_t* parsed = &command->parsed_command;
+  alp_interface_t* itf = alp_get_interface(forward_itf_id);
+  if(itf == NULL) {
+    DPRINT("interface %02X not registered, can therefore not be forwarded", forward_itf_id);
+    assert(false);
+  }
+
+  if(itf->unique && (itf->deinit != NG(current_itf_deinit))) {
+    // TODO refactor?
+    if(NG(current_itf_deinit) != NULL)
+      NG(current_itf_deinit)();
+
+    itf->init(session_config);
+    NG(current_itf_deinit) = itf->deinit;
+  }
+
+  // the remainder of the command is forwarded as is, from the command buffer
+  uint8_t start = parsed->actions[action_index].start;
+  uint8_t forwarded_alp_size = parsed->length - start;
+  uint8_t expected_response_length = alp_get_remaining_response_length(parsed, action_index);
+  error_t error = send_command(command, itf, parsed->alp_command + start, forwarded_alp_size, expected_response_length, session_config);
+  if(error) {
+    DPRINT("transmit returned error %x", error);
+    alp_layer_command_completed(command->trans_id, &error, NULL);
+  }
+
+  DPRINT("forwarded over interface %02X", forward_itf_id);
 }
 
 static bool alp_layer_parse_and_execute_alp_command(alp_command_t* command) {
   DPRINT("parse and exe command");
+  alp_command_desc_t* parsed = &command->parsed_command;
   alp_interface_config_t session_config;
   uint8_t forward_itf_id = ALP_ITF_ID_HOST;
-  bool do_forward = false;
-  bool found = false;
-
-  while(fifo_get_size(&command->alp_command_fifo) > 0) {
-    if(forward_itf_id != ALP_ITF_ID_HOST) {
-      do_forward = true;
-      for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-        if(forward_itf_id == interfaces[i]->itf_id) {
-          if(interfaces[i]->unique && (interfaces[i]->deinit != current_itf_deinit)) {
-            // TODO refactor?
-            if(current_itf_deinit != NULL)
-              current_itf_deinit();
-
-            interfaces[i]->init(&session_config);
-            current_itf_deinit = interfaces[i]->deinit;
-          }
-
-          uint8_t forwarded_alp_size = fifo_get_size(&command->alp_command_fifo);
-          assert(forwarded_alp_size <= ALP_PAYLOAD_MAX_SIZE);
-          uint8_t expected_response_length = alp_get_expected_response_length(command->alp_command_fifo);
-          fifo_pop(&command->alp_command_fifo, command->alp_command, forwarded_alp_size);
-          error_t error = interfaces[i]->send_command(command->alp_command, forwarded_alp_size, expected_response_length, &command->trans_id, &session_config);
-          if(error) {
-            DPRINT("transmit returned error %x", error);
-            alp_layer_command_completed(command->trans_id, &error, NULL);
-          }
-
-          found = true;
-          DPRINT("forwarded over interface %02X", forward_itf_id);
-          break;
-        }
-      }
-      if(!found) {
-        DPRINT("interface %02X not registered, can therefore not be forwarded");
-        assert(false);
+
+  // the command is parsed already, the actions are executed from the descriptors. Commands with more actions than
+  // fit in the descriptor list are parsed again from where the previous part stopped.
+  while(parsed->action_count > 0) {
+    for(uint8_t i = 0; i < parsed->action_count; i++) {
+      const alp_action_desc_t* action = &parsed->actions[i];
+      if(forward_itf_id != ALP_ITF_ID_HOST) {
+        forward_command(command, i, forward_itf_id, &session_config);
+        return true;
       }
 
-      return do_forward;
+      alp_status_codes_t alp_status;
+      switch(action->ctrl.operation) {
+      case ALP_OP_READ_FILE_DATA:
+          alp_status = process_op_read_file_data(command, action);
+          break;
+      case ALP_OP_READ_FILE_PROPERTIES:
+          alp_status = process_op_read_file_properties(command, action);
+          break;
+      case ALP_OP_WRITE_FILE_DATA:
+          alp_status = process_op_write_file_data(command, action);
+          break;
+      case ALP_OP_WRITE_FILE_PROPERTIES:
+          alp_status = process_op_write_file_properties(command, action);
+          break;
+      case ALP_OP_BREAK_QUERY:
+          alp_status = process_op_break_query(command, action);
+          if(alp_status != ALP_STATUS_OK)
+            return false; // stop processing the command
+          break;
+      case ALP_OP_STATUS:
+          alp_status = process_op_status(command, action);
+          break;
+      case ALP_OP_RESPONSE_TAG:
+          alp_status = process_op_response_tag(command, action);
+          break;
+      case ALP_OP_FORWARD:
+          alp_status = process_op_forward(command, action, &forward_itf_id, &session_config);
+          break;
+      case ALP_OP_INDIRECT_FORWARD:
+          alp_status = process_op_indirect_forward(command, action, &forward_itf_id, &session_config);
+          break;
+      case ALP_OP_REQUEST_TAG:
+          alp_status = process_op_request_tag(command, action);
+          break;
+      case ALP_OP_RETURN_FILE_DATA:
+          alp_status = process_op_return_file_data(command, action);
+          break;
+      case ALP_OP_CREATE_FILE:
+          alp_status = process_op_create_file(command, action);
+          break;
+        default:
+          assert(false); // TODO return error
+          //alp_status = ALP_STATUS_UNKNOWN_OPERATION;
+      }
     }
 
-    alp_control_t control;
-    assert(fifo_peek(&command->alp_command_fifo, &control.raw, 0, 1) == SUCCESS);
-    alp_status_codes_t alp_status;
-    switch(control.operation) {
-        case ALP_OP_READ_FILE_DATA:
-            alp_status = process_op_read_file_data(command);
-        break;
-    case ALP_OP_READ_FILE_PROPERTIES:
-        alp_status = process_op_read_file_properties(command);
-        break;
-    case ALP_OP_WRITE_FILE_DATA:
-        alp_status = process_op_write_file_data(command);
-        break;
-    case ALP_OP_WRITE_FILE_PROPERTIES:
-        alp_status = process_op_write_file_properties(command);
-        break;
-    case ALP_OP_BREAK_QUERY:
-        alp_status = process_op_break_query(command);
-        break;
-    case ALP_OP_STATUS:
-        alp_status = process_op_status(command);
-        break;
-    case ALP_OP_RESPONSE_TAG:
-        alp_status = process_op_response_tag(command);
-        break;
-    case ALP_OP_FORWARD:
-        alp_status = process_op_forward(command, &forward_itf_id, &session_config);
-        break;
-    case ALP_OP_INDIRECT_FORWARD:
-        alp_status = process_op_indirect_forward(command, &forward_itf_id, &session_config);
-        break;
-    case ALP_OP_REQUEST_TAG: ;
-        alp_control_tag_request_t* tag_request = (alp_control_tag_request_t*)&control;
-        alp_status = process_op_request_tag(command, tag_request->respond_when_completed);
-        break;
-    case ALP_OP_RETURN_FILE_DATA:
-        alp_status = process_op_return_file_data(command);
-        break;
-    case ALP_OP_CREATE_FILE:
-        alp_status = process_op_create_file(command);
-        break;
-      default:
-        assert(false); // TODO return error
-        //alp_status = ALP_STATUS_UNKNOWN_OPERATION;
-    }
+    if(parsed->end >= parsed->length || parsed->status != ALP_STATUS_OK)
+      break;
+
+    alp_parse_command(parsed, parsed->alp_command, parsed->length, parsed->end);
   }
 
-  return do_forward;
+  if(parsed->status != ALP_STATUS_OK)
+    DPRINT("ALP command parsing stopped at %i with status %x", parsed->end, parsed->status);
+
+  return false;
 }
 
 bool alp_layer_process_command(uint8_t* payload, uint8_t payload_length, alp_itf_id_t origin_itf_id, alp_interface_status_t* itf_status) {
   DPRINT("alp_layer_new_command");
   DPRINT_DATA(payload, payload_length);
-  alp_command_t* command = alloc_command();
-  assert(command != NULL);
+  alp_command_t* command = alloc_command(payload_length);
+  if(command == NULL) {
+    DPRINT("command dropped, no free command slot or buffer");
+    queue_stats.dropped_commands++;
+    return false;
+  }
+
   command->origin_itf_id = origin_itf_id;
 
   if(itf_status != NULL) // TODO
       current_status = *itf_status;
 
   memcpy(command->alp_command, payload, payload_length);
-  fifo_init_filled(&(command->alp_command_fifo), command->alp_command, payload_length, ALP_PAYLOAD_MAX_SIZE);
-  fifo_init(&(command->alp_response_fifo), command->alp_response, ALP_PAYLOAD_MAX_SIZE);
+  alp_parse_command(&command->parsed_command, command->alp_command, payload_length, 0);
 
   // TODO
 //  if(itf_cfg && (command->itf_id == ALP_ITF_ID_D7ASP))
 //    expect_completed = true; //d7aactp
 
-  alp_layer_process_command_timer.next_event = 0;
-  alp_layer_process_command_timer.priority = MAX_PRIORITY;
-  alp_layer_process_command_timer.arg = command;
-  error_t rtc = timer_add_event(&alp_layer_process_command_timer);
-  assert(rtc == SUCCESS);
+  enqueue_ready_command(command);
+  error_t rtc = sched_post_handle_prio(process_ready_commands_handle, MAX_PRIORITY, NULL);
+  assert(rtc == SUCCESS || rtc == EALREADY);
 
-  uint8_t expected_response_length = alp_get_expected_response_length(command->alp_command_fifo);
+  uint8_t expected_response_length = command->parsed_command.expected_response_length;
   DPRINT("This ALP command will initiate a response containing <%d> bytes", expected_response_length);
   return (expected_response_length > 0);
 }
 
-static void _async_process_command(void* arg)
+/* executes a batch of queued commands, the task is posted again when more commands are waiting */
+static void process_ready_commands()
+{
+  queue_stats.batches++;
+  for(uint8_t i = 0; i < MODULE_ALP_COMMAND_BATCH_SIZE; i++) {
+    alp_command_t* command = dequeue_ready_command();
+    if(command == NULL)
+      return;
+
+    queue_stats.executed_commands++;
+    _async_process_command(command);
+  }
+
+  if(queue_stats.queued_commands > 0)
+    sched_post_handle_prio(process_ready_commands_handle, MAX_PRIORITY, NULL);
+}
+
+static void _async_process_command(alp_command_t* command)
 {
-    alp_command_t* command = (alp_command_t*)arg;
     DPRINT("command allocated <%p>", command);
-    assert(command != NULL);
 
     bool do_forward = alp_layer_parse_and_execute_alp_command(command);
 
-    uint8_t expected_response_length = alp_get_expected_response_length(command->alp_response_fifo);
+    uint8_t expected_response_length = alp_get_expected_response_length(command->alp_response_fifo.buffer, fifo_get_size(&command->alp_response_fifo));
     if(command->respond_when_completed && !do_forward && (command->origin_itf_id == ALP_ITF_ID_SERIAL)) // TODO will proabably not work anymore, but should be refactored
       add_tag_response(command, true, false);
 
-    uint8_t alp_response_length = (uint8_t)fifo_get_size(&command->alp_response_fifo);
-    fifo_pop(&command->alp_response_fifo, command->alp_response, alp_response_length);
+    uint8_t alp_response_length;
+    uint8_t* alp_response = take_response(command, &alp_response_length);
 
     if(alp_response_length) {
       // when the command originates from the app code call callbacks directly, since this is not a 'real' interface
       if(command->origin_itf_id == ALP_ITF_ID_HOST) {
         if(init_args && init_args->alp_command_result_cb)
-          init_args->alp_command_result_cb(NULL, command->alp_response, alp_response_length);
+          init_args->alp_command_result_cb(NULL, alp_response, alp_response_length);
 
         if(init_args && init_args->alp_command_completed_cb)
           init_args->alp_command_completed_cb(command->tag_id, true); // TODO pass possible error
@@ -748,27 +1019,20 @@ static void _async_process_command(void* arg)
         goto cleanup;
       }
 
-      bool found = false;
-      for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-        if((interfaces[i] != NULL) && (interfaces[i]->itf_id == command->origin_itf_id)) {
-          DPRINT("interface found, sending len %i, expect %i answer", alp_response_length, expected_response_length);
-          found = true;
-          error_t err = interfaces[i]->send_command(command->alp_response, alp_response_length, expected_response_length, &command->trans_id, session_config_buffer);
-          if(err) {
-            free_command(command);
-          }
-
-          break;
-        }
-      }
-      if(!found) {
+      alp_interface_t* itf = alp_get_interface(command->origin_itf_id);
+      if(itf == NULL) {
         DPRINT("interface %i not found", command->origin_itf_id);
         assert(false);
       }
+
+      DPRINT("interface found, sending len %i, expect %i answer", alp_response_length, expected_response_length);
+      error_t err = send_command(command, itf, alp_response, alp_response_length, expected_response_length, NG(session_config_buffer));
+      if(err)
+        free_command(command);
     }
 
 cleanup:
-    if(!do_forward && !expect_completed) {
+    if(!do_forward && !NG(expect_completed)) {
       free_command(command);
     }
 
@@ -778,28 +1042,33 @@ cleanup:
 void alp_layer_command_completed(uint16_t trans_id, error_t* error, alp_interface_status_t* status) {
   DPRINT("command completed with trans id %i and error location %i: value %i", trans_id, error, *error);
   alp_command_t* command = get_command_by_transid(trans_id);
-  assert(command != NULL);
+  if(command == NULL)
+    return; // not (or no longer) known, for example because it could not be allocated
 
   if(shell_enabled && command->respond_when_completed) {
     if(error != NULL)
       add_tag_response(command, true, *error);
-    if(status != NULL)
-      fifo_put(&command->alp_response_fifo, status->itf_status, status->len);
-    
-    uint8_t response_size = fifo_get_size(&command->alp_response_fifo);
-    bool found = false;
-    fifo_pop(&command->alp_response_fifo, command->alp_response, response_size);
-    for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-      if((interfaces[i] != NULL) && (interfaces[i]->itf_id == ALP_ITF_ID_SERIAL)) {
-        found = true;
-        interfaces[i]->send_command(command->alp_response, response_size, 0, NULL, NULL);
-        break;
-      }
-    }
-    if(!found) {
+
+    alp_interface_t* serial_itf = alp_get_interface(ALP_ITF_ID_SERIAL);
+    if(serial_itf == NULL) {
       DPRINT("serial itf not found");
       assert(false);
     }
+
+    // the status is sent behind the response, without appending it to the response buffer
+    alp_segment_t segments[2];
+    segments[0].data = take_response(command, &segments[0].length);
+    uint8_t segment_count = 1;
+    // a serial message holds at most UINT8_MAX bytes, the status is dropped when it does not fit
+    if(status != NULL && segments[0].length + status->len <= UINT8_MAX)
+      segments[segment_count++] = (alp_segment_t){ .data = status->itf_status, .length = status->len };
+    else if(status != NULL)
+      queue_stats.dropped_responses++;
+
+    if(send_segments(serial_itf, segments, segment_count, 0, NULL, NULL) != SUCCESS) {
+      DPRINT("response not accepted by the serial interface");
+      queue_stats.dropped_responses++;
+    }
   }
 
   if(init_args != NULL && init_args->alp_command_completed_cb != NULL && error != NULL)
@@ -811,33 +1080,52 @@ void alp_layer_command_completed(uint16_t trans_id, error_t* error, alp_interfac
 void alp_layer_received_response(uint16_t trans_id, uint8_t* payload, uint8_t payload_length, alp_interface_status_t* itf_status) {
   DPRINT("received response");
   alp_command_t* command = get_command_by_transid(trans_id);
-  assert(command != NULL);
+  if(command == NULL)
+    return; // not (or no longer) known, for example because it could not be allocated
   current_status = *itf_status;
 
 
   // received result for known command
   if(shell_enabled) {
-      // TODO refactor
+      alp_interface_t* serial_itf = alp_get_interface(ALP_ITF_ID_SERIAL);
+      if(serial_itf == NULL) {
+        DPRINT("serial itf not found");
+        assert(false);
+      }
 
-      alp_append_interface_status(&command->alp_response_fifo, itf_status);
-      fifo_put(&command->alp_response_fifo, payload, payload_length);
+      // the received payload is forwarded as is, between the interface status and the tag response
+      uint8_t status[ALP_INTERFACE_STATUS_MAX_SIZE];
+      uint8_t tag_response[2];
+      uint8_t response_length;
+      uint8_t* response = take_response(command, &response_length);
+      uint8_t status_length = serialize_interface_status(itf_status, status);
+
+      // a serial message holds at most UINT8_MAX bytes. What does not fit is dropped, which is reported by the
+      // error bit of the tag response
+      bool forward_payload = true;
+      if(response_length + status_length + payload_length + sizeof(tag_response) > UINT8_MAX) {
+        DPRINT("response of %i bytes too large for the serial interface, payload dropped", payload_length);
+        forward_payload = false;
+        if(response_length + status_length + sizeof(tag_response) > UINT8_MAX)
+          response_length = 0;
+
+        queue_stats.dropped_responses++;
+      }
 
-      // tag and send response already with EOP bit cleared
-      add_tag_response(command, false, false); // TODO error
+      serialize_tag_response(command, false, !forward_payload, tag_response); // already with EOP bit cleared
+      alp_segment_t segments[4];
+      uint8_t segment_count = 0;
+      if(response_length > 0)
+        segments[segment_count++] = (alp_segment_t){ .data = response, .length = response_length };
 
-      uint8_t response_size = fifo_get_size(&command->alp_response_fifo);
-      bool found = false;
-      fifo_pop(&command->alp_response_fifo, command->alp_response, response_size);
-      for(uint8_t i = 0; i < MODULE_ALP_INTERFACE_SIZE; i++) {
-        if((interfaces[i] != NULL) && (interfaces[i]->itf_id == ALP_ITF_ID_SERIAL)) {
-          found = true;
-          interfaces[i]->send_command(command->alp_response, response_size, 0, NULL, NULL);
-          break;
-        }
-      }
-      if(!found) {
-        DPRINT("serial itf not found");
-        assert(false);
+      segments[segment_count++] = (alp_segment_t){ .data = status, .length = status_length };
+      if(forward_payload)
+        segments[segment_count++] = (alp_segment_t){ .data = payload, .length = payload_length };
+
+      segments[segment_count++] = (alp_segment_t){ .data = tag_response, .length = sizeof(tag_response) };
+      if(send_segments(serial_itf, segments, segment_count, 0, NULL, NULL) != SUCCESS) {
+        DPRINT("response not accepted by the serial interface");
+        queue_stats.dropped_responses++;
       }
   }
 
@@ -849,17 +1137,21 @@ void alp_layer_received_response(uint16_t trans_id, uint8_t* payload, uint8_t pa
 void alp_layer_process_d7aactp(d7ap_session_config_t* session_config, uint8_t* alp_command, uint32_t alp_command_length)
 {
     // TODO refactor, might be removed
-    alp_command_t* command = alloc_command();
-    assert(command != NULL);
+    assert(alp_command_length <= ALP_PAYLOAD_MAX_SIZE);
+    alp_command_t* command = alloc_command(alp_command_length);
+    if(command == NULL) {
+      DPRINT("D7AActP command dropped, no free command slot or buffer");
+      return;
+    }
 
     memcpy(command->alp_command, alp_command, alp_command_length);
-    fifo_init_filled(&(command->alp_command_fifo), command->alp_command, alp_command_length, ALP_PAYLOAD_MAX_SIZE);
-    fifo_init(&(command->alp_response_fifo), command->alp_response, ALP_PAYLOAD_MAX_SIZE);
+    alp_parse_command(&command->parsed_command, command->alp_command, alp_command_length, 0);
 
     alp_layer_parse_and_execute_alp_command(command);
 
-    uint8_t expected_response_length = alp_get_expected_response_length(command->alp_response_fifo);
-    error_t error = d7ap_send(alp_client_id, session_config, command->alp_response,
+    uint8_t expected_response_length = alp_get_expected_response_length(command->alp_response_fifo.buffer, fifo_get_size(&command->alp_response_fifo));
+    command->has_trans_id = true;
+    error_t error = d7ap_send(NG(alp_client_id), session_config, command->alp_response_fifo.buffer,
         fifo_get_size(&(command->alp_response_fifo)), expected_response_length, &command->trans_id);
 
     if (error)
@@ -867,24 +1159,26 @@ void alp_layer_process_d7aactp(d7ap_session_config_t* session_config, uint8_t* a
         DPRINT("d7ap_send returned an error %x", error);
         free_command(command);
     }
+    else
+        index_command(command);
 }
 #endif // MODULE_D7AP
 
 #ifdef MODULE_LORAWAN
-alp_interface_t interface_lorawan_otaa;
-alp_interface_t interface_lorawan_abp;
-uint16_t lorawan_trans_id;
-bool otaa_just_inited = false;
-bool abp_just_inited = false;
+alp_interface_t NGDEF(interface_lorawan_otaa);
+alp_interface_t NGDEF(interface_lorawan_abp);
+uint16_t NGDEF(lorawan_trans_id);
+bool NGDEF(otaa_just_inited);
+bool NGDEF(abp_just_inited);
 
 void lorawan_rx(lorawan_AppData_t *AppData)
 {
-  alp_layer_process_command(AppData->Buff, AppData->BuffSize, current_lorawan_interface_type, NULL);
+  alp_layer_process_command(AppData->Buff, AppData->BuffSize, NG(current_lorawan_interface_type), NULL);
 }
 
 void add_interface_status_lorawan(uint8_t* payload, uint8_t attempts, lorawan_stack_status_t status) {
   payload[0] = ALP_OP_STATUS + (1 << 6);
-  payload[1] = current_lorawan_interface_type;
+  payload[1] = NG(current_lorawan_interface_type);
   payload[2] = 4; //length
   payload[3] = attempts;
   payload[4] = status;
@@ -895,21 +1189,25 @@ void add_interface_status_lorawan(uint8_t* payload, uint8_t attempts, lorawan_st
 void lorawan_command_completed(lorawan_stack_status_t status, uint8_t attempts) {
   error_t status_buffer = (error_t)status;
   alp_interface_status_t result = (alp_interface_status_t) {
-    .itf_id = current_lorawan_interface_type,
+    .itf_id = NG(current_lorawan_interface_type),
     .len = 7,
   };
   add_interface_status_lorawan(result.itf_status, attempts, status);
 
-  alp_layer_command_completed(lorawan_trans_id, &status_buffer, &result);
+  alp_layer_command_completed(NG(lorawan_trans_id), &status_buffer, &result);
 }
 
 static void lorawan_status_callback(lorawan_stack_status_t status, uint8_t attempts)
 {
-  alp_command_t* command = alloc_command();
+  alp_command_t* command = alloc_command(0);
+  if(command == NULL)
+    return;
+
   command->respond_when_completed=true;
+  command->has_trans_id = true; // the status report is completed using trans_id 0
 
   alp_interface_status_t result = (alp_interface_status_t) {
-    .itf_id = current_lorawan_interface_type,
+    .itf_id = NG(current_lorawan_interface_type),
     .len = 7
   };
   add_interface_status_lorawan(result.itf_status, attempts, status);
@@ -918,30 +1216,31 @@ static void lorawan_status_callback(lorawan_stack_status_t status, uint8_t attem
 }
 
 static error_t lorawan_send_otaa(uint8_t* payload, uint8_t payload_length, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* itf_cfg) {
-  if(!otaa_just_inited && (lorawan_otaa_is_joined(&itf_cfg->lorawan_session_config_otaa))) {
+  if(!NG(otaa_just_inited) && (lorawan_otaa_is_joined(&itf_cfg->lorawan_session_config_otaa))) {
     DPRINT("sending otaa payload");
-    current_lorawan_interface_type = ALP_ITF_ID_LORAWAN_OTAA;
+    NG(current_lorawan_interface_type) = ALP_ITF_ID_LORAWAN_OTAA;
     lorawan_stack_status_t status = lorawan_stack_send(payload, payload_length, itf_cfg->lorawan_session_config_otaa.application_port, itf_cfg->lorawan_session_config_otaa.request_ack);
     lorawan_error_handler(trans_id, status);
   } else { //OTAA not joined yet or still initing
     DPRINT("OTAA not joined yet");
-    otaa_just_inited = false;
+    NG(otaa_just_inited) = false;
     alp_command_t* command = get_command_by_transid(*trans_id);
-    fifo_put(&command->alp_response_fifo, payload, payload_length);
+    if(reserve_response(command, payload_length))
+      fifo_put(&command->alp_response_fifo, payload, payload_length);
     lorawan_error_handler(trans_id, LORAWAN_STACK_ERROR_NOT_JOINED);
   }
   return SUCCESS;
 }
 
 static error_t lorawan_send_abp(uint8_t* payload, uint8_t payload_length, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* itf_cfg) {
-  if(!abp_just_inited) {
+  if(!NG(abp_just_inited)) {
     itf_cfg->lorawan_session_config_abp.devAddr = __builtin_bswap32(itf_cfg->lorawan_session_config_abp.devAddr);
     itf_cfg->lorawan_session_config_abp.network_id = __builtin_bswap32(itf_cfg->lorawan_session_config_abp.network_id);
     lorawan_abp_is_joined(&itf_cfg->lorawan_session_config_abp);
   } else
-    abp_just_inited = false;
+    NG(abp_just_inited) = false;
   DPRINT("sending abp payload");
-  current_lorawan_interface_type = ALP_ITF_ID_LORAWAN_ABP;
+  NG(current_lorawan_interface_type) = ALP_ITF_ID_LORAWAN_ABP;
   lorawan_stack_status_t status = lorawan_stack_send(payload, payload_length, itf_cfg->lorawan_session_config_abp.application_port, itf_cfg->lorawan_session_config_abp.request_ack);
   lorawan_error_handler(trans_id, status);
   return SUCCESS;
@@ -952,32 +1251,32 @@ static void lorawan_error_handler(uint16_t* trans_id, lorawan_stack_status_t sta
     log_print_string("!!!LORAWAN ERROR: %d\n", status);
     error_t status_buffer = (error_t)status;
     alp_interface_status_t result = (alp_interface_status_t) {
-      .itf_id = current_lorawan_interface_type,
+      .itf_id = NG(current_lorawan_interface_type),
       .len = 7
     };
     add_interface_status_lorawan(result.itf_status, 1, status);
   
     alp_layer_command_completed(*trans_id, &status_buffer, &result);
   } else 
-    lorawan_trans_id = *trans_id;
+    NG(lorawan_trans_id) = *trans_id;
 }
 
 static void lorawan_init_otaa(alp_interface_config_t* session_cfg) {
   lorawan_stack_init_otaa(&session_cfg->lorawan_session_config_otaa);
-  otaa_just_inited = true;
+  NG(otaa_just_inited) = true;
 }
 
 static void lorawan_init_abp(alp_interface_config_t* session_cfg) {
   session_cfg->lorawan_session_config_abp.devAddr = __builtin_bswap32(session_cfg->lorawan_session_config_abp.devAddr);
   session_cfg->lorawan_session_config_abp.network_id = __builtin_bswap32(session_cfg->lorawan_session_config_abp.network_id);
   lorawan_stack_init_abp(&session_cfg->lorawan_session_config_abp);
-  abp_just_inited = true;
+  NG(abp_just_inited) = true;
 }
 
 static void alp_layer_lorawan_init() {
   lorawan_register_cbs(lorawan_rx, lorawan_command_completed, lorawan_status_callback);
 
-  interface_lorawan_otaa = (alp_interface_t) {
+  NG(interface_lorawan_otaa) = (alp_interface_t) {
     .itf_id = 0x03,
     .itf_cfg_len = sizeof(lorawan_session_config_otaa_t),
     .itf_status_len = 7,
@@ -986,9 +1285,9 @@ static void alp_layer_lorawan_init() {
     .send_command = lorawan_send_otaa,
     .unique = true
   };
-  alp_layer_register_interface(&interface_lorawan_otaa);
+  alp_layer_register_interface(&NG(interface_lorawan_otaa));
 
-  interface_lorawan_abp = (alp_interface_t) {
+  NG(interface_lorawan_abp) = (alp_interface_t) {
     .itf_id = ALP_ITF_ID_LORAWAN_ABP,
     .itf_cfg_len = sizeof(lorawan_session_config_abp_t),
     .itf_status_len = 7,
@@ -997,7 +1296,7 @@ static void alp_layer_lorawan_init() {
     .send_command = lorawan_send_abp,
     .unique = true
   };
-  alp_layer_register_interface(&interface_lorawan_abp);
+  alp_layer_register_interface(&NG(interface_lorawan_abp));
 
 }
 #endif
@@ -22,6 +22,7 @@
 #include "debug.h"
 #include "packet.h"
 #include "d7anp.h"
+#include "d7anp_ssr.h"
 #include "d7ap_fs.h"
 #include "ng.h"
 #include "log.h"
@@ -31,6 +32,7 @@
 #include "packet_queue.h"
 #include "errors.h"
 #include "timer.h"
+#include "perf_counters.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_NP_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_NWL, __VA_ARGS__)
@@ -48,7 +50,7 @@ typedef enum {
     D7ANP_STATE_FOREGROUND_SCAN,
 } state_t;
 
-static state_t NGDEF(_d7anp_state) = D7ANP_STATE_STOPPED;
+static state_t NGDEF(_d7anp_state) = NGINIT(D7ANP_STATE_STOPPED);
 #define d7anp_state NG(_d7anp_state)
 
 static state_t NGDEF(_d7anp_prev_state);
@@ -61,18 +63,18 @@ static timer_tick_t NGDEF(_fg_scan_timeout_ticks);
 static dae_nwl_security_t NGDEF(_security_state);
 #define security_state NG(_security_state)
 
-static dae_nwl_ssr_t NGDEF(_node_security_state);
-#define node_security_state NG(_node_security_state)
-
 static dae_nwl_trusted_node_t* NGDEF(_latest_node);
 #define latest_node NG(_latest_node)
+
+static aes128_ctx_t NGDEF(_aes_ctx);
+#define aes_ctx NG(_aes_ctx)
 #endif
 
-static timer_event d7anp_fg_scan_expired_timer;
-static timer_event d7anp_start_fg_scan_after_d7aadvp_timer;
+static timer_event NGDEF(d7anp_fg_scan_expired_timer);
+static timer_event NGDEF(d7anp_start_fg_scan_after_d7aadvp_timer);
 
-d7ap_addressee_id_type_t address_id_type;
-uint8_t address_id[8];
+d7ap_addressee_id_type_t NGDEF(address_id_type);
+uint8_t NGDEF(address_id)[8];
 
 #if defined(MODULE_D7AP_NLS_ENABLED)
 static inline uint8_t get_auth_len(uint8_t nls_method)
@@ -148,8 +150,8 @@ static void schedule_foreground_scan_expired_timer()
     // since this FG scan is started directly from the ISR (transmitted callback), I don't expect a significative delta between now and the transmission time
 
     DPRINT("starting foreground scan expiration timer (%i ticks, now %i)", fg_scan_timeout_ticks, timer_get_counter_value());
-    d7anp_fg_scan_expired_timer.next_event = fg_scan_timeout_ticks;
-    error_t rtc = timer_add_event(&d7anp_fg_scan_expired_timer);
+    NG(d7anp_fg_scan_expired_timer).next_event = fg_scan_timeout_ticks;
+    error_t rtc = timer_add_event(&NG(d7anp_fg_scan_expired_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -178,7 +180,7 @@ void d7anp_set_foreground_scan_timeout(timer_tick_t timeout)
 
 static void cancel_foreground_scan_task()
 {
-    timer_cancel_event(&d7anp_fg_scan_expired_timer);
+    timer_cancel_event(&NG(d7anp_fg_scan_expired_timer));
     fg_scan_timeout_ticks = 0;
 }
 
@@ -203,9 +205,25 @@ void start_foreground_scan_after_D7AAdvP(void *arg)
     d7anp_start_foreground_scan();
 }
 
+#if defined(MODULE_D7AP_NLS_ENABLED)
+/*
+ * The key is expanded once and cached in aes_ctx, it only needs to be expanded again
+ * when the "NWL Security Key" file is modified
+ */
+static void load_security_key(uint8_t file_id)
+{
+    uint8_t key[AES_BLOCK_SIZE];
+
+    assert (d7ap_fs_read_nwl_security_key(key) == 0); // TODO permission
+    DPRINT("KEY");
+    DPRINT_DATA(key, AES_BLOCK_SIZE);
+    aes128_init(&aes_ctx, key);
+}
+#endif
+
 void d7anp_set_address_id(uint8_t file_id)
 {
-    d7ap_fs_read_uid(address_id);
+    d7ap_fs_read_uid(NG(address_id));
 }
 
 void d7anp_init()
@@ -216,41 +234,37 @@ void d7anp_init()
     fg_scan_timeout_ticks = 0;
 
     // Initialize timers
-    timer_init_event(&d7anp_fg_scan_expired_timer, &foreground_scan_expired);
-    timer_init_event(&d7anp_start_fg_scan_after_d7aadvp_timer, &start_foreground_scan_after_D7AAdvP);
+    timer_init_event(&NG(d7anp_fg_scan_expired_timer), &foreground_scan_expired);
+    timer_init_event(&NG(d7anp_start_fg_scan_after_d7aadvp_timer), &start_foreground_scan_after_D7AAdvP);
 
     /*
      * vid or uid caching to prevent latency due to file access
      */
-    d7ap_fs_read_vid(address_id);
+    d7ap_fs_read_vid(NG(address_id));
 
     // vid is not valid when set to FF
-    if (memcmp(address_id, (uint8_t[2]){ 0xFF, 0xFF }, 2) == 0)
+    if (memcmp(NG(address_id), (uint8_t[2]){ 0xFF, 0xFF }, 2) == 0)
     {
         fs_register_file_modified_callback(D7A_FILE_UID_FILE_ID, &d7anp_set_address_id);
-        d7ap_fs_read_uid(address_id);
-        address_id_type = ID_TYPE_UID;
+        d7ap_fs_read_uid(NG(address_id));
+        NG(address_id_type) = ID_TYPE_UID;
     } else
-        address_id_type = ID_TYPE_VID;
+        NG(address_id_type) = ID_TYPE_VID;
 
 #if defined(MODULE_D7AP_NLS_ENABLED)
     /*
      * Init Security
      * Read the 128 bits key from the "NWL Security Key" file
      */
-    uint8_t key[AES_BLOCK_SIZE];
-
-    assert (d7ap_fs_read_nwl_security_key(key) == ALP_STATUS_OK); // TODO permission
-    DPRINT("KEY");
-    DPRINT_DATA(key, AES_BLOCK_SIZE);
-    AES128_init(key);
+    load_security_key(D7A_FILE_NWL_SECURITY_KEY);
+    fs_register_file_modified_callback(D7A_FILE_NWL_SECURITY_KEY, &load_security_key);
 
     /* Read the NWL security parameters */
     d7ap_fs_read_nwl_security(&security_state);
     DPRINT("Initial Key counter %d", security_state.key_counter);
     DPRINT("Initial Frame counter %ld", security_state.frame_counter);
     /* Read the NWL security state of the successfully decrypted and authenticated devices */
-    d7ap_fs_read_nwl_security_state_register(&node_security_state);
+    d7anp_ssr_init();
     latest_node = NULL;
 #endif
 }
@@ -258,8 +272,13 @@ void d7anp_init()
 void d7anp_stop()
 {
     d7anp_state = D7ANP_STATE_STOPPED;
-    timer_cancel_event(&d7anp_fg_scan_expired_timer);
-    timer_cancel_event(&d7anp_start_fg_scan_after_d7aadvp_timer);
+    timer_cancel_event(&NG(d7anp_fg_scan_expired_timer));
+    timer_cancel_event(&NG(d7anp_start_fg_scan_after_d7aadvp_timer));
+
+#if defined(MODULE_D7AP_NLS_ENABLED)
+    // write the pending frame counter updates of the trusted nodes back
+    d7anp_ssr_flush();
+#endif
 }
 
 error_t d7anp_tx_foreground_frame(packet_t* packet, bool should_include_origin_template)
@@ -282,7 +301,7 @@ error_t d7anp_tx_foreground_frame(packet_t* packet, bool should_include_origin_t
     }
     else
     {
-        packet->d7anp_ctrl.origin_id_type = address_id_type;
+        packet->d7anp_ctrl.origin_id_type = NG(address_id_type);
         packet->d7anp_ctrl.origin_void = false;
         // note we set packet->origin_access_class in DLL, since we cache the active access class there already
     }
@@ -306,7 +325,7 @@ security:
         DPRINT("Frame counter %ld", packet->d7anp_security.frame_counter);
 
         // Update the frame counter in the D7A file
-        fs_write_nwl_security(&security_state);
+        d7ap_fs_write_nwl_security(&security_state);
     }
 #else
     assert(packet->d7anp_ctrl.nls_method == AES_NONE); // when encryption is requested the MODULE_D7AP_NLS_ENABLED cmake option should be set
@@ -320,8 +339,8 @@ security:
 static void schedule_foreground_scan_after_D7AAdvP(timer_tick_t eta)
 {
     DPRINT("Perform a dll foreground scan at the end of the delay period (%i ticks)", eta);
-    d7anp_start_fg_scan_after_d7aadvp_timer.next_event = eta;
-    error_t rtc = timer_add_event(&d7anp_start_fg_scan_after_d7aadvp_timer);
+    NG(d7anp_start_fg_scan_after_d7aadvp_timer).next_event = eta;
+    error_t rtc = timer_add_event(&NG(d7anp_start_fg_scan_after_d7aadvp_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -413,7 +432,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
         build_iv(packet, payload_len, ctr_blk);
 
         // the encrypted payload replaces the plaintext
-        AES128_CTR_encrypt(payload, payload, payload_len, ctr_blk);
+        aes128_ctr_encrypt(&aes_ctx, payload, payload, payload_len, ctr_blk);
         break;
     case AES_CBC_MAC_128:
     case AES_CBC_MAC_64:
@@ -425,7 +444,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
         header[0] |= ( add_len > 0 );
 
         /* Compute the CBC-MAC */
-        AES128_CBC_MAC(auth, payload, payload_len, header, add, add_len, auth_len);
+        aes128_cbc_mac(&aes_ctx, auth, payload, payload_len, header, add, add_len, auth_len);
 
         /* Insert the authentication Tag */
         memcpy(payload + payload_len, auth, auth_len);
@@ -444,7 +463,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
         header[0] |= ( add_len > 0 );
 
         // TODO check that the payload length does not exceed the maximum size
-        AES128_CCM_encrypt(payload, payload_len, header, add, add_len, ctr_blk, auth_len);
+        aes128_ccm_encrypt(&aes_ctx, payload, payload_len, header, add, add_len, ctr_blk, auth_len);
         break;
     }
 
@@ -499,7 +518,7 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
         build_iv(packet, payload_len, ctr_blk);
 
         // the decrypted payload replaces the encrypted data
-        AES128_CTR_encrypt(packet->hw_radio_packet.data + index,
+        aes128_ctr_encrypt(&aes_ctx, packet->hw_radio_packet.data + index,
                            packet->hw_radio_packet.data + index,
                            payload_len, ctr_blk);
         break;
@@ -513,7 +532,7 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
         header[0] |= ( add_len > 0 );
 
         /* Compute the CBC-MAC and check the authentication Tag */
-        AES128_CBC_MAC(auth, packet->hw_radio_packet.data + index,
+        aes128_cbc_mac(&aes_ctx, auth, packet->hw_radio_packet.data + index,
                        payload_len, header, add, add_len, auth_len);
 
         if (memcmp(auth, tag, auth_len) != 0)
@@ -535,7 +554,7 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
         /* Set Header flags */
         header[0] |= ( add_len > 0 );
 
-        if (AES128_CCM_decrypt(packet->hw_radio_packet.data + index,
+        if (aes128_ccm_decrypt(&aes_ctx, packet->hw_radio_packet.data + index,
                                payload_len, header, add, add_len, ctr_blk,
                                tag, auth_len) != 0)
             return false;
@@ -561,14 +580,14 @@ uint8_t d7anp_assemble_packet_header(packet_t *packet, uint8_t *data_ptr)
 
         if (packet->d7anp_ctrl.origin_id_type == ID_TYPE_UID)
         {
-            memcpy(packet->origin_access_id, address_id, 8);
-            memcpy(data_ptr, address_id, 8);
+            memcpy(packet->origin_access_id, NG(address_id), 8);
+            memcpy(data_ptr, NG(address_id), 8);
             data_ptr += 8;
         }
         else if (packet->d7anp_ctrl.origin_id_type == ID_TYPE_VID)
         {
-            memcpy(packet->origin_access_id, address_id, 2);
-            memcpy(data_ptr, address_id, 2);
+            memcpy(packet->origin_access_id, NG(address_id), 2);
+            memcpy(data_ptr, NG(address_id), 2);
             data_ptr += 2;
         }
         else if (packet->d7anp_ctrl.origin_id_type == ID_TYPE_NBID)
@@ -595,45 +614,6 @@ uint8_t d7anp_assemble_packet_header(packet_t *packet, uint8_t *data_ptr)
     return data_ptr - d7anp_header_start;
 }
 
-#if defined(MODULE_D7AP_NLS_ENABLED)
-dae_nwl_trusted_node_t *get_trusted_node(uint8_t *address)
-{
-    //look up the sender's address in the trusted node table
-    for(uint8_t i = 0; i < node_security_state.trusted_node_nb; i++)
-    {
-        if(memcmp(node_security_state.trusted_node_table[i].addr, address, 8) == 0)
-            return &(node_security_state.trusted_node_table[i]);
-    }
-
-    return NULL;
-}
-
-dae_nwl_trusted_node_t *add_trusted_node(uint8_t *address, uint32_t frame_counter,
-                                       uint8_t key_counter)
-{
-    uint8_t index = node_security_state.trusted_node_nb;
-    dae_nwl_trusted_node_t *node;
-
-    if (node_security_state.trusted_node_nb < FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE)
-        node_security_state.trusted_node_nb++;
-    else
-    {
-        DPRINT("SSR is full !");
-        return NULL;
-    }
-
-    node = &node_security_state.trusted_node_table[index];
-    memcpy(node->addr, address, 8);
-    node->frame_counter = frame_counter;
-    node->key_counter = key_counter;
-
-    DPRINT("Add node <%p> total number <%d>", node, node_security_state.trusted_node_nb);
-    /* Update the FS */
-    d7ap_fs_add_nwl_security_state_register_entry(node, node_security_state.trusted_node_nb);
-    return node;
-}
-#endif
-
 bool d7anp_disassemble_packet_header(packet_t* packet, uint8_t *data_idx)
 {
     packet->d7anp_ctrl.raw = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
@@ -676,7 +656,7 @@ bool d7anp_disassemble_packet_header(packet_t* packet, uint8_t *data_idx)
 
             DPRINT("Received key counter <%d>, frame counter <%ld>", packet->d7anp_security.key_counter, packet->d7anp_security.frame_counter);
 
-            if (node_security_state.filter_mode & ENABLE_SSR_FILTER)
+            if (d7anp_ssr_get_filter_mode() & ENABLE_SSR_FILTER)
                 prevent_replay_attack = true;
         }
 
@@ -692,22 +672,23 @@ bool d7anp_disassemble_packet_header(packet_t* packet, uint8_t *data_idx)
                 node = latest_node;
             }
             else
-                node = get_trusted_node(packet->origin_access_id);
+                node = d7anp_ssr_get_trusted_node(packet->origin_access_id);
 
             if (node && (node->frame_counter > packet->d7anp_security.frame_counter ||
                          node->frame_counter == (uint32_t)~0))
             {
                 DPRINT("Replay attack detected cnt %ld->%ld shift back", node->frame_counter, packet->d7anp_security.frame_counter);
+                PERF_COUNTER_INC(d7anp_replay_rejections);
                 return false;
             }
 
             // update the node
             if (node)
-                node->frame_counter = packet->d7anp_security.frame_counter;
+                d7anp_ssr_update_frame_counter(node, packet->d7anp_security.frame_counter);
             else
             {
                 if (ID_TYPE_IS_BROADCAST(packet->dll_header.control_target_id_type) &&
-                     !(node_security_state.filter_mode & ALLOW_NEW_SSR_ENTRY_IN_BCAST))
+                     !(d7anp_ssr_get_filter_mode() & ALLOW_NEW_SSR_ENTRY_IN_BCAST))
                 {
                     DPRINT("New SSR entry not authorized in broadcast");
                     return false;
@@ -721,8 +702,8 @@ bool d7anp_disassemble_packet_header(packet_t* packet, uint8_t *data_idx)
             return false;
 
         if (create_node)
-             add_trusted_node(packet->origin_access_id, packet->d7anp_security.frame_counter,
-                              packet->d7anp_security.key_counter);
+             d7anp_ssr_add_trusted_node(packet->origin_access_id, packet->d7anp_security.frame_counter,
+                                        packet->d7anp_security.key_counter);
     }
 #endif
 
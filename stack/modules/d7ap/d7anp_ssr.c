@@ -0,0 +1,332 @@
+/*! \file d7anp_ssr.c
+ *
+
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://mosaic-lopow.github.io/dash7-ap-open-source-stack/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "string.h"
+#include "types.h"
+#include "debug.h"
+#include "d7anp_ssr.h"
+#include "d7ap_fs.h"
+#include "ng.h"
+#include "log.h"
+#include "scheduler.h"
+#include "timer.h"
+
+#if defined(MODULE_D7AP_NLS_ENABLED)
+
+#if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_NP_LOG_ENABLED)
+#define DPRINT(...) log_print_stack_string(LOG_STACK_NWL, __VA_ARGS__)
+#else
+#define DPRINT(...)
+#endif
+
+#define SSR_SIZE FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE
+
+#if SSR_SIZE > 0x7FFF
+  #error FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE too large
+#endif
+
+// the hash table has at least twice the number of slots as entries, rounded up to a power of 2,
+// to keep the probe sequences short
+#define SSR_HASH_SIZE ROUND_UP_POW2(2 * SSR_SIZE)
+#define SSR_HASH_MASK (SSR_HASH_SIZE - 1)
+
+#define SSR_NONE 0xFFFF
+
+typedef struct
+{
+    dae_nwl_trusted_node_t node; // first member, so a node pointer can be converted to the entry
+    uint16_t lru_prev; // towards the most recently used entry
+    uint16_t lru_next; // towards the least recently used entry
+    bool dirty;
+} ssr_entry_t;
+
+static ssr_entry_t NGDEF(_entries)[SSR_SIZE];
+#define entries NG(_entries)
+
+// the index in entries of the node hashed to each slot, or SSR_NONE. Collisions are resolved by linear probing.
+static uint16_t NGDEF(_hash_table)[SSR_HASH_SIZE];
+#define hash_table NG(_hash_table)
+
+// entries are used in order, the entries below entry_count are valid
+static uint16_t NGDEF(_entry_count);
+#define entry_count NG(_entry_count)
+
+static uint16_t NGDEF(_lru_head);
+#define lru_head NG(_lru_head)
+
+static uint16_t NGDEF(_lru_tail);
+#define lru_tail NG(_lru_tail)
+
+static uint8_t NGDEF(_filter_mode);
+#define ssr_filter_mode NG(_filter_mode)
+
+// the number of entries which fit in the SSR file
+static uint16_t NGDEF(_persistent_count);
+#define persistent_count NG(_persistent_count)
+
+static bool NGDEF(_header_dirty);
+#define header_dirty NG(_header_dirty)
+
+static bool NGDEF(_writeback_scheduled);
+#define writeback_scheduled NG(_writeback_scheduled)
+
+static uint16_t hash_address(const uint8_t* address)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+    for(uint8_t i = 0; i < D7A_FILE_UID_SIZE; i++)
+    {
+        hash ^= address[i];
+        hash *= 16777619UL;
+    }
+
+    return (hash ^ (hash >> 16)) & SSR_HASH_MASK;
+}
+
+static bool is_valid_address(const uint8_t* address)
+{
+    uint8_t all_ones = 0xFF, all_zeros = 0x00;
+    for(uint8_t i = 0; i < D7A_FILE_UID_SIZE; i++)
+    {
+        all_ones &= address[i];
+        all_zeros |= address[i];
+    }
+
+    return all_ones != 0xFF && all_zeros != 0x00;
+}
+
+/* returns the slot containing the address, or the empty slot where it should be inserted */
+static uint16_t find_slot(const uint8_t* address)
+{
+    uint16_t slot = hash_address(address);
+    while(hash_table[slot] != SSR_NONE &&
+          memcmp(entries[hash_table[slot]].node.addr, address, D7A_FILE_UID_SIZE) != 0)
+        slot = (slot + 1) & SSR_HASH_MASK;
+
+    return slot;
+}
+
+/* removes the slot and moves the following entries of the probe sequence back, so no tombstones are needed */
+static void remove_slot(uint16_t slot)
+{
+    uint16_t next = slot;
+    while(true)
+    {
+        next = (next + 1) & SSR_HASH_MASK;
+        if(hash_table[next] == SSR_NONE)
+            break;
+
+        // the entry in next can be moved to slot when slot is cyclically between its home slot and next
+        uint16_t home = hash_address(entries[hash_table[next]].node.addr);
+        if(((next - home) & SSR_HASH_MASK) >= ((next - slot) & SSR_HASH_MASK))
+        {
+            hash_table[slot] = hash_table[next];
+            slot = next;
+        }
+    }
+
+    hash_table[slot] = SSR_NONE;
+}
+
+static void lru_unlink(uint16_t index)
+{
+    ssr_entry_t* entry = &entries[index];
+    if(entry->lru_prev != SSR_NONE)
+        entries[entry->lru_prev].lru_next = entry->lru_next;
+    else
+        lru_head = entry->lru_next;
+
+    if(entry->lru_next != SSR_NONE)
+        entries[entry->lru_next].lru_prev = entry->lru_prev;
+    else
+        lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(uint16_t index)
+{
+    entries[index].lru_prev = SSR_NONE;
+    entries[index].lru_next = lru_head;
+    if(lru_head != SSR_NONE)
+        entries[lru_head].lru_prev = index;
+    else
+        lru_tail = index;
+
+    lru_head = index;
+}
+
+static void writeback(void* arg)
+{
+    (void)arg;
+    d7anp_ssr_flush();
+}
+
+static void mark_dirty(uint16_t index)
+{
+    if(index >= persistent_count)
+        return; // only kept in RAM
+
+    entries[index].dirty = true;
+    if(!writeback_scheduled)
+    {
+        writeback_scheduled = true;
+        timer_post_task_delay(&writeback, MODULE_D7AP_SSR_WRITEBACK_DELAY * TIMER_TICKS_PER_SEC);
+    }
+}
+
+void d7anp_ssr_init(void)
+{
+    dae_nwl_ssr_t header = { 0 };
+
+    sched_register_task(&writeback);
+    if(writeback_scheduled)
+        timer_cancel_task(&writeback);
+
+    writeback_scheduled = false;
+    header_dirty = false;
+    entry_count = 0;
+    lru_head = SSR_NONE;
+    lru_tail = SSR_NONE;
+    memset(hash_table, 0xFF, sizeof(hash_table));
+
+    d7ap_fs_read_nwl_security_state_register(&header);
+    ssr_filter_mode = header.filter_mode;
+
+    persistent_count = d7ap_fs_get_nwl_security_state_register_capacity();
+    if(persistent_count > SSR_SIZE)
+        persistent_count = SSR_SIZE;
+
+    // the entries are written in order, so the first invalid entry marks the end of the table
+    while(entry_count < persistent_count)
+    {
+        ssr_entry_t* entry = &entries[entry_count];
+        if(d7ap_fs_read_nwl_security_state_register_entry(entry_count, &entry->node) != 0 ||
+           !is_valid_address(entry->node.addr))
+            break;
+
+        uint16_t slot = find_slot(entry->node.addr);
+        if(hash_table[slot] != SSR_NONE)
+            break; // duplicate, the file is corrupt
+
+        hash_table[slot] = entry_count;
+        entry->dirty = false;
+        lru_push_front(entry_count);
+        entry_count++;
+    }
+
+    DPRINT("SSR: %i trusted nodes loaded, %i can be stored", entry_count, persistent_count);
+}
+
+void d7anp_ssr_flush(void)
+{
+    uint16_t count = entry_count < persistent_count ? entry_count : persistent_count;
+
+    if(writeback_scheduled)
+    {
+        timer_cancel_task(&writeback);
+        writeback_scheduled = false;
+    }
+
+    for(uint16_t i = 0; i < count; i++)
+    {
+        if(entries[i].dirty)
+        {
+            d7ap_fs_write_nwl_security_state_register_entry(i, &entries[i].node);
+            entries[i].dirty = false;
+        }
+    }
+
+    if(header_dirty)
+    {
+        // the trusted node count of the file saturates, the entries are located by their address
+        dae_nwl_ssr_t header = {
+            .filter_mode = ssr_filter_mode,
+            .trusted_node_nb = count > UINT8_MAX ? UINT8_MAX : count
+        };
+
+        d7ap_fs_write_nwl_security_state_register(&header);
+        header_dirty = false;
+    }
+}
+
+uint8_t d7anp_ssr_get_filter_mode(void)
+{
+    return ssr_filter_mode;
+}
+
+uint16_t d7anp_ssr_get_trusted_node_count(void)
+{
+    return entry_count;
+}
+
+dae_nwl_trusted_node_t* d7anp_ssr_get_trusted_node(const uint8_t* address)
+{
+    uint16_t index = hash_table[find_slot(address)];
+    if(index == SSR_NONE)
+        return NULL;
+
+    if(index != lru_head)
+    {
+        lru_unlink(index);
+        lru_push_front(index);
+    }
+
+    return &entries[index].node;
+}
+
+dae_nwl_trusted_node_t* d7anp_ssr_add_trusted_node(const uint8_t* address, uint32_t frame_counter, uint8_t key_counter)
+{
+    uint16_t index = hash_table[find_slot(address)];
+
+    if(index != SSR_NONE)
+        lru_unlink(index);
+    else if(entry_count < SSR_SIZE)
+    {
+        index = entry_count++;
+        if(index < persistent_count)
+            header_dirty = true;
+    }
+    else
+    {
+        // evict the least recently used node
+        index = lru_tail;
+        DPRINT("SSR is full, evict node %i", index);
+        remove_slot(find_slot(entries[index].node.addr));
+        lru_unlink(index);
+    }
+
+    dae_nwl_trusted_node_t* node = &entries[index].node;
+    memcpy(node->addr, address, D7A_FILE_UID_SIZE);
+    node->frame_counter = frame_counter;
+    node->key_counter = key_counter;
+
+    hash_table[find_slot(address)] = index;
+    lru_push_front(index);
+    mark_dirty(index);
+
+    DPRINT("Add node <%i> total number <%i>", index, entry_count);
+    return node;
+}
+
+void d7anp_ssr_update_frame_counter(dae_nwl_trusted_node_t* node, uint32_t frame_counter)
+{
+    node->frame_counter = frame_counter;
+    mark_dirty((ssr_entry_t*)node - entries);
+}
+
+#endif // MODULE_D7AP_NLS_ENABLED
@@ -0,0 +1,69 @@
+/*! \file d7anp_ssr.h
+ *
+
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://mosaic-lopow.github.io/dash7-ap-open-source-stack/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*! \file d7anp_ssr.h
+ * \addtogroup D7ANP
+ * \ingroup D7AP
+ * @{
+ * \brief The Security State Register (SSR), which contains the trusted nodes used for replay protection
+ *
+ * The trusted nodes are kept in RAM in a hash table indexed by UID. When the table is full, the least
+ * recently used node is evicted. Slot i of the table is backed by entry i of the SSR file, which is
+ * only updated lazily: modified entries are written back in a batch, MODULE_D7AP_SSR_WRITEBACK_DELAY
+ * seconds after the first modification, or when d7anp_ssr_flush() is called. The number of entries
+ * which are persisted is limited by the length of the SSR file.
+ */
+
+#ifndef D7ANP_SSR_H_
+#define D7ANP_SSR_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#include "MODULE_D7AP_defs.h"
+#include "dae.h"
+
+/*! \brief Load the filter mode and the trusted nodes from the SSR file */
+void d7anp_ssr_init(void);
+
+/*! \brief Write all modified trusted nodes back to the SSR file */
+void d7anp_ssr_flush(void);
+
+uint8_t d7anp_ssr_get_filter_mode(void);
+
+uint16_t d7anp_ssr_get_trusted_node_count(void);
+
+/*! \brief Look up the trusted node with the given UID and mark it as most recently used
+ *
+ * \return the trusted node or NULL if the node is not known
+ */
+dae_nwl_trusted_node_t* d7anp_ssr_get_trusted_node(const uint8_t* address);
+
+/*! \brief Add a trusted node, evicting the least recently used node when the table is full
+ *
+ * \return the new trusted node
+ */
+dae_nwl_trusted_node_t* d7anp_ssr_add_trusted_node(const uint8_t* address, uint32_t frame_counter, uint8_t key_counter);
+
+/*! \brief Update the frame counter of a trusted node returned by d7anp_ssr_get_trusted_node() */
+void d7anp_ssr_update_frame_counter(dae_nwl_trusted_node_t* node, uint32_t frame_counter);
+
+#endif /* D7ANP_SSR_H_ */
+
+/** @}*/
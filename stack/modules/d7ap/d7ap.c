@@ -29,6 +29,7 @@
 #include "dae.h"
 #include "modules_defs.h"
 #include "MODULE_D7AP_defs.h"
+#include "ng.h"
 
 #ifdef MODULE_ALP
 #include "alp.h"
@@ -44,16 +45,16 @@
 
 #define D7A_SECURITY_HEADER_SIZE 5
 
-d7ap_resource_desc_t registered_client[MODULE_D7AP_MAX_CLIENT_COUNT];
-uint8_t registered_client_nb = 0;
-uint8_t alp_client_id;
-bool inited = false;
+d7ap_resource_desc_t NGDEF(registered_client)[MODULE_D7AP_MAX_CLIENT_COUNT];
+uint8_t NGDEF(registered_client_nb);
+uint8_t NGDEF(alp_client_id);
+bool NGDEF(inited);
 
 #ifdef MODULE_ALP
-alp_interface_t d7_alp_interface;
-alp_interface_config_t d7ap_session_config_buffer = (alp_interface_config_t) {
+alp_interface_t NGDEF(d7_alp_interface);
+alp_interface_config_t NGDEF(d7ap_session_config_buffer) = NGINIT({
     .itf_id = ALP_ITF_ID_D7ASP
-};
+});
 #endif // MODULE_ALP
 
 #ifdef MODULE_ALP
@@ -83,9 +84,9 @@ bool command_from_d7ap(uint8_t* payload, uint8_t len, d7ap_session_result_t resu
 error_t d7ap_alp_send(uint8_t* payload, uint8_t payload_length, uint8_t expected_response_length, uint16_t* trans_id, alp_interface_config_t* itf_cfg) {
     DPRINT("sending D7 packet");
     if(itf_cfg != NULL) {
-        return d7ap_send(alp_client_id, (d7ap_session_config_t*)&itf_cfg->itf_config, payload, payload_length, expected_response_length, trans_id);
+        return d7ap_send(NG(alp_client_id), (d7ap_session_config_t*)&itf_cfg->itf_config, payload, payload_length, expected_response_length, trans_id);
     } else {
-        return d7ap_send(alp_client_id, NULL, payload, payload_length, expected_response_length, trans_id);
+        return d7ap_send(NG(alp_client_id), NULL, payload, payload_length, expected_response_length, trans_id);
     }
 }
 
@@ -96,18 +97,18 @@ void d7ap_command_completed(uint16_t trans_id, error_t error) {
 
 void d7ap_init()
 {
-    if(inited)
+    if(NG(inited))
         return;
-    inited = true;
+    NG(inited) = true;
 
     d7ap_fs_init();
 
     // Initialize the D7AP stack
     d7ap_stack_init();
-    registered_client_nb = 0;
+    NG(registered_client_nb) = 0;
 
 #ifdef MODULE_ALP
-    d7_alp_interface = (alp_interface_t) {
+    NG(d7_alp_interface) = (alp_interface_t) {
         .itf_id = 0xD7,
         .itf_cfg_len = sizeof(d7ap_session_config_t),
         .itf_status_len = sizeof(d7ap_session_result_t),
@@ -117,7 +118,7 @@ void d7ap_init()
         .unique = true
     };
 
-    alp_layer_register_interface(&d7_alp_interface);
+    alp_layer_register_interface(&NG(d7_alp_interface));
 
     d7ap_resource_desc_t alp_desc = {
       .receive_cb = response_from_d7ap,
@@ -125,17 +126,17 @@ void d7ap_init()
       .unsolicited_cb = command_from_d7ap
     };
 
-    alp_client_id = d7ap_register(&alp_desc);
+    NG(alp_client_id) = d7ap_register(&alp_desc);
 
-    DPRINT("alp_client_id is %i",alp_client_id);
+    DPRINT("alp_client_id is %i",NG(alp_client_id));
 #endif // MODULE_ALP
 }
 
 void d7ap_stop()
 {
-    inited = false;
+    NG(inited) = false;
     d7ap_stack_stop();
-    registered_client_nb = 0;
+    NG(registered_client_nb) = 0;
 }
 
 /**
@@ -147,10 +148,10 @@ void d7ap_stop()
  */
 uint8_t d7ap_register(d7ap_resource_desc_t* desc)
 {
-    assert(registered_client_nb < D7AP_MAX_CLIENT_COUNT);
-    registered_client[registered_client_nb] = *desc;
-    registered_client_nb++;
-    return (registered_client_nb-1);
+    assert(NG(registered_client_nb) < MODULE_D7AP_MAX_CLIENT_COUNT);
+    NG(registered_client)[NG(registered_client_nb)] = *desc;
+    NG(registered_client_nb)++;
+    return (NG(registered_client_nb)-1);
 }
 
 //TODO to unregister, better to introduce a linked list for the registered clients
@@ -243,7 +244,7 @@ error_t d7ap_send(uint8_t client_id, d7ap_session_config_t* config, uint8_t* pay
 {
     error_t error;
 
-    if (client_id > registered_client_nb)
+    if (client_id > NG(registered_client_nb))
         return -ESIZE;
 
     error = d7ap_stack_send(client_id, config, payload, len, expected_response_len, trans_id);
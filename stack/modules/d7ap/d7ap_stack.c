@@ -32,6 +32,7 @@
 #include "d7anp.h"
 #include "dll.h"
 #include "d7ap_fs.h"
+#include "ng.h"
 
 
 
@@ -52,7 +53,7 @@ typedef struct {
     uint16_t trans_id[MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT];
 } session_t;
 
-static session_t sessions[MODULE_D7AP_MAX_SESSION_COUNT];
+static session_t NGDEF(sessions)[MODULE_D7AP_MAX_SESSION_COUNT];
 
 typedef struct {
     bool active;
@@ -60,14 +61,14 @@ typedef struct {
     uint8_t token;
 } slave_session_t;
 
-static slave_session_t slave_session = {
+static slave_session_t NGDEF(slave_session) = NGINIT({
     .active = false,
     .expected_response = false,
     .token = 0
-};
+});
 
-extern d7ap_resource_desc_t registered_client[D7AP_MAX_CLIENT_COUNT];
-extern uint8_t registered_client_nb;
+extern d7ap_resource_desc_t NGDEF(registered_client)[MODULE_D7AP_MAX_CLIENT_COUNT];
+extern uint8_t NGDEF(registered_client_nb);
 
 typedef enum {
     D7AP_STACK_STATE_STOPPED,
@@ -77,7 +78,7 @@ typedef enum {
     D7AP_STACK_STATE_WAIT_APP_ANSWER
 } state_t;
 
-static state_t d7ap_stack_state = D7AP_STACK_STATE_STOPPED;
+static state_t NGDEF(d7ap_stack_state) = NGINIT(D7AP_STACK_STATE_STOPPED);
 
 // TODO document state diagram
 static void switch_state(state_t new_state)
@@ -85,11 +86,11 @@ static void switch_state(state_t new_state)
     switch(new_state)
     {
         case D7AP_STACK_STATE_TRANSMITTING:
-            switch(d7ap_stack_state)
+            switch(NG(d7ap_stack_state))
             {
                 case D7AP_STACK_STATE_STOPPED:
                 case D7AP_STACK_STATE_IDLE:
-                    d7ap_stack_state = new_state;
+                    NG(d7ap_stack_state) = new_state;
                     DPRINT("[D7AP] Switching to state D7AP_STATE_TRANSMITTING");
                     break;
                 case D7AP_STACK_STATE_TRANSMITTING:
@@ -102,13 +103,13 @@ static void switch_state(state_t new_state)
 
             break;
         case D7AP_STACK_STATE_RECEIVING:
-            switch(d7ap_stack_state)
+            switch(NG(d7ap_stack_state))
             {
                 case D7AP_STACK_STATE_STOPPED:
                 case D7AP_STACK_STATE_IDLE:
                 case D7AP_STACK_STATE_WAIT_APP_ANSWER:
                 case D7AP_STACK_STATE_RECEIVING:
-                    d7ap_stack_state = new_state;
+                    NG(d7ap_stack_state) = new_state;
                     DPRINT("[D7AP] Switching to state D7AP_STATE_RECEIVING");
                     break;
                 default:
@@ -117,11 +118,11 @@ static void switch_state(state_t new_state)
             break;
 
         case D7AP_STACK_STATE_WAIT_APP_ANSWER:
-            switch(d7ap_stack_state)
+            switch(NG(d7ap_stack_state))
             {
                 case D7AP_STACK_STATE_STOPPED:
                 case D7AP_STACK_STATE_IDLE:
-                    d7ap_stack_state = new_state;
+                    NG(d7ap_stack_state) = new_state;
                     DPRINT("[D7AP] Switching to state D7AP_STACK_STATE_WAIT_APP_ANSWER");
                     break;
                 default:
@@ -130,13 +131,13 @@ static void switch_state(state_t new_state)
             break;
 
         case D7AP_STACK_STATE_IDLE:
-            switch(d7ap_stack_state)
+            switch(NG(d7ap_stack_state))
             {
                 case D7AP_STACK_STATE_RECEIVING:
                 case D7AP_STACK_STATE_TRANSMITTING:
                 case D7AP_STACK_STATE_WAIT_APP_ANSWER:
                 case D7AP_STACK_STATE_IDLE:
-                    d7ap_stack_state = new_state;
+                    NG(d7ap_stack_state) = new_state;
                     DPRINT("[D7AP] Switching to state D7AP_STACK_STATE_IDLE");
                     break;
                 default:
@@ -159,9 +160,9 @@ static void free_session(session_t* session) {
 
 static session_t* alloc_session(uint8_t client_id) {
     for(uint8_t i = 0; i < MODULE_D7AP_MAX_SESSION_COUNT; i++) {
-        if(sessions[i].client_id == INVALID_CLIENT_ID) {
-            sessions[i].client_id = client_id;
-        return &(sessions[i]);
+        if(NG(sessions)[i].client_id == INVALID_CLIENT_ID) {
+            NG(sessions)[i].client_id = client_id;
+        return &(NG(sessions)[i]);
         }
     }
 
@@ -172,7 +173,7 @@ static session_t* alloc_session(uint8_t client_id) {
 static void init_session_list()
 {
     for(uint8_t i = 0; i < MODULE_D7AP_MAX_SESSION_COUNT; i++) {
-        free_session(&sessions[i]);
+        free_session(&NG(sessions)[i]);
     }
 }
 
@@ -184,8 +185,8 @@ static void on_access_profile_file_changed(uint8_t file_id) {
 
 void d7ap_stack_init(void)
 {
-    assert(d7ap_stack_state == D7AP_STACK_STATE_STOPPED);
-    d7ap_stack_state = D7AP_STACK_STATE_IDLE;
+    assert(NG(d7ap_stack_state) == D7AP_STACK_STATE_STOPPED);
+    NG(d7ap_stack_state) = D7AP_STACK_STATE_IDLE;
 
     d7asp_init();
     d7atp_init();
@@ -205,15 +206,16 @@ void d7ap_stack_stop()
     d7anp_stop();
     dll_stop();
     hw_radio_stop();
+    d7ap_fs_flush(); // write back the status files kept in RAM
 
-    d7ap_stack_state = D7AP_STACK_STATE_STOPPED;
+    NG(d7ap_stack_state) = D7AP_STACK_STATE_STOPPED;
 }
 
 static session_t* get_session_by_session_token(uint8_t session_token)
 {
     for(uint8_t i = 0; i < MODULE_D7AP_MAX_SESSION_COUNT; i++) {
-        if(sessions[i].token == session_token)
-            return &(sessions[i]);
+        if(NG(sessions)[i].token == session_token)
+            return &(NG(sessions)[i]);
     }
 
     return NULL;
@@ -235,7 +237,7 @@ error_t d7ap_stack_send(uint8_t client_id, d7ap_session_config_t* config, uint8_
 
     // When an application response is expected, forward the payload directly to the current D7A session
     // TODO how to filter by client Id since we don't know to which client the request is addressed?
-    if (d7ap_stack_state == D7AP_STACK_STATE_WAIT_APP_ANSWER)
+    if (NG(d7ap_stack_state) == D7AP_STACK_STATE_WAIT_APP_ANSWER)
     {
         return (d7asp_send_response(payload, len));
     }
@@ -285,18 +287,18 @@ bool d7ap_stack_process_unsolicited_request(uint8_t *payload, uint8_t length, d7
     //TODO handle here the re-assembly if needed?
     DPRINT("[D7AP] received an unsolicited request");
 
-    slave_session.active = true;
-    slave_session.token = result.fifo_token;
-    slave_session.expected_response = result.response_expected;
+    NG(slave_session).active = true;
+    NG(slave_session).token = result.fifo_token;
+    NG(slave_session).expected_response = result.response_expected;
 
     // Forward this unsolicited request to all clients
-    for(uint8_t i = 0; i < registered_client_nb; i++)
+    for(uint8_t i = 0; i < NG(registered_client_nb); i++)
     {
-        if (registered_client[i].unsolicited_cb)
-            expect_upper_layer_resp_payload = registered_client[i].unsolicited_cb(payload, length, result);
+        if (NG(registered_client)[i].unsolicited_cb)
+            expect_upper_layer_resp_payload = NG(registered_client)[i].unsolicited_cb(payload, length, result);
     }
 
-    if ((slave_session.expected_response) && (expect_upper_layer_resp_payload))
+    if ((NG(slave_session).expected_response) && (expect_upper_layer_resp_payload))
         switch_state(D7AP_STACK_STATE_WAIT_APP_ANSWER);
     else
         switch_state(D7AP_STACK_STATE_RECEIVING);
@@ -326,8 +328,8 @@ void d7ap_stack_process_received_response(uint8_t *payload, uint8_t length, d7ap
 
     assert(i < session->request_nb);
 
-    if (registered_client[session->client_id].receive_cb)
-        registered_client[session->client_id].receive_cb(trans_id, payload, length, result);
+    if (NG(registered_client)[session->client_id].receive_cb)
+        NG(registered_client)[session->client_id].receive_cb(trans_id, payload, length, result);
 }
 
 void d7ap_stack_session_completed(uint8_t session_token, uint8_t* progress_bitmap, uint8_t* success_bitmap, uint8_t bitmap_byte_count)
@@ -339,7 +341,7 @@ void d7ap_stack_session_completed(uint8_t session_token, uint8_t* progress_bitma
 
     assert(session != NULL);
 
-    if (registered_client[session->client_id].transmitted_cb == NULL)
+    if (NG(registered_client)[session->client_id].transmitted_cb == NULL)
         goto free_session;
 
     for(uint8_t i = 0; i < session->request_nb; i++)
@@ -347,7 +349,7 @@ void d7ap_stack_session_completed(uint8_t session_token, uint8_t* progress_bitma
         request_id = (uint8_t)(session->trans_id[i] & 0xFF);
         error = bitmap_get(progress_bitmap, request_id) && bitmap_get(success_bitmap, request_id) ? SUCCESS : FAIL;
 
-        registered_client[session->client_id].transmitted_cb(session->trans_id[i], error);
+        NG(registered_client)[session->client_id].transmitted_cb(session->trans_id[i], error);
     }
 
     switch_state(D7AP_STACK_STATE_IDLE);
@@ -370,7 +372,7 @@ void d7ap_stack_signal_active_master_session(uint8_t session_token)
 void d7ap_stack_signal_slave_session_terminated(void)
 {
     DPRINT("[D7AP] slave session is terminated");
-    slave_session.active = false;
+    NG(slave_session).active = false;
     switch_state(D7AP_STACK_STATE_IDLE);
 }
 
@@ -378,14 +380,14 @@ void d7ap_stack_signal_transaction_terminated(void)
 {
     DPRINT("[D7AP] transaction is terminated");
 
-    if ( d7ap_stack_state ==  D7AP_STACK_STATE_WAIT_APP_ANSWER)
+    if ( NG(d7ap_stack_state) ==  D7AP_STACK_STATE_WAIT_APP_ANSWER)
         switch_state(D7AP_STACK_STATE_RECEIVING);
 }
 
 bool d7ap_stack_is_client_session_active(uint8_t client_id)
 {
     for(uint8_t i = 0; i < MODULE_D7AP_MAX_SESSION_COUNT; i++) {
-        if(sessions[i].client_id == client_id && sessions[i].active)
+        if(NG(sessions)[i].client_id == client_id && NG(sessions)[i].active)
             return true;
     }
 
@@ -39,6 +39,7 @@
 #include "d7atp.h"
 #include "packet_queue.h"
 #include "packet.h"
+#include "perf_counters.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_SP_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_SESSION, __VA_ARGS__)
@@ -90,8 +91,8 @@ static uint8_t NGDEF(_single_request_retry_limit);
 static packet_t* NGDEF(_current_response_packet);
 #define current_response_packet NG(_current_response_packet)
 
-static timer_event current_session_timer;
-static timer_event dormant_session_timer;
+static timer_event NGDEF(current_session_timer);
+static timer_event NGDEF(dormant_session_timer);
 
 typedef enum {
     D7ASP_STATE_STOPPED,
@@ -108,11 +109,11 @@ typedef struct {
   uint8_t id[8];
 } lowest_lb_responder_t;
 
-static lowest_lb_responder_t current_responder_lowest_lb;
+static lowest_lb_responder_t NGDEF(current_responder_lowest_lb);
 
 #define LB_MAX 140
 
-static state_t NGDEF(_state) = D7ASP_STATE_STOPPED;
+static state_t NGDEF(_state) = NGINIT(D7ASP_STATE_STOPPED);
 #define d7asp_state NG(_state)
 
 static void switch_state(state_t new_state);
@@ -168,8 +169,8 @@ static void schedule_current_session() {
     assert(current_master_session.state >= D7ASP_MASTER_SESSION_PENDING);
 
     DPRINT("Re-schedule immediately the current session");
-    current_session_timer.next_event = 0;
-    int rtc = timer_add_event(&current_session_timer);
+    NG(current_session_timer).next_event = 0;
+    int rtc = timer_add_event(&NG(current_session_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -199,7 +200,7 @@ static void flush_fifos()
         d7ap_stack_signal_active_master_session(current_master_session.token);
     }
 
-    current_responder_lowest_lb.lb = LB_MAX;
+    NG(current_responder_lowest_lb).lb = LB_MAX;
     DPRINT("Flushing FIFOs");
     hw_watchdog_feed(); // TODO do here?
 
@@ -233,7 +234,6 @@ static void flush_fifos()
             current_request_packet->d7anp_addressee = &current_master_session.preferred_addressee;
         }
 
-        memcpy(current_request_packet->payload, current_master_session.request_buffer + current_master_session.requests_indices[current_request_id], current_master_session.requests_lengths[current_request_id]);
         current_request_packet->payload_length = current_master_session.requests_lengths[current_request_id];
 
         if(is_triggered_dormant_session)
@@ -259,6 +259,7 @@ static void flush_fifos()
         {
             // mark request as failed and pop
             mark_current_request_done();
+            PERF_COUNTER_INC(d7asp_request_drops);
             DPRINT("Request reached single request retry limit (%i), skipping request", single_request_retry_limit);
             packet_queue_free_packet(current_request_packet);
             current_request_id = NO_ACTIVE_REQUEST_ID;
@@ -268,9 +269,14 @@ static void flush_fifos()
 
         packet_queue_mark_processing(current_request_packet);
         current_request_packet->type = RETRY_REQUEST;
+        PERF_COUNTER_INC(d7asp_request_retries);
         // TODO stop on error
     }
 
+    // the payload is written directly behind the headroom of the frame, it is copied again for a retry since the
+    // network layer secures it in place
+    memcpy(packet_get_tx_payload_buffer(current_request_packet), current_master_session.request_buffer + current_master_session.requests_indices[current_request_id], current_master_session.requests_lengths[current_request_id]);
+
     uint8_t listen_timeout = 0; // TODO calculate timeout (and update during transaction lifetime) (based on Tc, channel, cs, payload size, # msgs, # retries)
     ret = d7atp_send_request(current_master_session.token, current_request_id, (current_request_id == current_master_session.next_request_id - 1),
                        current_request_packet, &current_master_session.config.qos, listen_timeout, current_master_session.response_lengths[current_request_id]);
@@ -363,10 +369,10 @@ static void dormant_session_timeout() {
 
 static void schedule_dormant_session(d7asp_master_session_t* dormant_session) {
   assert(dormant_session->state == D7ASP_MASTER_SESSION_DORMANT);
-  timer_tick_t timeout = CT_DECOMPRESS(dormant_session->config.dormant_timeout);
+  timer_tick_t timeout = ct_decompress(dormant_session->config.dormant_timeout);
   DPRINT("Sched dormant timeout in %i s", timeout);
-  dormant_session_timer.next_event = timeout * 1024;
-  error_t rtc = timer_add_event(&dormant_session_timer);
+  NG(dormant_session_timer).next_event = timeout * 1024;
+  error_t rtc = timer_add_event(&NG(dormant_session_timer));
   assert(rtc == SUCCESS);
 }
 
@@ -378,20 +384,20 @@ void d7asp_init()
     current_request_id = NO_ACTIVE_REQUEST_ID;
 
     current_master_session.state = D7ASP_MASTER_SESSION_IDLE;
-    memcpy(current_responder_lowest_lb.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
+    memcpy(NG(current_responder_lowest_lb).id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
     memcpy(current_master_session.preferred_addressee.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
     DPRINT("REQUESTS_BITMAP_BYTE_COUNT %d", REQUESTS_BITMAP_BYTE_COUNT);
     DPRINT("FIFO_MAX_REQUESTS_COUNT %d", MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT);
 
-    timer_init_event(&dormant_session_timer, &dormant_session_timeout);
-    timer_init_event(&current_session_timer, &flush_fifos);
+    timer_init_event(&NG(dormant_session_timer), &dormant_session_timeout);
+    timer_init_event(&NG(current_session_timer), &flush_fifos);
 }
 
 void d7asp_stop()
 {
     d7asp_state = D7ASP_STATE_STOPPED;
-    timer_cancel_event(&current_session_timer);
-    timer_cancel_event(&dormant_session_timer);
+    timer_cancel_event(&NG(current_session_timer));
+    timer_cancel_event(&NG(dormant_session_timer));
 }
 
 uint8_t d7asp_master_session_create(d7ap_session_config_t* d7asp_master_session_config) {
@@ -464,7 +470,7 @@ error_t d7asp_send_response(uint8_t* payload, uint8_t length)
     }
 
     current_response_packet->payload_length = length;
-    memcpy(current_response_packet->payload, payload, length);
+    memcpy(packet_get_tx_payload_buffer(current_response_packet), payload, length);
 
     // check if there is a pending session
     if (current_master_session.state == D7ASP_MASTER_SESSION_ACTIVE)
@@ -573,12 +579,12 @@ void d7asp_process_received_response(packet_t* packet, bool extension)
         if(current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED
            && ID_TYPE_IS_BROADCAST(current_master_session.config.addressee.ctrl.id_type))
         {
-            if(result.link_budget < current_responder_lowest_lb.lb)
+            if(result.link_budget < NG(current_responder_lowest_lb).lb)
             {
-                memcpy(current_responder_lowest_lb.id, result.addressee.id, 8); // TODO assume UID for now
-                current_responder_lowest_lb.lb = result.link_budget;
-                DPRINT("current responder with lowest LB %i:", current_responder_lowest_lb.lb);
-                DPRINT_DATA(current_responder_lowest_lb.id, 8);
+                memcpy(NG(current_responder_lowest_lb).id, result.addressee.id, 8); // TODO assume UID for now
+                NG(current_responder_lowest_lb).lb = result.link_budget;
+                DPRINT("current responder with lowest LB %i:", NG(current_responder_lowest_lb).lb);
+                DPRINT_DATA(NG(current_responder_lowest_lb).id, 8);
             }
         }
         assert(packet != current_request_packet);
@@ -728,10 +734,10 @@ static void on_request_completed()
     DPRINT("request completed");
 
     if(current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED) {
-      memcpy(current_master_session.preferred_addressee.id, current_responder_lowest_lb.id, 8); // TODO assume UID for now
+      memcpy(current_master_session.preferred_addressee.id, NG(current_responder_lowest_lb).id, 8); // TODO assume UID for now
       current_master_session.preferred_addressee.ctrl.id_type = ID_TYPE_UID;
 
-      DPRINT("preferred addressee with LB %i is now:", current_responder_lowest_lb.lb);
+      DPRINT("preferred addressee with LB %i is now:", NG(current_responder_lowest_lb).lb);
       DPRINT_DATA(current_master_session.preferred_addressee.id, 8);
     }
 
@@ -741,7 +747,7 @@ static void on_request_completed()
           && memcmp(current_master_session.preferred_addressee.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8) != 0)
         {
             DPRINT("No ack from preferred addressee, switching to bcast");
-            current_responder_lowest_lb.lb = LB_MAX;
+            NG(current_responder_lowest_lb).lb = LB_MAX;
             memcpy(current_master_session.preferred_addressee.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
         }
         current_request_retry_count++;
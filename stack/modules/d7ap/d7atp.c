@@ -37,6 +37,7 @@
 #include "compress.h"
 #include "phy.h"
 #include "errors.h"
+#include "perf_counters.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_TP_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_TRANS, __VA_ARGS__)
@@ -70,8 +71,8 @@ static dae_access_profile_t NGDEF(_active_addressee_access_profile);
 static bool NGDEF(_stop_dialog_after_tx);
 #define stop_dialog_after_tx NG(_stop_dialog_after_tx)
 
-static timer_event d7atp_response_period_expired_timer;
-static timer_event d7atp_execution_delay_expired_timer;
+static timer_event NGDEF(d7atp_response_period_expired_timer);
+static timer_event NGDEF(d7atp_execution_delay_expired_timer);
 
 typedef enum {
     D7ATP_STATE_STOPPED,
@@ -83,7 +84,7 @@ typedef enum {
     D7ATP_STATE_SLAVE_TRANSACTION_RESPONSE_PERIOD,
 } state_t;
 
-static state_t NGDEF(_d7atp_state) = D7ATP_STATE_STOPPED;
+static state_t NGDEF(_d7atp_state) = NGINIT(D7ATP_STATE_STOPPED);
 #define d7atp_state NG(_d7atp_state)
 
 #define IS_IN_MASTER_TRANSACTION() (d7atp_state == D7ATP_STATE_MASTER_TRANSACTION_REQUEST_PERIOD || \
@@ -148,7 +149,7 @@ static void terminate_dialog()
     stop_dialog_after_tx = false;
 
     // Discard eventually the Tc timer
-    timer_cancel_event(&d7atp_response_period_expired_timer);
+    timer_cancel_event(&NG(d7atp_response_period_expired_timer));
 
     d7asp_signal_dialog_terminated();
     dll_notify_dialog_terminated();
@@ -158,6 +159,7 @@ static void response_period_timeout_handler()
 {
 //    DEBUG_PIN_CLR(2);
     DPRINT("Expiration of the response period");
+    PERF_COUNTER_INC(d7atp_response_period_timeouts);
 
     assert(d7atp_state == D7ATP_STATE_SLAVE_TRANSACTION_RESPONSE_PERIOD
            || d7atp_state == D7ATP_STATE_SLAVE_TRANSACTION_RECEIVED_REQUEST
@@ -200,8 +202,8 @@ static void schedule_response_period_timeout_handler(timer_tick_t timeout_ticks)
 
     DPRINT("Starting response_period timer (%i ticks)", timeout_ticks);
 
-    d7atp_response_period_expired_timer.next_event = timeout_ticks;
-    error_t rtc = timer_add_event(&d7atp_response_period_expired_timer);
+    NG(d7atp_response_period_expired_timer).next_event = timeout_ticks;
+    error_t rtc = timer_add_event(&NG(d7atp_response_period_expired_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -240,7 +242,7 @@ void d7atp_signal_dialog_termination()
     current_transaction_id = NO_ACTIVE_REQUEST_ID;
 
     // Discard eventually the Tc timer
-    timer_cancel_event(&d7atp_response_period_expired_timer);
+    timer_cancel_event(&NG(d7atp_response_period_expired_timer));
 
     if(current_Tl_received == 0) {
       DPRINT("Tl = 0, stop FG scan");
@@ -274,8 +276,8 @@ void d7atp_init()
     current_dialog_id = 0;
     current_Tl_received = 0;
     stop_dialog_after_tx = false;
-    timer_init_event(&d7atp_response_period_expired_timer, &response_period_timeout_handler);
-    timer_init_event(&d7atp_execution_delay_expired_timer, &execution_delay_timeout_handler);
+    timer_init_event(&NG(d7atp_response_period_expired_timer), &response_period_timeout_handler);
+    timer_init_event(&NG(d7atp_execution_delay_expired_timer), &execution_delay_timeout_handler);
 }
 
 void d7atp_notify_access_profile_file_changed(uint8_t file_id)
@@ -287,8 +289,8 @@ void d7atp_notify_access_profile_file_changed(uint8_t file_id)
 void d7atp_stop()
 {
     d7atp_state = D7ATP_STATE_STOPPED;
-    timer_cancel_event(&d7atp_response_period_expired_timer);
-    timer_cancel_event(&d7atp_execution_delay_expired_timer);
+    timer_cancel_event(&NG(d7atp_response_period_expired_timer));
+    timer_cancel_event(&NG(d7atp_execution_delay_expired_timer));
 }
 
 error_t d7atp_send_request(uint8_t dialog_id, uint8_t transaction_id, bool is_last_transaction,
@@ -361,7 +363,7 @@ error_t d7atp_send_request(uint8_t dialog_id, uint8_t transaction_id, bool is_la
         if (packet->d7anp_addressee->ctrl.id_type == ID_TYPE_NOID)
             nb = 32;
         else if (packet->d7anp_addressee->ctrl.id_type == ID_TYPE_NBID)
-            nb = CT_DECOMPRESS(packet->d7anp_addressee->id[0]);
+            nb = ct_decompress(packet->d7anp_addressee->id[0]);
 
         // Tc(NB, LEN, CH) = ceil((SFC  * NB  + 1) * TTX(CH, LEN) + TG) with NB the number of concurrent devices and SF the collision Avoidance Spreading Factor
         uint16_t resp_tc = (SFc * nb + 1) * tx_duration_response + t_g;
@@ -502,24 +504,24 @@ void d7atp_signal_packet_transmitted(packet_t* packet)
 
         if (packet->d7atp_ctrl.ctrl_is_ack_requested)
         {
-            timer_tick_t Tc = CT_DECOMPRESS(packet->d7atp_tc);
+            timer_tick_t Tc = ct_decompress(packet->d7atp_tc);
 
             // Check if an Execution Delay period needs to be observed
             if (packet->d7atp_ctrl.ctrl_te)
             {
-                timer_tick_t Te = adjust_timeout_value(CT_DECOMPRESS(packet->d7atp_te), packet->hw_radio_packet.tx_meta.timestamp);
+                timer_tick_t Te = adjust_timeout_value(ct_decompress(packet->d7atp_te), packet->hw_radio_packet.tx_meta.timestamp);
                 if (Te)
                 {
                     d7anp_set_foreground_scan_timeout(Tc + 2); // we include Tt here for now
 
-                    d7atp_execution_delay_expired_timer.next_event = Te;
-                    timer_add_event(&d7atp_execution_delay_expired_timer);
+                    NG(d7atp_execution_delay_expired_timer).next_event = Te;
+                    timer_add_event(&NG(d7atp_execution_delay_expired_timer));
                     return;
                 }
                 // if the the time passed since transmission is greater than Te, Tc is updated to include Te
                 // and the foreground scan is started immediately
                 else
-                    Tc += CT_DECOMPRESS(packet->d7atp_te);
+                    Tc += ct_decompress(packet->d7atp_te);
             }
 
             Tc = adjust_timeout_value( Tc, packet->hw_radio_packet.tx_meta.timestamp);
@@ -584,7 +586,7 @@ void d7atp_process_received_packet(packet_t* packet)
     DPRINT("Recvd dialog %i trans id %i, curr %i - %i", packet->d7atp_dialog_id, packet->d7atp_transaction_id, current_dialog_id, current_transaction_id);
 
     if (packet->d7atp_tl)
-        current_Tl_received = CT_DECOMPRESS(packet->d7atp_tl);
+        current_Tl_received = ct_decompress(packet->d7atp_tl);
     else
         current_Tl_received = 0;
     DPRINT("Tl=%i (CT) -> %i (Ti) ", packet->d7atp_tl, current_Tl_received);
@@ -648,13 +650,13 @@ void d7atp_process_received_packet(packet_t* packet)
          // The FG scan is only started when the response period expires.
         if (packet->d7atp_ctrl.ctrl_is_ack_requested)
         {
-            Tc = CT_DECOMPRESS(packet->d7atp_tc);
+            Tc = ct_decompress(packet->d7atp_tc);
 
             DPRINT("Tc=%i (CT) -> %i (Ti) ", packet->d7atp_tc, Tc);
 
             // extend Tc with Te
             if (packet->d7atp_ctrl.ctrl_te)
-                Tc += CT_DECOMPRESS(packet->d7atp_te);
+                Tc += ct_decompress(packet->d7atp_te);
 
             // We choose to start the FG scan after the execution delay and the response period so Tl = Tl - Tc - Te
             if (current_Tl_received > Tc)
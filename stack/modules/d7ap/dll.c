@@ -36,6 +36,7 @@
 
 #include "hwdebug.h"
 #include "hwatomic.h"
+#include "perf_counters.h"
 
 #include "MODULE_D7AP_defs.h"
 
@@ -71,11 +72,16 @@ static dae_access_profile_t NGDEF(_current_access_profile);
 static dae_access_profile_t NGDEF(_remote_access_profile);
 #define remote_access_profile NG(_remote_access_profile)
 
+// the access specifier of the cached remote_access_profile
+#define NO_REMOTE_ACCESS_SPECIFIER 0xFF
+static uint8_t NGDEF(_remote_access_specifier);
+#define remote_access_specifier NG(_remote_access_specifier)
+
 #define NO_ACTIVE_ACCESS_CLASS 0xFF
 static uint8_t NGDEF(_active_access_class);
 #define active_access_class NG(_active_access_class)
 
-static dll_state_t NGDEF(_dll_state) = DLL_STATE_STOPPED;
+static dll_state_t NGDEF(_dll_state) = NGINIT(DLL_STATE_STOPPED);
 #define dll_state NG(_dll_state)
 
 static packet_t* NGDEF(_current_packet);
@@ -124,10 +130,10 @@ static uint16_t NGDEF(_tsched);
 static bool NGDEF(_guarded_channel);
 #define guarded_channel NG(_guarded_channel)
 
-static uint8_t noisefl_last_measurements[PHY_STATUS_MAX_CHANNELS][NOISEFL_NUMBER_MEASUREMENTS]; //3 measurement per channel
-static channel_status_t channels[PHY_STATUS_MAX_CHANNELS];
-static uint8_t phy_status_channel_counter = 0;
-static bool reset_noisefl_last_measurements = false;
+static uint8_t NGDEF(noisefl_last_measurements)[PHY_STATUS_MAX_CHANNELS][NOISEFL_NUMBER_MEASUREMENTS]; //3 measurement per channel
+static channel_status_t NGDEF(channels)[PHY_STATUS_MAX_CHANNELS];
+static uint8_t NGDEF(phy_status_channel_counter);
+static bool NGDEF(reset_noisefl_last_measurements);
 
 static void execute_cca(void *arg);
 static void execute_csma_ca(void *arg);
@@ -138,32 +144,32 @@ static uint8_t get_position_channel();
 /*!
  * D7A timer used to perform a CCA
  */
-static timer_event dll_cca_timer;
+static timer_event NGDEF(dll_cca_timer);
 
 /*!
  * D7A timer used to perform a CSMA-CA
  */
-static timer_event dll_csma_timer;
+static timer_event NGDEF(dll_csma_timer);
 
 /*!
  * D7A timer used to start the automation scan (foreground)
  */
-static timer_event dll_scan_automation_timer;
+static timer_event NGDEF(dll_scan_automation_timer);
 
 /*!
  * D7A timer used to start a background scan
  */
-static timer_event dll_background_scan_timer;
+static timer_event NGDEF(dll_background_scan_timer);
 
 /*!
  * D7A timer used to expire the guard period
  */
-static timer_event dll_guard_period_expiration_timer;
+static timer_event NGDEF(dll_guard_period_expiration_timer);
 
 /*!
  * D7A timer used to delay the processing of a received packet
  */
-static timer_event dll_process_received_packet_timer;
+static timer_event NGDEF(dll_process_received_packet_timer);
 
 static void switch_state(dll_state_t next_state)
 {
@@ -183,16 +189,19 @@ static void switch_state(dll_state_t next_state)
     case DLL_STATE_CSMA_CA_RETRY:
         assert(dll_state == DLL_STATE_CCA1 || dll_state == DLL_STATE_CCA2);
         dll_state = next_state;
+        PERF_COUNTER_INC(dll_csma_ca_retries);
         DPRINT("Switched to DLL_STATE_CSMA_CA_RETRY");
         break;
     case DLL_STATE_CCA1:
         assert(dll_state == DLL_STATE_CSMA_CA_STARTED || dll_state == DLL_STATE_CSMA_CA_RETRY);
         dll_state = next_state;
+        PERF_COUNTER_INC(dll_cca_attempts);
         DPRINT("Switched to DLL_STATE_CCA1");
         break;
     case DLL_STATE_CCA2:
         assert(dll_state == DLL_STATE_CCA1);
         dll_state = next_state;
+        PERF_COUNTER_INC(dll_cca_attempts);
         DPRINT("Switched to DLL_STATE_CCA2");
         break;
     case DLL_STATE_FOREGROUND_SCAN:
@@ -242,6 +251,7 @@ static void switch_state(dll_state_t next_state)
         assert(dll_state == DLL_STATE_CCA1 || dll_state == DLL_STATE_CCA2
                 || dll_state == DLL_STATE_CSMA_CA_STARTED || dll_state == DLL_STATE_CSMA_CA_RETRY);
         dll_state = next_state;
+        PERF_COUNTER_INC(dll_cca_failures);
         DPRINT("Switched to DLL_STATE_CCA_FAIL");
         break;
     default:
@@ -290,8 +300,8 @@ void start_guard_period(timer_tick_t period)
 {
     DPRINT("guard channel");
     guarded_channel = true;
-    dll_guard_period_expiration_timer.next_event = period;
-    timer_add_event(&dll_guard_period_expiration_timer);
+    NG(dll_guard_period_expiration_timer).next_event = period;
+    timer_add_event(&NG(dll_guard_period_expiration_timer));
 }
 
 void median_measured_noisefloor(uint8_t position) {
@@ -299,13 +309,13 @@ void median_measured_noisefloor(uint8_t position) {
         E_CCA = - current_access_profile.subbands[0].cca;
         return;
     }
-    if(reset_noisefl_last_measurements) {
-        memset(noisefl_last_measurements[position], 0, 3);
-        reset_noisefl_last_measurements = false;
+    if(NG(reset_noisefl_last_measurements)) {
+        memset(NG(noisefl_last_measurements)[position], 0, 3);
+        NG(reset_noisefl_last_measurements) = false;
         DPRINT("reset CCA");
     }
-    if(noisefl_last_measurements[position][0] && noisefl_last_measurements[position][1] && noisefl_last_measurements[position][2]) { //If not default 0 values
-        uint8_t median = noisefl_last_measurements[position][0]>noisefl_last_measurements[position][1]?  ( noisefl_last_measurements[position][2]>noisefl_last_measurements[position][0]? noisefl_last_measurements[position][0] : (noisefl_last_measurements[position][1]>noisefl_last_measurements[position][2]? noisefl_last_measurements[position][1]:noisefl_last_measurements[position][2]) )  :  ( noisefl_last_measurements[position][2]>noisefl_last_measurements[position][1]? noisefl_last_measurements[position][1] : (noisefl_last_measurements[position][0]>noisefl_last_measurements[position][2]? noisefl_last_measurements[position][0]:noisefl_last_measurements[position][2]) );
+    if(NG(noisefl_last_measurements)[position][0] && NG(noisefl_last_measurements)[position][1] && NG(noisefl_last_measurements)[position][2]) { //If not default 0 values
+        uint8_t median = NG(noisefl_last_measurements)[position][0]>NG(noisefl_last_measurements)[position][1]?  ( NG(noisefl_last_measurements)[position][2]>NG(noisefl_last_measurements)[position][0]? NG(noisefl_last_measurements)[position][0] : (NG(noisefl_last_measurements)[position][1]>NG(noisefl_last_measurements)[position][2]? NG(noisefl_last_measurements)[position][1]:NG(noisefl_last_measurements)[position][2]) )  :  ( NG(noisefl_last_measurements)[position][2]>NG(noisefl_last_measurements)[position][1]? NG(noisefl_last_measurements)[position][1] : (NG(noisefl_last_measurements)[position][0]>NG(noisefl_last_measurements)[position][2]? NG(noisefl_last_measurements)[position][0]:NG(noisefl_last_measurements)[position][2]) );
         E_CCA = - median + 6; //Min of last 3 with 6dB offset
     } else
         E_CCA = - current_access_profile.subbands[0].cca;
@@ -316,8 +326,8 @@ void start_background_scan()
     assert(dll_state == DLL_STATE_SCAN_AUTOMATION);
 
     // Start a new tsched timer
-    dll_background_scan_timer.next_event = tsched;
-    timer_add_event(&dll_background_scan_timer);
+    NG(dll_background_scan_timer).next_event = tsched;
+    timer_add_event(&NG(dll_background_scan_timer));
 
     phy_rx_config_t config = {
         .channel_id = current_channel_id,
@@ -329,8 +339,8 @@ void start_background_scan()
         //if current_channel in array of channels AND gotten rssi_thr smaller than pre-programmed Ecca
         if(position != UINT8_MAX && (config.rssi_thr <= - current_access_profile.subbands[0].cca)) {
             //rotate measurements and add new at the end
-            memcpy(noisefl_last_measurements[position], &noisefl_last_measurements[position][1], 2);
-            noisefl_last_measurements[position][2] = - config.rssi_thr;
+            memcpy(NG(noisefl_last_measurements)[position], &NG(noisefl_last_measurements)[position][1], 2);
+            NG(noisefl_last_measurements)[position][2] = - config.rssi_thr;
         }
 
         median_measured_noisefloor(position);
@@ -342,7 +352,7 @@ void dll_stop_background_scan()
 {
     assert(dll_state == DLL_STATE_SCAN_AUTOMATION);
 
-    timer_cancel_event(&dll_background_scan_timer);
+    timer_cancel_event(&NG(dll_background_scan_timer));
     hw_radio_set_idle();
 }
 
@@ -374,7 +384,7 @@ void dll_signal_packet_received(packet_t* packet)
         // will be invoked again by packet_transmitted() or an CSMA failed.
         DPRINT("Postpone the processing of the received packet after Tx is completed");
         process_received_packets_after_tx = true;
-        dll_process_received_packet_timer.arg = packet;
+        NG(dll_process_received_packet_timer).arg = packet;
         return;
     }
 
@@ -408,8 +418,8 @@ void dll_signal_packet_transmitted(packet_t* packet)
 
     if (process_received_packets_after_tx)
     {
-        dll_process_received_packet_timer.next_event = 0;
-        error_t rtc = timer_add_event(&dll_process_received_packet_timer);
+        NG(dll_process_received_packet_timer).next_event = 0;
+        error_t rtc = timer_add_event(&NG(dll_process_received_packet_timer));
         assert(rtc == SUCCESS);
         process_received_packets_after_tx = false;
     }
@@ -434,15 +444,15 @@ static void discard_tx()
 
     if ((dll_state == DLL_STATE_CCA1) || (dll_state == DLL_STATE_CCA2))
     {
-        timer_cancel_event(&dll_cca_timer);
+        timer_cancel_event(&NG(dll_cca_timer));
     }
     else if ((dll_state == DLL_STATE_CCA_FAIL) || (dll_state == DLL_STATE_CSMA_CA_RETRY))
     {
-        timer_cancel_event(&dll_csma_timer);
+        timer_cancel_event(&NG(dll_csma_timer));
     }
     else if (dll_state == DLL_STATE_TX_FOREGROUND_COMPLETED)
     {
-        timer_cancel_event(&dll_guard_period_expiration_timer);
+        timer_cancel_event(&NG(dll_guard_period_expiration_timer));
         guarded_channel = false;
     }
 
@@ -462,8 +472,8 @@ static void cca_rssi_valid(int16_t cur_rssi)
         if((tx_nf_method == D7ADLL_MEDIAN_OF_THREE || rx_nf_method == D7ADLL_MEDIAN_OF_THREE))
         {
             uint8_t position = get_position_channel();
-            memcpy(noisefl_last_measurements[position], &noisefl_last_measurements[position][1], 2);
-            noisefl_last_measurements[position][2] = - cur_rssi;
+            memcpy(NG(noisefl_last_measurements)[position], &NG(noisefl_last_measurements)[position][1], 2);
+            NG(noisefl_last_measurements)[position][2] = - cur_rssi;
             median_measured_noisefloor(position);
         }
         if (dll_state == DLL_STATE_CCA1)
@@ -556,9 +566,9 @@ static void execute_csma_ca(void *arg)
 
             // in case of response, use the Tc parameter provided in the request
             if (current_packet->type == RESPONSE_TO_UNICAST || current_packet->type == RESPONSE_TO_BROADCAST)
-                dll_tc = CT_DECOMPRESS(current_packet->d7atp_tc);
+                dll_tc = ct_decompress(current_packet->d7atp_tc);
             else
-                dll_tc = ceil((SFc + 1) * current_packet->tx_duration + t_g);
+                dll_tc = (SFc + 1) * current_packet->tx_duration + t_g;
 
             /*
              * Tca = Tc - Ttx - Tg
@@ -631,15 +641,15 @@ static void execute_csma_ca(void *arg)
             if (t_offset)
             {
                 switch_state(DLL_STATE_CCA1);
-                dll_cca_timer.next_event = t_offset;
-                error_t rtc = timer_add_event(&dll_cca_timer);
+                NG(dll_cca_timer).next_event = t_offset;
+                error_t rtc = timer_add_event(&NG(dll_cca_timer));
                 assert(rtc == SUCCESS);
             }
             else
             {
                 switch_state(DLL_STATE_CCA1);
-                dll_cca_timer.next_event = 0;
-                error_t rtc = timer_add_event(&dll_cca_timer);
+                NG(dll_cca_timer).next_event = 0;
+                error_t rtc = timer_add_event(&NG(dll_cca_timer));
                 assert(rtc == SUCCESS);
             }
 
@@ -654,8 +664,8 @@ static void execute_csma_ca(void *arg)
             {
                 DPRINT("CCA fail because dll_to = %i", dll_to);
                 switch_state(DLL_STATE_CCA_FAIL);
-                dll_csma_timer.next_event = 0;
-                error_t rtc = timer_add_event(&dll_csma_timer);
+                NG(dll_csma_timer).next_event = 0;
+                error_t rtc = timer_add_event(&NG(dll_csma_timer));
                 assert(rtc == SUCCESS);
                 break;
             }
@@ -698,15 +708,15 @@ static void execute_csma_ca(void *arg)
 
             if (t_offset)
             {
-                dll_cca_timer.next_event = t_offset;
+                NG(dll_cca_timer).next_event = t_offset;
             }
             else
             {
-                dll_cca_timer.next_event = 0;
+                NG(dll_cca_timer).next_event = 0;
             }
 
             switch_state(DLL_STATE_CCA1);
-            error_t rtc = timer_add_event(&dll_cca_timer);
+            error_t rtc = timer_add_event(&NG(dll_cca_timer));
             assert(rtc == SUCCESS);
             break;
         }
@@ -717,8 +727,8 @@ static void execute_csma_ca(void *arg)
             d7anp_signal_transmission_failure();
             if (process_received_packets_after_tx)
             {
-                dll_process_received_packet_timer.next_event = 0;
-                error_t rtc = timer_add_event(&dll_process_received_packet_timer);
+                NG(dll_process_received_packet_timer).next_event = 0;
+                error_t rtc = timer_add_event(&NG(dll_process_received_packet_timer));
                 assert(rtc == SUCCESS);
                 process_received_packets_after_tx = false;
             }
@@ -729,7 +739,7 @@ static void execute_csma_ca(void *arg)
                 resume_fg_scan = false;
             }
 
-            reset_noisefl_last_measurements = true;
+            NG(reset_noisefl_last_measurements) = true;
             break;
         }
     }
@@ -746,8 +756,8 @@ static uint8_t get_position_channel() {
         .noise_floor = - E_CCA
     };
     for(position = 0; position < PHY_STATUS_MAX_CHANNELS; position++) {
-        if(((channels[position].raw_channel_status_identifier == 0) && (channels[position].channel_index_lsb == 0)) || 
-           ((channels[position].raw_channel_status_identifier == local_channel.raw_channel_status_identifier) && (channels[position].channel_index_lsb == local_channel.channel_index_lsb)))
+        if(((NG(channels)[position].raw_channel_status_identifier == 0) && (NG(channels)[position].channel_index_lsb == 0)) || 
+           ((NG(channels)[position].raw_channel_status_identifier == local_channel.raw_channel_status_identifier) && (NG(channels)[position].channel_index_lsb == local_channel.channel_index_lsb)))
             return position;
     }
     DPRINT("position of channel out of bound. Increase channels size or delete previous");
@@ -757,20 +767,20 @@ static uint8_t get_position_channel() {
 static void save_noise_floor(uint8_t position) {
     if(position == UINT8_MAX)
         return;
-    if((channels[position].raw_channel_status_identifier == 0) && (channels[position].channel_index_lsb == 0)) { // new channel
-        channels[position] = (channel_status_t) {
+    if((NG(channels)[position].raw_channel_status_identifier == 0) && (NG(channels)[position].channel_index_lsb == 0)) { // new channel
+        NG(channels)[position] = (channel_status_t) {
             .ch_freq_band = current_channel_id.channel_header.ch_freq_band,
             .bandwidth_25kHz = (current_channel_id.channel_header.ch_class == PHY_CLASS_LO_RATE),
             .channel_index_lsb = (current_channel_id.center_freq_index & 0xFF),
             .channel_index_msb = (uint8_t)((current_channel_id.center_freq_index >> 8) & 0x07),
             .noise_floor = - E_CCA
         };
-        phy_status_channel_counter++;
+        NG(phy_status_channel_counter)++;
     } else
-        channels[position].noise_floor = - E_CCA;
+        NG(channels)[position].noise_floor = - E_CCA;
 
-    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &phy_status_channel_counter, sizeof(uint8_t));
-    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) channels, phy_status_channel_counter * sizeof(channel_status_t));
+    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &NG(phy_status_channel_counter), sizeof(uint8_t));
+    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) NG(channels), NG(phy_status_channel_counter) * sizeof(channel_status_t));
 }
 
 void dll_execute_scan_automation()
@@ -780,7 +790,7 @@ void dll_execute_scan_automation()
 
     // first make sure the background scan timer is stopped and the pending task canceled
     // since they might not be necessary for current active class anymore
-    timer_cancel_event(&dll_background_scan_timer);
+    timer_cancel_event(&NG(dll_background_scan_timer));
 
     DPRINT("DLL execute scan autom AC=0x%02x", active_access_class);
 
@@ -815,7 +825,7 @@ void dll_execute_scan_automation()
         // Only consider the selectable subprofiles (having their Access Mask bits set to 1 and having non-void subband bitmaps)
         if ((ACCESS_MASK(active_access_class) & (0x01 << i)) && current_access_profile.subprofiles[i].subband_bitmap)
         {
-            scan_period = CT_DECOMPRESS(current_access_profile.subprofiles[i].scan_automation_period);
+            scan_period = ct_decompress(current_access_profile.subprofiles[i].scan_automation_period);
             if ((tsched == (uint16_t)~0) || (scan_period < tsched))
                 tsched = scan_period;
         }
@@ -860,8 +870,8 @@ void dll_execute_scan_automation()
 
         // If TSCHED > 0, an independent scheduler is set to generate regular scan start events at TSCHED rate.
         DPRINT("Perform a dll background scan at the end of TSCHED (%d ticks)", tsched);
-        dll_background_scan_timer.next_event = tsched;
-        error_t rtc = timer_add_event(&dll_background_scan_timer);
+        NG(dll_background_scan_timer).next_event = tsched;
+        error_t rtc = timer_add_event(&NG(dll_background_scan_timer));
         assert(rtc == SUCCESS);
     }
 
@@ -891,8 +901,8 @@ static void conf_file_changed_callback(uint8_t file_id)
         if (dll_state == DLL_STATE_IDLE || dll_state == DLL_STATE_SCAN_AUTOMATION)
         {
             DPRINT("Re-start the scan automation to apply this change");
-            dll_scan_automation_timer.next_event = 0;
-            int rtc = timer_add_event(&dll_scan_automation_timer);
+            NG(dll_scan_automation_timer).next_event = 0;
+            int rtc = timer_add_event(&NG(dll_scan_automation_timer));
             assert(rtc == SUCCESS);
         }
     }
@@ -902,6 +912,9 @@ void dll_notify_access_profile_file_changed(uint8_t file_id)
 {
     DPRINT("Access Profile changed");
 
+    if (file_id == D7A_FILE_ACCESS_PROFILE_ID + remote_access_specifier)
+        remote_access_specifier = NO_REMOTE_ACCESS_SPECIFIER;
+
     // update only the current access profile if this access profile has been changed
     if (file_id == D7A_FILE_ACCESS_PROFILE_ID + ACCESS_SPECIFIER(active_access_class))
     {
@@ -911,8 +924,8 @@ void dll_notify_access_profile_file_changed(uint8_t file_id)
         if (dll_state == DLL_STATE_IDLE || dll_state == DLL_STATE_SCAN_AUTOMATION)
         {
             DPRINT("Re-start the scan automation to apply this change");
-            dll_scan_automation_timer.next_event = 0;
-            int rtc = timer_add_event(&dll_scan_automation_timer);
+            NG(dll_scan_automation_timer).next_event = 0;
+            int rtc = timer_add_event(&NG(dll_scan_automation_timer));
             assert(rtc == SUCCESS);
         }
     }
@@ -931,12 +944,12 @@ void dll_init()
     uint8_t nf_ctrl;
 
     // Initialize timers
-    timer_init_event(&dll_cca_timer, &execute_cca);
-    timer_init_event(&dll_csma_timer, &execute_csma_ca);
-    timer_init_event(&dll_scan_automation_timer, &execute_scan_automation);
-    timer_init_event(&dll_background_scan_timer, &start_background_scan);
-    timer_init_event(&dll_guard_period_expiration_timer, &guard_period_expiration);
-    timer_init_event(&dll_process_received_packet_timer, &packet_received);
+    timer_init_event(&NG(dll_cca_timer), &execute_cca);
+    timer_init_event(&NG(dll_csma_timer), &execute_csma_ca);
+    timer_init_event(&NG(dll_scan_automation_timer), &execute_scan_automation);
+    timer_init_event(&NG(dll_background_scan_timer), &start_background_scan);
+    timer_init_event(&NG(dll_guard_period_expiration_timer), &guard_period_expiration);
+    timer_init_event(&NG(dll_process_received_packet_timer), &packet_received);
 
     phy_init();
 
@@ -951,6 +964,7 @@ void dll_init()
     // caching of the active class and the selected access profile
     active_access_class = d7ap_fs_read_dll_conf_active_access_class();
     d7ap_fs_read_access_class(ACCESS_SPECIFIER(active_access_class), &current_access_profile);
+    remote_access_specifier = NO_REMOTE_ACCESS_SPECIFIER;
 
     process_received_packets_after_tx = false;
     resume_fg_scan = false;
@@ -961,9 +975,9 @@ void dll_init()
     engineering_mode_init();
 #endif
 
-    d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &phy_status_channel_counter, 1);
-    if(phy_status_channel_counter && (phy_status_channel_counter < PHY_STATUS_MAX_CHANNELS))
-        d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) channels, phy_status_channel_counter*3);
+    d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &NG(phy_status_channel_counter), 1);
+    if(NG(phy_status_channel_counter) && (NG(phy_status_channel_counter) < PHY_STATUS_MAX_CHANNELS))
+        d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) NG(channels), NG(phy_status_channel_counter)*3);
 
     // Start immediately the scan automation
     guarded_channel = false;
@@ -973,21 +987,21 @@ void dll_init()
 void dll_stop()
 {
     dll_state = DLL_STATE_STOPPED;
-    timer_cancel_event(&dll_cca_timer);
-    timer_cancel_event(&dll_csma_timer);
-    timer_cancel_event(&dll_scan_automation_timer);
-    timer_cancel_event(&dll_background_scan_timer);
-    timer_cancel_event(&dll_guard_period_expiration_timer);
-    timer_cancel_event(&dll_process_received_packet_timer);
+    timer_cancel_event(&NG(dll_cca_timer));
+    timer_cancel_event(&NG(dll_csma_timer));
+    timer_cancel_event(&NG(dll_scan_automation_timer));
+    timer_cancel_event(&NG(dll_background_scan_timer));
+    timer_cancel_event(&NG(dll_guard_period_expiration_timer));
+    timer_cancel_event(&NG(dll_process_received_packet_timer));
 }
 
 void dll_tx_frame(packet_t* packet)
 {
-    timer_cancel_event(&dll_scan_automation_timer); //enable this code if this costly operation proves to be necessary
+    timer_cancel_event(&NG(dll_scan_automation_timer)); //enable this code if this costly operation proves to be necessary
 
     if (dll_state == DLL_STATE_SCAN_AUTOMATION)
     {
-        timer_cancel_event(&dll_background_scan_timer);
+        timer_cancel_event(&NG(dll_background_scan_timer));
     }
 
     if (dll_state != DLL_STATE_FOREGROUND_SCAN)
@@ -1036,7 +1050,12 @@ void dll_tx_frame(packet_t* packet)
     }
     else
     {
-        d7ap_fs_read_access_class(packet->d7anp_addressee->access_specifier, &remote_access_profile);
+        if (packet->d7anp_addressee->access_specifier != remote_access_specifier)
+        {
+            d7ap_fs_read_access_class(packet->d7anp_addressee->access_specifier, &remote_access_profile);
+            remote_access_specifier = packet->d7anp_addressee->access_specifier;
+        }
+
         /*
          * For now the access mask and the subband bitmap are not used
          * By default, subprofile[0] is selected and subband[0] is used
@@ -1066,7 +1085,7 @@ void dll_tx_frame(packet_t* packet)
             // Only consider the selectable subprofiles (having their Access Mask bits set to 1 and having non-void subband bitmaps)
             if ((packet->d7anp_addressee->access_mask & (0x01 << i)) && remote_access_profile.subprofiles[i].subband_bitmap)
             {
-                scan_period = CT_DECOMPRESS(remote_access_profile.subprofiles[i].scan_automation_period);
+                scan_period = ct_decompress(remote_access_profile.subprofiles[i].scan_automation_period);
                 if (scan_period > tsched)
                     tsched = scan_period;
             }
@@ -1120,7 +1139,7 @@ void dll_tx_frame(packet_t* packet)
         // If the Requester provides an Execution Delay Timeout, the Responders delay their responses
         if (packet->d7atp_ctrl.ctrl_te)
         {
-            timer_tick_t Te = CT_DECOMPRESS(packet->d7atp_te);
+            timer_tick_t Te = ct_decompress(packet->d7atp_te);
             timer_tick_t Trpd = timer_get_counter_value() - current_packet->request_received_timestamp; //response processing delay
 
             // the DLL foreground scan duration TC is adjusted to start after the Execution Delay period
@@ -1129,8 +1148,8 @@ void dll_tx_frame(packet_t* packet)
             if (Te > Trpd)
             {
                 Te -= Trpd;
-                dll_csma_timer.next_event = Te;
-                timer_add_event(&dll_csma_timer);
+                NG(dll_csma_timer).next_event = Te;
+                timer_add_event(&NG(dll_csma_timer));
                 return;
             }
             // If the response processing delay TRPD is bigger than TE,
@@ -1147,7 +1166,7 @@ static void start_foreground_scan()
 
     if (dll_state == DLL_STATE_SCAN_AUTOMATION)
     {
-        timer_cancel_event(&dll_background_scan_timer);
+        timer_cancel_event(&NG(dll_background_scan_timer));
         hw_radio_set_idle();
     }
 
@@ -26,6 +26,9 @@
 #include "MODULE_D7AP_defs.h"
 
 #include "debug.h"
+#include "perf_counters.h"
+#include <stddef.h>
+#include <string.h>
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_FWK_LOG_ENABLED)
 #define DPRINT_FWK(...) log_print_stack_string(LOG_STACK_FWK, __VA_ARGS__)
@@ -52,31 +55,55 @@ void packet_init(packet_t* packet)
     memset(packet, 0x00, sizeof(packet_t));
 }
 
-void packet_assemble(packet_t* packet)
+void packet_reset_header(packet_t* packet)
 {
-    uint8_t* data_ptr = packet->hw_radio_packet.data + 1; // skip length field for now, we fill this later
+    // everything except the raw data buffer, which is filled using its length field
+    memset(packet, 0x00, offsetof(packet_t, __data));
+    packet->hw_radio_packet.data[0] = 0;
+}
 
-    data_ptr += dll_assemble_packet_header(packet, data_ptr);
+uint8_t* packet_get_tx_payload_buffer(packet_t* packet)
+{
+    packet->payload = packet->hw_radio_packet.data + PACKET_TX_PAYLOAD_OFFSET;
+    return packet->payload;
+}
 
-    data_ptr += d7anp_assemble_packet_header(packet, data_ptr);
+void packet_assemble(packet_t* packet)
+{
+    // the headers are assembled first, since their length is only known afterwards, and are then put right in front of the
+    // payload which is already in place
+    uint8_t headers[PACKET_MAX_HEADER_SIZE];
+    uint8_t headers_length = dll_assemble_packet_header(packet, headers);
+
+    headers_length += d7anp_assemble_packet_header(packet, headers + headers_length);
 
 #if defined(MODULE_D7AP_NLS_ENABLED)
-    uint8_t* nwl_payload = data_ptr;
+    uint8_t nwl_payload_offset = headers_length;
 #endif
 
-    data_ptr += d7atp_assemble_packet_header(packet, data_ptr);
+    headers_length += d7atp_assemble_packet_header(packet, headers + headers_length);
+    assert(headers_length <= PACKET_MAX_HEADER_SIZE);
+
+    uint8_t* payload = packet->hw_radio_packet.data + PACKET_TX_PAYLOAD_OFFSET;
+    if (packet->payload_length > 0 && packet->payload != payload)
+        memmove(payload, packet->payload, packet->payload_length); // not filled using packet_get_tx_payload_buffer()
+
+    packet->payload = payload;
 
-    // add payload
-    memcpy(data_ptr, packet->payload, packet->payload_length); data_ptr += packet->payload_length;
+    uint8_t* frame = payload - headers_length - 1; // including the length field, we fill this later
+    memcpy(frame + 1, headers, headers_length);
+    uint8_t* data_ptr = payload + packet->payload_length;
 
 #if defined(MODULE_D7AP_NLS_ENABLED)
     /* Encrypt/authenticate nwl_payload if needed */
+    uint8_t* nwl_payload = frame + 1 + nwl_payload_offset;
     if (packet->d7anp_ctrl.nls_method)
         data_ptr += d7anp_secure_payload(packet, nwl_payload, data_ptr - nwl_payload);
 #endif
 
-    packet->hw_radio_packet.length = data_ptr - packet->hw_radio_packet.data + 2; // exclude the CRC bytes
-    packet->hw_radio_packet.data[0] = packet->hw_radio_packet.length - 1; // exclude the length byte
+    packet->hw_radio_packet.tx_meta.data_offset = frame - packet->hw_radio_packet.data;
+    packet->hw_radio_packet.length = data_ptr - frame + 2; // exclude the CRC bytes
+    frame[0] = packet->hw_radio_packet.length - 1; // exclude the length byte
 
     // TODO network protocol footer
 
@@ -84,7 +111,7 @@ void packet_assemble(packet_t* packet)
     if (!has_hardware_crc ||
               packet->phy_config.tx.channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
-        uint16_t crc = __builtin_bswap16(crc_calculate(packet->hw_radio_packet.data, packet->hw_radio_packet.length - 2));
+        uint16_t crc = __builtin_bswap16(crc_calculate(frame, packet->hw_radio_packet.length - 2));
         memcpy(data_ptr, &crc, 2);
     }
 
@@ -100,6 +127,7 @@ void packet_disassemble(packet_t* packet)
 
         if(memcmp(&crc, packet->hw_radio_packet.data + packet->hw_radio_packet.length - 2, 2) != 0)
         {
+            PERF_COUNTER_INC(phy_crc_failures);
             DPRINT_DLL("CRC invalid");
             DPRINT_DLL("Packet: len %d", packet->hw_radio_packet.length);
             DPRINT_DATA_DLL(packet->hw_radio_packet.data, packet->hw_radio_packet.length);
@@ -108,6 +136,7 @@ void packet_disassemble(packet_t* packet)
     }
     else if (packet->hw_radio_packet.rx_meta.crc_status == HW_CRC_INVALID)
     {
+        PERF_COUNTER_INC(phy_crc_failures);
         DPRINT_DLL("CRC invalid");
         goto cleanup;
     }
@@ -129,9 +158,9 @@ void packet_disassemble(packet_t* packet)
         if(!d7atp_disassemble_packet_header(packet, &data_idx))
             goto cleanup;
 
-        // extract payload
+        // the payload is used from the received frame
         packet->payload_length = packet->hw_radio_packet.length - data_idx - 2; // exclude the headers CRC bytes // TODO exclude footers
-        memcpy(packet->payload, packet->hw_radio_packet.data + data_idx, packet->payload_length);
+        packet->payload = packet->hw_radio_packet.data + data_idx;
     }
     else
     {
@@ -140,6 +169,7 @@ void packet_disassemble(packet_t* packet)
         packet->payload_length = packet->hw_radio_packet.length - data_idx - 2; // exclude the headers CRC bytes // TODO exclude footers
         assert(packet->payload_length == sizeof(uint16_t));
 
+        packet->payload = packet->hw_radio_packet.data + data_idx;
         memcpy(&eta, packet->hw_radio_packet.data + data_idx, packet->payload_length);
         packet->ETA = __builtin_bswap16(eta);
     }
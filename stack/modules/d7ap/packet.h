@@ -34,6 +34,15 @@
 #include "phy.h"
 #include "hwradio.h"
 
+/*! The maximum size of the headers in front of the payload: the DLL subnet, control and target ID (10 bytes),
+ * the network control, origin access class, origin ID and security header (15 bytes) and the transport control,
+ * IDs, timeouts and ACK template (9 bytes) */
+#define PACKET_MAX_HEADER_SIZE (10 + 15 + 9)
+
+/*! The offset of the payload of a packet to transmit in hw_radio_packet.data, which leaves room for the length byte and
+ * the headers */
+#define PACKET_TX_PAYLOAD_OFFSET (1 + PACKET_MAX_HEADER_SIZE)
+
 typedef enum {
     INITIAL_REQUEST,
     SUBSEQUENT_REQUEST,
@@ -68,17 +77,26 @@ struct packet
     uint16_t tx_duration;
     // TODO d7atp ack template
     uint8_t payload_length;
-    uint8_t payload[239]; // TODO make max size configurable using cmake
-                            // TODO store payload here or only pointer to file where we need to fetch it? can we assume data will not be changed in between
+    uint8_t* payload;       // references the payload in hw_radio_packet.data, use packet_get_tx_payload_buffer() to fill
+                            // the payload of a packet to transmit
     phy_config_t phy_config;
     hw_radio_packet_t hw_radio_packet; // TODO we might not need all metadata included in hw_radio_packet_t. If not copy needed data fields
-    uint8_t __data[255];    // reserves space for hw_radio_packet_t.data flexible array member,
-                            // do not use this directly but use hw_radio_packet_t.data instead, which contains the length byte
+    uint8_t __data[PACKET_MAX_HEADER_SIZE + 255]; // reserves space for hw_radio_packet_t.data flexible array member,
+                            // do not use this directly but use hw_radio_packet_t.data instead, which contains the length byte.
+                            // A received frame starts at data[0], a frame to transmit at data[tx_meta.data_offset]
                             // TODO configure max length from cmake
 };
 
 
 void packet_init(packet_t*);
+
+/*! Returns the buffer where the payload of a packet to transmit should be written, the headers are prepended in front
+ * of it by packet_assemble() so the payload is not copied again */
+uint8_t* packet_get_tx_payload_buffer(packet_t*);
+
+/*! Resets the metadata and headers of the packet, but not the contents of the raw data buffer */
+void packet_reset_header(packet_t*);
+
 void packet_assemble(packet_t*);
 void packet_disassemble(packet_t*);
 
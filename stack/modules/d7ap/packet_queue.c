@@ -16,12 +16,17 @@
  * limitations under the License.
  */
 
+#include <stddef.h>
+#include <string.h>
+
 #include "packet_queue.h"
 #include "MODULE_D7AP_defs.h"
 #include "debug.h"
+#include "hwatomic.h"
 #include "packet.h"
 #include "ng.h"
 #include "log.h"
+#include "perf_counters.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_PACKET_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_FWK, __VA_ARGS__)
@@ -29,88 +34,121 @@
 #define DPRINT(...)
 #endif
 
-typedef enum
-{
-    PACKET_QUEUE_ELEMENT_STATUS_FREE,       /*! The element is free */
-    PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED,  /*! The element is allocated and passed to hwradio for filling */
-    PACKET_QUEUE_ELEMENT_STATUS_RECEIVED,   /*! The element contains a successfully received packet, ready for further processing */
-    PACKET_QUEUE_ELEMENT_STATUS_TRANSMITTED,/*! The element contains a successfully transmitted packet */
-    PACKET_QUEUE_ELEMENT_STATUS_PROCESSING  /*! Indicates the supplied packet is being processed */
-} packet_queue_element_status_t;
-
 static packet_t NGDEF(_packet_queue)[MODULE_D7AP_PACKET_QUEUE_SIZE];
 #define packet_queue NG(_packet_queue)
 static packet_queue_element_status_t NGDEF(_packet_queue_element_status)[MODULE_D7AP_PACKET_QUEUE_SIZE];
 #define packet_queue_element_status NG(_packet_queue_element_status)
 
+// the free slots, linked through next_free and used as a stack
+#define NO_SLOT 0xFF
+static uint8_t NGDEF(_next_free)[MODULE_D7AP_PACKET_QUEUE_SIZE];
+#define next_free NG(_next_free)
+static uint8_t NGDEF(_free_head);
+#define free_head NG(_free_head)
+
+static packet_queue_stats_t NGDEF(_packet_queue_stats);
+#define packet_queue_stats NG(_packet_queue_stats)
+
+#if MODULE_D7AP_PACKET_QUEUE_SIZE >= NO_SLOT
+  #error MODULE_D7AP_PACKET_QUEUE_SIZE too large
+#endif
+
+static uint8_t get_slot(packet_t* packet)
+{
+    uint8_t slot = packet - packet_queue;
+    assert(packet >= packet_queue && slot < MODULE_D7AP_PACKET_QUEUE_SIZE);
+    return slot;
+}
+
+/* should be called atomically */
+static void set_status(uint8_t slot, packet_queue_element_status_t status)
+{
+    packet_queue_stats.count[packet_queue_element_status[slot]]--;
+    packet_queue_element_status[slot] = status;
+    packet_queue_stats.count[status]++;
+    if(packet_queue_stats.count[status] > packet_queue_stats.max_count[status])
+        packet_queue_stats.max_count[status] = packet_queue_stats.count[status];
+}
+
 void packet_queue_init()
 {
+    // the packets themselves are reset when they are allocated
+    memset(&packet_queue_stats, 0, sizeof(packet_queue_stats));
     for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
     {
-        packet_init(&(packet_queue[i]));
         packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_FREE;
+        next_free[i] = i + 1 < MODULE_D7AP_PACKET_QUEUE_SIZE ? i + 1 : NO_SLOT;
     }
+
+    free_head = 0;
+    packet_queue_stats.count[PACKET_QUEUE_ELEMENT_STATUS_FREE] = MODULE_D7AP_PACKET_QUEUE_SIZE;
+    packet_queue_stats.max_count[PACKET_QUEUE_ELEMENT_STATUS_FREE] = MODULE_D7AP_PACKET_QUEUE_SIZE;
 }
 
 packet_t* packet_queue_alloc_packet()
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
+    // also called from interrupt context by the radio driver
+    start_atomic();
+    uint8_t slot = free_head;
+    if(slot == NO_SLOT)
     {
-        if(packet_queue_element_status[i] == PACKET_QUEUE_ELEMENT_STATUS_FREE)
-        {
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED;
-            DPRINT("Packet queue alloc %p slot %i", &(packet_queue[i]), i);
-            return &(packet_queue[i]);
-        }
+        packet_queue_stats.alloc_failures++;
+        PERF_COUNTER_INC(packet_queue_alloc_failures);
+        end_atomic();
+        // should not happen, possible to small PACKET_QUEUE_SIZE or not always free()-ed correctly?
+        DPRINT("Packet queue full, could not alloc new packet!");
+        return NULL;
     }
 
-    // should not happen, possible to small PACKET_QUEUE_SIZE or not always free()-ed correctly?
-    DPRINT("Packet queue full, could not alloc new packet!");
-    return NULL;
+    free_head = next_free[slot];
+    set_status(slot, PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
+    end_atomic();
+
+    packet_reset_header(&(packet_queue[slot]));
+    DPRINT("Packet queue alloc %p slot %i", &(packet_queue[slot]), slot);
+    return &(packet_queue[slot]);
 }
 
 void packet_queue_free_packet(packet_t* packet)
 {
     DPRINT("Packet queue mark free %p", packet);
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(packet == &(packet_queue[i]))
-        {
-            DPRINT("packet slot %i", i);
-            assert(packet_queue_element_status[i] >= PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_FREE;
-            packet_init(&(packet_queue[i]));
-            return;
-        }
-    }
-
-    assert(false); // should never happen
+    uint8_t slot = get_slot(packet);
+    DPRINT("packet slot %i", slot);
+    start_atomic();
+    assert(packet_queue_element_status[slot] >= PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
+    set_status(slot, PACKET_QUEUE_ELEMENT_STATUS_FREE);
+    next_free[slot] = free_head;
+    free_head = slot;
+    end_atomic();
 }
 
 packet_t* packet_queue_find_packet(hw_radio_packet_t* hw_radio_packet)
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(&(packet_queue[i].hw_radio_packet) == hw_radio_packet)
-            return &(packet_queue[i]);
-    }
+    if(hw_radio_packet == NULL)
+        return NULL;
+
+    packet_t* packet = (packet_t*)((uint8_t*)hw_radio_packet - offsetof(packet_t, hw_radio_packet));
+    if(packet < packet_queue || packet >= packet_queue + MODULE_D7AP_PACKET_QUEUE_SIZE
+        || &(packet_queue[packet - packet_queue].hw_radio_packet) != hw_radio_packet)
+        return NULL;
 
-    return NULL;
+    return packet;
 }
 
 void packet_queue_mark_processing(packet_t* packet)
 {
     DPRINT("Packet queue mark processing %p", packet);
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(packet == &(packet_queue[i]))
-        {
-            assert(packet_queue_element_status[i] != PACKET_QUEUE_ELEMENT_STATUS_FREE);
-            DPRINT("Packet slot %i", i);
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_PROCESSING;
-            return;
-        }
-    }
+    uint8_t slot = get_slot(packet);
+    DPRINT("Packet slot %i", slot);
+    start_atomic();
+    assert(packet_queue_element_status[slot] != PACKET_QUEUE_ELEMENT_STATUS_FREE);
+    set_status(slot, PACKET_QUEUE_ELEMENT_STATUS_PROCESSING);
+    end_atomic();
+}
 
-    assert(false);
+void packet_queue_get_stats(packet_queue_stats_t* stats)
+{
+    start_atomic();
+    *stats = packet_queue_stats;
+    end_atomic();
 }
@@ -29,10 +29,29 @@
 
 #include "packet.h"
 
+typedef enum
+{
+    PACKET_QUEUE_ELEMENT_STATUS_FREE,       /*! The element is free */
+    PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED,  /*! The element is allocated and passed to hwradio for filling */
+    PACKET_QUEUE_ELEMENT_STATUS_RECEIVED,   /*! The element contains a successfully received packet, ready for further processing */
+    PACKET_QUEUE_ELEMENT_STATUS_TRANSMITTED,/*! The element contains a successfully transmitted packet */
+    PACKET_QUEUE_ELEMENT_STATUS_PROCESSING, /*! Indicates the supplied packet is being processed */
+    PACKET_QUEUE_ELEMENT_STATUS_COUNT
+} packet_queue_element_status_t;
+
+/*! The number of packets in each state, the highest number since init and the failed allocations */
+typedef struct
+{
+    uint8_t count[PACKET_QUEUE_ELEMENT_STATUS_COUNT];
+    uint8_t max_count[PACKET_QUEUE_ELEMENT_STATUS_COUNT];
+    uint32_t alloc_failures;
+} packet_queue_stats_t;
+
 /*! Initializes the packet queue */
 void packet_queue_init();
 
-/*! Returns the first free packet buffer in the queue and marks this as used until this is free()-ed again */
+/*! Returns a free packet buffer from the queue and marks this as used until this is free()-ed again. Only the headers
+ * and metadata of the packet are reset, not the raw data buffer */
 packet_t* packet_queue_alloc_packet();
 
 /*! Marks the packet buffer as free again */
@@ -49,6 +68,9 @@ void packet_queue_mark_processing(packet_t*);
 
 /*! Get a received packet for further processing. Returns NULL if no received packet queued. */
 packet_t* packet_queue_get_received_packet();
+
+/*! Returns the occupancy counters of the queue */
+void packet_queue_get_stats(packet_queue_stats_t* stats);
 #endif //OSS_7_PACKET_QUEUE_H
 
 /** @}*/
@@ -38,10 +38,12 @@
 #include "crc.h"
 #include "pn9.h"
 #include "fec.h"
+#include "perf_counters.h"
 
 #include "packet_queue.h"
 #include "MODULE_D7AP_defs.h"
 #include "d7ap_fs.h"
+#include "ng.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_PHY_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
@@ -128,17 +130,18 @@ typedef enum {
   STATE_CONT_RX
 } state_t;
 
-static hwradio_init_args_t init_args;
+static hwradio_init_args_t NGDEF(init_args);
 
-static phy_tx_packet_callback_t transmitted_callback;
-static phy_rx_packet_callback_t received_callback;
+static phy_tx_packet_callback_t NGDEF(transmitted_callback);
+static phy_rx_packet_callback_t NGDEF(received_callback);
+static phy_rx_packet_callback_t NGDEF(raw_received_callback);
 
-static state_t state = STATE_IDLE;
-static hw_radio_packet_t *current_packet;
-static bool should_rx_after_tx_completed = false;
-static syncword_class_t current_syncword_class = PHY_SYNCWORD_CLASS0;
-static uint16_t current_syncword = 0;
-static phy_rx_config_t pending_rx_cfg;
+static state_t NGDEF(state) = NGINIT(STATE_IDLE);
+static hw_radio_packet_t *NGDEF(current_packet);
+static bool NGDEF(should_rx_after_tx_completed);
+static syncword_class_t NGDEF(current_syncword_class) = NGINIT(PHY_SYNCWORD_CLASS0);
+static uint16_t NGDEF(current_syncword);
+static phy_rx_config_t NGDEF(pending_rx_cfg);
 
 static channel_id_t default_channel_id = {
   .channel_header.ch_coding = PHY_CODING_PN9,
@@ -149,43 +152,43 @@ static channel_id_t default_channel_id = {
 
 #define EMPTY_CHANNEL_ID { .channel_header_raw = 0xFF, .center_freq_index = 0xFF }
 
-static channel_id_t current_channel_id = EMPTY_CHANNEL_ID;
+static channel_id_t NGDEF(current_channel_id) = NGINIT(EMPTY_CHANNEL_ID);
 
-static uint32_t rx_bw_lo_rate;
-static uint32_t rx_bw_normal_rate;
-static uint32_t rx_bw_hi_rate;
-static bool fact_settings_changed = false;
+static uint32_t NGDEF(rx_bw_lo_rate);
+static uint32_t NGDEF(rx_bw_normal_rate);
+static uint32_t NGDEF(rx_bw_hi_rate);
+static bool NGDEF(fact_settings_changed);
 
-static uint32_t bitrate_lo_rate;
-static uint32_t fdev_lo_rate;
-static uint32_t bitrate_normal_rate;
-static uint32_t fdev_normal_rate;
-static uint32_t bitrate_hi_rate;
-static uint32_t fdev_hi_rate;
+static uint32_t NGDEF(bitrate_lo_rate);
+static uint32_t NGDEF(fdev_lo_rate);
+static uint32_t NGDEF(bitrate_normal_rate);
+static uint32_t NGDEF(fdev_normal_rate);
+static uint32_t NGDEF(bitrate_hi_rate);
+static uint32_t NGDEF(fdev_hi_rate);
 
-static uint32_t lora_bw;
-static uint8_t lora_SF;
+static uint32_t NGDEF(lora_bw);
+static uint8_t NGDEF(lora_SF);
 
-static uint8_t preamble_size_lo_rate;
-static uint8_t preamble_size_normal_rate;
-static uint8_t preamble_size_hi_rate;
-static uint8_t preamble_detector_size_lo_rate;
-static uint8_t preamble_detector_size_normal_rate;
-static uint8_t preamble_detector_size_hi_rate;
-static uint8_t preamble_tol_lo_rate;
-static uint8_t preamble_tol_normal_rate;
-static uint8_t preamble_tol_hi_rate;
+static uint8_t NGDEF(preamble_size_lo_rate);
+static uint8_t NGDEF(preamble_size_normal_rate);
+static uint8_t NGDEF(preamble_size_hi_rate);
+static uint8_t NGDEF(preamble_detector_size_lo_rate);
+static uint8_t NGDEF(preamble_detector_size_normal_rate);
+static uint8_t NGDEF(preamble_detector_size_hi_rate);
+static uint8_t NGDEF(preamble_tol_lo_rate);
+static uint8_t NGDEF(preamble_tol_normal_rate);
+static uint8_t NGDEF(preamble_tol_hi_rate);
 
-static uint8_t rssi_smoothing;
-static uint8_t rssi_offset;
+static uint8_t NGDEF(rssi_smoothing);
+static uint8_t NGDEF(rssi_offset);
 
-static uint16_t total_bg = 0;
-static uint16_t total_rssi_triggers = 0;
-static uint16_t total_fg = 0;
-static uint16_t total_succeeded_fg = 0;
-static uint8_t write_file_counter = 0;
+static uint16_t NGDEF(total_bg);
+static uint16_t NGDEF(total_rssi_triggers);
+static uint16_t NGDEF(total_fg);
+static uint16_t NGDEF(total_succeeded_fg);
+static uint8_t NGDEF(write_file_counter);
 
-static uint8_t gain_offset = 0;
+static uint8_t NGDEF(gain_offset);
 
 /*
  * FSK packet handler structure
@@ -213,7 +216,7 @@ typedef struct
     timer_tick_t stop_time;
 }bg_adv_t;
 
-bg_adv_t bg_adv;
+bg_adv_t NGDEF(bg_adv);
 
 typedef struct
 {
@@ -223,7 +226,7 @@ typedef struct
     bool bg_adv;
 }fg_frame_t;
 
-fg_frame_t fg_frame;
+fg_frame_t NGDEF(fg_frame);
 
 const uint16_t sync_word_value[2][4] = {
     { 0xE6D0, 0x0000, 0xF498, 0xE6D0 },
@@ -246,11 +249,11 @@ const uint8_t bg_timeout[4] = {
     To_CLASS_HI_RATE
 };
 
-uint16_t end_time;
+uint16_t NGDEF(end_time);
 /*!
  * D7A timer used to expire the continuous TX
  */
-static timer_event continuous_tx_expiration_timer;
+static timer_event NGDEF(continuous_tx_expiration_timer);
 
 static void fill_in_fifo(uint16_t remaining_bytes_len);
 
@@ -270,30 +273,32 @@ static void release_packet(hw_radio_packet_t* hw_radio_packet)
 void phy_switch_to_standby_mode()
 {
     hw_radio_set_opmode(HW_STATE_STANDBY);
-    state = STATE_IDLE;
+    NG(state) = STATE_IDLE;
 }
 
 void phy_switch_to_sleep_mode()
 {
     hw_radio_set_idle();
-    state = STATE_IDLE;
+    NG(state) = STATE_IDLE;
 }
 
 static void packet_transmitted(timer_tick_t timestamp)
 {
-    assert(state == STATE_TX || state == STATE_CONT_TX);
+    assert(NG(state) == STATE_TX || NG(state) == STATE_CONT_TX);
 
-    current_packet->tx_meta.timestamp = timestamp;
-    DPRINT("Transmitted packet @ %i with length = %i", current_packet->tx_meta.timestamp, current_packet->length);
+    NG(current_packet)->tx_meta.timestamp = timestamp;
+    PERF_COUNTER_INC(phy_tx_frames);
+    PERF_COUNTER_ADD(phy_tx_bytes, NG(current_packet)->length);
+    DPRINT("Transmitted packet @ %i with length = %i", NG(current_packet)->tx_meta.timestamp, NG(current_packet)->length);
 
     phy_switch_to_standby_mode();
 
-    transmitted_callback(packet_queue_find_packet(current_packet));
+    NG(transmitted_callback)(packet_queue_find_packet(NG(current_packet)));
 }
 
 static void packet_received(hw_radio_packet_t* hw_radio_packet)
 {
-    assert(state == STATE_RX || state == STATE_BG_SCAN);
+    assert(NG(state) == STATE_RX || NG(state) == STATE_BG_SCAN);
     // we are in interrupt context here, so mark packet for further processing,
     // schedule it and return
     DPRINT("packet received @ %i , RSSI = %d", hw_radio_packet->rx_meta.timestamp, hw_radio_packet->rx_meta.rssi);
@@ -303,6 +308,12 @@ static void packet_received(hw_radio_packet_t* hw_radio_packet)
     DPRINT("Rx packet before decoding <len = %d>", hw_radio_packet->length);
     DPRINT_DATA(hw_radio_packet->data, hw_radio_packet->length);
 
+    packet->phy_config.rx.syncword_class = NG(current_syncword_class);
+    memcpy(&(packet->phy_config.rx.channel_id), &NG(current_channel_id), sizeof(channel_id_t));
+
+    if (NG(raw_received_callback))
+        NG(raw_received_callback)(packet);
+
 #ifndef HAL_RADIO_USE_HW_DC_FREE
     pn9_encode(hw_radio_packet->data, hw_radio_packet->length);
 
@@ -310,11 +321,12 @@ static void packet_received(hw_radio_packet_t* hw_radio_packet)
     DPRINT_DATA(hw_radio_packet->data, hw_radio_packet->length);
 #endif
 #ifndef HAL_RADIO_USE_HW_FEC
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
-        fec_decode_packet(hw_radio_packet->data, hw_radio_packet->length, hw_radio_packet->length);
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
+        if (fec_decode_packet(hw_radio_packet->data, hw_radio_packet->length, hw_radio_packet->length) == 0)
+            PERF_COUNTER_INC(phy_fec_errors);
 #endif
 
-    if (current_syncword_class == PHY_SYNCWORD_CLASS0)
+    if (NG(current_syncword_class) == PHY_SYNCWORD_CLASS0)
     {
         packet->type = BACKGROUND_ADV;
         hw_radio_packet->length = BACKGROUND_FRAME_LENGTH;
@@ -323,20 +335,20 @@ static void packet_received(hw_radio_packet_t* hw_radio_packet)
         hw_radio_packet->length = hw_radio_packet->data[0] + 1;
 
     if(packet->type != BACKGROUND_ADV)
-        total_succeeded_fg++;
+        NG(total_succeeded_fg)++;
+
+    PERF_COUNTER_INC(phy_rx_frames);
+    PERF_COUNTER_ADD(phy_rx_bytes, hw_radio_packet->length);
 
     DPRINT("RX packet fully decoded <len = %d>", hw_radio_packet->length);
     DPRINT_DATA(hw_radio_packet->data, hw_radio_packet->length);
 
-    packet->phy_config.rx.syncword_class = current_syncword_class;
-    memcpy(&(packet->phy_config.rx.channel_id), &current_channel_id, sizeof(channel_id_t));
-
-    if (state == STATE_BG_SCAN)
+    if (NG(state) == STATE_BG_SCAN)
         phy_switch_to_standby_mode();
 
     // in case of FG scan, reception is continuous until upper layer decides to stop it
 
-    received_callback(packet);
+    NG(received_callback)(packet);
 }
 
 static void packet_header_received(uint8_t *data, uint8_t len)
@@ -351,7 +363,7 @@ static void packet_header_received(uint8_t *data, uint8_t len)
     pn9_encode(data, len);
 #endif
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
 #ifndef HAL_RADIO_USE_HW_FEC
         fec_decode_packet(data, len, len);
@@ -364,8 +376,8 @@ static void packet_header_received(uint8_t *data, uint8_t len)
     else
         packet_len = data[0] + 1 ;
 
-    if((current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9 && (packet_len > (0xFF * 2))) ||
-       (current_channel_id.channel_header.ch_coding != PHY_CODING_FEC_PN9 && (packet_len > 0xFF)) || (packet_len < 4))
+    if((NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9 && (packet_len > (0xFF * 2))) ||
+       (NG(current_channel_id).channel_header.ch_coding != PHY_CODING_FEC_PN9 && (packet_len > 0xFF)) || (packet_len < 4))
         packet_len = 0;
 
     DPRINT("RX Packet Length: %i ", packet_len);
@@ -379,6 +391,12 @@ bool phy_radio_channel_ids_equal(const channel_id_t* a, const channel_id_t* b)
     return (a->channel_header_raw == b->channel_header_raw) && (a->center_freq_index == b->center_freq_index);
 }
 
+bool phy_is_rx_on(const channel_id_t* channel, syncword_class_t syncword_class)
+{
+    return (NG(state) == STATE_RX || NG(state) == STATE_BG_SCAN) && NG(current_syncword_class) == syncword_class
+           && phy_radio_channel_ids_equal(&NG(current_channel_id), channel);
+}
+
 uint16_t phy_calculate_tx_duration(phy_channel_class_t channel_class, phy_coding_t ch_coding, uint16_t packet_length, bool payload_only)
 {
     double data_rate = 6.0; // Normal rate: 6.9 bytes/tick
@@ -394,7 +412,7 @@ uint16_t phy_calculate_tx_duration(phy_channel_class_t channel_class, phy_coding
         // based on http://www.semtech.com/images/datasheet/LoraDesignGuide_STD.pdf
         // only valid for explicit header, CR4/5, SF9 for now
         uint16_t payload_symbols = 8 + ceil(2*(packet_length+1)/9)*5;
-        uint16_t lora_duration = ((1 << lora_SF) * 1000) / lora_bw;
+        uint16_t lora_duration = ((1 << NG(lora_SF)) * 1000) / NG(lora_bw);
         uint16_t packet_duration = lora_duration * (LORA_T_PREAMBLE_LENGTH + payload_symbols); 
         return packet_duration;
     }
@@ -429,62 +447,62 @@ uint16_t phy_calculate_tx_duration(phy_channel_class_t channel_class, phy_coding
 
 static void configure_eirp(eirp_t eirp)
 {
-    eirp -= gain_offset;
-    DPRINT("Set Tx power: %d dBm including offset of %i\n", eirp, gain_offset);
+    eirp -= NG(gain_offset);
+    DPRINT("Set Tx power: %d dBm including offset of %i\n", eirp, NG(gain_offset));
 
     hw_radio_set_tx_power(eirp);
 }
 
 static void configure_channel(const channel_id_t* channel) {
-    if(phy_radio_channel_ids_equal(&current_channel_id, channel) && !fact_settings_changed) {
+    if(phy_radio_channel_ids_equal(&NG(current_channel_id), channel) && !NG(fact_settings_changed)) {
         return;
     }
 
-    fact_settings_changed = false;
+    NG(fact_settings_changed) = false;
 
 #ifdef USE_SX127X
-    if(channel->channel_header.ch_class != current_channel_id.channel_header.ch_class && ((channel->channel_header.ch_class == PHY_CLASS_LORA) || (current_channel_id.channel_header.ch_class == PHY_CLASS_LORA)))
+    if(channel->channel_header.ch_class != NG(current_channel_id).channel_header.ch_class && ((channel->channel_header.ch_class == PHY_CLASS_LORA) || (NG(current_channel_id).channel_header.ch_class == PHY_CLASS_LORA)))
         hw_radio_switch_longRangeMode(channel->channel_header.ch_class == PHY_CLASS_LORA);
 #endif
 
     // configure modulation settings
     if(channel->channel_header.ch_class == PHY_CLASS_LO_RATE)
     {
-        hw_radio_set_bitrate(bitrate_lo_rate);
+        hw_radio_set_bitrate(NG(bitrate_lo_rate));
         if(channel->channel_header.ch_coding != PHY_CODING_CW)
-            hw_radio_set_tx_fdev(fdev_lo_rate);
+            hw_radio_set_tx_fdev(NG(fdev_lo_rate));
         else
             hw_radio_set_tx_fdev(0);
-        hw_radio_set_rx_bw_hz(rx_bw_lo_rate);
-        hw_radio_set_preamble_size(preamble_size_lo_rate);
-        hw_radio_set_preamble_detector(preamble_detector_size_lo_rate, preamble_tol_lo_rate);
+        hw_radio_set_rx_bw_hz(NG(rx_bw_lo_rate));
+        hw_radio_set_preamble_size(NG(preamble_size_lo_rate));
+        hw_radio_set_preamble_detector(NG(preamble_detector_size_lo_rate), NG(preamble_tol_lo_rate));
     }
     else if(channel->channel_header.ch_class == PHY_CLASS_NORMAL_RATE)
     {
-        hw_radio_set_bitrate(bitrate_normal_rate);
+        hw_radio_set_bitrate(NG(bitrate_normal_rate));
         if(channel->channel_header.ch_coding != PHY_CODING_CW)
-            hw_radio_set_tx_fdev(fdev_normal_rate);
+            hw_radio_set_tx_fdev(NG(fdev_normal_rate));
         else
             hw_radio_set_tx_fdev(0);
-        hw_radio_set_rx_bw_hz(rx_bw_normal_rate);
-        hw_radio_set_preamble_size(preamble_size_normal_rate);
-        hw_radio_set_preamble_detector(preamble_detector_size_normal_rate, preamble_tol_normal_rate);
+        hw_radio_set_rx_bw_hz(NG(rx_bw_normal_rate));
+        hw_radio_set_preamble_size(NG(preamble_size_normal_rate));
+        hw_radio_set_preamble_detector(NG(preamble_detector_size_normal_rate), NG(preamble_tol_normal_rate));
     }
     else if(channel->channel_header.ch_class == PHY_CLASS_HI_RATE)
     {
-        hw_radio_set_bitrate(bitrate_hi_rate);
+        hw_radio_set_bitrate(NG(bitrate_hi_rate));
         if(channel->channel_header.ch_coding != PHY_CODING_CW)
-            hw_radio_set_tx_fdev(fdev_hi_rate);
+            hw_radio_set_tx_fdev(NG(fdev_hi_rate));
         else
             hw_radio_set_tx_fdev(0);
-        hw_radio_set_rx_bw_hz(rx_bw_hi_rate);
-        hw_radio_set_preamble_size(preamble_size_hi_rate);
-        hw_radio_set_preamble_detector(preamble_detector_size_hi_rate, preamble_tol_hi_rate);
+        hw_radio_set_rx_bw_hz(NG(rx_bw_hi_rate));
+        hw_radio_set_preamble_size(NG(preamble_size_hi_rate));
+        hw_radio_set_preamble_detector(NG(preamble_detector_size_hi_rate), NG(preamble_tol_hi_rate));
     }
 #ifdef USE_SX127X
     else if(channel->channel_header.ch_class == PHY_CLASS_LORA)
     {
-        hw_radio_set_lora_mode(lora_bw, lora_SF);
+        hw_radio_set_lora_mode(NG(lora_bw), NG(lora_SF));
     }
 #endif
 
@@ -503,22 +521,22 @@ static void configure_channel(const channel_id_t* channel) {
     center_freq += 25000 * channel->center_freq_index + channel_spacing_half;
     hw_radio_set_center_freq(center_freq);
 
-    current_channel_id = *channel;
+    NG(current_channel_id) = *channel;
     DPRINT("set channel_header %i, channel_band %i, center_freq_index %i\n",
-           current_channel_id.channel_header_raw,
-           current_channel_id.channel_header.ch_freq_band,
-           current_channel_id.center_freq_index);
+           NG(current_channel_id).channel_header_raw,
+           NG(current_channel_id).channel_header.ch_freq_band,
+           NG(current_channel_id).center_freq_index);
 }
 
 static void configure_syncword(syncword_class_t syncword_class, const channel_id_t* channel)
 {
-    if(current_syncword == sync_word_value[syncword_class][channel->channel_header.ch_coding ])
+    if(NG(current_syncword) == sync_word_value[syncword_class][channel->channel_header.ch_coding ])
         return;
-    current_syncword_class = syncword_class;
-    current_syncword = sync_word_value[syncword_class][channel->channel_header.ch_coding ];
+    NG(current_syncword_class) = syncword_class;
+    NG(current_syncword) = sync_word_value[syncword_class][channel->channel_header.ch_coding ];
 
     // DPRINT("sync_word = %04x", sync_word);
-    hw_radio_set_sync_word((uint8_t *)&current_syncword, sizeof(uint16_t));
+    hw_radio_set_sync_word((uint8_t *)&NG(current_syncword), sizeof(uint16_t));
 }
 
 void continuous_tx_expiration()
@@ -532,45 +550,45 @@ void fact_settings_file_change_callback(uint8_t file_id)
     uint8_t fact_settings[D7A_FILE_FACTORY_SETTINGS_SIZE];
     d7ap_fs_read_file(D7A_FILE_FACTORY_SETTINGS_FILE_ID, 0, fact_settings, D7A_FILE_FACTORY_SETTINGS_SIZE);
 
-    gain_offset = (int8_t)fact_settings[0];
-    rx_bw_lo_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+1)));
-    rx_bw_normal_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+5)));
-    rx_bw_hi_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+9)));
-
-    bitrate_lo_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+13)));
-    fdev_lo_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+17)));
-    bitrate_normal_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+21)));
-    fdev_normal_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+25)));
-    bitrate_hi_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+29)));
-    fdev_hi_rate = __builtin_bswap32(*((uint32_t*)(fact_settings+33)));
-
-    preamble_size_lo_rate = fact_settings[37];
-    preamble_size_normal_rate = fact_settings[38];
-    preamble_size_hi_rate = fact_settings[39];
-
-    preamble_detector_size_lo_rate = fact_settings[40];
-    preamble_detector_size_normal_rate = fact_settings[41];
-    preamble_detector_size_hi_rate = fact_settings[42];
-    preamble_tol_lo_rate = fact_settings[43];
-    preamble_tol_normal_rate = fact_settings[44];
-    preamble_tol_hi_rate = fact_settings[45];
-
-    rssi_smoothing = fact_settings[46];
-    rssi_offset = fact_settings[47];
-
-    hw_radio_set_rssi_config(rssi_smoothing, rssi_offset);
-
-    lora_bw = __builtin_bswap32(*((uint32_t*)(fact_settings+48)));
-    lora_SF = (uint8_t)fact_settings[52];
-
-    DPRINT("low rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", bitrate_lo_rate, fdev_lo_rate, rx_bw_lo_rate, preamble_size_lo_rate, preamble_detector_size_lo_rate, preamble_tol_lo_rate);
-    DPRINT("normal rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", bitrate_normal_rate, fdev_normal_rate, rx_bw_normal_rate, preamble_size_normal_rate, preamble_detector_size_normal_rate, preamble_tol_normal_rate);
-    DPRINT("high rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", bitrate_hi_rate, fdev_hi_rate, rx_bw_hi_rate, preamble_size_hi_rate, preamble_detector_size_hi_rate, preamble_tol_hi_rate);
-    DPRINT("rssi smoothing is set to %i with an offset of %i", 2 << rssi_smoothing, rssi_offset);
-    DPRINT("gain offset set to %i\n", gain_offset);
-    DPRINT("set lora bw to %i Hz with SF %i\n", lora_bw, lora_SF);
-
-    fact_settings_changed = true;
+    NG(gain_offset) = (int8_t)fact_settings[0];
+    NG(rx_bw_lo_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+1)));
+    NG(rx_bw_normal_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+5)));
+    NG(rx_bw_hi_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+9)));
+
+    NG(bitrate_lo_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+13)));
+    NG(fdev_lo_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+17)));
+    NG(bitrate_normal_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+21)));
+    NG(fdev_normal_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+25)));
+    NG(bitrate_hi_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+29)));
+    NG(fdev_hi_rate) = __builtin_bswap32(*((uint32_t*)(fact_settings+33)));
+
+    NG(preamble_size_lo_rate) = fact_settings[37];
+    NG(preamble_size_normal_rate) = fact_settings[38];
+    NG(preamble_size_hi_rate) = fact_settings[39];
+
+    NG(preamble_detector_size_lo_rate) = fact_settings[40];
+    NG(preamble_detector_size_normal_rate) = fact_settings[41];
+    NG(preamble_detector_size_hi_rate) = fact_settings[42];
+    NG(preamble_tol_lo_rate) = fact_settings[43];
+    NG(preamble_tol_normal_rate) = fact_settings[44];
+    NG(preamble_tol_hi_rate) = fact_settings[45];
+
+    NG(rssi_smoothing) = fact_settings[46];
+    NG(rssi_offset) = fact_settings[47];
+
+    hw_radio_set_rssi_config(NG(rssi_smoothing), NG(rssi_offset));
+
+    NG(lora_bw) = __builtin_bswap32(*((uint32_t*)(fact_settings+48)));
+    NG(lora_SF) = (uint8_t)fact_settings[52];
+
+    DPRINT("low rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", NG(bitrate_lo_rate), NG(fdev_lo_rate), NG(rx_bw_lo_rate), NG(preamble_size_lo_rate), NG(preamble_detector_size_lo_rate), NG(preamble_tol_lo_rate));
+    DPRINT("normal rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", NG(bitrate_normal_rate), NG(fdev_normal_rate), NG(rx_bw_normal_rate), NG(preamble_size_normal_rate), NG(preamble_detector_size_normal_rate), NG(preamble_tol_normal_rate));
+    DPRINT("high rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", NG(bitrate_hi_rate), NG(fdev_hi_rate), NG(rx_bw_hi_rate), NG(preamble_size_hi_rate), NG(preamble_detector_size_hi_rate), NG(preamble_tol_hi_rate));
+    DPRINT("rssi smoothing is set to %i with an offset of %i", 2 << NG(rssi_smoothing), NG(rssi_offset));
+    DPRINT("gain offset set to %i\n", NG(gain_offset));
+    DPRINT("set lora bw to %i Hz with SF %i\n", NG(lora_bw), NG(lora_SF));
+
+    NG(fact_settings_changed) = true;
 }
 
 
@@ -578,14 +596,14 @@ error_t phy_init(void) {
 
     error_t ret = SUCCESS;
 
-    init_args.alloc_packet_cb = alloc_new_packet;
-    init_args.release_packet_cb = release_packet;
-    init_args.rx_packet_cb = packet_received;
-    init_args.tx_packet_cb = packet_transmitted;
-    init_args.rx_packet_header_cb = packet_header_received;
-    init_args.tx_refill_cb = fill_in_fifo;
+    NG(init_args).alloc_packet_cb = alloc_new_packet;
+    NG(init_args).release_packet_cb = release_packet;
+    NG(init_args).rx_packet_cb = packet_received;
+    NG(init_args).tx_packet_cb = packet_transmitted;
+    NG(init_args).rx_packet_header_cb = packet_header_received;
+    NG(init_args).tx_refill_cb = fill_in_fifo;
 
-    hw_radio_init(&init_args);
+    hw_radio_init(&NG(init_args));
 
 #ifdef HAL_RADIO_USE_HW_CRC
     hw_radio_set_crc_on(true);
@@ -621,17 +639,18 @@ error_t phy_init(void) {
     //hw_radio_set_opmode(OPMODE_STANDBY); --> done by the netdev driver
     //while(hw_radio_get_opmode() != OPMODE_STANDBY) {}
 
-    timer_init_event(&continuous_tx_expiration_timer, &continuous_tx_expiration);
+    timer_init_event(&NG(continuous_tx_expiration_timer), &continuous_tx_expiration);
 
     return ret;
 }
 
 void status_write() {
-    write_file_counter++;
-    if(write_file_counter == 100) {
-        write_file_counter = 0;
-        uint16_t bg_trigger_ratio = 1024 * total_rssi_triggers / total_bg;
-        uint16_t scan_timeout_ratio = 1024 * (total_fg - total_succeeded_fg) / total_fg;
+    NG(write_file_counter)++;
+    if(NG(write_file_counter) == 100) {
+        NG(write_file_counter) = 0;
+        // a node which only does FG scans never triggers a BG scan (and the other way around)
+        uint16_t bg_trigger_ratio = NG(total_bg) ? 1024 * NG(total_rssi_triggers) / NG(total_bg) : 0;
+        uint16_t scan_timeout_ratio = NG(total_fg) ? 1024 * (NG(total_fg) - NG(total_succeeded_fg)) / NG(total_fg) : 0;
         uint8_t buffer[4] = {(uint8_t)(bg_trigger_ratio >> 8), (uint8_t)(bg_trigger_ratio & 0xFF), (uint8_t)(scan_timeout_ratio >> 8), (uint8_t)(scan_timeout_ratio & 0xFF)};
         d7ap_fs_write_file(D7A_FILE_DLL_STATUS_FILE_ID, 8, buffer, 4);
         DPRINT("wrote to file 0x%02X the bg trigger ratio %d and scan timeout ratio %d", D7A_FILE_DLL_STATUS_FILE_ID, bg_trigger_ratio, scan_timeout_ratio);
@@ -639,16 +658,16 @@ void status_write() {
 }
 
 error_t phy_start_rx(channel_id_t* channel, syncword_class_t syncword_class, phy_rx_packet_callback_t rx_cb) {
-    received_callback = rx_cb;
+    NG(received_callback) = rx_cb;
     // TODO error handling EINVAL, EOFF
 
     // if we are currently transmitting wait until TX completed before entering RX
     // we return now and go into RX when TX is completed
-    if(state == STATE_TX)
+    if(NG(state) == STATE_TX)
     {
-        should_rx_after_tx_completed = true;
-        pending_rx_cfg.channel_id = *channel;
-        pending_rx_cfg.syncword_class = syncword_class;
+        NG(should_rx_after_tx_completed) = true;
+        NG(pending_rx_cfg).channel_id = *channel;
+        NG(pending_rx_cfg).syncword_class = syncword_class;
         return SUCCESS;
     }
 
@@ -662,11 +681,11 @@ error_t phy_start_rx(channel_id_t* channel, syncword_class_t syncword_class, phy
     DEBUG_RX_START();
     DEBUG_FG_START();    
 
-    total_fg++;
+    NG(total_fg)++;
 
     status_write();
 
-    state = STATE_RX;
+    NG(state) = STATE_RX;
     hw_radio_set_opmode(HW_STATE_RX);
 
     return SUCCESS;
@@ -675,14 +694,14 @@ error_t phy_start_rx(channel_id_t* channel, syncword_class_t syncword_class, phy
 error_t phy_start_energy_scan(channel_id_t* channel, rssi_valid_callback_t rssi_cb, int16_t scan_duration)
 {
     // We should not initiate a RSSI measurement before TX is completed
-    assert(state != STATE_TX);
+    assert(NG(state) != STATE_TX);
 
     configure_channel(channel);
     //configure_syncword(syncword_class, channel);
     hw_radio_set_payload_length(0x00); // unlimited length mode
 
     // switch to RX since the RSSI measurement is done in RX mode
-    state = STATE_RX;
+    NG(state) = STATE_RX;
 
     //FIXME support asynchronous RSSI and scan duration
     //uint8_t rssi_samples = scan_duration
@@ -700,13 +719,19 @@ error_t phy_stop_rx(){
     return SUCCESS;
 }
 
+void phy_set_raw_rx_callback(phy_rx_packet_callback_t raw_rx_cb)
+{
+    NG(raw_received_callback) = raw_rx_cb;
+}
+
 static uint16_t encode_packet(hw_radio_packet_t* packet, uint8_t* encoded_packet)
 {
+    // the packet stays unmodified since it can be transmitted again, the encoded frame is the only copy
     uint16_t encoded_len = packet->length;
-    memcpy(encoded_packet, packet->data, packet->length);
+    memcpy(encoded_packet, packet->data + packet->tx_meta.data_offset, packet->length);
 
 #ifndef HAL_RADIO_USE_HW_FEC
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
         encoded_len = fec_encode(encoded_packet, packet->length);
 #endif
 
@@ -724,18 +749,18 @@ error_t phy_send_packet(hw_radio_packet_t* packet, phy_tx_config_t* config, phy_
 {
     assert(packet->length <= PACKET_MAX_SIZE);
 
-    transmitted_callback = tx_callback;
+    NG(transmitted_callback) = tx_callback;
 
     if(packet->length == 0)
         return ESIZE;
 
-    current_packet = packet;
+    NG(current_packet) = packet;
 
-    if(state == STATE_RX)
+    if(NG(state) == STATE_RX)
     {
-        pending_rx_cfg.channel_id = current_channel_id;
-        pending_rx_cfg.syncword_class = current_syncword_class;
-        should_rx_after_tx_completed = true;
+        NG(pending_rx_cfg).channel_id = NG(current_channel_id);
+        NG(pending_rx_cfg).syncword_class = NG(current_syncword_class);
+        NG(should_rx_after_tx_completed) = true;
         phy_switch_to_standby_mode();
     }
 
@@ -743,24 +768,24 @@ error_t phy_send_packet(hw_radio_packet_t* packet, phy_tx_config_t* config, phy_
     configure_eirp(config->eirp);
     configure_syncword(config->syncword_class, &config->channel_id);
 
-    state = STATE_TX;
+    NG(state) = STATE_TX;
 
     DPRINT("BEFORE ENCODING TX len=%i", packet->length);
-    DPRINT_DATA(packet->data, packet->length);
+    DPRINT_DATA(packet->data + packet->tx_meta.data_offset, packet->length);
 
     // Encode the packet if not supported by xcvr
     // uint8_t encoded_packet[(PACKET_MAX_SIZE + 1)*2]; // bufer sized for FEC encoding
-    fg_frame.encoded_length = encode_packet(packet, fg_frame.encoded_packet);
+    NG(fg_frame).encoded_length = encode_packet(packet, NG(fg_frame).encoded_packet);
 
-    DPRINT("AFTER ENCODING TX len=%i\n", fg_frame.encoded_length);
-    DPRINT_DATA(fg_frame.encoded_packet, fg_frame.encoded_length);
+    DPRINT("AFTER ENCODING TX len=%i\n", NG(fg_frame).encoded_length);
+    DPRINT_DATA(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
 
     DEBUG_RX_END();
     DEBUG_TX_START();
 
     DPRINT("start sending @ %i\n", timer_get_counter_value());
 
-    hw_radio_send_payload(fg_frame.encoded_packet, fg_frame.encoded_length);
+    hw_radio_send_payload(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
 
     return SUCCESS; // TODO other return codes
 }
@@ -778,27 +803,27 @@ static uint8_t assemble_background_payload()
      * subsequent advertising frame.
      */
 
-    memcpy(bg_adv.packet_payload, bg_adv.dll_header, BACKGROUND_DLL_HEADER_LENGTH);
+    memcpy(NG(bg_adv).packet_payload, NG(bg_adv).dll_header, BACKGROUND_DLL_HEADER_LENGTH);
 
     // add ETA for background frames
     //DPRINT("eta %i", bg_adv.eta);
-    swap_eta = __builtin_bswap16(bg_adv.eta);
-    memcpy(&bg_adv.packet_payload[BACKGROUND_DLL_HEADER_LENGTH], &swap_eta, sizeof(uint16_t));
+    swap_eta = __builtin_bswap16(NG(bg_adv).eta);
+    memcpy(&NG(bg_adv).packet_payload[BACKGROUND_DLL_HEADER_LENGTH], &swap_eta, sizeof(uint16_t));
 
     // add CRC
-    crc = __builtin_bswap16(crc_calculate(bg_adv.packet_payload, 4));
-    memcpy(&bg_adv.packet_payload[BACKGROUND_DLL_HEADER_LENGTH + sizeof(uint16_t)], &crc, 2);
+    crc = __builtin_bswap16(crc_calculate(NG(bg_adv).packet_payload, 4));
+    memcpy(&NG(bg_adv).packet_payload[BACKGROUND_DLL_HEADER_LENGTH + sizeof(uint16_t)], &crc, 2);
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
-        payload_len = fec_encode(bg_adv.packet_payload, BACKGROUND_FRAME_LENGTH);
-        pn9_encode(bg_adv.packet_payload, payload_len);
+        payload_len = fec_encode(NG(bg_adv).packet_payload, BACKGROUND_FRAME_LENGTH);
+        pn9_encode(NG(bg_adv).packet_payload, payload_len);
     }
     else
     {
         //DPRINT("assemble payload %d", BACKGROUND_FRAME_LENGTH);
         //DPRINT_DATA(bg_adv.packet_payload, BACKGROUND_FRAME_LENGTH);
-        pn9_encode(bg_adv.packet_payload, BACKGROUND_FRAME_LENGTH);
+        pn9_encode(NG(bg_adv).packet_payload, BACKGROUND_FRAME_LENGTH);
         payload_len = BACKGROUND_FRAME_LENGTH;
     }
 
@@ -817,14 +842,14 @@ static uint8_t assemble_background_payload()
 error_t phy_send_packet_with_advertising(hw_radio_packet_t* packet, phy_tx_config_t* config,
                                          uint8_t dll_header_bg_frame[2], uint16_t eta, phy_tx_packet_callback_t tx_callback)
 {   
-    transmitted_callback = tx_callback;
+    NG(transmitted_callback) = tx_callback;
     DPRINT("Start the bg advertising for ad-hoc sync before transmitting the FG frame");
 
     configure_syncword(PHY_SYNCWORD_CLASS0, &config->channel_id);
     configure_channel(&config->channel_id);
     configure_eirp(config->eirp);
 
-    current_packet = packet;
+    NG(current_packet) = packet;
 
     // During the advertising flooding, use the infinite packet length mode
     hw_radio_set_payload_length(0x00); // unlimited length mode
@@ -833,59 +858,59 @@ error_t phy_send_packet_with_advertising(hw_radio_packet_t* packet, phy_tx_confi
     hw_radio_enable_preloading(true);
 
     // Prepare the subsequent background frames which include the preamble and the sync word
-    uint8_t preamble_len = (current_channel_id.channel_header.ch_class ==  PHY_CLASS_HI_RATE ? PREAMBLE_HI_RATE_CLASS : PREAMBLE_LOW_RATE_CLASS);
-    memset(bg_adv.packet, 0xAA, preamble_len); // preamble length is given in number of bytes
-    uint16_t sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS0][current_channel_id.channel_header.ch_coding]);
-    memcpy(&bg_adv.packet[preamble_len], &sync_word, 2);
+    uint8_t preamble_len = (NG(current_channel_id).channel_header.ch_class ==  PHY_CLASS_HI_RATE ? PREAMBLE_HI_RATE_CLASS : PREAMBLE_LOW_RATE_CLASS);
+    memset(NG(bg_adv).packet, 0xAA, preamble_len); // preamble length is given in number of bytes
+    uint16_t sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS0][NG(current_channel_id).channel_header.ch_coding]);
+    memcpy(&NG(bg_adv).packet[preamble_len], &sync_word, 2);
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
-        bg_adv.packet_size = preamble_len + 2 + fec_calculated_decoded_length(BACKGROUND_FRAME_LENGTH);
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
+        NG(bg_adv).packet_size = preamble_len + 2 + fec_calculated_decoded_length(BACKGROUND_FRAME_LENGTH);
     else
-        bg_adv.packet_size = preamble_len + 2 + BACKGROUND_FRAME_LENGTH;
+        NG(bg_adv).packet_size = preamble_len + 2 + BACKGROUND_FRAME_LENGTH;
 
-    bg_adv.packet_payload = bg_adv.packet + preamble_len + 2 ;
+    NG(bg_adv).packet_payload = NG(bg_adv).packet + preamble_len + 2 ;
 
     // Backup the DLL header
-    memcpy(bg_adv.dll_header, dll_header_bg_frame, BACKGROUND_DLL_HEADER_LENGTH);
+    memcpy(NG(bg_adv).dll_header, dll_header_bg_frame, BACKGROUND_DLL_HEADER_LENGTH);
     DPRINT("DLL header followed by ETA %i", eta);
-    DPRINT_DATA(bg_adv.dll_header, BACKGROUND_DLL_HEADER_LENGTH);
+    DPRINT_DATA(NG(bg_adv).dll_header, BACKGROUND_DLL_HEADER_LENGTH);
 
-    bg_adv.eta = eta;
-    bg_adv.tx_duration = phy_calculate_tx_duration(current_channel_id.channel_header.ch_class,
-                                                   current_channel_id.channel_header.ch_coding,
+    NG(bg_adv).eta = eta;
+    NG(bg_adv).tx_duration = phy_calculate_tx_duration(NG(current_channel_id).channel_header.ch_class,
+                                                   NG(current_channel_id).channel_header.ch_coding,
                                                    BACKGROUND_FRAME_LENGTH, false);
 
     // prepare the foreground frame, so we can transmit this immediately
     DPRINT("Original payload with ETA %i", eta);
-    DPRINT_DATA(packet->data, packet->length);
+    DPRINT_DATA(packet->data + packet->tx_meta.data_offset, packet->length);
 
-    DPRINT("tx_duration_bg_frame %i", bg_adv.tx_duration);
-    fg_frame.bg_adv = true;
-    memset(fg_frame.encoded_packet, 0xAA, preamble_len);
-    sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS1][current_channel_id.channel_header.ch_coding]);
-    memcpy(&fg_frame.encoded_packet[preamble_len], &sync_word, 2);
-    fg_frame.encoded_length = encode_packet(packet, &fg_frame.encoded_packet[preamble_len + 2]);
-    fg_frame.encoded_length += preamble_len + 2; // add preamble + syncword
+    DPRINT("tx_duration_bg_frame %i", NG(bg_adv).tx_duration);
+    NG(fg_frame).bg_adv = true;
+    memset(NG(fg_frame).encoded_packet, 0xAA, preamble_len);
+    sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS1][NG(current_channel_id).channel_header.ch_coding]);
+    memcpy(&NG(fg_frame).encoded_packet[preamble_len], &sync_word, 2);
+    NG(fg_frame).encoded_length = encode_packet(packet, &NG(fg_frame).encoded_packet[preamble_len + 2]);
+    NG(fg_frame).encoded_length += preamble_len + 2; // add preamble + syncword
 
     uint8_t payload_len;
     payload_len = assemble_background_payload();
 
     // For the first advertising frame, transmit directly the payload since the preamble and the sync word are directly managed by the xcv
     DPRINT("Transmit packet: %d", payload_len);
-    DPRINT_DATA(bg_adv.packet_payload, payload_len);
+    DPRINT_DATA(NG(bg_adv).packet_payload, payload_len);
 
-    hw_radio_send_payload(bg_adv.packet_payload, payload_len); // in preloading mode
+    hw_radio_send_payload(NG(bg_adv).packet_payload, payload_len); // in preloading mode
 
     // prepare the next advertising frame, insert the preamble and the SYNC word
-    bg_adv.eta -= bg_adv.tx_duration; // the next ETA is the time remaining after the end transmission time of the D7AAdvP frame
+    NG(bg_adv).eta -= NG(bg_adv).tx_duration; // the next ETA is the time remaining after the end transmission time of the D7AAdvP frame
     assemble_background_payload();
 
     // start Tx
     timer_tick_t start = timer_get_counter_value();
-    bg_adv.stop_time = start + eta + bg_adv.tx_duration + FG_SCAN_STARTUP_TIME + 4; // Tadv = Tsched + Ttx + Tfg_startup + Tcalc
-    DPRINT("BG Tadv %i (start time @ %i stop time @ %i)", eta + bg_adv.tx_duration, start, bg_adv.stop_time);
+    NG(bg_adv).stop_time = start + eta + NG(bg_adv).tx_duration + FG_SCAN_STARTUP_TIME + 4; // Tadv = Tsched + Ttx + Tfg_startup + Tcalc
+    DPRINT("BG Tadv %i (start time @ %i stop time @ %i)", eta + NG(bg_adv).tx_duration, start, NG(bg_adv).stop_time);
 
-    state = STATE_TX;
+    NG(state) = STATE_TX;
     DEBUG_RX_END();
     DEBUG_TX_START();
     DEBUG_BG_START();
@@ -904,26 +929,26 @@ static void fill_in_fifo(uint16_t remaining_bytes_len)
     // TODO adapt how we calculate ETA. There is no reason to use current time for each ETA update, we can just use the BG frame duration
     // and a frame counter to determine this.
 
-    if (fg_frame.bg_adv)
+    if (NG(fg_frame).bg_adv)
     {
         DEBUG_BG_END();
         timer_tick_t current = timer_get_counter_value();
         // DPRINT("fill in fifo, bg adv, currently %d untill %d\n", current, bg_adv.stop_time);
 
         // calculate the time needed to flush the remaining bytes in the TX
-        uint16_t flush_duration = phy_calculate_tx_duration(current_channel_id.channel_header.ch_class,
+        uint16_t flush_duration = phy_calculate_tx_duration(NG(current_channel_id).channel_header.ch_class,
                                                             PHY_CODING_PN9, // override FEC, we need the time for the BG_THRESHOLD bytes in the fifo, regardless of coding
                                                             remaining_bytes_len, true); // don't take syncword and preamble into account
 
-        if (bg_adv.stop_time > current + 2 * bg_adv.tx_duration + flush_duration)
-            bg_adv.eta = (bg_adv.stop_time - current) - 2 * bg_adv.tx_duration; // ETA is updated according the real current time
-        else if(bg_adv.stop_time > current + bg_adv.tx_duration + flush_duration)
-            bg_adv.eta = 1; // Send last background frame with ETA which we calculated and assembled previous loop.
+        if (NG(bg_adv).stop_time > current + 2 * NG(bg_adv).tx_duration + flush_duration)
+            NG(bg_adv).eta = (NG(bg_adv).stop_time - current) - 2 * NG(bg_adv).tx_duration; // ETA is updated according the real current time
+        else if(NG(bg_adv).stop_time > current + NG(bg_adv).tx_duration + flush_duration)
+            NG(bg_adv).eta = 1; // Send last background frame with ETA which we calculated and assembled previous loop.
         else
             //TODO avoid stop time being elapsed
-            bg_adv.eta = 0;
+            NG(bg_adv).eta = 0;
 
-        DPRINT("ts after tx %d, new ETA %d\n", current + bg_adv.tx_duration, bg_adv.eta);
+        DPRINT("ts after tx %d, new ETA %d\n", current + NG(bg_adv).tx_duration, NG(bg_adv).eta);
 
         /*
          * When no more advertising background frames can be fully transmitted before
@@ -931,11 +956,11 @@ static void fill_in_fifo(uint16_t remaining_bytes_len)
          * symbols after the end of the background packet, in order to guarantee no silence period.
          * The FIFO level allows to write enough padding preamble bytes without overflow
          */
-        if(bg_adv.eta)
+        if(NG(bg_adv).eta)
         {
             DEBUG_BG_START();
             // Fill up the TX FIFO with the full packet including the preamble and the SYNC word
-            hw_radio_send_payload(bg_adv.packet, bg_adv.packet_size);
+            hw_radio_send_payload(NG(bg_adv).packet, NG(bg_adv).packet_size);
 
             // Prepare the next frame
             assemble_background_payload();
@@ -947,45 +972,45 @@ static void fill_in_fifo(uint16_t remaining_bytes_len)
             uint16_t preamble_len = 0;
             uint8_t preamble[24];
 
-            preamble_len = (bg_adv.stop_time - current) * (bg_adv.packet_size / (float)bg_adv.tx_duration); // TODO instead of current we should use the timestamp
-            DPRINT("ETA %d, packet size %d, tx_duration %d, current time %d\n", bg_adv.eta, bg_adv.packet_size, bg_adv.tx_duration, timer_get_counter_value());
+            preamble_len = (NG(bg_adv).stop_time - current) * (NG(bg_adv).packet_size / (float)NG(bg_adv).tx_duration); // TODO instead of current we should use the timestamp
+            DPRINT("ETA %d, packet size %d, tx_duration %d, current time %d\n", NG(bg_adv).eta, NG(bg_adv).packet_size, NG(bg_adv).tx_duration, timer_get_counter_value());
 
             DPRINT("Add preamble_bytes: %d\n", preamble_len);
             memset(preamble, 0xAA, preamble_len);
             hw_radio_send_payload(preamble, preamble_len);
             DEBUG_BG_END();
 
-            bg_adv.eta = 0;
-            fg_frame.bg_adv = false;
+            NG(bg_adv).eta = 0;
+            NG(fg_frame).bg_adv = false;
         }
     }
     else
     {
         // Disable the refill event since this is the last chunk of data to transmit
-        if (state != STATE_CONT_TX) 
+        if (NG(state) != STATE_CONT_TX) 
             hw_radio_enable_refill(false);
         DEBUG_FG_START();
-        hw_radio_send_payload(fg_frame.encoded_packet, fg_frame.encoded_length);
+        hw_radio_send_payload(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
     }
 }
 
 error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callback_t rx_cb)
 {
     DEBUG_BG_START();
-    received_callback = rx_cb;
+    NG(received_callback) = rx_cb;
     uint8_t packet_len;
 
     //DPRINT("START BG scan @ %i", timer_get_counter_value());
 
     // We should not initiate a background scan before TX is completed
-    assert(state != STATE_TX);
+    assert(NG(state) != STATE_TX);
 
-    state = STATE_BG_SCAN;
+    NG(state) = STATE_BG_SCAN;
 
     configure_syncword(PHY_SYNCWORD_CLASS0, &config->channel_id);
     configure_channel(&config->channel_id);
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
         packet_len = fec_calculated_decoded_length(BACKGROUND_FRAME_LENGTH);
     else
         packet_len = BACKGROUND_FRAME_LENGTH;
@@ -993,7 +1018,7 @@ error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callbac
     // set PayloadLength to the length of the expected Background frame (fixed length packet format is used)
     hw_radio_set_payload_length(packet_len);
 
-    total_bg++;
+    NG(total_bg)++;
 
     DEBUG_RX_START();
 
@@ -1012,14 +1037,14 @@ error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callbac
     config->rssi_thr = rssi;
     DEBUG_BG_END();
 
-    total_rssi_triggers++;
+    NG(total_rssi_triggers)++;
 
     status_write();
 
     DPRINT("rssi %i, waiting for BG frame\n", rssi);
 
     // the device has a period of To to successfully detect the sync word
-    hw_radio_set_rx_timeout(bg_timeout[current_channel_id.channel_header.ch_class] + 40); //TO DO: OPTIMISE THIS TIMEOUT
+    hw_radio_set_rx_timeout(bg_timeout[NG(current_channel_id).channel_header.ch_class] + 40); //TO DO: OPTIMISE THIS TIMEOUT
     DEBUG_BG_START();
     hw_radio_set_opmode(HW_STATE_RX);
 
@@ -1028,14 +1053,14 @@ error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callbac
 
 void phy_continuous_tx(phy_tx_config_t const* tx_cfg, uint8_t time_period, phy_tx_packet_callback_t tx_cb)
 {
-    transmitted_callback = tx_cb;
+    NG(transmitted_callback) = tx_cb;
     DPRINT("Continuous tx\n");
 
-    if(state == STATE_RX)
+    if(NG(state) == STATE_RX)
     {
-        pending_rx_cfg.channel_id = current_channel_id;
-        pending_rx_cfg.syncword_class = current_syncword_class;
-        should_rx_after_tx_completed = true;
+        NG(pending_rx_cfg).channel_id = NG(current_channel_id);
+        NG(pending_rx_cfg).syncword_class = NG(current_syncword_class);
+        NG(should_rx_after_tx_completed) = true;
         phy_switch_to_standby_mode();
     }
 
@@ -1044,38 +1069,38 @@ void phy_continuous_tx(phy_tx_config_t const* tx_cfg, uint8_t time_period, phy_t
     configure_syncword(tx_cfg->syncword_class, &tx_cfg->channel_id);
     hw_radio_enable_refill(true);
 
-    state = STATE_CONT_TX;
+    NG(state) = STATE_CONT_TX;
     if(time_period) {
-        continuous_tx_expiration_timer.next_event = time_period * 1024;
-        timer_add_event(&continuous_tx_expiration_timer);
+        NG(continuous_tx_expiration_timer).next_event = time_period * 1024;
+        timer_add_event(&NG(continuous_tx_expiration_timer));
     }
 
-    fg_frame.bg_adv = false;
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    NG(fg_frame).bg_adv = false;
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
         uint8_t payload_len = 32;
-        fg_frame.encoded_packet[0] = payload_len;
+        NG(fg_frame).encoded_packet[0] = payload_len;
         for (uint8_t i = 0; i < payload_len; i++)
-            fg_frame.encoded_packet[i+1] = i;
+            NG(fg_frame).encoded_packet[i+1] = i;
 
-        fg_frame.encoded_length = fec_encode(fg_frame.encoded_packet, payload_len);
-        pn9_encode(fg_frame.encoded_packet, fg_frame.encoded_length);
+        NG(fg_frame).encoded_length = fec_encode(NG(fg_frame).encoded_packet, payload_len);
+        pn9_encode(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
     }
-    else if (current_channel_id.channel_header.ch_coding == PHY_CODING_PN9)
+    else if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_PN9)
     {
         uint8_t payload_len = 63;
-        fg_frame.encoded_packet[0] = payload_len;
+        NG(fg_frame).encoded_packet[0] = payload_len;
         for (uint8_t i = 0; i < payload_len; i++)
-            fg_frame.encoded_packet[i+1] = 0xAA;
+            NG(fg_frame).encoded_packet[i+1] = 0xAA;
 
-        pn9_encode(fg_frame.encoded_packet, payload_len);
-        fg_frame.encoded_length = payload_len;
+        pn9_encode(NG(fg_frame).encoded_packet, payload_len);
+        NG(fg_frame).encoded_length = payload_len;
     } else {
         uint8_t payload_len = 0xFF;
-        fg_frame.encoded_packet[0] = payload_len;
+        NG(fg_frame).encoded_packet[0] = payload_len;
         for (uint8_t i = 1; i < payload_len; i++)
-            fg_frame.encoded_packet[i+1] = i;
-        fg_frame.encoded_length = payload_len;
+            NG(fg_frame).encoded_packet[i+1] = i;
+        NG(fg_frame).encoded_length = payload_len;
     }
-    hw_radio_send_payload(fg_frame.encoded_packet, fg_frame.encoded_length);
+    hw_radio_send_payload(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
 }
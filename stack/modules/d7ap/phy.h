@@ -257,6 +257,12 @@ error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callbac
  */
 bool phy_radio_channel_ids_equal(const channel_id_t* a, const channel_id_t* b);
 
+/* \brief Checks whether a frame transmitted on the given channel, using the given syncword class, would be received
+ *
+ * \return bool  true if the PHY is in a foreground or background scan on this channel and with this syncword class
+ */
+bool phy_is_rx_on(const channel_id_t* channel, syncword_class_t syncword_class);
+
 uint16_t phy_calculate_tx_duration(phy_channel_class_t channel_class, phy_coding_t ch_coding, uint16_t packet_length, bool payload_only);
 
 void phy_continuous_tx(phy_tx_config_t const* tx_cfg, uint8_t time_period, phy_tx_packet_callback_t tx_cb);
@@ -266,6 +272,17 @@ error_t phy_init();
 error_t phy_start_rx(channel_id_t *channel, syncword_class_t syncword_class, phy_rx_packet_callback_t rx_cb);
 error_t phy_stop_rx();
 
+/* \brief Sets a callback which receives every frame before the PHY removes the PN9 whitening and the FEC
+ *
+ * The callback is called from interrupt context with the frame as read from the radio, including any bit errors, and
+ * with the rx metadata, the channel and the syncword class filled in. It should not modify or free the packet, which
+ * is decoded and passed to the rx callback afterwards. When HAL_RADIO_USE_HW_DC_FREE or HAL_RADIO_USE_HW_FEC is
+ * defined the radio already removed the whitening or the FEC.
+ *
+ * \param raw_rx_cb  The callback, or NULL to remove it
+ */
+void phy_set_raw_rx_callback(phy_rx_packet_callback_t raw_rx_cb);
+
 /** \brief Start the energy scan sequence on the radio.
  *
  * \param channel_id   The channel to perform the energy scan on.
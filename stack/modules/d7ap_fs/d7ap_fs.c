@@ -21,6 +21,7 @@
  */
 
 #include "modules_defs.h"
+#include "MODULE_D7AP_FS_defs.h"
 #include "string.h"
 #include "debug.h"
 #include "fs.h"
@@ -33,6 +34,9 @@
 #include "version.h"
 #include "key.h"
 #include "log.h"
+#include "ng.h"
+#include "scheduler.h"
+#include "timer.h"
 
 ///////////////////////////////////////
 // The d7a file header is concatenated with the file data.
@@ -70,6 +74,301 @@ static inline bool is_file_defined(uint8_t file_id)
     return (stat != NULL);
 }
 
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+///////////////////////////////////////
+// Cache
+// The decoded file headers are cached, so the header does not need to be read from the blockdevice before
+// every access. The data of the files written often by the stack itself (the status files) is kept in RAM
+// as well and only written back after MODULE_D7AP_FS_WRITEBACK_DELAY seconds or when d7ap_fs_flush() is
+// called, consecutive writes are coalesced in a single dirty range per file. Only the persistence is deferred,
+// the file modified callbacks run when the file is written. All other files, including
+// the security files, are written through.
+///////////////////////////////////////
+
+#define WRITEBACK_FILES_MAX 2
+#define NO_FILE 0xFF
+
+typedef enum {
+  CACHE_POLICY_WRITE_THROUGH,
+  CACHE_POLICY_WRITE_BACK,
+} cache_policy_t;
+
+typedef struct {
+  uint8_t file_id;
+  uint16_t offset; // in the writeback buffer
+  uint16_t length;
+  uint16_t dirty_start;
+  uint16_t dirty_end; // dirty_start == dirty_end when clean
+} writeback_file_t;
+
+static d7ap_fs_file_header_t NGDEF(cached_headers)[FRAMEWORK_FS_FILE_COUNT];
+static uint8_t NGDEF(cached_header_valid)[(FRAMEWORK_FS_FILE_COUNT + 7) / 8];
+
+static uint8_t NGDEF(writeback_buffer)[MODULE_D7AP_FS_WRITEBACK_BUFFER_SIZE];
+static uint16_t NGDEF(writeback_buffer_used);
+static writeback_file_t NGDEF(writeback_files)[WRITEBACK_FILES_MAX];
+static uint8_t NGDEF(writeback_file_count);
+static bool NGDEF(writeback_scheduled);
+
+static d7ap_fs_cache_stats_t NGDEF(cache_stats);
+
+static cache_policy_t get_cache_policy(uint8_t file_id)
+{
+  switch(file_id)
+  {
+    case D7A_FILE_PHY_STATUS_FILE_ID: // noise floor of the scanned channels, updated every background scan
+    case D7A_FILE_DLL_STATUS_FILE_ID:
+      return CACHE_POLICY_WRITE_BACK;
+    default:
+      return CACHE_POLICY_WRITE_THROUGH;
+  }
+}
+
+static inline bool is_header_cached(uint8_t file_id)
+{
+  return NG(cached_header_valid)[file_id / 8] & (1 << (file_id % 8));
+}
+
+static void cache_header(uint8_t file_id, const d7ap_fs_file_header_t* file_header)
+{
+  NG(cached_headers)[file_id] = *file_header;
+  NG(cached_header_valid)[file_id / 8] |= (1 << (file_id % 8));
+}
+
+static writeback_file_t* get_writeback_file(uint8_t file_id)
+{
+  for(uint8_t i = 0; i < NG(writeback_file_count); i++)
+  {
+    if(NG(writeback_files)[i].file_id == file_id)
+      return &NG(writeback_files)[i];
+  }
+
+  return NULL;
+}
+
+static void flush_writeback_file(writeback_file_t* wb_file)
+{
+  if(wb_file->dirty_start == wb_file->dirty_end)
+    return;
+
+  uint16_t dirty_length = wb_file->dirty_end - wb_file->dirty_start;
+  // the file modified callbacks already ran when the file was written
+  fs_persist_file(wb_file->file_id, sizeof(d7ap_fs_file_header_t) + wb_file->dirty_start,
+                  NG(writeback_buffer) + wb_file->offset + wb_file->dirty_start, dirty_length);
+
+  NG(cache_stats).writes_saved--;
+  NG(cache_stats).bytes_saved -= dirty_length;
+  NG(cache_stats).flushes++;
+  wb_file->dirty_start = wb_file->dirty_end = 0;
+}
+
+static void writeback(void *arg)
+{
+  (void)arg;
+  d7ap_fs_flush();
+}
+
+/* returns the file in the writeback buffer, loading it when needed, or NULL when the file is written through */
+static writeback_file_t* load_writeback_file(uint8_t file_id, uint32_t length)
+{
+  if(get_cache_policy(file_id) != CACHE_POLICY_WRITE_BACK)
+    return NULL;
+
+  writeback_file_t* wb_file = get_writeback_file(file_id);
+  if(wb_file)
+    return wb_file;
+
+  if(NG(writeback_file_count) == WRITEBACK_FILES_MAX ||
+     NG(writeback_buffer_used) + length > MODULE_D7AP_FS_WRITEBACK_BUFFER_SIZE)
+    return NULL; // does not fit, write through
+
+  wb_file = &NG(writeback_files)[NG(writeback_file_count)];
+  if(fs_read_file(file_id, sizeof(d7ap_fs_file_header_t), NG(writeback_buffer) + NG(writeback_buffer_used), length) != 0)
+    return NULL;
+
+  wb_file->file_id = file_id;
+  wb_file->offset = NG(writeback_buffer_used);
+  wb_file->length = length;
+  wb_file->dirty_start = wb_file->dirty_end = 0;
+  NG(writeback_buffer_used) += length;
+  NG(writeback_file_count)++;
+  return wb_file;
+}
+
+void d7ap_fs_flush()
+{
+  if(NG(writeback_scheduled))
+  {
+    timer_cancel_task(&writeback);
+    NG(writeback_scheduled) = false;
+  }
+
+  for(uint8_t i = 0; i < NG(writeback_file_count); i++)
+    flush_writeback_file(&NG(writeback_files)[i]);
+}
+
+const d7ap_fs_cache_stats_t* d7ap_fs_get_cache_stats()
+{
+  return &NG(cache_stats);
+}
+
+/* the writeback buffer was sized for the allocated length of the file when it was loaded. When the length changes
+   the pending data is written and the buffer is emptied, the files are loaded again by the next write. */
+static void revalidate_writeback_file(uint8_t file_id, uint32_t allocated_length)
+{
+  writeback_file_t* wb_file = get_writeback_file(file_id);
+  if(wb_file == NULL || wb_file->length == allocated_length)
+    return;
+
+  d7ap_fs_flush();
+  NG(writeback_buffer_used) = 0;
+  NG(writeback_file_count) = 0;
+}
+
+static void cache_init()
+{
+  d7ap_fs_flush();
+  memset(NG(cached_header_valid), 0, sizeof(NG(cached_header_valid)));
+  NG(writeback_buffer_used) = 0;
+  NG(writeback_file_count) = 0;
+  sched_register_task(&writeback);
+}
+#else
+void d7ap_fs_flush()
+{
+}
+
+const d7ap_fs_cache_stats_t* d7ap_fs_get_cache_stats()
+{
+  static const d7ap_fs_cache_stats_t no_stats = { 0 };
+  return &no_stats;
+}
+#endif // MODULE_D7AP_FS_CACHE_ENABLED
+
+#if defined(FRAMEWORK_SCHED_PROFILING) || defined(FRAMEWORK_PERF_COUNTERS)
+///////////////////////////////////////
+// Generated files
+// The scheduler profile and performance counter files are not stored, their content is generated from the
+// live data when read.
+///////////////////////////////////////
+
+static uint8_t* put_uint32_be(uint8_t* ptr, uint32_t value)
+{
+  *ptr++ = value >> 24;
+  *ptr++ = value >> 16;
+  *ptr++ = value >> 8;
+  *ptr++ = value;
+  return ptr;
+}
+
+static void get_generated_file_header(d7ap_fs_file_header_t* file_header, uint32_t length)
+{
+  *file_header = (d7ap_fs_file_header_t) {
+    .file_permissions = 0x24, // user and guest readable
+    .file_properties.storage_class = FS_STORAGE_VOLATILE,
+    .action_file_id = 0xFF,
+    .interface_file_id = 0xFF,
+    .length = length,
+    .allocated_length = length
+  };
+}
+#endif
+
+#ifdef FRAMEWORK_SCHED_PROFILING
+// the scheduler profile is generated one part (the header or a task record) at a time, so the whole profile
+// does not need to fit in the file buffer
+
+static uint32_t get_sched_profile_file_length()
+{
+  return D7A_FILE_SCHED_PROFILE_HEADER_SIZE + sched_get_task_count() * D7A_FILE_SCHED_PROFILE_TASK_SIZE;
+}
+
+static uint16_t generate_sched_profile_header(uint8_t* buffer)
+{
+  const sched_profile_t* profile = sched_get_profile();
+  uint8_t* ptr = buffer;
+  *ptr++ = D7A_FILE_SCHED_PROFILE_VERSION;
+  *ptr++ = sched_get_task_count();
+  *ptr++ = sizeof(profile->queue_high_watermark);
+  *ptr++ = SCHED_PROFILE_HISTOGRAM_BUCKETS;
+  ptr = put_uint32_be(ptr, timer_get_counter_value() - profile->start_time);
+  ptr = put_uint32_be(ptr, profile->lowpower_time);
+  ptr = put_uint32_be(ptr, profile->lowpower_count);
+  memcpy(ptr, profile->queue_high_watermark, sizeof(profile->queue_high_watermark));
+  ptr += sizeof(profile->queue_high_watermark);
+  return ptr - buffer;
+}
+
+static uint16_t generate_sched_profile_task(sched_task_handle_t handle, uint8_t* buffer)
+{
+  const sched_task_profile_t* task_profile = sched_get_task_profile(handle);
+  uint8_t* ptr = buffer;
+  ptr = put_uint32_be(ptr, (uint32_t)(uintptr_t) sched_get_task(handle)); // for looking up the name in the ELF file
+  ptr = put_uint32_be(ptr, task_profile->invocations);
+  ptr = put_uint32_be(ptr, task_profile->total_run_time);
+  ptr = put_uint32_be(ptr, task_profile->max_run_time);
+  ptr = put_uint32_be(ptr, task_profile->total_latency);
+  ptr = put_uint32_be(ptr, task_profile->max_latency);
+  for(uint8_t i = 0; i < SCHED_PROFILE_HISTOGRAM_BUCKETS; i++)
+  {
+    *ptr++ = task_profile->run_time_histogram[i] >> 8;
+    *ptr++ = task_profile->run_time_histogram[i];
+  }
+
+  return ptr - buffer;
+}
+
+static int read_sched_profile_file(uint32_t offset, uint8_t* buffer, uint32_t length)
+{
+  if(get_sched_profile_file_length() < offset + length)
+    return -EINVAL;
+
+  uint32_t part_offset = 0;
+  uint8_t task_count = sched_get_task_count();
+  for(int16_t part = -1; part < task_count && length > 0; part++)
+  {
+    uint16_t part_length = part < 0 ? D7A_FILE_SCHED_PROFILE_HEADER_SIZE : D7A_FILE_SCHED_PROFILE_TASK_SIZE;
+    if(offset < part_offset + part_length)
+    {
+      if(part < 0)
+        generate_sched_profile_header(file_buffer);
+      else
+        generate_sched_profile_task(part, file_buffer);
+
+      uint16_t start = offset - part_offset;
+      uint16_t copy_length = part_length - start;
+      if(copy_length > length)
+        copy_length = length;
+
+      memcpy(buffer, file_buffer + start, copy_length);
+      buffer += copy_length;
+      offset += copy_length;
+      length -= copy_length;
+    }
+
+    part_offset += part_length;
+  }
+
+  return 0;
+}
+#endif // FRAMEWORK_SCHED_PROFILING
+
+#ifdef FRAMEWORK_PERF_COUNTERS
+static int read_perf_counters_file(uint32_t offset, uint8_t* buffer, uint32_t length)
+{
+  if(D7A_FILE_PERF_COUNTERS_SIZE < offset + length)
+    return -EINVAL;
+
+  const uint32_t* counters = (const uint32_t*) perf_counters_get();
+  uint8_t* ptr = file_buffer;
+  for(uint8_t i = 0; i < D7A_FILE_PERF_COUNTERS_SIZE / sizeof(uint32_t); i++)
+    ptr = put_uint32_be(ptr, counters[i]);
+
+  memcpy(buffer, file_buffer + offset, length);
+  return 0;
+}
+#endif // FRAMEWORK_PERF_COUNTERS
+
 #if defined(MODULE_ALP) && defined(MODULE_D7AP)
 static void execute_d7a_action_protocol(uint8_t action_file_id, uint8_t interface_file_id)
 {
@@ -94,6 +393,10 @@ void d7ap_fs_init()
   //init fs with the D7A specific system files
   fs_init();
 
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+  cache_init();
+#endif
+
   // TODO platform specific
   // TODO set FW version
 
@@ -138,6 +441,11 @@ int d7ap_fs_init_file(uint8_t file_id, const d7ap_fs_file_header_t* file_header,
 
   rtc = fs_init_file(file_id, file_header->file_properties.storage_class,
                      (const uint8_t *)file_buffer, sizeof(d7ap_fs_file_header_t) + file_header->allocated_length);
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+  if(rtc == 0)
+    cache_header(file_id, file_header);
+#endif
+
   return rtc;
 }
 
@@ -148,6 +456,15 @@ int d7ap_fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_
 
   DPRINT("FS RD %i\n", file_id);
 
+#ifdef FRAMEWORK_SCHED_PROFILING
+  if(file_id == D7A_FILE_SCHED_PROFILE_FILE_ID)
+    return read_sched_profile_file(offset, buffer, length);
+#endif
+#ifdef FRAMEWORK_PERF_COUNTERS
+  if(file_id == D7A_FILE_PERF_COUNTERS_FILE_ID)
+    return read_perf_counters_file(offset, buffer, length);
+#endif
+
   if(!is_file_defined(file_id)) return -ENOENT;
 
   rtc = d7ap_fs_read_file_header(file_id, &header);
@@ -157,9 +474,17 @@ int d7ap_fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_
   if(header.length < offset + length)
     return -EINVAL;
 
-  rtc = fs_read_file(file_id, sizeof(d7ap_fs_file_header_t) + offset, buffer, length);
-  if (rtc != 0)
-    return rtc;
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+  writeback_file_t* wb_file = get_writeback_file(file_id);
+  if(wb_file && offset + length <= wb_file->length)
+    memcpy(buffer, NG(writeback_buffer) + wb_file->offset + offset, length);
+  else
+#endif
+  {
+    rtc = fs_read_file(file_id, sizeof(d7ap_fs_file_header_t) + offset, buffer, length);
+    if (rtc != 0)
+      return rtc;
+  }
 
 #if defined(MODULE_ALP) && defined(MODULE_D7AP)
   if(header.file_properties.action_protocol_enabled == true
@@ -175,8 +500,32 @@ int d7ap_fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_
 int d7ap_fs_read_file_header(uint8_t file_id, d7ap_fs_file_header_t* file_header)
 {
   int rtc;
+#ifdef FRAMEWORK_SCHED_PROFILING
+  if(file_id == D7A_FILE_SCHED_PROFILE_FILE_ID)
+  {
+    get_generated_file_header(file_header, get_sched_profile_file_length());
+    return 0;
+  }
+#endif
+#ifdef FRAMEWORK_PERF_COUNTERS
+  if(file_id == D7A_FILE_PERF_COUNTERS_FILE_ID)
+  {
+    get_generated_file_header(file_header, D7A_FILE_PERF_COUNTERS_SIZE);
+    return 0;
+  }
+#endif
+
   if(!is_file_defined(file_id)) return -ENOENT;
 
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+  if(is_header_cached(file_id))
+  {
+    *file_header = NG(cached_headers)[file_id];
+    NG(cache_stats).header_reads_saved++;
+    return 0;
+  }
+#endif
+
   rtc = fs_read_file(file_id, 0, (uint8_t *)file_header, sizeof(d7ap_fs_file_header_t));
   if (rtc != 0)
     return rtc;
@@ -187,6 +536,10 @@ int d7ap_fs_read_file_header(uint8_t file_id, d7ap_fs_file_header_t* file_header
   file_header->allocated_length = __builtin_bswap32(file_header->allocated_length);
 #endif
 
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+  cache_header(file_id, file_header);
+#endif
+
   return 0;
 }
 
@@ -194,6 +547,11 @@ int d7ap_fs_write_file_header(uint8_t file_id, d7ap_fs_file_header_t* file_heade
 {
   if(!is_file_defined(file_id)) return -ENOENT;
 
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+  revalidate_writeback_file(file_id, file_header->allocated_length);
+  cache_header(file_id, file_header);
+#endif
+
   // Input of data shall be in big-endian ordering
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
   file_header->length = __builtin_bswap32(file_header->length);
@@ -210,6 +568,21 @@ int d7ap_fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer,
 
   DPRINT("FS WR %i\n", file_id);
 
+#ifdef FRAMEWORK_SCHED_PROFILING
+  if(file_id == D7A_FILE_SCHED_PROFILE_FILE_ID)
+  {
+    sched_reset_profile();
+    return 0;
+  }
+#endif
+#ifdef FRAMEWORK_PERF_COUNTERS
+  if(file_id == D7A_FILE_PERF_COUNTERS_FILE_ID)
+  {
+    perf_counters_reset();
+    return 0;
+  }
+#endif
+
   if(!is_file_defined(file_id)) return -ENOENT;
 
   rtc = d7ap_fs_read_file_header(file_id, &header);
@@ -219,9 +592,43 @@ int d7ap_fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer,
   if(header.allocated_length < offset + length)
     return -EINVAL;
 
-  rtc = fs_write_file(file_id, sizeof(d7ap_fs_file_header_t) + offset, buffer, length);
-  if (rtc != 0)
-    return rtc;
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+  writeback_file_t* wb_file = load_writeback_file(file_id, header.allocated_length);
+  if(wb_file)
+  {
+    memcpy(NG(writeback_buffer) + wb_file->offset + offset, buffer, length);
+    if(wb_file->dirty_start == wb_file->dirty_end)
+    {
+      wb_file->dirty_start = offset;
+      wb_file->dirty_end = offset + length;
+    }
+    else
+    {
+      if(offset < wb_file->dirty_start)
+        wb_file->dirty_start = offset;
+
+      if(offset + length > wb_file->dirty_end)
+        wb_file->dirty_end = offset + length;
+    }
+
+    NG(cache_stats).writes_saved++;
+    NG(cache_stats).bytes_saved += length;
+    if(!NG(writeback_scheduled))
+    {
+      NG(writeback_scheduled) = true;
+      timer_post_task_delay(&writeback, MODULE_D7AP_FS_WRITEBACK_DELAY * TIMER_TICKS_PER_SEC);
+    }
+
+    // only the persistence is deferred, listeners see the new content immediately
+    fs_notify_file_modified(file_id);
+  }
+  else
+#endif
+  {
+    rtc = fs_write_file(file_id, sizeof(d7ap_fs_file_header_t) + offset, buffer, length);
+    if (rtc != 0)
+      return rtc;
+  }
 
 
 #if defined(MODULE_ALP) && defined(MODULE_D7AP)
@@ -273,55 +680,69 @@ int d7ap_fs_write_nwl_security(dae_nwl_security_t *nwl_security)
 
 int d7ap_fs_read_nwl_security_state_register(dae_nwl_ssr_t *node_security_state)
 {
-  int rtc;
-
   if(!is_file_defined(D7A_FILE_NWL_SECURITY_STATE_REG)) return -ENOENT;
 
-  rtc = (d7ap_fs_read_file(D7A_FILE_NWL_SECURITY_STATE_REG, 0,
-                           (uint8_t*)node_security_state, sizeof(dae_nwl_ssr_t)));
-  if (rtc != 0)
-    return rtc;
+  return (d7ap_fs_read_file(D7A_FILE_NWL_SECURITY_STATE_REG, 0, (uint8_t*)node_security_state,
+                            D7A_FILE_NWL_SECURITY_STATE_REG_HEADER_SIZE));
+}
 
-   // correct endiannes
-  for(uint8_t i = 0; i < node_security_state->trusted_node_nb; i++)
-  {
-    node_security_state->trusted_node_table[i].frame_counter = (uint32_t)__builtin_bswap32(node_security_state->trusted_node_table[i].frame_counter);
-  }
+int d7ap_fs_write_nwl_security_state_register(const dae_nwl_ssr_t *node_security_state)
+{
+  if(!is_file_defined(D7A_FILE_NWL_SECURITY_STATE_REG)) return -ENOENT;
 
-  return rtc;
+  return (d7ap_fs_write_file(D7A_FILE_NWL_SECURITY_STATE_REG, 0, (const uint8_t*)node_security_state,
+                             D7A_FILE_NWL_SECURITY_STATE_REG_HEADER_SIZE));
 }
 
-static int write_security_state_register_entry(dae_nwl_trusted_node_t *trusted_node, uint8_t trusted_node_nb)
+uint16_t d7ap_fs_get_nwl_security_state_register_capacity(void)
 {
-  assert(trusted_node_nb <= FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE);
+  if(!is_file_defined(D7A_FILE_NWL_SECURITY_STATE_REG)) return 0;
 
-  uint16_t entry_offset = (D7A_FILE_NWL_SECURITY_SIZE + D7A_FILE_UID_SIZE)*(trusted_node_nb - 1) + 2;
-  // correct endiannes before writing
-  dae_nwl_trusted_node_t node;
-  memcpy(&node, trusted_node, sizeof(dae_nwl_trusted_node_t));
-  node.frame_counter = __builtin_bswap32(node.frame_counter);
-  return (d7ap_fs_write_file(D7A_FILE_NWL_SECURITY, entry_offset, (uint8_t*)&node, sizeof(dae_nwl_trusted_node_t)));
+  uint32_t length = d7ap_fs_get_file_length(D7A_FILE_NWL_SECURITY_STATE_REG);
+  if(length < D7A_FILE_NWL_SECURITY_STATE_REG_HEADER_SIZE)
+    return 0;
+
+  length = (length - D7A_FILE_NWL_SECURITY_STATE_REG_HEADER_SIZE) / D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE;
+  return length > UINT16_MAX ? UINT16_MAX : length;
 }
 
-int d7ap_fs_add_nwl_security_state_register_entry(dae_nwl_trusted_node_t *trusted_node,
-                                                  uint8_t trusted_node_nb)
+// the entries are stored as key counter, frame counter (big endian) and address
+static inline uint32_t get_security_state_register_entry_offset(uint16_t index)
 {
-  // TODO test
-  assert(trusted_node_nb <= FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE);
+  return D7A_FILE_NWL_SECURITY_STATE_REG_HEADER_SIZE + (uint32_t)index * D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE;
+}
+
+int d7ap_fs_read_nwl_security_state_register_entry(uint16_t index, dae_nwl_trusted_node_t *trusted_node)
+{
+  uint8_t entry[D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE];
+  int rtc;
+
   if(!is_file_defined(D7A_FILE_NWL_SECURITY_STATE_REG)) return -ENOENT;
 
-  // first add the new entry ...
-  write_security_state_register_entry(trusted_node, trusted_node_nb);
-  // ... and finally update the node count
-  return (d7ap_fs_write_file(D7A_FILE_NWL_SECURITY, 1, &trusted_node_nb, 1));
+  rtc = d7ap_fs_read_file(D7A_FILE_NWL_SECURITY_STATE_REG, get_security_state_register_entry_offset(index),
+                          entry, D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE);
+  if (rtc != 0)
+    return rtc;
+
+  trusted_node->key_counter = entry[0];
+  memcpy(&trusted_node->frame_counter, entry + 1, sizeof(uint32_t));
+  trusted_node->frame_counter = __builtin_bswap32(trusted_node->frame_counter); // correct endianess
+  memcpy(trusted_node->addr, entry + D7A_FILE_NWL_SECURITY_SIZE, D7A_FILE_UID_SIZE);
+  return 0;
 }
 
-int d7ap_fs_update_nwl_security_state_register(dae_nwl_trusted_node_t *trusted_node,
-                                               uint8_t trusted_node_index)
+int d7ap_fs_write_nwl_security_state_register_entry(uint16_t index, const dae_nwl_trusted_node_t *trusted_node)
 {
+  uint8_t entry[D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE];
+  uint32_t frame_counter = __builtin_bswap32(trusted_node->frame_counter); // correct endianess
+
   if(!is_file_defined(D7A_FILE_NWL_SECURITY_STATE_REG)) return -ENOENT;
 
-  return (write_security_state_register_entry(trusted_node, trusted_node_index));
+  entry[0] = trusted_node->key_counter;
+  memcpy(entry + 1, &frame_counter, sizeof(uint32_t));
+  memcpy(entry + D7A_FILE_NWL_SECURITY_SIZE, trusted_node->addr, D7A_FILE_UID_SIZE);
+  return (d7ap_fs_write_file(D7A_FILE_NWL_SECURITY_STATE_REG, get_security_state_register_entry_offset(index),
+                             entry, D7A_FILE_NWL_SECURITY_STATE_REG_ENTRY_SIZE));
 }
 
 int d7ap_fs_read_access_class(uint8_t access_class_index, dae_access_profile_t *access_class)
@@ -207,12 +207,32 @@ static const unsigned char ctr_ct[CTR_TEST_VECTORS_NB][36] =
 
 static const int ctr_len[CTR_TEST_VECTORS_NB] = { 16, 32, 36 };
 
+/*
+ * AES-ECB test vector from FIPS-197, appendix C.1
+ */
+static const uint8_t ecb_key[AES_BLOCK_SIZE] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+static const uint8_t ecb_pt[AES_BLOCK_SIZE] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+};
+
+static const uint8_t ecb_ct[AES_BLOCK_SIZE] = {
+    0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30,
+    0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A
+};
+
 int main(int argc, char *argv[])
 {
     int i;
     error_t ret;
     uint8_t ctr[AES_BLOCK_SIZE];
     uint8_t payload[AES_BLOCK_SIZE * 3];
+    aes128_ctx_t ctr_ctx;
+    aes128_ctx_t ccm_ctx;
 
     DPRINT("Unit-tests for AES-CTR / AES-CCM mode \n");
 
@@ -288,6 +308,74 @@ int main(int argc, char *argv[])
         DPRINT("AES-CCM test vector #%d passed\n", i + 1);
     }
 
+    /* test the AES-ECB block functions */
+    aes128_init(&ctr_ctx, ecb_key);
+    aes128_encrypt_block(&ctr_ctx, ecb_pt, payload);
+    if (memcmp(payload, ecb_ct, AES_BLOCK_SIZE) != 0)
+    {
+        DPRINT("AES-ECB encryption failed\n");
+        return -1;
+    }
+
+    aes128_decrypt_block(&ctr_ctx, payload, payload);
+    if (memcmp(payload, ecb_pt, AES_BLOCK_SIZE) != 0)
+    {
+        DPRINT("AES-ECB decryption failed\n");
+        return -1;
+    }
+
+    DPRINT("AES-ECB test vector passed\n");
+
+    /* test two contexts with a different key used alternately */
+    aes128_init(&ccm_ctx, ccm_key);
+    for (i = 0; i < CTR_TEST_VECTORS_NB; i++)
+    {
+        aes128_init(&ctr_ctx, ctr_key[i]);
+
+        memcpy(payload, ccm_pt + ccm_offset[i], ccm_len[i]);
+        memcpy(ctr, ccm_ctr[i], AES_BLOCK_SIZE);
+        ret = aes128_ccm_encrypt(&ccm_ctx, payload, ccm_len[i], ccm_iv[i], ad, add_len[i],
+                                 ctr, CCM_AUTH_LEN);
+        if (ret != 0 || memcmp(payload, ccm_ct[i], ccm_len[i] + CCM_AUTH_LEN) != 0)
+        {
+            DPRINT("AES-CCM encryption with context #%d failed\n", i + 1);
+            return -1;
+        }
+
+        memcpy(payload, ctr_pt[i], ctr_len[i]);
+        memcpy(ctr, ctr_blk[i], AES_BLOCK_SIZE);
+        aes128_ctr_encrypt(&ctr_ctx, payload, payload, ctr_len[i], ctr);
+        if (memcmp(payload, ctr_ct[i], ctr_len[i]) != 0)
+        {
+            DPRINT("AES-CTR encryption with context #%d failed\n", i + 1);
+            return -1;
+        }
+
+        memcpy(payload, ccm_ct[i], ccm_len[i] + CCM_AUTH_LEN);
+        memcpy(ctr, ccm_ctr[i], AES_BLOCK_SIZE);
+        ret = aes128_ccm_decrypt(&ccm_ctx, payload, ccm_len[i], ccm_iv[i], ad, add_len[i],
+                                 ctr, payload + ccm_len[i], CCM_AUTH_LEN);
+        if (ret != 0 || memcmp(payload, ccm_pt + ccm_offset[i], ccm_len[i]) != 0)
+        {
+            DPRINT("AES-CCM decryption with context #%d failed\n", i + 1);
+            return -1;
+        }
+
+        /* a modified tag should be rejected */
+        memcpy(payload, ccm_ct[i], ccm_len[i] + CCM_AUTH_LEN);
+        payload[ccm_len[i]] ^= 0x01;
+        memcpy(ctr, ccm_ctr[i], AES_BLOCK_SIZE);
+        ret = aes128_ccm_decrypt(&ccm_ctx, payload, ccm_len[i], ccm_iv[i], ad, add_len[i],
+                                 ctr, payload + ccm_len[i], CCM_AUTH_LEN);
+        if (ret == 0)
+        {
+            DPRINT("AES-CCM modified tag #%d not detected\n", i + 1);
+            return -1;
+        }
+    }
+
+    DPRINT("AES contexts test passed\n");
+
     DPRINT("AES all unit tests OK !\n");
     return 0;
 }
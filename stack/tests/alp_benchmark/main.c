@@ -0,0 +1,145 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "alp.h"
+#include "fifo.h"
+#include "errors.h"
+#include "debug.h"
+
+/*
+ * Benchmark of the ALP parser on the NATIVE platform.
+ *
+ * A mix of commands as handled by a gateway is parsed with alp_parse_command(), which locates all actions in a
+ * single pass, and with alp_get_expected_response_length() which only determines the response length. The
+ * traffic consists of sensor data pushed by the nodes, and of requests from the host which are forwarded over D7ASP.
+ */
+
+#define ITERATIONS 1000000
+#define COMMAND_COUNT 4
+
+static uint8_t commands[COMMAND_COUNT][ALP_PAYLOAD_MAX_SIZE];
+static uint8_t command_lengths[COMMAND_COUNT];
+
+static uint64_t get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void build_commands()
+{
+    fifo_t fifo;
+    uint8_t data[16] = { 0 };
+    alp_interface_config_t itf_config = (alp_interface_config_t){
+        .itf_id = ALP_ITF_ID_D7ASP,
+        .d7ap_session_config = {
+            .qos = { .qos_resp_mode = SESSION_RESP_MODE_PREFERRED },
+            .addressee = {
+                .ctrl = { .nls_method = AES_NONE, .id_type = ID_TYPE_UID },
+                .access_class = 0x01,
+                .id = { 0xAA, 0, 0, 0, 0, 0, 0, 0x01 }
+            }
+        }
+    };
+
+    // unsolicited sensor data, as pushed by the nodes
+    fifo_init(&fifo, commands[0], ALP_PAYLOAD_MAX_SIZE);
+    alp_append_return_file_data_action(&fifo, 0x40, 0, 3, data);
+    command_lengths[0] = fifo_get_size(&fifo);
+
+    // read a sensor file of a node
+    fifo_init(&fifo, commands[1], ALP_PAYLOAD_MAX_SIZE);
+    alp_append_forward_action(&fifo, &itf_config, sizeof(itf_config));
+    alp_append_tag_request_action(&fifo, 1, true);
+    alp_append_read_file_data_action(&fifo, 0x40, 0, 8, true, false);
+    command_lengths[1] = fifo_get_size(&fifo);
+
+    // configure a node
+    fifo_init(&fifo, commands[2], ALP_PAYLOAD_MAX_SIZE);
+    alp_append_forward_action(&fifo, &itf_config, sizeof(itf_config));
+    alp_append_tag_request_action(&fifo, 2, true);
+    alp_append_write_file_data_action(&fifo, 0x41, 0, sizeof(data), data, true, false);
+    command_lengths[2] = fifo_get_size(&fifo);
+
+    // read the identification files of the gateway itself
+    fifo_init(&fifo, commands[3], ALP_PAYLOAD_MAX_SIZE);
+    alp_append_tag_request_action(&fifo, 3, true);
+    alp_append_read_file_data_action(&fifo, 0x00, 0, 8, true, false);
+    alp_append_read_file_data_action(&fifo, 0x02, 0, 4, true, false);
+    alp_append_read_file_data_action(&fifo, 0x0A, 0, 7, true, false);
+    command_lengths[3] = fifo_get_size(&fifo);
+}
+
+static void bench_parse()
+{
+    alp_command_desc_t parsed;
+    uint32_t action_count = 0;
+    uint64_t start = get_time_ns();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        uint8_t c = i % COMMAND_COUNT;
+        alp_status_codes_t status = alp_parse_command(&parsed, commands[c], command_lengths[c], 0);
+        assert(status == ALP_STATUS_OK);
+        action_count += parsed.action_count;
+    }
+
+    uint64_t duration = get_time_ns() - start;
+    printf("alp_parse_command():                %10.0f commands/s, %6.1f ns/command, %u actions\n",
+           ITERATIONS * 1e9 / duration, (double)duration / ITERATIONS, action_count);
+
+    volatile uint32_t response_length = 0;
+    start = get_time_ns();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        uint8_t c = i % COMMAND_COUNT;
+        response_length += alp_get_expected_response_length(commands[c], command_lengths[c]);
+    }
+
+    duration = get_time_ns() - start;
+    printf("alp_get_expected_response_length(): %10.0f commands/s, %6.1f ns/command\n",
+           ITERATIONS * 1e9 / duration, (double)duration / ITERATIONS);
+}
+
+static void check_commands()
+{
+    // the response to the gateway command contains 3 return file data actions, the forwarded commands expect one
+    alp_command_desc_t parsed;
+    assert(alp_parse_command(&parsed, commands[3], command_lengths[3], 0) == ALP_STATUS_OK);
+    assert(parsed.action_count == 4 && parsed.expected_response_length == 3 * 4 + 8 + 4 + 7);
+
+    assert(alp_parse_command(&parsed, commands[1], command_lengths[1], 0) == ALP_STATUS_OK);
+    assert(parsed.action_count == 3 && parsed.actions[0].ctrl.operation == ALP_OP_FORWARD);
+    assert(parsed.actions[0].length == 4 + 8 && alp_get_remaining_response_length(&parsed, 1) == 4 + 8);
+
+    // an incomplete action is not returned
+    assert(alp_parse_command(&parsed, commands[0], command_lengths[0] - 1, 0) == ALP_STATUS_INCOMPLETE_OPERAND);
+    assert(parsed.action_count == 0);
+}
+
+void bootstrap()
+{
+    build_commands();
+    check_commands();
+
+    printf("Benchmarking ALP parser with %i iterations\n", ITERATIONS);
+    bench_parse();
+    exit(0);
+}
@@ -0,0 +1,262 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alp.h"
+#include "errors.h"
+
+/*
+ * Tests the single pass ALP parser, alp_parse_command(), using the encodings of the actions as they are received:
+ * the operands located for each supported action type, truncated and malformed commands, commands with more
+ * actions than are stored at once and the expected response length.
+ */
+
+#define check(condition) do { \
+    if(!(condition)) { \
+        printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        exit(1); \
+    } \
+} while(0)
+
+#define FILE_HEADER 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x10
+
+#define TEST_ITF_ID 0x42
+#define TEST_ITF_CFG_LEN 3
+
+typedef struct
+{
+    const char* name;
+    uint8_t command[20];
+    uint8_t size;
+    alp_operation_t operation;
+    uint8_t id;
+    uint8_t query_code;
+    uint8_t data;                   // relative to the start of the action
+    uint32_t offset;
+    uint32_t length;
+    uint8_t response_length;
+} encoding_t;
+
+static const encoding_t encodings[] = {
+    { "read file data", { 0x41, 0x40, 0x00, 0x08 }, 4, ALP_OP_READ_FILE_DATA, 0x40, 0, 0, 0, 8, 2 + 1 + 1 + 8 },
+    { "read file data, 2 byte operands", { 0x41, 0x40, 0x41, 0x23, 0x40, 0x64 }, 6, ALP_OP_READ_FILE_DATA, 0x40, 0, 0,
+      0x123, 100, 2 + 2 + 2 + 100 },
+    { "read file properties", { 0x02, 0x40 }, 2, ALP_OP_READ_FILE_PROPERTIES, 0x40, 0, 0, 0, 0, 0 },
+    { "write file data", { 0x04, 0x40, 0x05, 0x03, 0x0A, 0x0B, 0x0C }, 7, ALP_OP_WRITE_FILE_DATA, 0x40, 0, 4, 5, 3, 0 },
+    { "write file properties", { 0x06, 0x40, FILE_HEADER }, 14, ALP_OP_WRITE_FILE_PROPERTIES, 0x40, 0, 2, 0, 12, 0 },
+    { "create file", { 0x11, 0x41, FILE_HEADER }, 14, ALP_OP_CREATE_FILE, 0x41, 0, 2, 0, 12, 0 },
+    { "return file data", { 0x20, 0x40, 0x00, 0x02, 0x12, 0x34 }, 6, ALP_OP_RETURN_FILE_DATA, 0x40, 0, 4, 0, 2, 0 },
+    { "return file properties", { 0x21, 0x40, FILE_HEADER }, 14, ALP_OP_RETURN_FILE_PROPERTIES, 0x40, 0, 2, 0, 12, 0 },
+    { "break query", { 0x09, 0x41, 0x02, 0x12, 0x34, 0x40, 0x03 }, 7, ALP_OP_BREAK_QUERY, 0x40, 0x41, 3, 3, 2, 0 },
+    { "action status", { 0x22, 0x00 }, 2, ALP_OP_STATUS, 0, 0, 1, 0, 1, 0 },
+    { "interface status", { 0x62, 0xD7, 0x03, 0x01, 0x02, 0x03 }, 6, ALP_OP_STATUS, 0xD7, 0, 3, 0, 3, 0 },
+    { "response tag", { 0x23, 0x05 }, 2, ALP_OP_RESPONSE_TAG, 0x05, 0, 0, 0, 0, 0 },
+    { "request tag", { 0xB4, 0x05 }, 2, ALP_OP_REQUEST_TAG, 0x05, 0, 0, 0, 0, 0 },
+    { "forward D7ASP, UID", { 0x32, 0xD7, 0x01, 0x00, 0x20, 0x01, 0xAA, 0, 0, 0, 0, 0, 0, 0x01 }, 14, ALP_OP_FORWARD,
+      0xD7, 0, 2, 0, 4 + 8, 0 },
+    { "forward D7ASP, NBID", { 0x32, 0xD7, 0x01, 0x00, 0x00, 0x01, 0x05 }, 7, ALP_OP_FORWARD, 0xD7, 0, 2, 0, 4 + 1, 0 },
+    { "forward registered interface", { 0x32, TEST_ITF_ID, 0x01, 0x02, 0x03 }, 5, ALP_OP_FORWARD, TEST_ITF_ID, 0, 2, 0,
+      TEST_ITF_CFG_LEN, 0 },
+    { "indirect forward", { 0x33, 0x48 }, 2, ALP_OP_INDIRECT_FORWARD, 0x48, 0, 2, 0, 0, 0 },
+    { "indirect forward, overloaded VID", { 0xB3, 0x48, 0x30, 0x01, 0xAB, 0xCD }, 6, ALP_OP_INDIRECT_FORWARD, 0x48, 0, 2,
+      0, 2 + 2, 0 },
+};
+
+#define ENCODING_COUNT (sizeof(encodings) / sizeof(encodings[0]))
+
+static alp_interface_t test_interface = {
+    .itf_id = TEST_ITF_ID,
+    .itf_cfg_len = TEST_ITF_CFG_LEN,
+};
+
+static void test_action_types()
+{
+    alp_command_desc_t parsed;
+    uint8_t command[32];
+    for(uint8_t i = 0; i < ENCODING_COUNT; i++)
+    {
+        const encoding_t* e = &encodings[i];
+        printf("Testing %s ... ", e->name);
+
+        // preceded by a tag request, so the indices are checked relative to the start of the action
+        command[0] = 0x34;
+        command[1] = 0x01;
+        memcpy(command + 2, e->command, e->size);
+        check(alp_parse_command(&parsed, command, 2 + e->size, 0) == ALP_STATUS_OK);
+        check(parsed.status == ALP_STATUS_OK);
+        check(parsed.action_count == 2 && parsed.end == 2 + e->size);
+        check(parsed.alp_command == command && parsed.length == 2 + e->size);
+
+        const alp_action_desc_t* action = &parsed.actions[1];
+        check(action->ctrl.raw == e->command[0] && action->ctrl.operation == e->operation);
+        check(action->start == 2 && action->size == e->size);
+        // the operands which do not apply to the operation are not set
+        if(e->id)
+            check(action->id == e->id);
+
+        if(e->operation == ALP_OP_BREAK_QUERY)
+            check(action->query_code == e->query_code);
+
+        check(action->offset == e->offset && action->length == e->length);
+        if(e->data)
+            check(action->data == 2 + e->data);
+
+        check(action->response_length == e->response_length);
+        check(parsed.expected_response_length == e->response_length);
+        check(alp_get_expected_response_length(command, 2 + e->size) == e->response_length);
+        printf("Success!\n");
+    }
+}
+
+static void test_truncated()
+{
+    printf("Testing truncated actions ... ");
+    alp_command_desc_t parsed;
+    uint8_t command[32];
+    for(uint8_t i = 0; i < ENCODING_COUNT; i++)
+    {
+        const encoding_t* e = &encodings[i];
+        memcpy(command, encodings[0].command, encodings[0].size);
+        memcpy(command + encodings[0].size, e->command, e->size);
+
+        // every prefix of the action is incomplete, the complete actions before it are still returned
+        for(uint8_t length = 1; length < e->size; length++)
+        {
+            check(alp_parse_command(&parsed, command + encodings[0].size, length, 0) == ALP_STATUS_INCOMPLETE_OPERAND);
+            check(parsed.action_count == 0 && parsed.end == 0 && parsed.expected_response_length == 0);
+
+            check(alp_parse_command(&parsed, command, encodings[0].size + length, 0) == ALP_STATUS_INCOMPLETE_OPERAND);
+            check(parsed.status == ALP_STATUS_INCOMPLETE_OPERAND);
+            check(parsed.action_count == 1 && parsed.end == encodings[0].size);
+            check(parsed.expected_response_length == encodings[0].response_length);
+            check(alp_get_expected_response_length(command, encodings[0].size + length) == encodings[0].response_length);
+        }
+    }
+
+    printf("Success!\n");
+}
+
+static void test_malformed()
+{
+    printf("Testing malformed actions ... ");
+    alp_command_desc_t parsed;
+
+    // a data length operand which exceeds the command, coded in 1 and in 4 bytes
+    uint8_t short_data[] = { 0x04, 0x40, 0x00, 0x3F, 0x01, 0x02 };
+    check(alp_parse_command(&parsed, short_data, sizeof(short_data), 0) == ALP_STATUS_INCOMPLETE_OPERAND);
+    check(parsed.action_count == 0);
+    uint8_t huge_length[] = { 0x04, 0x40, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    check(alp_parse_command(&parsed, huge_length, sizeof(huge_length), 0) == ALP_STATUS_INCOMPLETE_OPERAND);
+    check(parsed.action_count == 0);
+
+    // an operation which is not supported stops the parsing, the actions before it are returned
+    uint8_t unsupported[] = { 0x41, 0x40, 0x00, 0x08, 0x10, 0x40, 0x41, 0x40, 0x00, 0x08 };
+    check(alp_parse_command(&parsed, unsupported, sizeof(unsupported), 0) == ALP_STATUS_UNKNOWN_OPERATION);
+    check(parsed.status == ALP_STATUS_UNKNOWN_OPERATION);
+    check(parsed.action_count == 1 && parsed.end == 4 && parsed.expected_response_length == 12);
+    check(alp_get_expected_response_length(unsupported, sizeof(unsupported)) == 12);
+
+    // the configuration length of an interface which is not registered is unknown
+    uint8_t unknown_itf[] = { 0x32, TEST_ITF_ID + 1, 0x01, 0x02, 0x03 };
+    check(alp_parse_command(&parsed, unknown_itf, sizeof(unknown_itf), 0) == ALP_STATUS_UNKNOWN_ERROR);
+    check(parsed.action_count == 0);
+
+    // an empty command, or a start index at the end of the command
+    check(alp_parse_command(&parsed, unknown_itf, 0, 0) == ALP_STATUS_OK);
+    check(parsed.action_count == 0 && parsed.end == 0 && parsed.expected_response_length == 0);
+    check(alp_parse_command(&parsed, short_data, 4, 4) == ALP_STATUS_OK);
+    check(parsed.action_count == 0 && parsed.end == 4);
+    printf("Success!\n");
+}
+
+static void test_response_length()
+{
+    printf("Testing the response length ... ");
+    alp_command_desc_t parsed;
+
+    // read 8 bytes, read 100 bytes at offset 0x123 and write 3 bytes
+    uint8_t command[4 + 6 + 7];
+    memcpy(command, encodings[0].command, 4);
+    memcpy(command + 4, encodings[1].command, 6);
+    memcpy(command + 10, encodings[3].command, 7);
+    check(alp_parse_command(&parsed, command, sizeof(command), 0) == ALP_STATUS_OK);
+    check(parsed.action_count == 3 && parsed.expected_response_length == 12 + 106);
+    check(alp_get_remaining_response_length(&parsed, 0) == 12 + 106);
+    check(alp_get_remaining_response_length(&parsed, 1) == 106);
+    check(alp_get_remaining_response_length(&parsed, 2) == 0);
+    check(alp_get_remaining_response_length(&parsed, 3) == 0);
+
+    // parsing from a start index only counts the actions following it
+    check(alp_parse_command(&parsed, command, sizeof(command), 4) == ALP_STATUS_OK);
+    check(parsed.action_count == 2 && parsed.actions[0].start == 4 && parsed.expected_response_length == 106);
+
+    // the response length saturates at the maximum length operand of the interfaces
+    uint8_t large_reads[3 * 6];
+    for(uint8_t i = 0; i < 3; i++)
+        memcpy(large_reads + i * 6, encodings[1].command, 6);
+
+    check(alp_parse_command(&parsed, large_reads, sizeof(large_reads), 0) == ALP_STATUS_OK);
+    check(parsed.expected_response_length == UINT8_MAX);
+    check(alp_get_expected_response_length(large_reads, sizeof(large_reads)) == UINT8_MAX);
+
+    uint8_t large_read[] = { 0x41, 0x40, 0x00, 0x41, 0x2C };
+    check(alp_parse_command(&parsed, large_read, sizeof(large_read), 0) == ALP_STATUS_OK);
+    check(parsed.actions[0].length == 300 && parsed.actions[0].response_length == UINT8_MAX);
+    printf("Success!\n");
+}
+
+static void test_many_actions()
+{
+    printf("Testing more than %i actions ... ", ALP_MAX_PARSED_ACTION_COUNT);
+    alp_command_desc_t parsed;
+
+    // the actions which are not stored are included in the response length, parsing continues at parsed.end
+    uint8_t command[(ALP_MAX_PARSED_ACTION_COUNT + 2) * 4];
+    for(uint8_t i = 0; i < ALP_MAX_PARSED_ACTION_COUNT + 2; i++)
+        memcpy(command + i * 4, encodings[0].command, 4);
+
+    check(alp_parse_command(&parsed, command, sizeof(command), 0) == ALP_STATUS_OK);
+    check(parsed.action_count == ALP_MAX_PARSED_ACTION_COUNT && parsed.end == ALP_MAX_PARSED_ACTION_COUNT * 4);
+    check(parsed.expected_response_length == (ALP_MAX_PARSED_ACTION_COUNT + 2) * 12);
+    check(alp_get_remaining_response_length(&parsed, ALP_MAX_PARSED_ACTION_COUNT) == 2 * 12);
+    for(uint8_t i = 0; i < ALP_MAX_PARSED_ACTION_COUNT; i++)
+        check(parsed.actions[i].start == i * 4 && parsed.actions[i].size == 4);
+
+    check(alp_parse_command(&parsed, command, sizeof(command), parsed.end) == ALP_STATUS_OK);
+    check(parsed.action_count == 2 && parsed.end == sizeof(command) && parsed.expected_response_length == 2 * 12);
+    check(parsed.actions[1].start == (ALP_MAX_PARSED_ACTION_COUNT + 1) * 4);
+    printf("Success!\n");
+}
+
+void bootstrap()
+{
+    // the RAM cost of the parsed actions per ALP command, see ALP_MAX_PARSED_ACTION_COUNT
+    check(sizeof(alp_action_desc_t) * ALP_MAX_PARSED_ACTION_COUNT <= 160);
+
+    check(alp_register_interface(&test_interface) == ALP_STATUS_OK);
+
+    test_action_types();
+    test_truncated();
+    test_malformed();
+    test_response_length();
+    test_many_actions();
+
+    printf("All tests passed!\n");
+    exit(0);
+}
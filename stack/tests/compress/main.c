@@ -0,0 +1,72 @@
+#include "compress.h"
+#include "assert.h"
+#include "math.h"
+#include "stdio.h"
+
+// the original floating point implementations, used as reference
+#define REFERENCE_CT_DECOMPRESS(ct) (pow(4, ct >> 5) * (ct & 0b11111))
+
+static uint8_t reference_compress_data(uint16_t value, bool ceil)
+{
+    uint8_t mantissa;
+    uint16_t remainder;
+
+    for ( int i = 0; i < 8; i++)
+    {
+        if (value <= (pow(4, i) * 31))
+        {
+            mantissa = value / pow(4, i);
+            remainder = value % (uint16_t)(pow(4, i));
+
+            if (ceil && remainder)
+                mantissa++;
+
+            return (uint8_t)( i<<5 | mantissa);
+        }
+    }
+
+    assert(false);
+}
+
+// the macros can be used in initializers
+static const uint32_t max_time = CT_DECOMPRESS(0xFF);
+static const uint8_t bg_scan_period = CT_COMPRESS(786, false);
+
+void test_decompress()
+{
+    for(int ct = 0; ct <= 0xFF; ct++)
+    {
+        assert(CT_DECOMPRESS(ct) == REFERENCE_CT_DECOMPRESS(ct));
+        assert(ct_decompress(ct) == REFERENCE_CT_DECOMPRESS(ct));
+    }
+
+    assert(max_time == 507904);
+}
+
+void test_compress()
+{
+    for(uint32_t value = 0; value <= UINT16_MAX; value++)
+    {
+        assert(compress_data(value, false) == reference_compress_data(value, false));
+        assert(compress_data(value, true) == reference_compress_data(value, true));
+        assert(CT_COMPRESS(value, false) == reference_compress_data(value, false));
+        assert(CT_COMPRESS(value, true) == reference_compress_data(value, true));
+
+        // rounding up never results in a smaller time and rounding down never in a larger one
+        assert(CT_DECOMPRESS(compress_data(value, true)) >= value);
+        assert(CT_DECOMPRESS(compress_data(value, false)) <= value);
+    }
+
+    assert(bg_scan_period == reference_compress_data(786, false));
+}
+
+int main(int argc, char *argv[])
+{
+    printf("Testing decompression of all compressed times ... ");
+    test_decompress();
+    printf("Success!\n");
+
+    printf("Testing compression of all 16 bit values ... ");
+    test_compress();
+    printf("Success!\n");
+}
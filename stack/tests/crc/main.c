@@ -0,0 +1,105 @@
+#include "crc.h"
+#include "assert.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define MAX_LENGTH 600
+
+// the original byte wise implementation, used as reference
+static uint16_t reference_crc(uint8_t* data, uint16_t length)
+{
+    uint16_t crc = 0xffff;
+    for(uint16_t i = 0; i < length; i++)
+    {
+        uint16_t crc_new = (uint8_t)(crc >> 8) | (crc << 8);
+        crc_new ^= data[i];
+        crc_new ^= (uint8_t)(crc_new & 0xff) >> 4;
+        crc_new ^= crc_new << 12;
+        crc_new ^= (crc_new & 0xff) << 5;
+        crc = crc_new;
+    }
+
+    return crc;
+}
+
+void test_check_value()
+{
+    uint8_t data[] = "123456789";
+    assert(crc_calculate(data, 9) == 0x29B1);
+    assert(crc_calculate(data, 0) == 0xFFFF);
+}
+
+void test_against_reference()
+{
+    uint8_t data[MAX_LENGTH];
+    for(int i = 0; i < MAX_LENGTH; i++)
+        data[i] = rand();
+
+    for(uint16_t length = 0; length <= MAX_LENGTH; length++)
+    {
+        assert(crc_calculate(data, length) == reference_crc(data, length));
+        // unaligned start
+        if(length > 0)
+            assert(crc_calculate(data + 1, length - 1) == reference_crc(data + 1, length - 1));
+    }
+}
+
+void test_context()
+{
+    uint8_t data[MAX_LENGTH];
+    for(int i = 0; i < MAX_LENGTH; i++)
+        data[i] = rand();
+
+    uint16_t expected = reference_crc(data, MAX_LENGTH);
+
+    // split the data in 2 parts at every position, like a fifo which wraps around
+    for(uint16_t split = 0; split <= MAX_LENGTH; split++)
+    {
+        crc_ctx_t ctx;
+        crc_init(&ctx);
+        crc_update(&ctx, data, split);
+        crc_update(&ctx, data + split, MAX_LENGTH - split);
+        assert(crc_final(&ctx) == expected);
+    }
+
+    // many small fragments of varying size
+    crc_ctx_t ctx;
+    crc_init(&ctx);
+    uint16_t offset = 0;
+    while(offset < MAX_LENGTH)
+    {
+        uint16_t length = rand() % 9;
+        if(offset + length > MAX_LENGTH)
+            length = MAX_LENGTH - offset;
+
+        crc_update(&ctx, data + offset, length);
+        offset += length;
+    }
+
+    assert(crc_final(&ctx) == expected);
+
+    // independent contexts do not influence each other
+    crc_ctx_t ctx1, ctx2;
+    crc_init(&ctx1);
+    crc_init(&ctx2);
+    crc_update(&ctx1, data, 10);
+    crc_update(&ctx2, data + 10, 10);
+    crc_update(&ctx1, data + 10, 10);
+    assert(crc_final(&ctx1) == reference_crc(data, 20));
+    assert(crc_final(&ctx2) == reference_crc(data + 10, 10));
+}
+
+int main(int argc, char *argv[])
+{
+    printf("Testing check value ... ");
+    test_check_value();
+    printf("Success!\n");
+
+    printf("Testing against reference implementation ... ");
+    test_against_reference();
+    printf("Success!\n");
+
+    printf("Testing fragmented calculation ... ");
+    test_context();
+    printf("Success!\n");
+}
@@ -0,0 +1,242 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "d7anp_ssr.h"
+#include "d7ap_fs.h"
+#include "framework_defs.h"
+#include "types.h"
+
+/*
+ * Tests the trusted node table of the Security State Register: the lookup by UID, the collisions in the hash
+ * table, including the removal of an entry from the middle of a probe sequence, and the eviction of the least
+ * recently used node when the table is full.
+ */
+
+#define check(condition) do { \
+    if(!(condition)) { \
+        printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        exit(1); \
+    } \
+} while(0)
+
+#define SSR_SIZE FRAMEWORK_FS_TRUSTED_NODE_TABLE_SIZE
+#define SSR_HASH_MASK (ROUND_UP_POW2(2 * SSR_SIZE) - 1)
+#define COLLIDING_COUNT 3
+
+// generated by APP_BUILD for the applications, d7ap_fs stores them in the firmware version file
+const char _GIT_SHA1[] = "0000000";
+const char _APP_NAME[] = "ssrtst";
+
+// the same hash as d7anp_ssr.c, to construct addresses which collide
+static uint16_t hash_address(const uint8_t* address)
+{
+    uint32_t hash = 2166136261UL;
+    for(uint8_t i = 0; i < D7A_FILE_UID_SIZE; i++)
+    {
+        hash ^= address[i];
+        hash *= 16777619UL;
+    }
+
+    return (hash ^ (hash >> 16)) & SSR_HASH_MASK;
+}
+
+static void make_address(uint8_t* address, uint16_t n)
+{
+    memset(address, 0, D7A_FILE_UID_SIZE);
+    address[0] = 0xAA;
+    address[6] = n >> 8;
+    address[7] = n;
+}
+
+/* fills addresses with count addresses which hash to the same slot, starting the search from n */
+static uint16_t make_colliding_addresses(uint8_t addresses[][D7A_FILE_UID_SIZE], uint8_t count, uint16_t n)
+{
+    make_address(addresses[0], n++);
+    uint16_t home = hash_address(addresses[0]);
+    for(uint8_t i = 1; i < count; n++)
+    {
+        make_address(addresses[i], n);
+        if(hash_address(addresses[i]) == home)
+            i++;
+    }
+
+    return n;
+}
+
+static void check_node(const uint8_t* address, uint32_t frame_counter, uint8_t key_counter)
+{
+    dae_nwl_trusted_node_t* node = d7anp_ssr_get_trusted_node(address);
+    check(node != NULL);
+    check(memcmp(node->addr, address, D7A_FILE_UID_SIZE) == 0);
+    check(node->frame_counter == frame_counter);
+    check(node->key_counter == key_counter);
+}
+
+static void test_lookup()
+{
+    uint8_t address[D7A_FILE_UID_SIZE];
+    d7anp_ssr_init();
+    check(d7anp_ssr_get_trusted_node_count() == 0);
+
+    for(uint16_t i = 0; i < SSR_SIZE; i++)
+    {
+        make_address(address, i);
+        check(d7anp_ssr_get_trusted_node(address) == NULL);
+        dae_nwl_trusted_node_t* node = d7anp_ssr_add_trusted_node(address, 1000 + i, i);
+        check(node != NULL && node->frame_counter == 1000 + i);
+    }
+
+    check(d7anp_ssr_get_trusted_node_count() == SSR_SIZE);
+    for(uint16_t i = 0; i < SSR_SIZE; i++)
+    {
+        make_address(address, i);
+        check_node(address, 1000 + i, i);
+    }
+
+    make_address(address, SSR_SIZE);
+    check(d7anp_ssr_get_trusted_node(address) == NULL);
+
+    // adding a known node updates it
+    make_address(address, 3);
+    d7anp_ssr_add_trusted_node(address, 5000, 7);
+    check(d7anp_ssr_get_trusted_node_count() == SSR_SIZE);
+    check_node(address, 5000, 7);
+
+    dae_nwl_trusted_node_t* node = d7anp_ssr_get_trusted_node(address);
+    d7anp_ssr_update_frame_counter(node, 5001);
+    check_node(address, 5001, 7);
+}
+
+static void test_collisions()
+{
+    // the last address is not added, looking it up walks the whole probe sequence
+    uint8_t addresses[COLLIDING_COUNT + 1][D7A_FILE_UID_SIZE];
+    d7anp_ssr_init();
+    make_colliding_addresses(addresses, COLLIDING_COUNT + 1, 0);
+
+    for(uint8_t i = 0; i < COLLIDING_COUNT; i++)
+        d7anp_ssr_add_trusted_node(addresses[i], i, 0);
+
+    check(d7anp_ssr_get_trusted_node_count() == COLLIDING_COUNT);
+    for(uint8_t i = 0; i < COLLIDING_COUNT; i++)
+        check_node(addresses[i], i, 0);
+
+    check(d7anp_ssr_get_trusted_node(addresses[COLLIDING_COUNT]) == NULL);
+}
+
+static void test_lru_eviction()
+{
+    uint8_t address[D7A_FILE_UID_SIZE];
+    d7anp_ssr_init();
+    for(uint16_t i = 0; i < SSR_SIZE; i++)
+    {
+        make_address(address, i);
+        d7anp_ssr_add_trusted_node(address, i, 0);
+    }
+
+    // node 0 is used again, so node 1 is the least recently used one
+    make_address(address, 0);
+    check(d7anp_ssr_get_trusted_node(address) != NULL);
+    make_address(address, SSR_SIZE);
+    d7anp_ssr_add_trusted_node(address, SSR_SIZE, 0);
+    check(d7anp_ssr_get_trusted_node_count() == SSR_SIZE);
+    make_address(address, 1);
+    check(d7anp_ssr_get_trusted_node(address) == NULL);
+    make_address(address, 0);
+    check_node(address, 0, 0);
+    for(uint16_t i = 2; i <= SSR_SIZE; i++)
+    {
+        make_address(address, i);
+        check_node(address, i, 0);
+    }
+
+    // adding a known node does not evict another one
+    make_address(address, 2);
+    d7anp_ssr_add_trusted_node(address, 100, 0);
+    check(d7anp_ssr_get_trusted_node_count() == SSR_SIZE);
+    for(uint16_t i = 3; i <= SSR_SIZE; i++)
+    {
+        make_address(address, i);
+        check(d7anp_ssr_get_trusted_node(address) != NULL);
+    }
+}
+
+static void test_eviction_from_probe_sequence()
+{
+    uint8_t addresses[COLLIDING_COUNT][D7A_FILE_UID_SIZE];
+    uint8_t address[D7A_FILE_UID_SIZE];
+    d7anp_ssr_init();
+    uint16_t n = make_colliding_addresses(addresses, COLLIDING_COUNT, 0);
+
+    // the first colliding node is in its home slot and is evicted first, the others follow it in the probe sequence
+    for(uint8_t i = 0; i < COLLIDING_COUNT; i++)
+        d7anp_ssr_add_trusted_node(addresses[i], i, 0);
+
+    for(uint16_t i = COLLIDING_COUNT; i < SSR_SIZE; i++)
+    {
+        make_address(address, n + i);
+        d7anp_ssr_add_trusted_node(address, n + i, 0);
+    }
+
+    for(uint8_t i = 1; i < COLLIDING_COUNT; i++)
+        check(d7anp_ssr_get_trusted_node(addresses[i]) != NULL);
+
+    for(uint16_t i = COLLIDING_COUNT; i < SSR_SIZE; i++)
+    {
+        make_address(address, n + i);
+        check(d7anp_ssr_get_trusted_node(address) != NULL);
+    }
+
+    make_address(address, n + SSR_SIZE);
+    d7anp_ssr_add_trusted_node(address, n + SSR_SIZE, 0);
+    check(d7anp_ssr_get_trusted_node(addresses[0]) == NULL);
+    for(uint8_t i = 1; i < COLLIDING_COUNT; i++)
+        check_node(addresses[i], i, 0);
+
+    // the evicted node can be added again, evicting the next least recently used node
+    make_address(address, n + COLLIDING_COUNT);
+    d7anp_ssr_add_trusted_node(addresses[0], 0, 0);
+    check_node(addresses[0], 0, 0);
+    check(d7anp_ssr_get_trusted_node(address) == NULL);
+    check(d7anp_ssr_get_trusted_node_count() == SSR_SIZE);
+}
+
+void bootstrap()
+{
+    d7ap_fs_init();
+
+    printf("Testing lookup ... ");
+    test_lookup();
+    printf("Success!\n");
+
+    printf("Testing collisions ... ");
+    test_collisions();
+    printf("Success!\n");
+
+    printf("Testing LRU eviction ... ");
+    test_lru_eviction();
+    printf("Success!\n");
+
+    printf("Testing eviction from a probe sequence ... ");
+    test_eviction_from_probe_sequence();
+    printf("Success!\n");
+
+    exit(0);
+}
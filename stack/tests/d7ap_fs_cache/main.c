@@ -0,0 +1,189 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "d7ap_fs.h"
+#include "fs.h"
+#include "platform.h"
+#include "modules_defs.h"
+#include "MODULE_D7AP_FS_defs.h"
+
+/*
+ * Tests the write-back cache of d7ap_fs on the NATIVE platform.
+ *
+ * The DLL status file is written back: the writes are coalesced in RAM and only programmed in the simulated EEPROM
+ * when the write-back timer expires or when the cache is flushed, while the file modified callback runs when the
+ * file is written. Changing the allocated length of the file flushes its pending data.
+ */
+
+#define check(condition) do { \
+    if(!(condition)) { \
+        printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        exit(1); \
+    } \
+} while(0)
+
+#define FILE_ID D7A_FILE_DLL_STATUS_FILE_ID
+
+// generated by APP_BUILD for the applications, d7ap_fs stores them in the firmware version file
+const char _GIT_SHA1[] = "0000000";
+const char _APP_NAME[] = "fstest";
+
+static uint8_t modified_count = 0;
+
+static void file_modified(uint8_t file_id)
+{
+    check(file_id == FILE_ID);
+    modified_count++;
+}
+
+static blockdevice_sim_eeprom_stats_t get_permanent_stats()
+{
+    blockdevice_sim_eeprom_stats_t stats;
+    native_get_blockdevice_stats(NULL, &stats);
+    return stats;
+}
+
+// the content of the file as stored on the blockdevice, bypassing the cache
+static void read_stored(uint32_t offset, uint8_t* buffer, uint32_t length)
+{
+    check(fs_read_file(FILE_ID, sizeof(d7ap_fs_file_header_t) + offset, buffer, length) == 0);
+}
+
+static void test_coalescing()
+{
+    uint8_t data[6] = { 0 };
+    uint8_t stored[6];
+    read_stored(0, stored, sizeof(stored));
+    native_reset_blockdevice_stats();
+    modified_count = 0;
+
+    data[0] = 0x11; data[1] = 0x12;
+    check(d7ap_fs_write_file(FILE_ID, 0, data, 2) == 0);
+    data[4] = 0x15; data[5] = 0x16;
+    check(d7ap_fs_write_file(FILE_ID, 4, data + 4, 2) == 0);
+    data[1] = 0x22; data[2] = 0x23;
+    check(d7ap_fs_write_file(FILE_ID, 1, data + 1, 2) == 0);
+
+    // the callbacks ran for every write, nothing was programmed
+    check(modified_count == 3);
+    check(get_permanent_stats().program_calls == 0);
+
+    // the readers see the new content, the blockdevice still has the old one
+    uint8_t buffer[6];
+    check(d7ap_fs_read_file(FILE_ID, 0, buffer, sizeof(buffer)) == 0);
+    check(memcmp(buffer, data, sizeof(data)) == 0);
+    read_stored(0, buffer, sizeof(buffer));
+    check(memcmp(buffer, stored, sizeof(stored)) == 0);
+
+    // a single range is programmed, from the first to the last byte written
+    d7ap_fs_flush();
+    blockdevice_sim_eeprom_stats_t stats = get_permanent_stats();
+    check(stats.program_calls == 1);
+    check(stats.bytes_requested == sizeof(data));
+    read_stored(0, buffer, sizeof(buffer));
+    check(memcmp(buffer, data, sizeof(data)) == 0);
+    check(modified_count == 3);
+
+    // nothing left to flush
+    d7ap_fs_flush();
+    check(get_permanent_stats().program_calls == 1);
+}
+
+static void test_flush_on_timer()
+{
+    uint8_t data[2] = { 0x31, 0x32 };
+    native_reset_blockdevice_stats();
+    modified_count = 0;
+    uint32_t flushes = d7ap_fs_get_cache_stats()->flushes;
+
+    check(d7ap_fs_write_file(FILE_ID, 0, data, sizeof(data)) == 0);
+    check(modified_count == 1);
+
+    // the second write does not restart the delay
+    uint64_t delay = MODULE_D7AP_FS_WRITEBACK_DELAY * native_timer_get_ticks_per_sec();
+    native_timer_advance(delay / 2);
+    data[1] = 0x42;
+    check(d7ap_fs_write_file(FILE_ID, 1, data + 1, 1) == 0);
+    check(modified_count == 2);
+    native_timer_advance(delay / 2 - 1);
+    check(get_permanent_stats().program_calls == 0);
+
+    native_timer_advance(2);
+    check(get_permanent_stats().program_calls == 1);
+    check(d7ap_fs_get_cache_stats()->flushes == flushes + 1);
+    uint8_t buffer[2];
+    read_stored(0, buffer, sizeof(buffer));
+    check(memcmp(buffer, data, sizeof(data)) == 0);
+    check(modified_count == 2);
+}
+
+static void test_header_change()
+{
+    d7ap_fs_file_header_t header;
+    check(d7ap_fs_read_file_header(FILE_ID, &header) == 0);
+    uint32_t allocated_length = header.allocated_length;
+
+    uint8_t data[2] = { 0x51, 0x52 };
+    uint8_t buffer[2];
+    native_reset_blockdevice_stats();
+    check(d7ap_fs_write_file(FILE_ID, 0, data, sizeof(data)) == 0);
+    check(get_permanent_stats().program_calls == 0);
+
+    // the file no longer fits its place in the write-back buffer, the pending data is written before the header
+    header.allocated_length = allocated_length + 2;
+    check(d7ap_fs_write_file_header(FILE_ID, &header) == 0);
+    read_stored(0, buffer, sizeof(buffer));
+    check(memcmp(buffer, data, sizeof(data)) == 0);
+
+    // the file is not loaded in the write-back buffer using the old length, the write past the stored data fails
+    check(d7ap_fs_write_file(FILE_ID, allocated_length, data, sizeof(data)) != 0);
+
+    // shrinking the file, it is loaded again using the new length
+    check(d7ap_fs_read_file_header(FILE_ID, &header) == 0);
+    header.allocated_length = allocated_length - 2;
+    check(d7ap_fs_write_file_header(FILE_ID, &header) == 0);
+    check(d7ap_fs_write_file(FILE_ID, allocated_length - 2, data, 1) != 0);
+    data[0] = 0x61;
+    check(d7ap_fs_write_file(FILE_ID, allocated_length - 4, data, sizeof(data)) == 0);
+    check(d7ap_fs_read_file(FILE_ID, allocated_length - 4, buffer, sizeof(buffer)) == 0);
+    check(memcmp(buffer, data, sizeof(data)) == 0);
+
+    // restoring the length writes the data kept for the shorter file
+    check(d7ap_fs_read_file_header(FILE_ID, &header) == 0);
+    header.allocated_length = allocated_length;
+    check(d7ap_fs_write_file_header(FILE_ID, &header) == 0);
+    read_stored(allocated_length - 4, buffer, sizeof(buffer));
+    check(memcmp(buffer, data, sizeof(data)) == 0);
+}
+
+void bootstrap()
+{
+    d7ap_fs_init();
+#ifdef MODULE_D7AP_FS_CACHE_ENABLED
+    check(fs_register_file_modified_callback(FILE_ID, &file_modified));
+    test_coalescing();
+    test_flush_on_timer();
+    test_header_change();
+    printf("d7ap_fs cache tests passed\n");
+#else
+    printf("d7ap_fs is built without MODULE_D7AP_FS_CACHE_ENABLED, skipping\n");
+#endif
+    exit(0);
+}
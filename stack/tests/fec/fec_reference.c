@@ -1,4 +1,6 @@
-/*! \file fec.c
+/*! \file fec_reference.c
+ *
+ * The bit serial FEC implementation the framework used before, kept as reference for the tests and benchmarks
  *
  *  \copyright (C) Copyright 2015 University of Antwerp and others (http://oss-7.cosys.be)
  *
@@ -27,11 +29,25 @@
 #include <stdint.h>
 #include <string.h>
 
-#include "fec.h"
+#include "fec_reference.h"
+
+typedef struct {
+	uint8_t cost;
+	uint16_t path;
+} VITERBIPATH;
+
+typedef struct {
+	uint8_t path_size;
+	VITERBIPATH* old;
+	VITERBIPATH* new;
+	VITERBIPATH states1[8];
+	VITERBIPATH states2[8];
+} VITERBISTATE;
+
 
 #define INITIAL_FECSTATE 0x00
 #define TRELLIS_TERMINATOR 0x0B
-#define FEC_BUFFER_SIZE 128
+#define FEC_BUFFER_SIZE 256
 
 #define INTERLEAVING
 
@@ -45,7 +61,7 @@ static uint8_t data_buffer[FEC_BUFFER_SIZE];
 static uint8_t* input_buffer;
 static uint8_t* output_buffer;
 
-static uint8_t packetlength;
+static uint16_t packetlength;
 static uint16_t fecpacketlength;
 static uint16_t output_packet_length;
 
@@ -58,68 +74,21 @@ static VITERBISTATE vstate;
 
 static bool fec_decode(uint8_t* input);
 
-#define DPRINT(...) printf(__VA_ARGS__)
-#define DPRINT_DATA(...) print_array(__VA_ARGS__)
-
-void print_array(uint8_t* buffer, uint8_t length, uint8_t binary)
-{
-	int i = 0;
-	for (; i < length; i++)
-	{
-	    printf("%02X", buffer[i]);
-	}
-
-	if (binary)
-	{
-		printf(" ");
-
-		for (i = 0; i < length; i++)
-		{
-			printf("%s", byte_to_binary(buffer[i]));
-		}
-	}
-}
-
-const char *int_to_binary(uint16_t x)
-{
-    static char b[17];
-    b[0] = '\0';
-
-    uint16_t z;
-    for (z = 0x8000; z > 0; z >>= 1)
-    {
-        strcat(b, ((x & z) == z) ? "1" : "0");
-    }
-
-    return b;
-}
+#if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_PHY_LOG_ENABLED) // TODO more granular (LOG_PHY_ENABLED)
+#define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
+#define DPRINT_DATA(...) log_print_data(__VA_ARGS__)
+#else
+#define DPRINT(...)
+#define DPRINT_DATA(...)
+#endif
 
-static void print_vstate()
+static uint16_t fec_calculated_decoded_length(uint16_t packet_length)
 {
-//	typedef struct {
-//		uint8_t cost;
-//		uint16_t path;
-//	} VITERBIPATH;
-//	typedef struct {
-//		uint8_t path_size;
-//		VITERBIPATH* old;
-//		VITERBIPATH* new;
-//		VITERBIPATH states1[8];
-//		VITERBIPATH states2[8];
-//	} VITERBISTATE;
-
-	printf("VSTATE:\n");
-	printf(" - path_size: %d\n", vstate.path_size);
-	//printf(" - old: %03d - %s\n", vstate.old->cost, int_to_binary(vstate.old->path));
-	//printf(" - new: %03d - %s\n", vstate.new->cost, int_to_binary(vstate.new->path));
-	int i;
-	for (i=0;i<8;i++)
-		printf(" - states - %d: %03d - %s\n", i, vstate.old[i].cost, int_to_binary(vstate.old[i].path));
-
+	return 2* (packet_length + 2 - (packet_length % 2));
 }
 
 /* Convolutional encoder */
-uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
+uint16_t fec_reference_encode(uint8_t *data, uint16_t nbytes)
 {
 	memcpy(data_buffer, data, nbytes);
 	uint8_t *input = data_buffer;
@@ -203,7 +172,7 @@ uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
 	return length;
 }
 
-uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_length)
+uint16_t fec_reference_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length)
 {
 	uint8_t* output = data_buffer;
 	if(output_length < packet_length)
@@ -220,7 +189,6 @@ uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_l
 
 	output_buffer = output;
 	packetlength = packet_length;
-	fecpacketlength = ((packet_length & 0xFE) + 2) << 1;
 	output_packet_length = output_length;
 
 	processedbytes = 0;
@@ -236,9 +204,9 @@ uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_l
 	vstate.old = vstate.states1;
 	vstate.new = vstate.states2;
 
-	uint8_t decoded_length = 0;
+	uint16_t decoded_length = 0;
 
-	for(i = 0; i < packet_length; i =i+4)
+	for(i = 0; i < packet_length; i = i + 4)
 	{
 		//printf("FEC encoding i = %d\n", i);
 
@@ -263,7 +231,7 @@ static bool fec_decode(uint8_t* input)
 	uint8_t fecbuffer[4];
 	VITERBIPATH* vstate_tmp;
 
-	if(fecprocessedbytes >= fecpacketlength)
+	if(fecprocessedbytes >= packetlength)
 		return false;
 
 	//Deinterleaving (symbols are stored in reverse as this is easier for Viterbi decoding)
@@ -0,0 +1,9 @@
+#ifndef FEC_REFERENCE_H_
+#define FEC_REFERENCE_H_
+
+#include <stdint.h>
+
+uint16_t fec_reference_encode(uint8_t *data, uint16_t nbytes);
+uint16_t fec_reference_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length);
+
+#endif /* FEC_REFERENCE_H_ */
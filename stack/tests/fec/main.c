@@ -3,9 +3,15 @@
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
 #include "fec.h"
+#include "fec_reference.h"
 
 #define BINARY 0
+#define MAX_PAYLOAD_LENGTH 250
+#define MAX_ENCODED_LENGTH (2 * (MAX_PAYLOAD_LENGTH + 3))
+#define BENCHMARK_ITERATIONS 20000
 
 
 const char *byte_to_binary(uint8_t x)
@@ -22,6 +28,25 @@ const char *byte_to_binary(uint8_t x)
     return b;
 }
 
+void print_array(uint8_t* buffer, uint8_t length, uint8_t binary)
+{
+	int i = 0;
+	for (; i < length; i++)
+	{
+	    printf("%02X", buffer[i]);
+	}
+
+	if (binary)
+	{
+		printf(" ");
+
+		for (i = 0; i < length; i++)
+		{
+			printf("%s", byte_to_binary(buffer[i]));
+		}
+	}
+}
+
 unsigned char Partab[] = { 0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0
 ,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1
 ,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,};
@@ -82,6 +107,137 @@ void test_interleaver()
 
 }
 
+static void fill_random(uint8_t* data, uint16_t length)
+{
+	for(uint16_t i = 0; i < length; i++)
+		data[i] = rand();
+}
+
+static void add_bit_errors(uint8_t* data, uint16_t length, uint16_t nr_errors)
+{
+	for(uint16_t i = 0; i < nr_errors; i++)
+	{
+		int r = rand() % (length * 8);
+		data[r / 8] ^= 1 << (r % 8);
+	}
+}
+
+static void test_encoder_bit_exact()
+{
+	uint8_t input[MAX_PAYLOAD_LENGTH];
+	uint8_t encoded[MAX_ENCODED_LENGTH];
+	uint8_t expected[MAX_ENCODED_LENGTH];
+
+	for(uint16_t length = 1; length <= MAX_PAYLOAD_LENGTH; length++)
+	{
+		fill_random(input, length);
+		memcpy(encoded, input, length);
+		memcpy(expected, input, length);
+
+		uint16_t encoded_length = fec_encode(encoded, length);
+		assert(encoded_length == fec_reference_encode(expected, length));
+		assert(memcmp(encoded, expected, encoded_length) == 0);
+	}
+}
+
+static void test_decoder_bit_exact()
+{
+	uint8_t input[MAX_PAYLOAD_LENGTH];
+	uint8_t decoded[MAX_ENCODED_LENGTH];
+	uint8_t expected[MAX_ENCODED_LENGTH];
+
+	for(uint16_t nr_errors = 0; nr_errors <= 16; nr_errors += 4)
+	{
+		for(uint16_t length = 1; length <= MAX_PAYLOAD_LENGTH; length++)
+		{
+			fill_random(input, length);
+			memcpy(decoded, input, length);
+			uint16_t encoded_length = fec_encode(decoded, length);
+			add_bit_errors(decoded, encoded_length, nr_errors);
+			memcpy(expected, decoded, encoded_length);
+
+			uint16_t decoded_length = fec_decode_packet(decoded, encoded_length, encoded_length);
+			assert(decoded_length == fec_reference_decode_packet(expected, encoded_length, encoded_length));
+			// the reference implementation does not decode the last (terminator) byte
+			assert(memcmp(decoded, expected, decoded_length - 1) == 0);
+
+			if(nr_errors == 0)
+				assert(memcmp(decoded, input, length) == 0);
+		}
+	}
+}
+
+static void test_decoder_fragmented()
+{
+	uint8_t input[MAX_PAYLOAD_LENGTH];
+	uint8_t encoded[MAX_ENCODED_LENGTH];
+	uint8_t expected[MAX_ENCODED_LENGTH];
+	uint8_t decoded[MAX_ENCODED_LENGTH];
+	uint8_t header[4];
+
+	for(uint16_t length = 1; length <= MAX_PAYLOAD_LENGTH; length++)
+	{
+		fill_random(input, length);
+		memcpy(encoded, input, length);
+		uint16_t encoded_length = fec_encode(encoded, length);
+		add_bit_errors(encoded, encoded_length, 4);
+		memcpy(expected, encoded, encoded_length);
+		uint16_t expected_length = fec_decode_packet(expected, encoded_length, encoded_length);
+
+		// feed the data in chunks of random size, like a radio FIFO which is read at a threshold,
+		// and decode a header in between which should not influence the packet decoding
+		fec_decoder_t decoder;
+		fec_decoder_init(&decoder, decoded, sizeof(decoded));
+		uint16_t offset = 0;
+		while(offset < encoded_length)
+		{
+			uint16_t chunk = 1 + rand() % 9;
+			if(offset + chunk > encoded_length)
+				chunk = encoded_length - offset;
+
+			fec_decoder_feed(&decoder, encoded + offset, chunk);
+			offset += chunk;
+
+			memcpy(header, encoded, sizeof(header));
+			fec_decode_packet(header, sizeof(header), sizeof(header));
+		}
+
+		assert(fec_decoder_finish(&decoder) == expected_length);
+		assert(memcmp(decoded, expected, expected_length) == 0);
+	}
+}
+
+static double benchmark(uint16_t (*encode)(uint8_t*, uint16_t), uint16_t (*decode)(uint8_t*, uint16_t, uint16_t), bool decoding)
+{
+	uint8_t input[MAX_PAYLOAD_LENGTH];
+	uint8_t buffer[MAX_ENCODED_LENGTH];
+	fill_random(input, sizeof(input));
+
+	clock_t start = clock();
+	for(int i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		memcpy(buffer, input, sizeof(input));
+		uint16_t encoded_length = encode(buffer, sizeof(input));
+		if(decoding)
+			decode(buffer, encoded_length, encoded_length);
+	}
+
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	return (double)BENCHMARK_ITERATIONS * MAX_PAYLOAD_LENGTH / seconds / 1000;
+}
+
+static void run_benchmarks()
+{
+	double encode = benchmark(&fec_encode, &fec_decode_packet, false);
+	double encode_reference = benchmark(&fec_reference_encode, &fec_reference_decode_packet, false);
+	// the decoding benchmark includes encoding, subtract it to get the decoder throughput
+	double decode = 1 / (1 / benchmark(&fec_encode, &fec_decode_packet, true) - 1 / encode);
+	double decode_reference = 1 / (1 / benchmark(&fec_reference_encode, &fec_reference_decode_packet, true) - 1 / encode_reference);
+
+	printf("Encoder: %.0f kB/s (reference %.0f kB/s)\n", encode, encode_reference);
+	printf("Decoder: %.0f kB/s (reference %.0f kB/s)\n", decode, decode_reference);
+}
+
 int main(int argc, char *argv[])
 {
 	//test_interleaver();
@@ -89,10 +245,6 @@ int main(int argc, char *argv[])
 	uint8_t input_length = sizeof(input);
 	uint8_t encoded[255];
 	uint8_t decoded[255];
-	uint8_t errors[255];
-
-	memset(errors, 0, 255);
-
 
 	printf("Input: %d ", input_length);
 	print_array(input, input_length, BINARY);
@@ -108,51 +260,27 @@ int main(int argc, char *argv[])
 
 	memcpy(decoded, encoded, lenght_encoded);
 
-
 	uint8_t length_decoded =  fec_decode_packet(decoded, lenght_encoded, 255);
 
 	printf("Decoded: %d ", length_decoded);
 	print_array(decoded, length_decoded, BINARY);
 	printf("\n");
 
-	int nr_errors = 1;
-	int notrecovered = 0;
 	srand(time(NULL));
 
-//	while (notrecovered < 1)
-//	{
-//		int r = rand() % (lenght_encoded * 8);
-//		//printf("Rand: %d\n", r);
-//
-//		encoded[r/8] ^= 1 << r % 8;
-//		errors[r/8] ^= 1 << r % 8;
-//		printf("Errors %d - BER %d%%\n", nr_errors, (nr_errors * 100) / (lenght_encoded * 8));
-//		printf("Error: ");
-//		print_array(errors, lenght_encoded);
-//		printf("\n");
-//		printf("Enc. error: ");
-//		print_array(encoded, lenght_encoded);
-//		printf("\n");
-//
-//		length_decoded =  fec_decode_packet(encoded, lenght_encoded, decoded, 255);
-//
-//		printf("Decoded: ");
-//		print_array(decoded, length_decoded);
-//		printf("\n");
-//
-//		if (memcmp(input, decoded, input_length) == 0)
-//		{
-//			printf("ok\n");
-//		}
-//		else
-//		{
-//			printf("error\n");
-//			notrecovered++;
-//		}
-//
-//		nr_errors++;
-//	}
-
-
-    return 0;
+	printf("Testing encoder against reference implementation ... ");
+	test_encoder_bit_exact();
+	printf("Success!\n");
+
+	printf("Testing decoder against reference implementation ... ");
+	test_decoder_bit_exact();
+	printf("Success!\n");
+
+	printf("Testing fragmented decoding ... ");
+	test_decoder_fragmented();
+	printf("Success!\n");
+
+	run_benchmarks();
+
+	return 0;
 }
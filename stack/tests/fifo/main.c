@@ -2,6 +2,10 @@
 #include "assert.h"
 #include "errors.h"
 #include "stdio.h"
+#include "string.h"
+#ifdef FIFO_BENCHMARK
+#include <time.h>
+#endif
 
 #define BUFFER_SIZE 10
 
@@ -236,6 +240,301 @@ void test_pop_empty()
     assert(fifo_get_size(&test_fifo) == 0);
 }
 
+void test_spans()
+{
+    fifo_t test_fifo;
+    fifo_span_t spans[2];
+    uint8_t buffer[BUFFER_SIZE] = {0,};
+    uint8_t data[BUFFER_SIZE] = {0,1,2,3,4,5,6,7,8,9};
+    uint8_t buff[BUFFER_SIZE] = {0,};
+
+    fifo_init(&test_fifo, buffer, BUFFER_SIZE);
+    assert(fifo_reserve(&test_fifo, spans) == BUFFER_SIZE);
+    assert(spans[0].data == buffer && spans[0].len == BUFFER_SIZE && spans[1].len == 0);
+    assert(fifo_peek_spans(&test_fifo, spans) == 0);
+    assert(spans[0].len == 0 && spans[1].len == 0);
+
+    // produce in place
+    assert(fifo_reserve(&test_fifo, spans) == BUFFER_SIZE);
+    memcpy(spans[0].data, data, 7);
+    assert(fifo_commit(&test_fifo, 7) == SUCCESS);
+    assert(fifo_get_size(&test_fifo) == 7);
+    assert(fifo_pop(&test_fifo, buff, 5) == SUCCESS); // {5,6}
+    assert(memcmp(buff, data, 5) == 0);
+
+    // free space wraps: 3 bytes at the end of the buffer and 5 at the start
+    assert(fifo_reserve(&test_fifo, spans) == 8);
+    assert(spans[0].data == buffer + 7 && spans[0].len == 3);
+    assert(spans[1].data == buffer && spans[1].len == 5);
+    assert(fifo_commit(&test_fifo, 9) == ESIZE);
+    memcpy(spans[0].data, data, 3);
+    memcpy(spans[1].data, data + 3, 5);
+    assert(fifo_commit(&test_fifo, 8) == SUCCESS); // {5,6,0,1,2,3,4,5,6,7}
+    assert(fifo_is_full(&test_fifo) == true);
+    assert(fifo_reserve(&test_fifo, spans) == 0);
+    assert(fifo_commit(&test_fifo, 1) == ESIZE);
+
+    // consume in place, the data wraps
+    assert(fifo_peek_spans(&test_fifo, spans) == BUFFER_SIZE);
+    assert(spans[0].data == buffer + 5 && spans[0].len == 5);
+    assert(spans[1].data == buffer && spans[1].len == 5);
+    assert(spans[0].data[0] == 5 && spans[0].data[2] == 0 && spans[1].data[4] == 7);
+    assert(fifo_consume(&test_fifo, 11) == ESIZE);
+    assert(fifo_consume(&test_fifo, 6) == SUCCESS);
+    assert(fifo_is_full(&test_fifo) == false);
+    assert(fifo_peek_spans(&test_fifo, spans) == 4);
+    assert(spans[0].data == buffer + 1 && spans[0].len == 4 && spans[1].len == 0);
+    assert(fifo_consume(&test_fifo, 4) == SUCCESS);
+    assert(fifo_get_size(&test_fifo) == 0);
+
+    // subviews can not be produced to
+    fifo_init_filled(&test_fifo, buffer, 5, BUFFER_SIZE);
+    fifo_t subview;
+    assert(fifo_init_subview(&subview, &test_fifo, 1, 3) == SUCCESS);
+    assert(fifo_reserve(&subview, spans) == 0);
+    assert(fifo_commit(&subview, 1) == EINVAL);
+    assert(fifo_peek_spans(&subview, spans) == 3);
+    assert(spans[0].data == buffer + 1 && spans[0].len == 3);
+}
+
+void test_power_of_two()
+{
+    fifo_t test_fifo;
+    uint8_t buffer[16];
+    uint8_t buff[16];
+    uint8_t next_in = 0, next_out = 0;
+
+    // run the same sequence with a masked (16) and a non masked (15) buffer size
+    for(uint8_t max_size = 15; max_size <= 16; max_size++)
+    {
+        fifo_init(&test_fifo, buffer, max_size);
+        assert(test_fifo.index_mask == (max_size == 16 ? 15 : 0));
+        for(int i = 0; i < 100; i++)
+        {
+            uint8_t len = (i % 7) + 1;
+            for(uint8_t j = 0; j < len; j++)
+                assert(fifo_put_byte(&test_fifo, next_in++) == SUCCESS);
+
+            assert(fifo_peek(&test_fifo, buff, 0, len) == SUCCESS);
+            assert(buff[0] == next_out);
+            assert(fifo_pop(&test_fifo, buff, len) == SUCCESS);
+            for(uint8_t j = 0; j < len; j++)
+                assert(buff[j] == next_out++);
+        }
+
+        while(fifo_put_byte(&test_fifo, next_in) == SUCCESS)
+            next_in++;
+
+        assert(fifo_get_size(&test_fifo) == max_size);
+        fifo_clear(&test_fifo);
+        assert(fifo_get_size(&test_fifo) == 0);
+        next_out = next_in;
+    }
+}
+
+void test_spsc()
+{
+    fifo_spsc_t test_fifo;
+    fifo_span_t spans[2];
+    uint8_t buffer[16];
+    uint8_t data[16];
+    uint8_t buff[16];
+    uint8_t next_in = 0, next_out = 0;
+
+    fifo_spsc_init(&test_fifo, buffer, sizeof(buffer));
+    assert(fifo_spsc_get_size(&test_fifo) == 0);
+    assert(fifo_spsc_pop(&test_fifo, buff, 1) == ESIZE);
+
+    // interleave producing and consuming until the free running indices have wrapped a few times
+    for(uint32_t i = 0; i < 3 * 65536 / 5; i++)
+    {
+        uint8_t len = (i % 5) + 1;
+        if(i % 2)
+        {
+            for(uint8_t j = 0; j < len; j++)
+                data[j] = next_in++;
+
+            assert(fifo_spsc_put(&test_fifo, data, len) == SUCCESS);
+        }
+        else
+        {
+            // produce in place
+            assert(fifo_spsc_reserve(&test_fifo, spans) == sizeof(buffer) - fifo_spsc_get_size(&test_fifo));
+            for(uint8_t j = 0; j < len; j++)
+                *(j < spans[0].len ? &spans[0].data[j] : &spans[1].data[j - spans[0].len]) = next_in++;
+
+            assert(fifo_spsc_commit(&test_fifo, len) == SUCCESS);
+        }
+
+        if(i % 3)
+        {
+            assert(fifo_spsc_pop(&test_fifo, buff, len) == SUCCESS);
+            for(uint8_t j = 0; j < len; j++)
+                assert(buff[j] == next_out++);
+        }
+        else
+        {
+            // consume in place
+            uint16_t size = fifo_spsc_peek_spans(&test_fifo, spans);
+            assert(size == spans[0].len + spans[1].len && size >= len);
+            for(uint8_t j = 0; j < len; j++)
+                assert((j < spans[0].len ? spans[0].data[j] : spans[1].data[j - spans[0].len]) == next_out++);
+
+            assert(fifo_spsc_consume(&test_fifo, len) == SUCCESS);
+        }
+    }
+
+    fifo_span_t free_spans[2];
+    uint16_t size = fifo_spsc_get_size(&test_fifo);
+    assert(fifo_spsc_reserve(&test_fifo, free_spans) == sizeof(buffer) - size);
+    assert(fifo_spsc_commit(&test_fifo, sizeof(buffer) - size + 1) == ESIZE);
+    assert(fifo_spsc_commit(&test_fifo, sizeof(buffer) - size) == SUCCESS);
+    assert(fifo_spsc_get_size(&test_fifo) == sizeof(buffer));
+    assert(fifo_spsc_put(&test_fifo, data, 1) == ESIZE);
+    assert(fifo_spsc_consume(&test_fifo, sizeof(buffer) + 1) == ESIZE);
+    assert(fifo_spsc_consume(&test_fifo, sizeof(buffer)) == SUCCESS);
+    assert(fifo_spsc_get_size(&test_fifo) == 0);
+}
+
+#ifdef FIFO_BENCHMARK
+/*
+ * Benchmarks, only built for the NATIVE platform since they use the host clock.
+ *
+ * A stream of frames is pushed through a FIFO and read back, using the byte-wise calls (as done by the ALP
+ * encoders), the copying block calls and the span calls. The frame size is chosen so frames regularly wrap around
+ * the end of the buffer. Both a power of 2 buffer size (masked indices) and one which is not are used.
+ */
+
+#define BENCHMARK_BYTES (16 * 1024 * 1024)
+#define BENCHMARK_FRAME_SIZE 48
+
+static uint8_t benchmark_buffer[256];
+static uint8_t benchmark_frame[BENCHMARK_FRAME_SIZE];
+static volatile uint32_t benchmark_sum;
+
+static uint64_t get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_result(const char* name, uint16_t max_size, uint64_t start)
+{
+    uint64_t duration = get_time_ns() - start;
+    printf("  %-14s size %3i: %6.2f ns/byte, %7.1f MB/s\n", name, max_size,
+           (double)duration / BENCHMARK_BYTES, BENCHMARK_BYTES * 1000.0 / duration);
+}
+
+static void benchmark_byte(uint16_t max_size)
+{
+    fifo_t fifo;
+    uint8_t byte;
+    uint32_t sum = 0;
+    fifo_init(&fifo, benchmark_buffer, max_size);
+    uint64_t start = get_time_ns();
+    for(uint32_t i = 0; i < BENCHMARK_BYTES / BENCHMARK_FRAME_SIZE; i++)
+    {
+        for(uint8_t j = 0; j < BENCHMARK_FRAME_SIZE; j++)
+            fifo_put_byte(&fifo, benchmark_frame[j]);
+
+        for(uint8_t j = 0; j < BENCHMARK_FRAME_SIZE; j++)
+        {
+            fifo_pop(&fifo, &byte, 1);
+            sum += byte;
+        }
+    }
+
+    print_result("byte", max_size, start);
+    benchmark_sum = sum;
+}
+
+static void benchmark_copy(uint16_t max_size)
+{
+    fifo_t fifo;
+    uint8_t frame[BENCHMARK_FRAME_SIZE];
+    uint32_t sum = 0;
+    fifo_init(&fifo, benchmark_buffer, max_size);
+    uint64_t start = get_time_ns();
+    for(uint32_t i = 0; i < BENCHMARK_BYTES / BENCHMARK_FRAME_SIZE; i++)
+    {
+        fifo_put(&fifo, benchmark_frame, BENCHMARK_FRAME_SIZE);
+        fifo_pop(&fifo, frame, BENCHMARK_FRAME_SIZE);
+        for(uint8_t j = 0; j < BENCHMARK_FRAME_SIZE; j++)
+            sum += frame[j];
+    }
+
+    print_result("copy", max_size, start);
+    benchmark_sum = sum;
+}
+
+static void benchmark_span(uint16_t max_size)
+{
+    fifo_t fifo;
+    fifo_span_t spans[2];
+    uint32_t sum = 0;
+    fifo_init(&fifo, benchmark_buffer, max_size);
+    uint64_t start = get_time_ns();
+    for(uint32_t i = 0; i < BENCHMARK_BYTES / BENCHMARK_FRAME_SIZE; i++)
+    {
+        // the producer writes in place, like a DMA would
+        fifo_reserve(&fifo, spans);
+        uint8_t part1 = spans[0].len < BENCHMARK_FRAME_SIZE ? spans[0].len : BENCHMARK_FRAME_SIZE;
+        memcpy(spans[0].data, benchmark_frame, part1);
+        memcpy(spans[1].data, benchmark_frame + part1, BENCHMARK_FRAME_SIZE - part1);
+
+        fifo_commit(&fifo, BENCHMARK_FRAME_SIZE);
+
+        // the consumer parses in place
+        fifo_peek_spans(&fifo, spans);
+        for(uint8_t j = 0; j < BENCHMARK_FRAME_SIZE; j++)
+            sum += j < spans[0].len ? spans[0].data[j] : spans[1].data[j - spans[0].len];
+
+        fifo_consume(&fifo, BENCHMARK_FRAME_SIZE);
+    }
+
+    print_result("span", max_size, start);
+    benchmark_sum = sum;
+}
+
+static void benchmark_spsc(uint16_t max_size)
+{
+    fifo_spsc_t fifo;
+    fifo_span_t spans[2];
+    uint32_t sum = 0;
+    fifo_spsc_init(&fifo, benchmark_buffer, max_size);
+    uint64_t start = get_time_ns();
+    for(uint32_t i = 0; i < BENCHMARK_BYTES / BENCHMARK_FRAME_SIZE; i++)
+    {
+        fifo_spsc_put(&fifo, benchmark_frame, BENCHMARK_FRAME_SIZE);
+        fifo_spsc_peek_spans(&fifo, spans);
+        for(uint8_t j = 0; j < BENCHMARK_FRAME_SIZE; j++)
+            sum += j < spans[0].len ? spans[0].data[j] : spans[1].data[j - spans[0].len];
+
+        fifo_spsc_consume(&fifo, BENCHMARK_FRAME_SIZE);
+    }
+
+    print_result("spsc put/span", max_size, start);
+    benchmark_sum = sum;
+}
+
+void run_benchmarks()
+{
+    for(uint8_t i = 0; i < BENCHMARK_FRAME_SIZE; i++)
+        benchmark_frame[i] = i;
+
+    uint16_t sizes[] = { 200, 256 };
+    for(uint8_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        benchmark_byte(sizes[i]);
+        benchmark_copy(sizes[i]);
+        benchmark_span(sizes[i]);
+    }
+
+    benchmark_spsc(256);
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     printf("Testing fifo_peek ... ");
@@ -266,4 +565,21 @@ int main(int argc, char *argv[])
     test_pop_empty();
     printf("Success!\n");
 
+    printf("Testing spans ... ");
+    test_spans();
+    printf("Success!\n");
+
+    printf("Testing power of 2 and other sizes ... ");
+    test_power_of_two();
+    printf("Success!\n");
+
+    printf("Testing spsc fifo ... ");
+    test_spsc();
+    printf("Success!\n");
+
+#ifdef FIFO_BENCHMARK
+    printf("Benchmarks:\n");
+    run_benchmarks();
+#endif
+
 }
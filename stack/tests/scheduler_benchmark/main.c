@@ -0,0 +1,163 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "scheduler.h"
+#include "errors.h"
+#include "debug.h"
+
+/*
+ * Benchmark of the scheduler on the NATIVE platform.
+ *
+ * It compares the function pointer API (sched_post_task_prio(), which has to look up the task
+ * in the sorted task index on every call) with the handle API (sched_post_handle_prio(), which
+ * indexes the task directly). Both the raw post/cancel cost and the post-to-dispatch latency
+ * through scheduler_run() are measured. The scheduler is filled with dummy tasks first so the
+ * task index has a realistic size.
+ *
+ * When FRAMEWORK_SCHED_PROFILING is set the profile of the latency task is checked and printed as well,
+ * including the overhead of keeping it.
+ */
+
+#define ITERATIONS 1000000
+
+static uint64_t get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#define DUMMY_TASK(n) static void dummy_task_##n(void *arg) {}
+DUMMY_TASK(0) DUMMY_TASK(1) DUMMY_TASK(2) DUMMY_TASK(3) DUMMY_TASK(4) DUMMY_TASK(5) DUMMY_TASK(6) DUMMY_TASK(7)
+DUMMY_TASK(8) DUMMY_TASK(9) DUMMY_TASK(10) DUMMY_TASK(11) DUMMY_TASK(12) DUMMY_TASK(13) DUMMY_TASK(14) DUMMY_TASK(15)
+DUMMY_TASK(16) DUMMY_TASK(17) DUMMY_TASK(18) DUMMY_TASK(19) DUMMY_TASK(20) DUMMY_TASK(21) DUMMY_TASK(22) DUMMY_TASK(23)
+
+static const task_t dummy_tasks[] = {
+    dummy_task_0, dummy_task_1, dummy_task_2, dummy_task_3, dummy_task_4, dummy_task_5, dummy_task_6, dummy_task_7,
+    dummy_task_8, dummy_task_9, dummy_task_10, dummy_task_11, dummy_task_12, dummy_task_13, dummy_task_14, dummy_task_15,
+    dummy_task_16, dummy_task_17, dummy_task_18, dummy_task_19, dummy_task_20, dummy_task_21, dummy_task_22, dummy_task_23,
+};
+
+static void latency_task(void *arg);
+static sched_task_handle_t latency_task_handle;
+
+static bool use_handle = false;
+static uint32_t latency_count = 0;
+static uint64_t post_time = 0;
+static uint64_t total_latency = 0;
+static uint64_t max_latency = 0;
+
+static void bench_post_cancel()
+{
+    uint64_t start = get_time_ns();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        sched_post_task_prio(&latency_task, MAX_PRIORITY, NULL);
+        sched_cancel_task(&latency_task);
+    }
+
+    uint64_t fp_duration = get_time_ns() - start;
+
+    start = get_time_ns();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        sched_post_handle_prio(latency_task_handle, MAX_PRIORITY, NULL);
+        sched_cancel_handle(latency_task_handle);
+    }
+
+    uint64_t handle_duration = get_time_ns() - start;
+
+    printf("post + cancel, function pointer API: %6.1f ns/op\n", (double)fp_duration / ITERATIONS);
+    printf("post + cancel, handle API:           %6.1f ns/op\n", (double)handle_duration / ITERATIONS);
+}
+
+static void post_latency_task()
+{
+    post_time = get_time_ns();
+    error_t err;
+    if(use_handle)
+        err = sched_post_handle_prio(latency_task_handle, MIN_PRIORITY, NULL);
+    else
+        err = sched_post_task_prio(&latency_task, MIN_PRIORITY, NULL);
+
+    assert(err == SUCCESS);
+}
+
+#ifdef FRAMEWORK_SCHED_PROFILING
+static void print_profile()
+{
+    const sched_task_profile_t* profile = sched_get_task_profile(latency_task_handle);
+    assert(profile->invocations == 2 * ITERATIONS - 1); // the current run is not finished yet
+    printf("profile of latency task: %u invocations, run time total %u max %u, latency total %u max %u ticks\n",
+           profile->invocations, profile->total_run_time, profile->max_run_time, profile->total_latency, profile->max_latency);
+
+    assert(sched_get_task(latency_task_handle) == &latency_task);
+    assert(sched_get_profile()->queue_high_watermark[MIN_PRIORITY] == 1);
+    assert(sched_get_profile()->queue_high_watermark[MAX_PRIORITY] == 1); // from bench_post_cancel()
+
+    sched_reset_profile();
+    assert(sched_get_task_profile(latency_task_handle)->invocations == 0);
+}
+#endif
+
+static void latency_task(void *arg)
+{
+    uint64_t latency = get_time_ns() - post_time;
+    total_latency += latency;
+    if(latency > max_latency)
+        max_latency = latency;
+
+    latency_count++;
+    if(latency_count < ITERATIONS)
+    {
+        post_latency_task();
+        return;
+    }
+
+    printf("post-to-dispatch, %-21s avg %6.1f ns, max %8llu ns\n", use_handle ? "handle API:" : "function pointer API:",
+           (double)total_latency / ITERATIONS, (unsigned long long)max_latency);
+
+    if(use_handle)
+    {
+#ifdef FRAMEWORK_SCHED_PROFILING
+        print_profile();
+#endif
+        exit(0);
+    }
+
+    use_handle = true;
+    latency_count = 0;
+    total_latency = 0;
+    max_latency = 0;
+    post_latency_task();
+}
+
+void bootstrap()
+{
+    for(uint8_t i = 0; i < sizeof(dummy_tasks) / sizeof(dummy_tasks[0]); i++)
+        sched_register_task(dummy_tasks[i]);
+
+    assert(sched_register_task_handle(&latency_task, &latency_task_handle) == SUCCESS);
+    assert(sched_get_task_handle(&latency_task) == latency_task_handle);
+
+    printf("Benchmarking scheduler with %i iterations\n", ITERATIONS);
+    bench_post_cancel();
+    post_latency_task();
+}
@@ -0,0 +1,203 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2019 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "modem_interface.h"
+#include "platform.h"
+#include "crc.h"
+#include "fifo.h"
+#include "errors.h"
+#include "debug.h"
+#include "framework_defs.h"
+
+/*
+ * Throughput test of the modem interface RX path on the NATIVE platform.
+ *
+ * A host thread writes serial frames to the pseudo-terminal backing UART 0. They are delivered in blocks to the
+ * modem interface, parsed by process_rx_fifo() and passed to the ALP handler, which checks the payload of every
+ * message. The messages are sent one per frame using serial protocol v0 first, and then batched in v1 frames when
+ * the modem interface is built with v1 support. The test fails when a message is lost or corrupted.
+ */
+
+#define MESSAGE_COUNT 65536
+#define PAYLOAD_SIZE 64
+#define FRAME_HEADER_SIZE 7
+#define RECORD_HEADER_SIZE 2
+#define RECORDS_PER_FRAME 3
+#define V0_FRAME_SIZE (FRAME_HEADER_SIZE + PAYLOAD_SIZE)
+#define V1_FRAME_SIZE (FRAME_HEADER_SIZE + RECORDS_PER_FRAME * (RECORD_HEADER_SIZE + PAYLOAD_SIZE))
+#define FRAMES_PER_WRITE 16
+#define V1_FRAME_COUNT (MESSAGE_COUNT / RECORDS_PER_FRAME / FRAMES_PER_WRITE * FRAMES_PER_WRITE)
+
+static uint32_t received_messages = 0;
+static uint64_t start_time;
+
+static uint64_t get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void build_payload(uint8_t* payload, uint32_t index)
+{
+    for(uint8_t i = 0; i < PAYLOAD_SIZE; i++)
+        payload[i] = (uint8_t)(index + i);
+}
+
+static void build_header(uint8_t* frame, uint8_t version, uint8_t counter, uint8_t type, uint8_t length)
+{
+    frame[0] = 0xC0; // sync byte
+    frame[1] = version;
+    frame[2] = counter;
+    frame[3] = type;
+    frame[4] = length;
+
+    // v1 also protects the sequence number, acknowledgement and length
+    crc_ctx_t crc_ctx;
+    crc_init(&crc_ctx);
+    if(version == 1)
+        crc_update(&crc_ctx, frame + 2, 3);
+
+    crc_update(&crc_ctx, frame + FRAME_HEADER_SIZE, length);
+    uint16_t crc = crc_final(&crc_ctx);
+    frame[5] = crc >> 8;
+    frame[6] = crc & 0xFF;
+}
+
+static void build_v0_frame(uint8_t* frame, uint32_t index)
+{
+    build_payload(frame + FRAME_HEADER_SIZE, index);
+    // the modem interface expects the counter of the first frame to be 1
+    build_header(frame, 0, (uint8_t)(index + 1), SERIAL_MESSAGE_TYPE_ALP_DATA, PAYLOAD_SIZE);
+}
+
+static void build_v1_frame(uint8_t* frame, uint32_t index)
+{
+    uint8_t* record = frame + FRAME_HEADER_SIZE;
+    for(uint8_t i = 0; i < RECORDS_PER_FRAME; i++)
+    {
+        record[0] = SERIAL_MESSAGE_TYPE_ALP_DATA;
+        record[1] = PAYLOAD_SIZE;
+        build_payload(record + RECORD_HEADER_SIZE, MESSAGE_COUNT + index * RECORDS_PER_FRAME + i);
+        record += RECORD_HEADER_SIZE + PAYLOAD_SIZE;
+    }
+
+    // sequence numbers start at 1, the messages of the modem interface are not acknowledged
+    build_header(frame, 1, (uint8_t)(index + 1), 0, V1_FRAME_SIZE - FRAME_HEADER_SIZE);
+}
+
+static void write_all(int fd, uint8_t* data, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        assert(written > 0);
+        data += written;
+        length -= written;
+    }
+}
+
+// the acknowledgements sent by the modem interface are discarded, but they have to be read to prevent the
+// pseudo-terminal from blocking the stack when its buffer is full
+static void* host_reader(void* arg)
+{
+    int fd = *(int*)arg;
+    uint8_t buffer[256];
+    while(read(fd, buffer, sizeof(buffer)) > 0);
+    return NULL;
+}
+
+static void* host_writer(void* arg)
+{
+    static int fd;
+    fd = open(native_uart_get_pty_name(0), O_RDWR | O_NOCTTY);
+    assert(fd >= 0);
+
+    pthread_t reader;
+    assert(pthread_create(&reader, NULL, &host_reader, &fd) == 0);
+
+    static uint8_t frames[FRAMES_PER_WRITE * V1_FRAME_SIZE];
+    for(uint32_t index = 0; index < MESSAGE_COUNT; index += FRAMES_PER_WRITE)
+    {
+        for(uint8_t i = 0; i < FRAMES_PER_WRITE; i++)
+            build_v0_frame(frames + i * V0_FRAME_SIZE, index + i);
+
+        write_all(fd, frames, FRAMES_PER_WRITE * V0_FRAME_SIZE);
+    }
+
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION >= 1
+    for(uint32_t index = 0; index < V1_FRAME_COUNT; index += FRAMES_PER_WRITE)
+    {
+        for(uint8_t i = 0; i < FRAMES_PER_WRITE; i++)
+            build_v1_frame(frames + i * V1_FRAME_SIZE, index + i);
+
+        write_all(fd, frames, FRAMES_PER_WRITE * V1_FRAME_SIZE);
+    }
+#endif
+
+    return NULL;
+}
+
+static void print_result(char* protocol, uint32_t frame_size, uint32_t frame_count, uint32_t message_count)
+{
+    uint64_t now = get_time_ns();
+    double duration_s = (double)(now - start_time) / 1000000000;
+    printf("%s: received %i messages (%i bytes) in %.3f s, %.2f MB/s\n", protocol, message_count,
+           frame_size * frame_count, duration_s, (double)frame_size * frame_count / duration_s / 1000000);
+    start_time = now;
+}
+
+static void alp_handler(fifo_t* cmd_fifo)
+{
+    uint8_t payload[PAYLOAD_SIZE];
+    assert(fifo_get_size(cmd_fifo) == PAYLOAD_SIZE);
+    fifo_pop(cmd_fifo, payload, PAYLOAD_SIZE);
+    for(uint8_t i = 0; i < PAYLOAD_SIZE; i++)
+        assert(payload[i] == (uint8_t)(received_messages + i));
+
+    received_messages++;
+    if(received_messages == MESSAGE_COUNT)
+    {
+        print_result("v0", V0_FRAME_SIZE, MESSAGE_COUNT, MESSAGE_COUNT);
+#if FRAMEWORK_MODEM_INTERFACE_PROTOCOL_VERSION < 1
+        exit(0);
+#endif
+    }
+
+    if(received_messages == MESSAGE_COUNT + V1_FRAME_COUNT * RECORDS_PER_FRAME)
+    {
+        print_result("v1", V1_FRAME_SIZE, V1_FRAME_COUNT, V1_FRAME_COUNT * RECORDS_PER_FRAME);
+        exit(0);
+    }
+}
+
+void bootstrap()
+{
+    modem_interface_init(0, 115200, 0, 0);
+    modem_interface_register_handler(&alp_handler, SERIAL_MESSAGE_TYPE_ALP_DATA);
+
+    printf("Pushing %i messages of %i bytes through the modem interface\n", MESSAGE_COUNT, PAYLOAD_SIZE);
+    start_time = get_time_ns();
+    pthread_t writer;
+    assert(pthread_create(&writer, NULL, &host_writer, NULL) == 0);
+}
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+
+# Converts the output of the sniffer app into a capture file which can be replayed on the NATIVE platform, see
+# framework/inc/radio_capture.h for the format. Bytes which are not part of a capture record (for example the boot
+# message) are skipped.
+#
+# usage: sniffer_to_capture.py <capture file> [-i <file>] [-s <serial port> -b <baudrate>] [-t <timer ticks/s>]
+
+import argparse
+import struct
+import sys
+
+RADIO_CAPTURE_MAGIC = 0x43413744
+RADIO_CAPTURE_VERSION = 1
+RADIO_CAPTURE_SERIAL_SYNC = 0xC0
+RADIO_CAPTURE_SERIAL_RECORD = 0x02
+
+HEADER_FORMAT = "<IB3xI"
+RECORD_FORMAT = "<IBHBhBBH"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+MAX_FRAME_SIZE = 512 # larger frames are treated as corrupt records
+
+
+class Converter:
+  def __init__(self, output):
+    self.output = output
+    self.buffer = bytearray()
+    self.records = 0
+    self.skipped = 0
+
+  def feed(self, data):
+    self.buffer += data
+    while len(self.buffer) >= 2:
+      if self.buffer[0] != RADIO_CAPTURE_SERIAL_SYNC or self.buffer[1] != RADIO_CAPTURE_SERIAL_RECORD:
+        del self.buffer[0]
+        self.skipped += 1
+        continue
+
+      if len(self.buffer) < 2 + RECORD_SIZE:
+        break
+
+      length = struct.unpack_from(RECORD_FORMAT, self.buffer, 2)[-1]
+      if length > MAX_FRAME_SIZE:
+        del self.buffer[0]
+        self.skipped += 1
+        continue
+
+      if len(self.buffer) < 2 + RECORD_SIZE + length:
+        break
+
+      self.output.write(self.buffer[2:2 + RECORD_SIZE + length])
+      del self.buffer[:2 + RECORD_SIZE + length]
+      self.records += 1
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Converts the output of the sniffer app into a capture file.")
+  parser.add_argument("capture", help="the capture file to write")
+  parser.add_argument("-i", "--input", help="file containing the sniffer output, stdin by default")
+  parser.add_argument("-s", "--serial", help="serial port to read the sniffer output from")
+  parser.add_argument("-b", "--baudrate", help="baudrate", type=int, default=115200)
+  parser.add_argument("-t", "--ticks-per-sec", help="the resolution of the timer of the sniffer (default 1024)",
+                      type=int, default=1024)
+  config = parser.parse_args()
+
+  with open(config.capture, "wb") as output:
+    output.write(struct.pack(HEADER_FORMAT, RADIO_CAPTURE_MAGIC, RADIO_CAPTURE_VERSION, config.ticks_per_sec))
+    converter = Converter(output)
+    if config.serial:
+      import serial
+      source = serial.Serial(config.serial, config.baudrate)
+      read = lambda: source.read(max(1, source.in_waiting))
+    else:
+      source = open(config.input, "rb") if config.input else sys.stdin.buffer
+      read = lambda: source.read1(4096)
+
+    try:
+      while True:
+        data = read()
+        if not data:
+          break
+        converter.feed(data)
+    except KeyboardInterrupt:
+      pass
+
+  sys.stderr.write("%i frames captured, %i bytes skipped\n" % (converter.records, converter.skipped))
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+
+# Decodes the output of the binary logging (FRAMEWORK_LOG_BINARY) back into the text which the printf based logging
+# would have produced. The format strings are looked up in the ELF file of the application, using the addresses
+# contained in the log records. Bytes which are not part of a log record (for example printf() output) are passed
+# through unchanged.
+#
+# usage: decode_binary_log.py <elf> [-i <file>] [-s <serial port> -b <baudrate>]
+
+import argparse
+import re
+import struct
+import sys
+
+LOG_RECORD_SYNC = 0xA5
+LOG_RECORD_HEADER_SIZE = 8
+LOG_RECORD_STRING = 0x00
+LOG_RECORD_DATA = 0x01
+LOG_RECORD_DATA_CONTINUED = 0x02
+LOG_RECORD_DROPPED = 0x03
+LOG_RECORD_ANCHOR = 0x04
+
+# see log_stack_layer_t in framework/inc/log.h
+LAYERS = {
+  0x00: "", 0x01: "PHY", 0x02: "DLL", 0x03: "MAC", 0x04: "NWL", 0x05: "TRANS", 0x06: "SESSION", 0x07: "D7AP",
+  0x08: "ALP", 0x10: "FWK", 0x11: "EM"
+}
+
+FORMAT_SPECIFIER = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diuxXcsp%])")
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+
+
+class Elf:
+  def __init__(self, path):
+    with open(path, "rb") as f:
+      self.data = f.read()
+
+    assert self.data[:4] == b"\x7fELF", "not an ELF file"
+    self.is_64 = self.data[4] == 2
+    self.endian = "<" if self.data[5] == 1 else ">"
+    self.word_size = 8 if self.is_64 else 4
+    if self.is_64:
+      shoff, = struct.unpack_from(self.endian + "Q", self.data, 0x28)
+      shentsize, shnum, shstrndx = struct.unpack_from(self.endian + "HHH", self.data, 0x3A)
+    else:
+      shoff, = struct.unpack_from(self.endian + "I", self.data, 0x20)
+      shentsize, shnum, shstrndx = struct.unpack_from(self.endian + "HHH", self.data, 0x2E)
+
+    self.sections = [self.parse_section(shoff + i * shentsize) for i in range(shnum)]
+    names = self.sections[shstrndx]
+    for section in self.sections:
+      section["name"] = self.read_string(names["offset"] + section["name_idx"])
+
+    self.symbols = {}
+    for section in self.sections:
+      if section["type"] == SHT_SYMTAB:
+        self.parse_symbols(section, self.sections[section["link"]])
+
+  def parse_section(self, offset):
+    if self.is_64:
+      name_idx, type, flags, addr, off, size, link = struct.unpack_from(self.endian + "IIQQQQI", self.data, offset)
+    else:
+      name_idx, type, flags, addr, off, size, link = struct.unpack_from(self.endian + "IIIIIII", self.data, offset)
+
+    return { "name_idx": name_idx, "type": type, "flags": flags, "addr": addr, "offset": off, "size": size, "link": link }
+
+  def parse_symbols(self, symtab, strtab):
+    entry_size = 24 if self.is_64 else 16
+    for offset in range(symtab["offset"], symtab["offset"] + symtab["size"], entry_size):
+      if self.is_64:
+        name_idx, = struct.unpack_from(self.endian + "I", self.data, offset)
+        value, = struct.unpack_from(self.endian + "Q", self.data, offset + 8)
+      else:
+        name_idx, value = struct.unpack_from(self.endian + "II", self.data, offset)
+
+      if name_idx:
+        self.symbols[self.read_string(strtab["offset"] + name_idx)] = value
+
+  def read_string(self, offset):
+    end = self.data.index(b"\0", offset)
+    return self.data[offset:end].decode("utf-8", "replace")
+
+  def string_at(self, address):
+    for section in self.sections:
+      if section["flags"] & SHF_ALLOC and section["type"] != SHT_NOBITS \
+          and section["addr"] <= address < section["addr"] + section["size"]:
+        return self.read_string(section["offset"] + address - section["addr"])
+
+    return None
+
+
+class Decoder:
+  def __init__(self, elf, output):
+    self.elf = elf
+    self.output = output
+    self.buffer = bytearray()
+    self.counter = 0
+    self.relocation = 0 # difference between the runtime and the ELF addresses, for position independent executables
+
+  def expand(self, format, args):
+    args = list(args)
+
+    def replace(match):
+      flags, width, precision, conversion = match.groups()
+      if conversion == "%":
+        return "%"
+
+      if not args:
+        return match.group(0)
+
+      arg = args.pop(0)
+      spec = "%" + flags + width + ("." + precision if precision else "")
+      if conversion == "s":
+        string = self.elf.string_at(arg - self.relocation)
+        return (spec + "s") % (string if string is not None else "<0x%x>" % arg)
+      if conversion == "p":
+        return "0x%x" % arg
+
+      arg &= 0xFFFFFFFF # the arguments are ints, the upper bits of wider words are undefined
+      if conversion in "di":
+        return (spec + "d") % (arg - (1 << 32) if arg & 0x80000000 else arg)
+      if conversion == "u":
+        return (spec + "d") % arg
+      if conversion == "c":
+        return (spec + "c") % (arg & 0xFF)
+      return (spec + conversion) % arg
+
+    return FORMAT_SPECIFIER.sub(replace, format)
+
+  def print_record(self, kind, layer, timestamp, payload):
+    word_size = self.elf.word_size
+    if kind == LOG_RECORD_ANCHOR:
+      anchor, = struct.unpack("<" + ("Q" if word_size == 8 else "I"), payload)
+      self.relocation = anchor - self.elf.symbols.get("log_binary_anchor", anchor)
+      return
+
+    if kind == LOG_RECORD_DATA_CONTINUED:
+      self.output.write("".join(" %02X" % b for b in payload))
+      return
+
+    self.output.write("\n\r[%03d] %10u %-7s " % (self.counter, timestamp, LAYERS.get(layer, "0x%02x" % layer)))
+    self.counter += 1
+    if kind == LOG_RECORD_STRING:
+      words = struct.unpack("<%i%s" % (len(payload) // word_size, "Q" if word_size == 8 else "I"), payload)
+      format = self.elf.string_at(words[0] - self.relocation)
+      if format is None:
+        self.output.write("<unknown format string 0x%x>" % words[0])
+      else:
+        self.output.write(self.expand(format, words[1:]))
+    elif kind == LOG_RECORD_DATA:
+      self.output.write("".join(" %02X" % b for b in payload))
+    elif kind == LOG_RECORD_DROPPED:
+      self.output.write("!!! %i log records dropped" % struct.unpack("<I", payload))
+
+  def feed(self, data):
+    self.buffer += data
+    while self.buffer:
+      if self.buffer[0] != LOG_RECORD_SYNC or (len(self.buffer) > 1 and self.buffer[1] > LOG_RECORD_ANCHOR):
+        self.output.write(chr(self.buffer[0]))
+        del self.buffer[0]
+        continue
+
+      if len(self.buffer) < LOG_RECORD_HEADER_SIZE or len(self.buffer) < LOG_RECORD_HEADER_SIZE + self.buffer[3]:
+        break
+
+      kind, layer, length, timestamp = struct.unpack_from("<BBBI", self.buffer, 1)
+      payload = bytes(self.buffer[LOG_RECORD_HEADER_SIZE:LOG_RECORD_HEADER_SIZE + length])
+      del self.buffer[:LOG_RECORD_HEADER_SIZE + length]
+      self.print_record(kind, layer, timestamp, payload)
+
+    self.output.flush()
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Decodes binary log output using the ELF file of the application.")
+  parser.add_argument("elf", help="the ELF file of the application which produced the log")
+  parser.add_argument("-i", "--input", help="file containing the log output, stdin by default")
+  parser.add_argument("-s", "--serial", help="serial port to read the log output from")
+  parser.add_argument("-b", "--baudrate", help="baudrate", type=int, default=115200)
+  config = parser.parse_args()
+
+  decoder = Decoder(Elf(config.elf), sys.stdout)
+  if config.serial:
+    import serial
+    source = serial.Serial(config.serial, config.baudrate)
+    read = lambda: source.read(max(1, source.in_waiting))
+  else:
+    source = open(config.input, "rb") if config.input else sys.stdin.buffer
+    read = lambda: source.read1(4096)
+
+  try:
+    while True:
+      data = read()
+      if not data:
+        break
+      decoder.feed(data)
+  except KeyboardInterrupt:
+    pass
+
+  sys.stdout.write("\n")